@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "haplotypes.h"
+#include "tajd.h"
+
+/* Site based statistics for nucleotide ('A', 'G', 'C', 'T') data,
+ * as produced by seq-gen. Per site counts are kept with the convention
+ * 0 -> 'A', 1 -> 'G', 2 -> 'C', 3 -> 'T'. */
+
+/* Calculate the frequencies of 'A', 'G', 'C', and 'T' at each site
+ * in the data list. For each site, the site_frequencies array has
+ * an array with four positions.
+ *
+ *      nsam        - total number of samples in data list
+ *      nsites      - total number of positions
+ *      list        - the data ( samples by positions matrix of chars )
+ *      site_freqs  - 2D matrix with enough rows for each site and 4 int columns
+ *
+ * Returns nothing (updates the passed-by-references site_frequencies
+ */
+void calculate_site_frequencies(int   nsam,
+                                int   nsites,
+                                char  **list,
+                                int   **site_freqs)
+{
+    int     i;                  /* iterator */
+
+    for (i=0; i<nsites; i++) {
+        site_freqs[i][0] = frequency( 'A', i, nsam, list );
+        site_freqs[i][1] = frequency( 'G', i, nsam, list );
+        site_freqs[i][2] = frequency( 'C', i, nsam, list );
+        site_freqs[i][3] = frequency( 'T', i, nsam, list );
+    }
+}
+
+/*  Calculate the number of segregating sites
+ *
+ *      nsam            - total number of samples
+ *      nsites          - total number of sites
+ *      site_freqs      - array with nucleotide counts per site
+ *
+ *  Returns an integer
+ */
+int num_segregating_sites(int nsam, int nsites, int **site_freqs)
+{
+    int     i,j,                /* iterators */
+            addone,             /* flag to say if we should increment the
+                                 * count */
+            count;              /* running count of segregating sites */
+
+    count = 0;
+
+    /* run through site_freqs, upping the segregating site count every
+     * time we find a site where one of the individual nucleotide counts
+     * is neither 0 nor the max (which means there must be variation!) */
+    for (i=0; i<nsites; i++) {
+        addone = 0;
+        for (j=0; j<4; j++) {
+            if (site_freqs[i][j] != 0 && site_freqs[i][j] != nsam) {
+                addone = 1;
+            }
+        }
+        if (addone) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*  Calculate pi (nucleotide diversity)
+ *
+ *      nsam            - total number of samples
+ *      nsites          - total number of sites
+ *      site_freqs      - array with nucleotide counts per site
+ *
+ *  Returns a double
+ */
+double agct_theta_pi(int nsam, int nsites, int **site_freqs)
+{
+    int     i,j;                /* iterators */
+    double  pi,                 /* what we are calculating */
+            ssh,                /* sum of site homozygosity */
+            nd,                 /* nsam cast to double value */
+            denom;              /* nsam * (nsam - 1) */
+
+    pi = 0.0 ;
+
+    /* create a double with the value of nsam */
+    nd = nsam;
+    denom = nd * (nd - 1.0);
+
+    for (i=0; i<nsites; i++) {
+        ssh = 0.0;
+        for (j=0; j<4; j++) {
+            ssh += (site_freqs[i][j] * (site_freqs[i][j] - 1.0))/denom;
+        }
+        pi += 1.0 - ssh;
+    }
+
+    return pi;
+}
+
+/*  Count the pairwise differences: the pairs of samples that do not
+ *    share a base, summed over the sites. pi is this over the
+ *    nsam*(nsam-1)/2 pairs, as agct_theta_pi() gives it, but summed in
+ *    integers, so it is exact however the sites are taken.
+ *
+ *      nsam            - total number of samples
+ *      nsites          - total number of sites
+ *      site_freqs      - array with nucleotide counts per site
+ *
+ *  Returns a 64 bit integer
+ */
+int64_t agct_pair_differences(int nsam, int nsites, int **site_freqs)
+{
+    int     i,j;                /* iterators */
+    int64_t same,               /* ordered pairs sharing a base, all sites */
+            c;                  /* count of one base at one site */
+
+    same = 0;
+    for (i=0; i<nsites; i++) {
+        for (j=0; j<4; j++) {
+            c = site_freqs[i][j];
+            same += c*(c - 1);
+        }
+    }
+
+    return ((int64_t)nsites*nsam*(nsam - 1) - same)/2;
+}
+
+/*  Calculates Watterson's theta
+ *
+ *      nsam            - total number of samples in data list
+ *      segsites        - total number of segregating sites
+ *
+ *  Returns a double with the calculated value
+ */
+double agct_theta_w(int nsam, int segsites)
+{
+    double  denom;              /* denominator of Watterson's theta */
+
+    denom = a1f(nsam);
+
+    return segsites/denom;
+}
+
+/*  Count the total number of singleton sites in the data.
+ *    This is the number of variant sites appearing once
+ *    and only once in the entire dataset.
+ *
+ *      nsites          - total number of sites
+ *      site_freqs      - array with nucleotide counts per site
+ *
+ *  Returns an integer
+ */
+int agct_num_singleton_sites(int nsites, int **site_freqs)
+{
+    int     i,j,                /* iterators */
+            num_ones,           /* how many sites have a frequency of 1 */
+            num_gt_zero,        /* how many sites have a frequency > 0 */
+            count;              /* running total */
+
+    count = 0;
+
+    for (i=0; i<nsites; i++) {
+        num_ones = 0;
+        num_gt_zero = 0;
+        for (j=0; j<4; j++) {
+            if (site_freqs[i][j] == 1)
+                num_ones++;
+            if (site_freqs[i][j] > 0)
+                num_gt_zero++;
+        }
+        if (num_ones == 1 && num_gt_zero == 2)
+          count++;
+    }
+
+    return count;
+}
+
+/*  Build the folded site frequency spectrum: how many sites have a
+ *    minor allele in 1, 2, ..., nsam/2 samples. The ancestral state is
+ *    not known, so only the counts of the two alleles at a site are
+ *    used; sites with more than two nucleotides are left out.
+ *
+ *      nsam            - total number of samples
+ *      nsites          - total number of sites
+ *      site_freqs      - array with nucleotide counts per site
+ *      sfs             - the array to fill (length nsam/2); sfs[i-1]
+ *                        is the number of sites with minor allele count i
+ *
+ *  Returns the length of the spectrum (nsam/2)
+ */
+int folded_site_frequency_spectrum(int nsam, int nsites, int **site_freqs, int *sfs)
+{
+    int     i,j,                /* iterators */
+            alleles,            /* number of nucleotides seen at a site */
+            minor;              /* smallest non-zero nucleotide count */
+
+    for (i=0; i<nsam/2; i++)
+        sfs[i] = 0;
+
+    for (i=0; i<nsites; i++) {
+        alleles = 0;
+        minor = nsam;
+        for (j=0; j<4; j++) {
+            if (site_freqs[i][j] > 0) {
+                alleles++;
+                if (site_freqs[i][j] < minor)
+                    minor = site_freqs[i][j];
+            }
+        }
+        if (alleles == 2 && minor <= nsam/2)
+            sfs[minor - 1]++;
+    }
+
+    return nsam/2;
+}
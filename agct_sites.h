@@ -0,0 +1,9 @@
+#include <stdint.h>
+
+void calculate_site_frequencies(int nsam, int nsites, char **list, int **site_freqs);
+int num_segregating_sites(int nsam, int nsites, int **site_freqs);
+double agct_theta_pi(int nsam, int nsites, int **site_freqs);
+int64_t agct_pair_differences(int nsam, int nsites, int **site_freqs);
+double agct_theta_w(int nsam, int segsites);
+int agct_num_singleton_sites(int nsites, int **site_freqs);
+int folded_site_frequency_spectrum(int nsam, int nsites, int **site_freqs, int *sfs);
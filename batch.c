@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "batch.h"
+
+/* Kernels for batches of small nucleotide replicates (see batch.h) */
+
+#define LOW7        0x7F7F7F7F7F7F7F7FULL   /* the low 7 bits of every byte */
+#define ONES        0x0101010101010101ULL   /* 1 in every byte */
+
+/*  Find the bytes of a word equal to a character
+ *
+ *      x           - 8 sites of a row
+ *      c           - the character
+ *
+ *  Returns a word with 1 in each byte of x equal to c, 0 in the others
+ */
+static uint64_t matches(uint64_t x, unsigned char c)
+{
+    uint64_t    y;                  /* zero where x is c */
+
+    y = x ^ (ONES*c);
+    return ~(((y & LOW7) + LOW7) | y | LOW7) >> 7;
+}
+
+/*  Fetch up to 8 sites of a row, the bytes past the end as 0
+ *
+ *      p           - the first site
+ *      n           - number of sites, 1 .. 8
+ *
+ *  Returns the word
+ */
+static uint64_t load_sites(const unsigned char *p, int n)
+{
+    uint64_t    x;                  /* the word */
+
+    x = 0;
+    memcpy(&x, p, (size_t)n);
+    return x;
+}
+
+/*  Fold a word into a hash
+ *
+ *      h           - the hash so far
+ *      w           - the word
+ *
+ *  Returns the new hash
+ */
+static uint64_t mix(uint64_t h, uint64_t w)
+{
+    h ^= w;
+    h *= 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 29);
+}
+
+/*  Make sure the scratch space can hold the counts of a batch
+ *
+ *      s           - the scratch space (zeroed before first use)
+ *      nwords      - words of counts of all the replicates of the batch
+ *
+ *  Returns 0, or -1 if out of memory
+ */
+int batch_reserve(struct batch_scratch *s, size_t nwords)
+{
+    void    *p;                 /* result of the reallocation */
+
+    if (nwords > s->counts_size) {
+        if (!(p = realloc(s->counts, nwords*sizeof(uint64_t))))
+            return -1;
+        s->counts = (uint64_t *)p;
+        s->counts_size = nwords;
+    }
+    return 0;
+}
+
+/*  Free what the scratch space holds
+ *
+ *      s           - the scratch space
+ *
+ *  Returns nothing
+ */
+void batch_scratch_free(struct batch_scratch *s)
+{
+    free(s->counts);
+    memset(s, 0, sizeof(*s));
+}
+
+/*  Count the bases at each site of a replicate
+ *
+ *      nsam        - number of samples (at most BATCH_MAXSAM)
+ *      nsites      - number of sites
+ *      data        - the first row, one char per site
+ *      stride      - bytes from one row to the next
+ *      counts      - where to put the counts (BATCH_WORDS(nsites)): word
+ *                    4*k + b holds those of base b ('A', 'G', 'C', 'T') at
+ *                    sites 8*k .. 8*k + 7, site 8*k + s in byte s
+ *
+ *  Returns nothing
+ */
+void batch_counts(int nsam, int nsites, const unsigned char *data, size_t stride,
+                  uint64_t *counts)
+{
+    int                 i, k;   /* iterators */
+    int                 nfull;  /* words of 8 sites */
+    uint64_t            x,      /* 8 sites of a row */
+                        *c;     /* the counts of those sites */
+    const unsigned char *p;     /* the current row */
+
+    memset(counts, 0, BATCH_WORDS(nsites)*sizeof(uint64_t));
+    nfull = nsites/8;
+    for (i=0; i<nsam; i++) {
+        p = data + (size_t)i*stride;
+        for (k=0; k<=nfull; k++) {
+            if (k < nfull)
+                memcpy(&x, p + 8*k, 8);
+            else if (nsites % 8 != 0)
+                x = load_sites(p + 8*k, nsites % 8);
+            else
+                break;
+            c = counts + 4*k;
+            c[0] += matches(x, 'A');
+            c[1] += matches(x, 'G');
+            c[2] += matches(x, 'C');
+            c[3] += matches(x, 'T');
+        }
+    }
+}
+
+/*  Sum the site statistics of a replicate from its base counts, and count
+ *    the bases each sample alone has, as count_agct_unic_frequencies() does
+ *
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      data        - the first row, one char per site
+ *      stride      - bytes from one row to the next
+ *      counts      - the counts, from batch_counts()
+ *      sums        - where to put the sums
+ *      unic_freqs  - where to put the counts (length nsam), or NULL
+ *
+ *  Returns nothing
+ */
+void batch_sites(int nsam, int nsites, const unsigned char *data, size_t stride,
+                 const uint64_t *counts, struct batch_sums *sums, int *unic_freqs)
+{
+    int                 i, j, b;    /* iterators */
+    int                 c,          /* count of one base at one site */
+                        ones,       /* bases seen once at the site */
+                        present,    /* bases seen at all */
+                        seg;        /* 1 if the site segregates */
+    int64_t             same;       /* ordered pairs sharing a base, all sites */
+    const unsigned char *bytes;     /* the counts, a byte each */
+    const char          *agct;      /* the bases, in the order of the counts */
+
+    agct = "AGCT";
+    bytes = (const unsigned char *)counts;
+    if (unic_freqs != NULL)
+        for (i=0; i<nsam; i++)
+            unic_freqs[i] = 0;
+    same = 0;
+    sums->ss = sums->nss = 0;
+    for (j=0; j<nsites; j++) {
+        ones = present = seg = 0;
+        for (b=0; b<4; b++) {
+            c = bytes[8*(4*(j/8) + b) + j % 8];
+            same += c*(c - 1);
+            ones += c == 1;
+            present += c > 0;
+            seg |= c != 0 && c != nsam;
+            if (c == 1 && unic_freqs != NULL) {
+                /* find the sample that has it */
+                for (i=0; data[(size_t)i*stride + j] != agct[b]; i++)
+                    ;
+                unic_freqs[i] += 1;
+            }
+        }
+        sums->ss += seg;
+        sums->nss += ones == 1 && present == 2;
+    }
+    sums->diffs = ((int64_t)nsites*nsam*(nsam - 1) - same)/2;
+}
+
+/*  Count the haplotypes of a replicate, as count_haplotype_frequencies()
+ *    does: the first sample of each haplotype gets its count and the
+ *    others -9. Rows are compared only where their hashes agree.
+ *
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      data        - the first row, one char per site
+ *      stride      - bytes from one row to the next
+ *      hashes      - room for a hash per sample
+ *      hap_freqs   - where to put the counts (length nsam)
+ *
+ *  Returns nothing
+ */
+void batch_haplotypes(int nsam, int nsites, const unsigned char *data, size_t stride,
+                      uint64_t *hashes, int *hap_freqs)
+{
+    int                 i, j, k;    /* iterators */
+    uint64_t            h,          /* hash of the current row */
+                        x;          /* 8 sites of it */
+    const unsigned char *p;         /* the current row */
+
+    for (i=0; i<nsam; i++) {
+        p = data + (size_t)i*stride;
+        h = 0x243F6A8885A308D3ULL;
+        for (k=0; k + 8 <= nsites; k+=8) {
+            memcpy(&x, p + k, 8);
+            h = mix(h, x);
+        }
+        if (k < nsites)
+            h = mix(h, load_sites(p + k, nsites - k));
+        hashes[i] = h;
+        hap_freqs[i] = 0;
+    }
+
+    for (i=0; i<nsam; i++) {
+        if (hap_freqs[i] != 0)
+            continue;
+        hap_freqs[i] = 1;
+        for (j=i+1; j<nsam; j++) {
+            if (hap_freqs[j] == 0 && hashes[j] == hashes[i]
+                && !memcmp(data + (size_t)i*stride, data + (size_t)j*stride, nsites)) {
+                hap_freqs[i] += 1;
+                hap_freqs[j] = -9;
+            }
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Kernels for batches of small nucleotide replicates, as seq-gen writes
+ * them by the million (see ss_compute_batch()).
+ *
+ * The base counts of eight sites share a word, a byte per site: each row is
+ * read eight sites at a time, the bytes equal to 'A', 'G', 'C' or 'T' are
+ * found with the usual zero byte test and added to that base's word of
+ * counts. Rows of up to BATCH_MAXSAM samples keep every count within its
+ * byte. The counts of every replicate of a batch are built in one pass over
+ * their rows and lie in one block, a replicate after another, and the site
+ * sums are then read off the bytes. Haplotypes are told apart by a hash of
+ * each row before the rows themselves are compared. */
+
+#define BATCH_MAXSAM    255         /* most samples of a batched replicate */
+#define BATCH_MAXSITES  1024        /* most sites of a batched replicate */
+
+/* words of counts for a number of sites: 4 per 8 sites */
+#define BATCH_WORDS(nsites) (4*(((size_t)(nsites) + 7)/8))
+
+/* The per-site sums of one replicate, as agct_sites.c gives them */
+struct batch_sums {
+    int64_t     diffs;              /* agct_pair_differences() */
+    int         ss,                 /* num_segregating_sites() */
+                nss;                /* agct_num_singleton_sites() */
+};
+
+/* Scratch space, grown by batch_reserve() and kept between calls */
+struct batch_scratch {
+    size_t      counts_size;        /* words counts has room for */
+    uint64_t    *counts;            /* the base counts of a batch */
+};
+
+int batch_reserve(struct batch_scratch *s, size_t nwords);
+void batch_scratch_free(struct batch_scratch *s);
+void batch_counts(int nsam, int nsites, const unsigned char *data, size_t stride,
+                  uint64_t *counts);
+void batch_sites(int nsam, int nsites, const unsigned char *data, size_t stride,
+                 const uint64_t *counts, struct batch_sums *sums, int *unic_freqs);
+void batch_haplotypes(int nsam, int nsites, const unsigned char *data, size_t stride,
+                      uint64_t *hashes, int *hap_freqs);
+
+#endif /* BATCH_H */
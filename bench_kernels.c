@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "simple_getopt.h"
+#include "samplestats.h"
+#include "haplotypes.h"
+#include "agct_sites.h"
+#include "binary_sites.h"
+#include "r2.h"
+#include "fs.h"
+#include "tajd.h"
+#include "prefetch.h"
+
+#define PACKAGE "bench_kernels"
+#define VERSION "0.0.1"
+
+/* String containing name the program is called with. */
+const char *program_name;
+
+/* the grid of replicate sizes */
+static const int grid_nsam[] = { 10, 50, 100, 200 };
+static const int grid_sites[] = { 100, 1000, 5000 };
+#define GRID_NSAM   (int)(sizeof(grid_nsam)/sizeof(grid_nsam[0]))
+#define GRID_SITES  (int)(sizeof(grid_sites)/sizeof(grid_sites[0]))
+#define MAXSAM      200
+#define MAXSITES    5000
+
+/* shortest time each measurement runs for, in seconds (-t) */
+static double min_time = 0.05;
+
+/* the replicate the kernels are timed on, as '0'/'1' and as AGCT rows,
+ * and what they need to work on it */
+static char *binary[MAXSAM],
+            *agct[MAXSAM];
+static int  site_freqs[MAXSITES],
+            *agct_freqs[MAXSITES],
+            agct_counts[4*MAXSITES],
+            hap_freqs[MAXSAM],
+            unic_freqs[MAXSAM];
+static int  nsam, nsites;
+static double pi;
+static int  nh;
+static double *qew;
+static struct ss_workspace *ws;
+static volatile double sink;    /* keeps the results from being optimised away */
+
+/* the ms text the parser is timed on */
+static FILE *ms_text;
+static long ms_bytes;
+
+static unsigned long long state = 4242;
+
+static int next_below(int n) {
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return (int)((state >> 33) % (unsigned long long)n);
+}
+
+static double now(void) {
+    struct timespec ts;         /* the monotonic clock */
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* the kernels, one call each */
+
+static void run_frequency(void) {
+    int     j, sum = 0;
+    for (j=0; j<nsites; j++)
+        sum += frequency('1', j, nsam, binary);
+    sink = sum;
+}
+
+static void run_calculate_site_frequencies(void) {
+    calculate_site_frequencies(nsam, nsites, agct, agct_freqs);
+    sink = agct_freqs[0][0];
+}
+
+static void run_count_haplotype_frequencies(void) {
+    count_haplotype_frequencies(nsam, nsites, binary, hap_freqs);
+    sink = hap_freqs[0];
+}
+
+static void run_unic_frequencies(void) {
+    count_binary_unic_frequencies(nsam, nsites, binary, site_freqs, unic_freqs);
+    sink = unic_freqs[0];
+}
+
+static void run_R2(void) {
+    sink = R2(unic_freqs, pi, nsam, nsites);
+}
+
+static void run_Fs(void) {
+    sink = Fs(nsam, pi, nh);
+}
+
+static void run_Fs_qew(void) {
+    sink = Fs_qew(nsam, pi, nh, qew);
+}
+
+static void run_tajd(void) {
+    sink = tajd(nsam, nsites, pi);
+}
+
+static void run_ss_compute(void) {
+    struct ss_replicate rep;    /* the replicate, as the library sees it */
+    struct ss_results res;      /* its statistics */
+
+    rep.nsam = nsam;
+    rep.nsites = nsites;
+    rep.alphabet = SS_BINARY;
+    rep.encoding = SS_ASCII;
+    rep.data = (const unsigned char *)binary[0];
+    rep.stride = MAXSITES + 1;
+    ss_compute(&rep, SS_PI | SS_SS | SS_D | SS_THETAH | SS_H, ws, &res);
+    sink = res.pi;
+}
+
+/* read the ms text back the way sample_stats2 does */
+static void run_parse_ms(void) {
+    struct prefetch *input;     /* the text, read ahead */
+    char    line[1001],         /* one line of it */
+            row[MAXSITES + 1];  /* one sample */
+    int     i, segsites, sum = 0;
+
+    rewind(ms_text);
+    input = prefetch_open(fileno(ms_text));
+    prefetch_gets(line, 1000, input);
+    prefetch_gets(line, 1000, input);
+    while (prefetch_gets(line, 1000, input) != NULL) {
+        if (strncmp(line, "segsites:", 9) != 0)
+            continue;
+        sscanf(line, "segsites: %d", &segsites);
+        if (segsites > 0) {
+            prefetch_skip_line(input);
+            for (i=0; i<nsam; i++)
+                sum += prefetch_word(row, MAXSITES + 1, input);
+        }
+    }
+    prefetch_close(input);
+    sink = sum;
+}
+
+/*  Time a kernel: call it more and more times until the calls take at
+ *    least min_time, and print a JSON record of the last round
+ *
+ *      name        - the kernel's name
+ *      kernel      - the kernel
+ *      bytes       - bytes of input one call reads, for MB/s (0: none)
+ *      first       - 1 for the first record
+ *
+ *  Returns nothing
+ */
+static void measure(const char *name, void (*kernel)(void), long bytes, int first) {
+    long    calls,              /* calls in this round */
+            i;                  /* iterator */
+    double  start,              /* when the round started */
+            elapsed;            /* and how long it took */
+
+    kernel();
+    for (calls = 1; ; calls *= 2) {
+        start = now();
+        for (i=0; i<calls; i++)
+            kernel();
+        elapsed = now() - start;
+        if (elapsed >= min_time)
+            break;
+    }
+    printf("%s    {\"kernel\": \"%s\", \"nsam\": %d, \"segsites\": %d, \"calls\": %ld, "
+           "\"seconds\": %.6f, \"ns_per_call\": %.1f, \"ns_per_site\": %.3f",
+           first ? "" : ",\n", name, nsam, nsites, calls, elapsed, elapsed/calls*1e9,
+           elapsed/calls*1e9/(nsites > 0 ? nsites : 1));
+    if (bytes > 0)
+        printf(", \"mb_per_second\": %.2f", bytes*(double)calls/elapsed/1e6);
+    printf("}");
+    fflush(stdout);
+}
+
+/*  Make up a replicate of the current size, write it out as ms text and
+ *    work out what the kernels that follow others need
+ *
+ *  Returns nothing
+ */
+static void make_replicate(void) {
+    const char bases[] = "AGCT";
+    int     i, j,               /* iterators */
+            nfounders;          /* haplotypes the samples copy */
+
+    /* a few founders, so that there are repeated haplotypes */
+    nfounders = nsam/4 + 2;
+    for (i=0; i<nsam; i++) {
+        for (j=0; j<nsites; j++) {
+            binary[i][j] = i < nfounders ? '0' + (next_below(4) == 0)
+                           : binary[next_below(nfounders)][j];
+            agct[i][j] = binary[i][j] == '1' ? bases[j % 4] : bases[(j + 1) % 4];
+        }
+        binary[i][nsites] = agct[i][nsites] = '\0';
+    }
+    for (j=0; j<nsites; j++)
+        site_freqs[j] = frequency('1', j, nsam, binary);
+    pi = theta_pi(nsam, nsites, site_freqs);
+    count_haplotype_frequencies(nsam, nsites, binary, hap_freqs);
+    nh = num_haplotypes(nsam, hap_freqs);
+    count_binary_unic_frequencies(nsam, nsites, binary, site_freqs, unic_freqs);
+
+    /* ten replicates of it as ms output, for the parser */
+    ms_text = tmpfile();
+    fprintf(ms_text, "ms %d 10 -s %d\n1 2 3\n", nsam, nsites);
+    for (i=0; i<10; i++) {
+        fprintf(ms_text, "\n//\nsegsites: %d\npositions:", nsites);
+        for (j=0; j<nsites; j++)
+            fprintf(ms_text, " %d.%04d", 0, j % 10000);
+        fprintf(ms_text, " \n");
+        for (j=0; j<nsam; j++)
+            fprintf(ms_text, "%s\n", binary[j]);
+    }
+    fflush(ms_text);
+    ms_bytes = ftell(ms_text);
+}
+
+/* Print help info. */
+static void print_help (void) {
+  printf ("Usage: %s [OPTIONS]\n", program_name);
+
+  puts ("");
+  fputs ("\
+    -h        display this help and exit\n\
+    -v        display version information and exit\n\
+    -t SECS   time each kernel for at least SECS seconds (default 0.05)\n", stdout);
+
+  puts ("");
+  fputs ("\
+Time the statistics kernels and the ms parser over a grid of sample sizes\n\
+and segregating sites, writing one JSON record per kernel and size.\n", stdout);
+}
+
+/* Print version and copyright information.  */
+static void print_version (void) {
+  printf ("(%s) version %s\n", PACKAGE, VERSION);
+}
+
+int main(int argc, char *argv[]) {
+    int     a, b, i, j,         /* iterators */
+            first;              /* 1 until the first record is out */
+    char    ch;                 /* current character iterator for getopt option parsing */
+
+    program_name = argv[0];
+
+    while ((ch = getopt(argc, argv, "t:hv")) != -1) {
+        switch (ch) {
+            case 't':
+                min_time = atof(optarg);
+                break;
+            case 'h':
+                print_help();
+                exit (EXIT_SUCCESS);
+                break;
+            case 'v':
+                print_version();
+                exit (EXIT_SUCCESS);
+                break;
+            case '?':
+                fprintf (stderr, "Unknown option `-%c'.\n", optopt);
+                exit (EXIT_FAILURE);
+                break;
+        }
+    }
+
+    for (i=0; i<MAXSAM; i++) {
+        binary[i] = (char *)malloc(MAXSITES + 1);
+        agct[i] = (char *)malloc(MAXSITES + 1);
+        if (binary[i] == NULL || agct[i] == NULL) {
+            perror("alloc error in bench_kernels");
+            exit (EXIT_FAILURE);
+        }
+    }
+    /* ss_compute() sees the rows as one block, MAXSITES + 1 apart */
+    binary[0] = (char *)realloc(binary[0], (size_t)MAXSAM*(MAXSITES + 1));
+    for (i=1; i<MAXSAM; i++) {
+        free(binary[i]);
+        binary[i] = binary[0] + (size_t)i*(MAXSITES + 1);
+    }
+    for (j=0; j<MAXSITES; j++)
+        agct_freqs[j] = agct_counts + 4*j;
+    if ((qew = (double *)malloc(FS_QEW_SIZE(MAXSAM)*sizeof(double))) == NULL
+        || (ws = ss_workspace_new()) == NULL) {
+        perror("alloc error in bench_kernels");
+        exit (EXIT_FAILURE);
+    }
+
+    printf("{\n  \"benchmark\": \"kernels\",\n  \"isa\": \"%s\",\n  \"min_time\": %g,\n"
+           "  \"results\": [\n", ss_get_isa(), min_time);
+    first = 1;
+    for (a=0; a<GRID_NSAM; a++) {
+        for (b=0; b<GRID_SITES; b++) {
+            nsam = grid_nsam[a];
+            nsites = grid_sites[b];
+            make_replicate();
+            measure("frequency", run_frequency, 0, first);
+            first = 0;
+            measure("calculate_site_frequencies", run_calculate_site_frequencies, 0, 0);
+            measure("count_haplotype_frequencies", run_count_haplotype_frequencies, 0, 0);
+            measure("count_binary_unic_frequencies", run_unic_frequencies, 0, 0);
+            measure("R2", run_R2, 0, 0);
+            measure("Fs", run_Fs, 0, 0);
+            measure("Fs_qew", run_Fs_qew, 0, 0);
+            measure("tajd", run_tajd, 0, 0);
+            measure("ss_compute", run_ss_compute, 0, 0);
+            measure("parse_ms", run_parse_ms, ms_bytes, 0);
+            fclose(ms_text);
+        }
+    }
+    printf("\n  ]\n}\n");
+
+    ss_workspace_free(ws);
+    free(qew);
+    free(binary[0]);
+    for (i=0; i<MAXSAM; i++)
+        free(agct[i]);
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,148 @@
+#include <stdlib.h>
+
+#include "tajd.h"
+
+/* Site based statistics for binary ('0' ancestral, '1' derived) data,
+ * as produced by ms */
+
+/*  Calculate pi (nucleotide diversity)
+ *
+ *      nsam            - total number of samples
+ *      segsites        - total number of segregating sites
+ *                        ( length of data in site_freqs array )
+ *      site_freqs      - array with counts of '1' per site
+ *
+ *  Returns a double
+ */
+double theta_pi(int nsam, int segsites, int *site_freqs)
+{
+    int     s;                  /* iterator */
+    double  pi,                 /* what we are calculating */
+            p1,                 /* site frequency of derived allele */
+            nd,                 /* nsam cast to double value */
+            nnm1;               /* (N / (N Minus 1)) */
+
+    pi = 0.0 ;
+
+    /* create a double with the value of nsam */
+    nd = nsam;
+
+    nnm1 = nd/(nd-1.0);
+
+    for (s=0; s<segsites; s++) {
+        /* calculate site frequency of '1' */
+        p1 = site_freqs[s]/nd ;
+        /* sum up the per site average distances */
+        pi += 2.0*p1*(1.0 -p1)*nnm1 ;
+    }
+
+    return pi;
+}
+
+/*  Calculates Fay's theta_H
+ *
+ *      nsam            - total number of samples in data list
+ *      segsites        - total number of segregating sites
+ *      site_freqs      - array with counts of '1' per site
+ *
+ *  Returns a double with the calculated value
+ */
+double theta_h(int nsam, int segsites, int *site_freqs)
+{
+    int     s;                  /* iterator */
+    double  pi,                 /* what we are calculating */
+            p1,                 /* site count of derived allele */
+            nd;                 /* nsam cast to double value */
+
+    pi = 0.0 ;
+
+    /* create a double with the value of nsam */
+    nd = nsam;
+
+    for (s=0; s<segsites; s++) {
+        p1 = site_freqs[s];
+        pi += p1*p1;
+    }
+
+    return pi*2.0/(nd*(nd-1.0));
+}
+
+/*  Calculates Watterson's theta
+ *
+ *      nsam            - total number of samples in data list
+ *      segsites        - total number of segregating sites
+ *                        ( length of positions array )
+ *      site_freqs      - array with counts of '1' per site
+ *
+ *  Returns a double with the calculated value
+ */
+double theta_w(int nsam, int segsites, int *site_freqs)
+{
+    int     s;                  /* iterator */
+    double  pi,                 /* what we are calculating */
+            denom;              /* denominator of Watterson's theta */
+
+    pi = 0.0 ;
+
+    denom = a1f(nsam);
+
+    for (s=0; s<segsites; s++) {
+        pi += 1.0/denom;
+    }
+
+    return pi;
+}
+
+/*  Count the total number of singleton sites in the data.
+ *    This is the number of variant sites appearing once
+ *    and only once in the entire dataset.
+ *
+ *      segsites        - total number of segregating sites
+ *                        ( length of positions array )
+ *      site_freqs      - array with counts of '1' per site
+ *
+ *  Returns an integer
+ */
+int num_singleton_sites(int segsites, int *site_freqs)
+{
+    int     i,                  /* iterator */
+            count;              /* running total */
+
+    count = 0;
+
+    for (i=0; i<segsites; i++) {
+        /* calculate site frequency of '1' */
+        if (site_freqs[i] == 1) {
+          count++;
+        }
+    }
+
+    return count;
+}
+
+/*  Build the unfolded site frequency spectrum: how many sites carry
+ *    the derived allele in 1, 2, ..., nsam-1 samples. Sites where every
+ *    sample or no sample carries it are not counted.
+ *
+ *      nsam            - total number of samples in data list
+ *      segsites        - total number of segregating sites
+ *      site_freqs      - array with counts of '1' per site
+ *      sfs             - the array to fill (length nsam-1); sfs[i-1]
+ *                        is the number of sites with i derived alleles
+ *
+ *  Returns the length of the spectrum (nsam-1)
+ */
+int site_frequency_spectrum(int nsam, int segsites, int *site_freqs, int *sfs)
+{
+    int     i;                  /* iterator */
+
+    for (i=0; i<nsam-1; i++)
+        sfs[i] = 0;
+
+    for (i=0; i<segsites; i++) {
+        if (site_freqs[i] > 0 && site_freqs[i] < nsam)
+            sfs[site_freqs[i] - 1]++;
+    }
+
+    return nsam > 1 ? nsam - 1 : 0;
+}
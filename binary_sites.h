@@ -0,0 +1,5 @@
+double theta_pi(int nsam, int segsites, int *site_freqs);
+double theta_h(int nsam, int segsites, int *site_freqs);
+double theta_w(int nsam, int segsites, int *site_freqs);
+int num_singleton_sites(int segsites, int *site_freqs);
+int site_frequency_spectrum(int nsam, int segsites, int *site_freqs, int *sfs);
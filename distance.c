@@ -0,0 +1,438 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "packed.h"
+#include "isa.h"
+#include "distance.h"
+
+/* Pairwise differences on bit-packed rows (see distance.h) */
+
+#define LOW_BITS    0x5555555555555555ULL   /* the low bit of every 2 bit site */
+
+#if defined(__GNUC__)
+#define popcount64(x)   __builtin_popcountll(x)
+#else
+static int popcount64(uint64_t x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+}
+#endif
+
+/* one thread's share of the tiles */
+struct dist_job {
+    const uint64_t *rows;           /* packed rows */
+    int         *dist;              /* the matrix */
+    int         nsam,               /* number of samples */
+                nwords,             /* words per row */
+                agct,               /* 1 for nucleotide rows */
+                nthreads,           /* threads sharing the tiles */
+                id;                 /* this thread, 0 .. nthreads-1 */
+    const struct ss_kernels *k;     /* kernels for this CPU */
+};
+
+/*  Make sure the scratch space can hold a replicate
+ *
+ *      s           - the scratch space (zeroed before first use)
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      agct        - 1 if the rows are nucleotides
+ *
+ *  Returns 0, or -1 if out of memory
+ */
+int dist_reserve(struct dist_scratch *s, int nsam, int nsites, int agct)
+{
+    void    *p;                 /* result of each reallocation */
+    int     nwords;             /* words per packed row */
+
+    nwords = agct ? DIST_AGCT_WORDS(nsites) : PACKED_WORDS(nsites);
+
+    if (nsam > s->maxsam || nwords > s->maxwords) {
+        if (nsam < s->maxsam)
+            nsam = s->maxsam;
+        if (nwords < s->maxwords)
+            nwords = s->maxwords;
+        if (!(p = realloc(s->rows, (size_t)nsam*nwords*sizeof(uint64_t) + 1)))
+            return -1;
+        s->rows = (uint64_t *)p;
+        s->maxwords = nwords;
+    }
+    if (nsam > s->maxsam) {
+        if (!(p = realloc(s->dist, (size_t)nsam*nsam*sizeof(int))))
+            return -1;
+        s->dist = (int *)p;
+        s->maxsam = nsam;
+    }
+    if (nsites + 1 > s->maxcounts) {
+        if (!(p = realloc(s->counts, (size_t)(nsites + 1)*sizeof(long))))
+            return -1;
+        s->counts = (long *)p;
+        s->maxcounts = nsites + 1;
+    }
+
+    return 0;
+}
+
+/*  Free what the scratch space holds
+ *
+ *      s           - the scratch space
+ *
+ *  Returns nothing
+ */
+void dist_scratch_free(struct dist_scratch *s)
+{
+    free(s->rows);
+    free(s->dist);
+    free(s->counts);
+    memset(s, 0, sizeof(*s));
+}
+
+/*  Pack '0'/'1' rows into words, 64 sites to a word, for replicates that
+ *    were not packed on the way in
+ *
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      rows        - the rows
+ *      packed      - where to put the packed rows (nsam * PACKED_WORDS(nsites))
+ *
+ *  Returns nothing
+ */
+void dist_pack_rows(int nsam, int nsites, char **rows, uint64_t *packed)
+{
+    int     i;                  /* iterator */
+    const struct ss_kernels *k; /* kernels for this CPU */
+
+    k = ss_kernels();
+    for (i=0; i<nsam; i++)
+        k->pack_rows_ascii(1, nsites, (const unsigned char *)rows[i], 0,
+                           packed + (size_t)i*PACKED_WORDS(nsites));
+}
+
+/*  Pack nucleotide rows, two bits a base, 32 sites to a word, followed by
+ *    as many words marking the sites that hold a base
+ *
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      rows        - the rows ('A', 'G', 'C', 'T'; anything else is missing)
+ *      packed      - where to put the packed rows (nsam * DIST_AGCT_WORDS(nsites))
+ *
+ *  Returns nothing
+ */
+void dist_pack_agct(int nsam, int nsites, char **rows, uint64_t *packed)
+{
+    int         i, j;           /* iterators */
+    int         half;           /* words of codes per row */
+    uint64_t    *code, *mask;   /* the current row's words */
+    uint64_t    c;              /* code of a site */
+
+    half = DIST_AGCT_WORDS(nsites)/2;
+    for (i=0; i<nsam; i++) {
+        code = packed + (size_t)i*2*half;
+        mask = code + half;
+        memset(code, 0, 2*half*sizeof(uint64_t));
+        for (j=0; j<nsites; j++) {
+            switch (rows[i][j]) {
+                case 'A': c = 0; break;
+                case 'G': c = 1; break;
+                case 'C': c = 2; break;
+                case 'T': c = 3; break;
+                default: continue;
+            }
+            code[j/32] |= c << (2*(j % 32));
+            mask[j/32] |= (uint64_t)3 << (2*(j % 32));
+        }
+    }
+}
+
+/*  XOR one packed binary row with a run of others and popcount: the
+ *    number of sites at which the one differs from each of the others
+ *
+ *      nwords      - words per row
+ *      a           - the one row
+ *      rows        - the others, one after the other
+ *      n           - number of others
+ *      counts      - array to fill (length n)
+ *
+ *  Returns nothing (fills in the array given)
+ */
+void dist_xor_counts(int nwords, const uint64_t *a, const uint64_t *rows, int n,
+                     int *counts)
+{
+    int         j, g;               /* iterators */
+    const uint64_t *b;              /* the other row */
+
+    for (j=0; j<n; j++) {
+        b = rows + (size_t)j*nwords;
+        counts[j] = 0;
+        for (g=0; g<nwords; g++)
+            counts[j] += popcount64(a[g] ^ b[g]);
+    }
+}
+
+/*  The same for packed nucleotide rows: a site differs if either bit of
+ *    the XOR of the codes is set where both rows hold a base
+ *
+ *      nwords      - words per row (DIST_AGCT_WORDS(nsites))
+ *      a           - the one row
+ *      rows        - the others, one after the other
+ *      n           - number of others
+ *      counts      - array to fill (length n)
+ *
+ *  Returns nothing (fills in the array given)
+ */
+void dist_xor2_counts(int nwords, const uint64_t *a, const uint64_t *rows, int n,
+                      int *counts)
+{
+    int         j, g,               /* iterators */
+                half;               /* words of codes */
+    const uint64_t *b;              /* the other row */
+    uint64_t    x;                  /* differing bits */
+
+    half = nwords/2;
+    for (j=0; j<n; j++) {
+        b = rows + (size_t)j*nwords;
+        counts[j] = 0;
+        for (g=0; g<half; g++) {
+            x = (a[g] ^ b[g]) & a[half + g] & b[half + g];
+            counts[j] += popcount64((x | (x >> 1)) & LOW_BITS);
+        }
+    }
+}
+
+/*  Fill in the differences between the samples of one block and those
+ *    of another, and their mirror images
+ *
+ *      job         - what the thread is working on
+ *      bi, bj      - the blocks (bi <= bj)
+ *
+ *  Returns nothing
+ */
+static void dist_tile(const struct dist_job *job, int bi, int bj)
+{
+    int         i, j,               /* iterators */
+                iend,               /* last sample + 1 of block bi */
+                j0, j1;             /* range of partners of sample i */
+    int         *row;               /* sample i's row of the matrix */
+    size_t      n;                  /* samples, as a size */
+
+    n = (size_t)job->nsam;
+    iend = (bi + 1)*DIST_BLOCK < job->nsam ? (bi + 1)*DIST_BLOCK : job->nsam;
+
+    for (i=bi*DIST_BLOCK; i<iend; i++) {
+        j0 = bj*DIST_BLOCK > i + 1 ? bj*DIST_BLOCK : i + 1;
+        j1 = (bj + 1)*DIST_BLOCK < job->nsam ? (bj + 1)*DIST_BLOCK : job->nsam;
+        if (j0 >= j1)
+            continue;
+        row = job->dist + i*n;
+        if (job->agct)
+            job->k->xor2_counts(job->nwords, job->rows + (size_t)i*job->nwords,
+                                job->rows + (size_t)j0*job->nwords, j1 - j0, row + j0);
+        else
+            job->k->xor_counts(job->nwords, job->rows + (size_t)i*job->nwords,
+                               job->rows + (size_t)j0*job->nwords, j1 - j0, row + j0);
+        for (j=j0; j<j1; j++)
+            job->dist[j*n + i] = row[j];
+    }
+}
+
+/*  Work through one thread's share of the tiles: every nthreads'th tile,
+ *    counting along the rows of blocks
+ *
+ *      arg         - the job
+ *
+ *  Returns NULL
+ */
+static void *dist_tiles(void *arg)
+{
+    const struct dist_job *job;     /* what to do */
+    int         bi, bj,             /* blocks */
+                nblocks;            /* number of blocks */
+    long        k;                  /* tile number */
+
+    job = (const struct dist_job *)arg;
+    nblocks = (job->nsam + DIST_BLOCK - 1) / DIST_BLOCK;
+    k = 0;
+    for (bi=0; bi<nblocks; bi++) {
+        for (bj=bi; bj<nblocks; bj++) {
+            if (k++ % job->nthreads == job->id)
+                dist_tile(job, bi, bj);
+        }
+    }
+    return NULL;
+}
+
+/*  Work out the number of differences between every pair of samples
+ *
+ *      nsam        - number of samples
+ *      nwords      - words per packed row
+ *      rows        - the packed rows, from pack_rows_*() (binary) or
+ *                    dist_pack_agct() (nucleotides)
+ *      agct        - 1 if the rows are nucleotides
+ *      nthreads    - threads to share the tiles between
+ *      dist        - where to put the differences (nsam * nsam, row major,
+ *                    with 0 down the diagonal)
+ *
+ *  Returns nothing
+ */
+void dist_matrix(int nsam, int nwords, const uint64_t *rows, int agct, int nthreads,
+                 int *dist)
+{
+    int             i, t;           /* iterators */
+    struct dist_job jobs[DIST_MAXTHREADS];
+    pthread_t       threads[DIST_MAXTHREADS];
+    int             started[DIST_MAXTHREADS];
+
+    for (i=0; i<nsam; i++)
+        dist[(size_t)i*nsam + i] = 0;
+
+    if (nthreads > DIST_MAXTHREADS)
+        nthreads = DIST_MAXTHREADS;
+    if (nthreads < 1 || nsam <= DIST_BLOCK)
+        nthreads = 1;
+
+    for (t=0; t<nthreads; t++) {
+        jobs[t].rows = rows;
+        jobs[t].dist = dist;
+        jobs[t].nsam = nsam;
+        jobs[t].nwords = nwords;
+        jobs[t].agct = agct;
+        jobs[t].nthreads = nthreads;
+        jobs[t].id = t;
+        jobs[t].k = ss_kernels();
+    }
+    for (t=1; t<nthreads; t++)
+        started[t] = pthread_create(&threads[t], NULL, dist_tiles, &jobs[t]) == 0;
+    dist_tiles(&jobs[0]);
+    for (t=1; t<nthreads; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+        else
+            dist_tiles(&jobs[t]);
+    }
+}
+
+/*  Histogram the differences between pairs of samples: the mismatch
+ *    distribution
+ *
+ *      nsam        - number of samples
+ *      dist        - the matrix from dist_matrix()
+ *      counts      - array to fill: counts[k] pairs differ at k sites
+ *                    (room for the number of sites + 1)
+ *
+ *  Returns the number of entries filled in, the largest difference + 1
+ *    (0 if there are no pairs)
+ */
+int dist_mismatch(int nsam, const int *dist, long *counts)
+{
+    int     i, j, k,            /* iterators */
+            len;                /* entries filled in so far */
+    const int *row;             /* sample i's row of the matrix */
+
+    len = 0;
+    for (i=0; i<nsam; i++) {
+        row = dist + (size_t)i*nsam;
+        for (j=i+1; j<nsam; j++) {
+            for (k=len; k<=row[j]; k++)
+                counts[k] = 0;
+            if (row[j] >= len)
+                len = row[j] + 1;
+            counts[row[j]]++;
+        }
+    }
+    return len;
+}
+
+/*  The mean and variance of the mismatch distribution and Harpending's
+ *    (1994) raggedness index, the sum of the squared differences between
+ *    neighbouring classes of the distribution as proportions (with one
+ *    empty class past the last)
+ *
+ *      len         - number of classes, from dist_mismatch()
+ *      counts      - pairs per class
+ *      mean        - where to put the mean number of differences
+ *      var         - where to put their variance over the pairs
+ *      rag         - where to put the raggedness index
+ *
+ *  Returns nothing
+ */
+void dist_mismatch_moments(int len, const long *counts, double *mean, double *var,
+                           double *rag)
+{
+    int     k;                  /* iterator */
+    double  pairs,              /* number of pairs */
+            sum,                /* running sum */
+            f, last;            /* proportions of pairs in neighbouring classes */
+
+    pairs = sum = 0.0;
+    for (k=0; k<len; k++) {
+        pairs += counts[k];
+        sum += (double)k*counts[k];
+    }
+    *mean = *var = *rag = 0.0;
+    if (pairs == 0.0)
+        return;
+    *mean = sum/pairs;
+
+    sum = 0.0;
+    for (k=0; k<len; k++)
+        sum += (k - *mean)*(k - *mean)*counts[k];
+    *var = sum/pairs;
+
+    sum = 0.0;
+    last = counts[0]/pairs;
+    for (k=1; k<=len; k++) {
+        f = k < len ? counts[k]/pairs : 0.0;
+        sum += (f - last)*(f - last);
+        last = f;
+    }
+    *rag = sum;
+}
+
+/*  Hudson's (2000) nearest neighbour statistic: for each sample, the
+ *    share of its nearest neighbours (the samples fewest differences away,
+ *    ties all counted) that come from its own population, averaged over
+ *    the samples
+ *
+ *      nsam        - number of samples
+ *      dist        - the matrix from dist_matrix()
+ *      pop         - population of each sample
+ *
+ *  Returns Snn, or 0 if there are fewer than two samples
+ */
+double dist_snn(int nsam, const int *dist, const int *pop)
+{
+    int     i, j,               /* iterators */
+            best,               /* fewest differences to another sample */
+            near,               /* nearest neighbours */
+            same;               /* of those, from the same population */
+    const int *row;             /* sample i's row of the matrix */
+    double  sum;                /* running sum */
+
+    if (nsam < 2)
+        return 0.0;
+
+    sum = 0.0;
+    for (i=0; i<nsam; i++) {
+        row = dist + (size_t)i*nsam;
+        best = -1;
+        near = same = 0;
+        for (j=0; j<nsam; j++) {
+            if (j == i)
+                continue;
+            if (best < 0 || row[j] < best) {
+                best = row[j];
+                near = same = 0;
+            }
+            if (row[j] == best) {
+                near++;
+                same += pop[j] == pop[i];
+            }
+        }
+        sum += (double)same/near;
+    }
+    return sum/nsam;
+}
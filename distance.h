@@ -0,0 +1,53 @@
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+#include <stdint.h>
+
+/* Pairwise differences between the haplotypes of a replicate.
+ *
+ * Binary rows are packed 64 sites to a word, so the number of sites at
+ * which two samples differ is an XOR and a popcount. Nucleotide rows are
+ * packed 32 sites to a word, two bits per base (A 0, G 1, C 2, T 3), with a
+ * second run of words holding 11 for each site that is a base at all, so a
+ * pair of samples differs where the XOR of the codes, masked by both, has
+ * either bit of a site set; sites where either sample has an N, gap or
+ * other character are not compared. Samples are taken DIST_BLOCK at a time,
+ * so that two blocks of rows stay in the cache while the pairs between them
+ * are worked through, and the tiles of block pairs are shared out between
+ * threads. */
+
+/* samples per block */
+#define DIST_BLOCK      64
+
+/* most threads one call will use */
+#define DIST_MAXTHREADS 64
+
+/* number of words per packed nucleotide row (codes, then the mask) */
+#define DIST_AGCT_WORDS(nsites) (2*(((nsites) + 31) / 32))
+
+/* Scratch space, grown by dist_reserve() and kept between calls */
+struct dist_scratch {
+    int         maxsam,             /* samples there is room for */
+                maxwords,           /* row words there is room for */
+                maxcounts;          /* mismatch classes there is room for */
+    uint64_t    *rows;              /* packed rows */
+    int         *dist;              /* nsam x nsam differences, row major */
+    long        *counts;            /* pairs per number of differences */
+};
+
+int dist_reserve(struct dist_scratch *s, int nsam, int nsites, int agct);
+void dist_scratch_free(struct dist_scratch *s);
+void dist_pack_rows(int nsam, int nsites, char **rows, uint64_t *packed);
+void dist_pack_agct(int nsam, int nsites, char **rows, uint64_t *packed);
+void dist_xor_counts(int nwords, const uint64_t *a, const uint64_t *rows, int n,
+                     int *counts);
+void dist_xor2_counts(int nwords, const uint64_t *a, const uint64_t *rows, int n,
+                      int *counts);
+void dist_matrix(int nsam, int nwords, const uint64_t *rows, int agct, int nthreads,
+                 int *dist);
+int dist_mismatch(int nsam, const int *dist, long *counts);
+void dist_mismatch_moments(int len, const long *counts, double *mean, double *var,
+                           double *rag);
+double dist_snn(int nsam, const int *dist, const int *pop);
+
+#endif /* DISTANCE_H */
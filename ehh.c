@@ -0,0 +1,333 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "packed.h"
+#include "ehh.h"
+
+/* Extended haplotype homozygosity on bit-packed columns (see ehh.h) */
+
+/*  Make sure the scratch space can hold a replicate
+ *
+ *      s           - the scratch space (zeroed before first use)
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *
+ *  Returns 0, or -1 if out of memory
+ */
+int ehh_reserve(struct ehh_scratch *s, int nsam, int nsites)
+{
+    void    *p;                 /* result of each reallocation */
+
+    if (nsam > s->maxsam) {
+        if (!(p = realloc(s->order, (size_t)5*nsam*sizeof(int))))
+            return -1;
+        s->order = (int *)p;
+        s->div = s->order + nsam;
+        s->order2 = s->div + nsam;
+        s->div2 = s->order2 + nsam;
+        s->runs = s->div2 + nsam;
+        if (!(p = realloc(s->thr, (size_t)nsam*sizeof(int))))
+            return -1;
+        s->thr = (int *)p;
+        if (!(p = realloc(s->pairs, (size_t)nsam*sizeof(int64_t))))
+            return -1;
+        s->pairs = (int64_t *)p;
+        if (!(p = realloc(s->keys, (size_t)nsam*sizeof(uint64_t))))
+            return -1;
+        s->keys = (uint64_t *)p;
+        s->maxsam = nsam;
+    }
+
+    if (nsites > s->maxsites || s->first == NULL) {
+        if (!(p = realloc(s->derived, (size_t)nsites*sizeof(int) + 1)))
+            return -1;
+        s->derived = (int *)p;
+        if (!(p = realloc(s->first, (size_t)6*nsites*sizeof(double) + 1)))
+            return -1;
+        s->first = (double *)p;
+        s->ihs = s->first + 4*(size_t)nsites;
+        s->nsl = s->ihs + nsites;
+        s->maxsites = nsites;
+    }
+
+    return 0;
+}
+
+/*  Free what the scratch space holds
+ *
+ *      s           - the scratch space
+ *
+ *  Returns nothing
+ */
+void ehh_scratch_free(struct ehh_scratch *s)
+{
+    free(s->order);
+    free(s->thr);
+    free(s->pairs);
+    free(s->keys);
+    free(s->derived);
+    free(s->first);
+    memset(s, 0, sizeof(*s));
+}
+
+/*  qsort() comparison of two neighbour keys */
+static int compare_keys(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a,
+             y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*  Move the PBWT order and divergences on past one site
+ *
+ *      nsam        - number of samples
+ *      k           - the site, counted in the direction of the pass
+ *      col         - its column words
+ *      s           - the scratch space; order and div are updated
+ *
+ *  Returns the number of carriers of the ancestral allele, which now come
+ *    first in the order
+ */
+static int pbwt_step(int nsam, int k, const uint64_t *col, struct ehh_scratch *s)
+{
+    int     i,                  /* iterator */
+            h,                  /* current haplotype */
+            u, v,               /* carriers of 0 and 1 so far */
+            p, q,               /* matches of the next 0 and 1 start here */
+            *t;                 /* for swapping */
+
+    /* the carriers of 1 wait in runs and thr, which are free until the
+     * site's EHH is worked out */
+    u = v = 0;
+    p = q = k + 1;
+    for (i=0; i<nsam; i++) {
+        h = s->order[i];
+        if (s->div[i] > p)
+            p = s->div[i];
+        if (s->div[i] > q)
+            q = s->div[i];
+        if ((col[h >> 6] >> (h & 63)) & 1) {
+            s->runs[v] = h;
+            s->thr[v++] = q;
+            q = 0;
+        } else {
+            s->order2[u] = h;
+            s->div2[u++] = p;
+            p = 0;
+        }
+    }
+    /* the 1s go after the 0s */
+    memcpy(s->order2 + u, s->runs, v*sizeof(int));
+    memcpy(s->div2 + u, s->thr, v*sizeof(int));
+
+    t = s->order; s->order = s->order2; s->order2 = t;
+    t = s->div; s->div = s->div2; s->div2 = t;
+    return u;
+}
+
+/*  Work out EHH outward from a core site on one side, for the carriers
+ *    of one allele, and integrate it
+ *
+ *      div         - divergences of the carriers, in PBWT order (div[0]
+ *                    is not used)
+ *      m           - number of carriers (at least 2)
+ *      core        - the core site, counted in the direction of the pass
+ *      nsites      - number of sites
+ *      positions   - site positions, or NULL for site indices
+ *      back        - 1 if the pass runs right to left
+ *      s           - the scratch space
+ *      ihh         - where to put EHH integrated over distance, out to
+ *                    where it drops to EHH_CUTOFF or to the end
+ *      sl          - where to put EHH summed over the sites, to the end:
+ *                    the mean number of sites a pair matches over
+ *
+ *  Returns nothing
+ */
+static void one_side(const int *div, int m, int core, int nsites, const double *positions,
+                     int back, struct ehh_scratch *s, double *ihh, double *sl)
+{
+    int     i, t,               /* iterators */
+            l, r,               /* ends of the two runs a neighbour joins */
+            g,                  /* number of steps */
+            hi, lo;             /* sites of the current step of EHH */
+    int64_t p;                  /* pairs matching so far */
+    double  total,              /* pairs of carriers */
+            e, e2,              /* EHH either side of a step */
+            sum;                /* running integral */
+
+/* position of site x counted in the direction of the pass */
+#define POS(x) (positions == NULL ? (double)(x) \
+                : back ? -positions[nsites - 1 - (x)] : positions[x])
+
+    /* merge neighbours in order of how far back they match; the pairs
+     * matching over [x, core] are those of the runs merged by then */
+    for (i=1; i<m; i++)
+        s->keys[i-1] = (uint64_t)div[i] << 32 | (uint64_t)i;
+    qsort(s->keys, m - 1, sizeof(uint64_t), compare_keys);
+    for (i=0; i<m; i++)
+        s->runs[i] = i;
+    p = 0;
+    g = 0;
+    for (t=0; t<m-1; t++) {
+        i = (int)(s->keys[t] & 0xffffffffu);
+        l = s->runs[i-1];
+        r = s->runs[i];
+        p += (int64_t)(i - l)*(r - i + 1);
+        s->runs[l] = r;
+        s->runs[r] = l;
+        if (t == m - 2 || s->keys[t+1] >> 32 != s->keys[t] >> 32) {
+            s->thr[g] = (int)(s->keys[t] >> 32);
+            s->pairs[g++] = p;
+        }
+    }
+    total = (double)m*(m - 1)/2.0;
+
+    /* EHH is pairs[i]/total from site thr[i] up to the next step */
+    sum = 0.0;
+    for (i=0; i<g; i++)
+        sum += (double)s->pairs[i]*((i + 1 < g ? s->thr[i+1] : core + 1) - s->thr[i]);
+    *sl = sum/total;
+
+    /* trapezoids out from the core; flat stretches are one rectangle */
+    sum = 0.0;
+    hi = core;
+    e = 1.0;
+    for (i=g-1; ; i--) {
+        lo = s->thr[i];
+        sum += e*(POS(hi) - POS(lo));
+        if (lo == 0)
+            break;
+        e2 = i > 0 ? s->pairs[i-1]/total : 0.0;
+        sum += 0.5*(e + e2)*(POS(lo) - POS(lo - 1));
+        if (e2 <= EHH_CUTOFF)
+            break;
+        hi = lo - 1;
+        e = e2;
+    }
+    *ihh = sum;
+
+#undef POS
+}
+
+/*  Unstandardised iHS and nSL at every site: the log of the ratio of the
+ *    ancestral to the derived allele's integrated EHH (iHS, over distance)
+ *    and mean shared length (nSL, in sites). Sites where either allele has
+ *    fewer than two carriers get NAN.
+ *
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      cols        - site columns, PACKED_WORDS(nsam) words per site
+ *      positions   - site positions, not decreasing, or NULL for indices
+ *      s           - scratch space from ehh_reserve()
+ *      ihs         - where to put iHS (nsites)
+ *      nsl         - where to put nSL (nsites)
+ *
+ *  Returns nothing
+ */
+void ehh_scan(int nsam, int nsites, const uint64_t *cols, const double *positions,
+              struct ehh_scratch *s, double *ihs, double *nsl)
+{
+    int     i, k,               /* iterators */
+            back,               /* 1 on the right to left pass */
+            site,               /* the site, in the usual order */
+            nwords,             /* column words per site */
+            u;                  /* carriers of the ancestral allele */
+    double  v[4],               /* iHH and SL of the ancestral then the
+                                 *   derived allele, on this side */
+            *f;                 /* the same from the first pass */
+
+    nwords = PACKED_WORDS(nsam);
+
+    for (back=0; back<2; back++) {
+        for (i=0; i<nsam; i++) {
+            s->order[i] = i;
+            s->div[i] = 0;
+        }
+        for (k=0; k<nsites; k++) {
+            site = back ? nsites - 1 - k : k;
+            u = pbwt_step(nsam, k, cols + (size_t)site*nwords, s);
+            s->derived[site] = nsam - u;
+            f = s->first + 4*(size_t)site;
+
+            if (u < 2 || nsam - u < 2) {
+                if (back)
+                    ihs[site] = nsl[site] = NAN;
+                continue;
+            }
+            one_side(s->div, u, k, nsites, positions, back, s, &v[0], &v[1]);
+            one_side(s->div + u, nsam - u, k, nsites, positions, back, s, &v[2], &v[3]);
+
+            if (!back) {
+                memcpy(f, v, sizeof(v));
+            } else {
+                /* the core itself is in the shared length on both sides */
+                ihs[site] = log((f[0] + v[0])/(f[2] + v[2]));
+                nsl[site] = log((f[1] + v[1] - 1.0)/(f[3] + v[3] - 1.0));
+            }
+        }
+    }
+}
+
+/*  Standardise values within bins of derived allele frequency, as is
+ *    done with iHS and nSL, and find the most extreme
+ *
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      derived     - derived allele count per site
+ *      values      - value per site (NAN where there is none)
+ *
+ *  Returns the largest |(value - bin mean)/bin sd| over bins with at least
+ *    two values, or 0 if there are none
+ */
+double ehh_standardise(int nsam, int nsites, const int *derived, const double *values)
+{
+    int     i,                  /* iterator */
+            b,                  /* bin of a site */
+            n[EHH_BINS];        /* values per bin */
+    double  sum[EHH_BINS],      /* their sums */
+            sq[EHH_BINS],       /* and sums of squares */
+            mean, sd,           /* of the bin of a site */
+            z,                  /* a standardised value */
+            best;               /* the largest |z| */
+
+    if (nsam < 2)
+        return 0.0;
+    for (b=0; b<EHH_BINS; b++) {
+        n[b] = 0;
+        sum[b] = sq[b] = 0.0;
+    }
+
+#define BIN(d) ((int)((int64_t)((d) - 1)*EHH_BINS/(nsam - 1)))
+
+    for (i=0; i<nsites; i++) {
+        if (!isfinite(values[i]) || derived[i] < 1 || derived[i] > nsam - 1)
+            continue;
+        b = BIN(derived[i]);
+        n[b]++;
+        sum[b] += values[i];
+        sq[b] += values[i]*values[i];
+    }
+
+    best = 0.0;
+    for (i=0; i<nsites; i++) {
+        if (!isfinite(values[i]) || derived[i] < 1 || derived[i] > nsam - 1)
+            continue;
+        b = BIN(derived[i]);
+        if (n[b] < 2)
+            continue;
+        mean = sum[b]/n[b];
+        sd = sqrt((sq[b] - sum[b]*mean)/(n[b] - 1));
+        if (!(sd > 0.0))
+            continue;
+        z = fabs((values[i] - mean)/sd);
+        if (z > best)
+            best = z;
+    }
+
+#undef BIN
+
+    return best;
+}
@@ -0,0 +1,49 @@
+#ifndef EHH_H
+#define EHH_H
+
+#include <stdint.h>
+
+/* Extended haplotype homozygosity scans: iHS (Voight et al. 2006) and nSL
+ * (Ferrer-Admetlla et al. 2014) at every site of a binary replicate.
+ *
+ * The haplotypes are kept in positional Burrows-Wheeler order (Durbin 2014)
+ * as the sites are passed over, once left to right and once right to left.
+ * At each core site the carriers of each allele then sit together, and the
+ * divergence array says how far back each one matches its neighbour, so
+ * merging neighbours in order of divergence gives EHH as a step function
+ * with at most one step per carrier. Each core costs O(nsam log nsam)
+ * however far the homozygosity extends, in place of rescanning every
+ * haplotype out to the cutoff. */
+
+/* iHH integrates EHH out to where it first drops to or below this */
+#define EHH_CUTOFF      0.05
+
+/* derived allele frequency bins values are standardised within */
+#define EHH_BINS        20
+
+/* Scratch space, grown by ehh_reserve() and kept between calls */
+struct ehh_scratch {
+    int         maxsam,             /* samples there is room for */
+                maxsites;           /* sites there is room for */
+    int         *order,             /* haplotypes in PBWT order */
+                *div,               /* where each matches the one before from */
+                *order2,            /* both again, for the next site */
+                *div2,
+                *runs,              /* ends of the runs of merged neighbours */
+                *thr,               /* divergences at which EHH steps */
+                *derived;           /* derived allele count per site */
+    int64_t     *pairs;             /* pairs of carriers still matching there */
+    uint64_t    *keys;              /* neighbours, (divergence << 32) | index */
+    double      *first,             /* per site: iHH and SL of both alleles
+                                     *   from the left to right pass */
+                *ihs,               /* per site results, when the caller */
+                *nsl;               /*   has nowhere to put them */
+};
+
+int ehh_reserve(struct ehh_scratch *s, int nsam, int nsites);
+void ehh_scratch_free(struct ehh_scratch *s);
+void ehh_scan(int nsam, int nsites, const uint64_t *cols, const double *positions,
+              struct ehh_scratch *s, double *ihs, double *nsl);
+double ehh_standardise(int nsam, int nsites, const int *derived, const double *values);
+
+#endif /* EHH_H */
@@ -1,6 +1,8 @@
 #include <stdlib.h>
 #include <math.h>
 
+#include "fs.h"
+
 /* Derived from Ramos-Onsins & Rozas's mlcoalsim */
 
 
@@ -11,14 +13,16 @@
  *      theta       - in this case is the average pairwise number of 
  *                    subsitutions (pi)
  *      qew_        - 
+ *      lfact       - lfact[n] is the sum of log(jj) for jj = 2 .. n-1
+ *      ltheta      - ltheta[n] is the sum of log(theta + jj) for jj = 0 .. n-1
  *
  *  Returns a double
  *  Also updates the qew_ array in progress
  */
-double FunEq23Ewens(int N, int i, double theta, double *qew_)
+static double FunEq23Ewens(int N, int i, double theta, double *qew_,
+                           const double *lfact, const double *ltheta)
 {                  
     long int acceso; 
-    int jj;
     double ValorN;  /* log del numerador */
     double ValorD;  /* log del denominador */
 
@@ -29,49 +33,46 @@ double FunEq23Ewens(int N, int i, double theta, double *qew_)
     if (qew_[acceso] < 0.0) {   
         if (i==1) {
             /* calculo de qj,1   (i = 1)   Antigua equacion 19  */
-            if (N > 2) {             
-                for (jj=2; jj<N; jj++)
-                    ValorN = ValorN + log((double)jj);  
-            }
-            ValorN = ValorN + log(theta);
-            for (jj=0; jj<N; jj++)
-                ValorD  = ValorD + log((double)theta + (double)jj);      
+            ValorN = lfact[N] + log(theta);
+            ValorD = ltheta[N];
             qew_[acceso] = exp((double)(ValorN - ValorD)); 
         }    
         if (i==N) {          
             /* calculo de qj,j   (n = i)   antigua equacion 20 */
             ValorN = log((double)theta) * (double)N;
-            for (jj=0; jj<N; jj++)     
-                ValorD  = ValorD + log((double)theta + (double)jj);
+            ValorD = ltheta[N];
             qew_[acceso] = exp((double)(ValorN - ValorD));
 	      }
 	      if (i>1 && i<N) {    
             /*  recursividad  */
-            qew_[acceso] = FunEq23Ewens(N-1,i,  theta,qew_) * ((double)(N-1)/(theta + (double)N-1.0))
-                         + FunEq23Ewens(N-1,i-1,theta,qew_) *         (theta/(theta + (double)N-1.0));
+            qew_[acceso] = FunEq23Ewens(N-1,i,  theta,qew_,lfact,ltheta) * ((double)(N-1)/(theta + (double)N-1.0))
+                         + FunEq23Ewens(N-1,i-1,theta,qew_,lfact,ltheta) *         (theta/(theta + (double)N-1.0));
         }    
     }  
 
     return qew_[acceso];
 }
 
-/*  Calculates Fu's Fs
+/*  Calculates Fu's Fs, using a caller supplied scratch table so that
+ *    repeated calls need not allocate
  *
  *      Nsample     - number of samples
  *      pi          - average number of pairwise substitutions
  *      NumAlelos   - number of haplotypes
+ *      qew         - scratch space for at least FS_QEW_SIZE(Nsample) doubles
  *
  *  Returns a double
  */
-double Fs(int Nsample, double pi, int NumAlelos)
+double Fs_qew(int Nsample, double pi, int NumAlelos, double *qew)
 {
     /* Rozas program */
 	
     double    SumaP,
               RestaP,
               ValorFs,
-              est_var;
-    double    *qew;
+              est_var,
+              *lfact,     /* running sums of log(jj), shared by every N */
+              *ltheta;    /* running sums of log(theta + jj) */
     long int  i;          /* iterator */       
 
     if (pi == 0.0 || Nsample < 2) 
@@ -79,25 +80,38 @@ double Fs(int Nsample, double pi, int NumAlelos)
 
     est_var = pi;
 
-    qew  = (double *)malloc((long int)Nsample*(long int)Nsample*sizeof(double));
-    
     for (i=0; i<(long int)Nsample*(long int)Nsample ;i++)
     	  qew[i] = -1.0;
+
+    /* the sums of logs in equations 19 and 20 only grow by one term from
+     * N to N+1, so work them out once for every N instead of at every
+     * step of the recursion */
+    lfact = qew + (long int)Nsample*(long int)Nsample;
+    ltheta = lfact + Nsample + 1;
+    lfact[0] = lfact[1] = lfact[2] = 0.0;
+    for (i=3; i<=Nsample; i++)
+        lfact[i] = lfact[i-1] + log((double)(i-1));
+    ltheta[0] = 0.0;
+    for (i=1; i<=Nsample; i++)
+        ltheta[i] = ltheta[i-1] + log((double)est_var + (double)(i-1));
             
     SumaP=RestaP=0.0;
 
     for (i=1; i<NumAlelos; i++) {
         /* calculo q(n,aleloI)   ecuacion 21 (recurrente con eq. 19 y 20) */
-        SumaP += FunEq23Ewens(Nsample, i, est_var, qew);
+        SumaP += FunEq23Ewens(Nsample, i, est_var, qew, lfact, ltheta);
     }
 
-    if (SumaP > 1.-1E-37) {
+    /* past a half, 1 - SumaP cancels, and with every sample a haplotype of
+     * its own it is all rounding error; sum S' itself instead, so that Fs
+     * is the log of the ratio of two sums of positive terms */
+    if (SumaP > 0.5) {
     	  for (i=NumAlelos; i<=Nsample; i++)
-            RestaP += FunEq23Ewens(Nsample, i, est_var, qew);	 	
+            RestaP += FunEq23Ewens(Nsample, i, est_var, qew, lfact, ltheta);	 	
         if (RestaP < 1E-37)
             return -10000;
 
-        ValorFs = log((double)RestaP) - log((double)1.0-RestaP);
+        ValorFs = log((double)RestaP) - log((double)SumaP);
     } else {
         if (SumaP < 1E-37)
             return +10000;
@@ -107,10 +121,31 @@ double Fs(int Nsample, double pi, int NumAlelos)
 
     if (fabs(ValorFs) < 1.0E-15)
         ValorFs = 0.0;	    
-    
-    free(qew);
 
     return ValorFs;
 }
 
+/*  Calculates Fu's Fs
+ *
+ *      Nsample     - number of samples
+ *      pi          - average number of pairwise substitutions
+ *      NumAlelos   - number of haplotypes
+ *
+ *  Returns a double
+ */
+double Fs(int Nsample, double pi, int NumAlelos)
+{
+    double    *qew,
+              ValorFs;
+
+    if (pi == 0.0 || Nsample < 2) 
+        return(-10000);	
 
+    qew  = (double *)malloc(FS_QEW_SIZE(Nsample)*sizeof(double));
+
+    ValorFs = Fs_qew(Nsample, pi, NumAlelos, qew);
+    
+    free(qew);
+
+    return ValorFs;
+}
@@ -1 +1,6 @@
+/* scratch space Fs_qew() needs for a sample size: the Nsample*Nsample table
+ * of Ewens probabilities plus two running sums of logs of Nsample+1 each */
+#define FS_QEW_SIZE(n) ((size_t)(n)*(size_t)(n) + 2*((size_t)(n) + 1))
+
 double Fs(int Nsample, double pi, int NumAlelos);
+double Fs_qew(int Nsample, double pi, int NumAlelos, double *qew);
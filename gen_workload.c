@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "simple_getopt.h"
+
+#define PACKAGE "gen_workload"
+#define VERSION "0.0.1"
+
+/* String containing name the program is called with. */
+const char *program_name;
+
+/* the generator's state; everything drawn comes from here, so the same
+ * seed gives the same bytes on any machine */
+static unsigned long long state;
+
+/*  Draw a number below n (n > 0) from the generator
+ *
+ *      n           - the bound
+ *
+ *  Returns a number in 0 .. n-1
+ */
+static int next_below(int n) {
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return (int)((state >> 33) % (unsigned long long)n);
+}
+
+/*  Put the first k entries of a Fisher-Yates shuffle of 0 .. n-1 at the
+ *    start of <order>
+ *
+ *      n           - number of entries
+ *      k           - number to draw
+ *      order       - room for n ints
+ *
+ *  Returns nothing
+ */
+static void draw_without_replacement(int n, int k, int *order) {
+    int     i, j,               /* iterators */
+            t;                  /* entry being swapped */
+
+    for (i=0; i<n; i++)
+        order[i] = i;
+    for (i=0; i<k; i++) {
+        j = i + next_below(n - i);
+        t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+}
+
+static int compare_ints(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+/* Print help info. */
+static void print_help (void) {
+  printf ("Usage: %s [OPTIONS]\n", program_name);
+
+  puts ("");
+  fputs ("\
+    -h        display this help and exit\n\
+    -v        display version information and exit\n\
+    -n NSAM   samples per replicate (default 10)\n\
+    -r REPS   number of replicates (default 1)\n\
+    -S SITES  segregating sites per replicate (default 100)\n\
+    -l LEN    PHYLIP alignment length, at least SITES (default 1000)\n\
+    -k HAPS   haplotype diversity: the samples are copies of HAPS founder\n\
+              haplotypes, 2 .. NSAM (default NSAM, every sample its own)\n\
+    -a ALPHA  site frequency shape: a site is carried by k founders with\n\
+              weight 1/k^ALPHA (default 1, the neutral spectrum; 0 is flat)\n\
+    -s SEED   seed for the generator (default 1)\n\
+    -p        write PHYLIP, as seq-gen does, instead of ms output\n", stdout);
+
+  puts ("");
+  fputs ("\
+Write a synthetic workload for sample_stats2 (ms format) or sample_stats3\n\
+(PHYLIP format), so that benchmarks can be regenerated byte for byte without\n\
+ms or seq-gen. The same options and seed always give the same output.\n\
+\n\
+Examples:\n\
+      gen_workload -n 100 -r 1000 -S 50 | sample_stats2\n\
+      gen_workload -p -n 10 -r 5 -l 2000 -S 200 | sample_stats3", stdout);
+  printf ("\n");
+}
+
+/* Print version and copyright information.  */
+static void print_version (void) {
+  printf ("(%s) version %s\n", PACKAGE, VERSION);
+}
+
+int main(int argc, char *argv[]) {
+    int     nsam,               /* samples per replicate */
+            howmany,            /* number of replicates */
+            segsites,           /* segregating sites per replicate */
+            length,             /* PHYLIP alignment length */
+            nfounders,          /* founder haplotypes */
+            phylip;             /* 1 to write PHYLIP */
+    double  alpha;              /* site frequency shape */
+    unsigned long seed;         /* the seed */
+
+    int     rep, i, j, k,       /* iterators */
+            derived,            /* founders carrying the site */
+            col,                /* alignment column of the site */
+            base,               /* ancestral base of a column */
+            alt;                /* and the derived one */
+    int     *founder,           /* founder of each sample */
+            *order,             /* scratch for draws without replacement */
+            *carrier,           /* 1 for the founders carrying the site */
+            *where;             /* positions or columns of the sites */
+    unsigned *cumulative;       /* the weights of 1 .. nfounders-1 carriers,
+                                 *   summed and scaled to 2^31 */
+    double  total,              /* sum of the weights */
+            sum;                /* running sum of the weights */
+    char    *rows,              /* the replicate, one row per sample */
+            ch;                 /* current character iterator for getopt option parsing */
+    const char bases[] = "AGCT";
+
+    program_name = argv[0];
+
+    nsam = 10;
+    howmany = 1;
+    segsites = 100;
+    length = 1000;
+    nfounders = 0;
+    alpha = 1.0;
+    seed = 1;
+    phylip = 0;
+
+    while ((ch = getopt(argc, argv, "n:r:S:l:k:a:s:phv")) != -1) {
+        switch (ch) {
+            case 'n':
+                nsam = atoi(optarg);
+                break;
+            case 'r':
+                howmany = atoi(optarg);
+                break;
+            case 'S':
+                segsites = atoi(optarg);
+                break;
+            case 'l':
+                length = atoi(optarg);
+                break;
+            case 'k':
+                nfounders = atoi(optarg);
+                break;
+            case 'a':
+                alpha = atof(optarg);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                phylip = 1;
+                break;
+            case 'h':
+                print_help();
+                exit (EXIT_SUCCESS);
+                break;
+            case 'v':
+                print_version();
+                exit (EXIT_SUCCESS);
+                break;
+            case '?':
+                fprintf (stderr, "Unknown option `-%c'.\n", optopt);
+                exit (EXIT_FAILURE);
+                break;
+        }
+    }
+
+    if (nfounders == 0)
+        nfounders = nsam;
+    if (nsam < 2 || howmany < 0 || segsites < 0 || nfounders < 2 || nfounders > nsam
+        || (phylip && length < segsites)) {
+        fprintf (stderr, "Bad -n, -r, -S, -l or -k value.\nTry '%s -h' for help\n", program_name);
+        exit (EXIT_FAILURE);
+    }
+    if (!phylip)
+        length = 10000;
+
+    founder = (int *)malloc(nsam*sizeof(int));
+    order = (int *)malloc((nsam > length ? nsam : length)*sizeof(int));
+    carrier = (int *)malloc(nfounders*sizeof(int));
+    where = (int *)malloc((segsites > 0 ? segsites : 1)*sizeof(int));
+    cumulative = (unsigned *)malloc(nfounders*sizeof(unsigned));
+    rows = (char *)malloc((size_t)nsam*((phylip ? length : segsites) + 1));
+    if (!founder || !order || !carrier || !where || !cumulative || !rows) {
+        perror("alloc error in gen_workload");
+        exit (EXIT_FAILURE);
+    }
+
+    /* the weights are turned into integer thresholds once, so that the
+     * draws themselves are integer arithmetic only */
+    total = 0.0;
+    for (k=1; k<nfounders; k++)
+        total += pow(k, -alpha);
+    sum = 0.0;
+    for (k=1; k<nfounders; k++) {
+        sum += pow(k, -alpha);
+        cumulative[k] = (unsigned)(sum/total*2147483648.0 + 0.5);
+    }
+    cumulative[nfounders-1] = 2147483648u;
+
+    state = seed;
+    if (!phylip)
+        printf("ms %d %d -s %d\n%lu\n", nsam, howmany, segsites, seed);
+
+    for (rep=0; rep<howmany; rep++) {
+        /* every founder has a sample, and the other samples copy one at
+         * random, in no particular order */
+        for (i=0; i<nsam; i++)
+            founder[i] = i < nfounders ? i : next_below(nfounders);
+        for (i=nsam-1; i>0; i--) {
+            j = next_below(i + 1);
+            k = founder[i];
+            founder[i] = founder[j];
+            founder[j] = k;
+        }
+
+        /* where the sites go: ms positions in 1/10000ths of the locus, or
+         * alignment columns, in order */
+        if (phylip) {
+            draw_without_replacement(length, segsites, order);
+            memcpy(where, order, segsites*sizeof(int));
+        } else {
+            for (j=0; j<segsites; j++)
+                where[j] = next_below(length);
+        }
+        qsort(where, segsites, sizeof(int), compare_ints);
+
+        /* PHYLIP rows start out as the ancestral sequence */
+        if (phylip) {
+            for (j=0; j<length; j++) {
+                base = bases[next_below(4)];
+                for (i=0; i<nsam; i++)
+                    rows[(size_t)i*(length + 1) + j] = base;
+            }
+        }
+
+        for (j=0; j<segsites; j++) {
+            /* the number of founders carrying the derived allele, then
+             * which ones */
+            k = next_below(2147483647) + 1;
+            for (derived=1; derived<nfounders-1 && cumulative[derived] < (unsigned)k; derived++)
+                ;
+            draw_without_replacement(nfounders, derived, order);
+            memset(carrier, 0, nfounders*sizeof(int));
+            for (i=0; i<derived; i++)
+                carrier[order[i]] = 1;
+
+            if (phylip) {
+                col = where[j];
+                base = rows[col];
+                alt = bases[(strchr(bases, base) - bases + 1 + next_below(3)) % 4];
+                for (i=0; i<nsam; i++)
+                    if (carrier[founder[i]])
+                        rows[(size_t)i*(length + 1) + col] = alt;
+            } else {
+                for (i=0; i<nsam; i++)
+                    rows[(size_t)i*(segsites + 1) + j] = carrier[founder[i]] ? '1' : '0';
+            }
+        }
+
+        if (phylip) {
+            printf(" %d %d\n", nsam, length);
+            for (i=0; i<nsam; i++) {
+                rows[(size_t)i*(length + 1) + length] = '\0';
+                printf("%-10d%s\n", i + 1, rows + (size_t)i*(length + 1));
+            }
+        } else {
+            printf("\n//\nsegsites: %d\n", segsites);
+            if (segsites > 0) {
+                printf("positions:");
+                for (j=0; j<segsites; j++)
+                    printf(" %d.%04d", where[j]/10000, where[j] % 10000);
+                printf(" \n");
+                for (i=0; i<nsam; i++) {
+                    rows[(size_t)i*(segsites + 1) + segsites] = '\0';
+                    printf("%s\n", rows + (size_t)i*(segsites + 1));
+                }
+            }
+        }
+    }
+
+    free(founder);
+    free(order);
+    free(carrier);
+    free(where);
+    free(cumulative);
+    free(rows);
+    exit (EXIT_SUCCESS);
+}
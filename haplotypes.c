@@ -0,0 +1,276 @@
+#include <stdlib.h>
+#include <string.h>
+
+/*  Calculates the frequency of an allele at a particular site
+ *    across all chromosomes
+ *
+ *      allele      - the allele to count, e.g. '1' or 'A'
+ *      site        - the position to count, in the range 0, number of sites - 1
+ *      nsam        - the number of samples in the dataset (number of rows in list)
+ *      list        - a matrix containing the data, samples in rows, positions in columns
+ *
+ *  Returns an integer
+ */
+int frequency(char allele, int site, int nsam, char **list)
+{
+    int     i,                  /* iterator */
+            count;              /* running count of allele */
+
+    count = 0;
+
+    for (i=0; i<nsam; i++) {
+        count += (list[i][site] == allele ? 1 : 0);
+    }
+
+    return count;
+}
+
+/*  Count up the haplotype frequencies in the data
+ *
+ *      nsam            - total number of samples in data list
+ *      nsites          - total number of sites (length of each row of list;
+ *                        rows need not be '\0' terminated)
+ *      list            - the data ( samples by positions matrix of chars )
+ *      hap_freqs       - the (initialized) array of integers to fill (length nsam)
+ *
+ *  Returns nothing (fills in the array given)
+ */
+void count_haplotype_frequencies(int nsam, int nsites, char **list, int *hap_freqs)
+{
+    int     i, j;               /* iterators */
+
+    /* first initialize all haplotype counts to 0 */
+    for (i=0; i<nsam; i++) {
+        hap_freqs[i] = 0;
+    }
+
+    /* If there are no sites, then there is only one haplotype.
+     * Set the haplotype count of the first haplotype to the number
+     * of samples and all the rest to -9 */
+    if (nsites == 0) {
+        hap_freqs[0] = nsam;
+        for (i=1; i<nsam; i++) {
+            hap_freqs[i] = -9;
+        }
+    } else {
+        /* step through the data list, comparing each haplotype
+         * to all those following it */
+        for (i=0; i<nsam; i++) {
+            /* if a haplotype has not been seen, it's count in the
+             * hap_freqs array will be 0 */
+            if (hap_freqs[i] == 0) {
+                /* we automatically have one of this haplotype */
+                hap_freqs[i] = 1;
+                /* compare the current haplotype to all following in the list
+                 * that have not already been matched to an earlier one */
+                for (j=i+1; j<nsam; j++) {
+                    if (hap_freqs[j] == 0 && !memcmp(list[i], list[j], nsites)) {
+                        /* if we have a match, up the current haplotype's count
+                         * and set the count of the matching position to -9 so
+                         * we know we've already counted it */
+                        hap_freqs[i] += 1;
+                        hap_freqs[j] = -9;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*  Count the total number of haplotypes
+ *
+ *      nsam            - total number of samples in data list
+ *      hap_freqs       - an array with counts per haplotype
+ *                         (each entry corresponds to a row in the
+ *                          original data; all entries should have
+ *                          an integer value; a value of -9 indicates
+ *                          that the entry at that row has already been
+ *                          counted)
+ *
+ *  Returns an integer
+ */
+int num_haplotypes(int nsam, int *hap_freqs)
+{
+    int     i,                  /* iterator */
+            count;              /* running total */
+
+    count = 0;
+
+    for (i=0; i<nsam; i++) {
+        if (hap_freqs[i] > 0) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*  The size of the largest group of identical haplotypes
+ *
+ *      nsam            - total number of samples in data list
+ *      hap_freqs       - an array with counts per haplotype
+ *                         (each entry corresponds to a row in the
+ *                          original data; all entries should have
+ *                          an integer value; a value of -9 indicates
+ *                          that the entry at that row has already been
+ *                          counted)
+ *
+ *  Returns an integer
+ */
+int max_identical_haplotypes(int nsam, int *hap_freqs)
+{
+    int     i,                  /* iterator */
+            max_num;            /* running largest value */
+
+    max_num = 0;
+
+    for (i=0; i<nsam; i++) {
+        if (hap_freqs[i] > max_num) {
+            max_num = hap_freqs[i];
+        }
+    }
+
+    return max_num;
+}
+
+/*  Count the total number of singletons (haplotypes with only
+ *    one occurence.
+ *
+ *      nsam            - total number of samples in data list
+ *      hap_freqs       - an array with counts per haplotype
+ *                         (each entry corresponds to a row in the
+ *                          original data; all entries should have
+ *                          an integer value; a value of -9 indicates
+ *                          that the entry at that row has already been
+ *                          counted)
+ *
+ *  Returns an integer
+ */
+int num_singletons(int nsam, int *hap_freqs)
+{
+    int     i,                  /* iterator */
+            count;              /* running total */
+
+    count = 0;
+
+    for (i=0; i<nsam; i++) {
+        if (hap_freqs[i] == 1) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*  Calculate homozygosity.  This is done by summing up the squares
+ *    of haplotype proportions.
+ *
+ *      nsam            - total number of samples in data list
+ *      hap_freqs       - an array with counts per haplotype
+ *                         (each entry corresponds to a row in the
+ *                          original data; all entries should have
+ *                          an integer value; a value of -9 indicates
+ *                          that the entry at that row has already been
+ *                          counted)
+ *
+ *  Returns a double
+ */
+double homozygosity(int nsam, int *hap_freqs)
+{
+    int     i;                  /* iterator */
+    double  total,              /* double value for the total number of samples */
+            count,              /* temporary holder for each haplotype count */
+            proportion,         /* temporary holder for each haplotype proportion */
+            ho;                 /* calculated as we go (sum of per site homozygosities) */
+
+    ho = 0.0;
+    total = nsam;
+
+    for (i=0; i<nsam; i++) {
+        if (hap_freqs[i] > 0) {
+            count = hap_freqs[i];
+            proportion = count/total;
+            ho += proportion*proportion;
+        }
+    }
+
+    return ho;
+}
+
+/*  qsort() comparison putting larger haplotype counts first */
+static int compare_counts(const void *a, const void *b)
+{
+    int     x = *(const int *)a,
+            y = *(const int *)b;
+
+    return x > y ? -1 : x < y;
+}
+
+/*  Gather the haplotype counts into a table, largest first. This is
+ *    the haplotype frequency spectrum, and what Garud's H statistics
+ *    are worked out from.
+ *
+ *      nsam            - total number of samples in data list
+ *      hap_freqs       - an array with counts per haplotype
+ *                         (each entry corresponds to a row in the
+ *                          original data; all entries should have
+ *                          an integer value; a value of -9 indicates
+ *                          that the entry at that row has already been
+ *                          counted)
+ *      counts          - the array to fill (length nsam)
+ *
+ *  Returns the number of haplotypes (entries of counts filled in)
+ */
+int haplotype_count_table(int nsam, int *hap_freqs, int *counts)
+{
+    int     i,                  /* iterator */
+            nh;                 /* haplotypes so far */
+
+    nh = 0;
+
+    for (i=0; i<nsam; i++) {
+        if (hap_freqs[i] > 0) {
+            counts[nh++] = hap_freqs[i];
+        }
+    }
+    qsort(counts, nh, sizeof(int), compare_counts);
+
+    return nh;
+}
+
+/*  Calculate Garud et al's haplotype homozygosity statistics from a
+ *    sorted count table: H1 is the homozygosity, H12 the same with the
+ *    two commonest haplotypes pooled, and H2/H1 the share of H1 left
+ *    once the commonest haplotype is taken out.
+ *
+ *      nsam            - total number of samples in data list
+ *      nh              - number of haplotypes
+ *      counts          - their counts, largest first
+ *      h1              - where to put H1
+ *      h12             - where to put H12
+ *      h2h1            - where to put H2/H1
+ *
+ *  Returns nothing
+ */
+void garud_h(int nsam, int nh, int *counts, double *h1, double *h12, double *h2h1)
+{
+    int     i;                  /* iterator */
+    double  total,              /* double value for the total number of samples */
+            p1, p2,             /* proportions of the two commonest haplotypes */
+            proportion,         /* temporary holder for each haplotype proportion */
+            ho;                 /* sum of squared proportions */
+
+    ho = 0.0;
+    total = nsam;
+
+    for (i=0; i<nh; i++) {
+        proportion = counts[i]/total;
+        ho += proportion*proportion;
+    }
+    p1 = nh > 0 ? counts[0]/total : 0.0;
+    p2 = nh > 1 ? counts[1]/total : 0.0;
+
+    *h1 = ho;
+    *h12 = ho + 2.0*p1*p2;
+    *h2h1 = ho > 0.0 ? (ho - p1*p1)/ho : 0.0;
+}
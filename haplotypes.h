@@ -0,0 +1,8 @@
+int frequency(char allele, int site, int nsam, char **list);
+void count_haplotype_frequencies(int nsam, int nsites, char **list, int *hap_freqs);
+int num_haplotypes(int nsam, int *hap_freqs);
+int max_identical_haplotypes(int nsam, int *hap_freqs);
+int num_singletons(int nsam, int *hap_freqs);
+double homozygosity(int nsam, int *hap_freqs);
+int haplotype_count_table(int nsam, int *hap_freqs, int *counts);
+void garud_h(int nsam, int nh, int *counts, double *h1, double *h12, double *h2h1);
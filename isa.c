@@ -0,0 +1,533 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "samplestats.h"
+#include "packed.h"
+#include "ld.h"
+#include "distance.h"
+#include "isa.h"
+
+/* Run time selection of the bit-packed kernels (see isa.h) */
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#ifdef HAVE_X86_KERNELS
+
+/*  Pack '0'/'1' rows into words, 16 sites at a time: shift the low bit
+ *    of each character up to the top and collect the tops with movemask
+ *
+ *  Arguments and return as pack_rows_ascii()
+ */
+__attribute__((target("sse4.2")))
+static void pack_rows_ascii_sse42(int nsam, int nsites, const unsigned char *data,
+                                  size_t stride, uint64_t *rowbits)
+{
+    int                 i, j, k;    /* iterators */
+    int                 nwords;     /* words per packed row */
+    const unsigned char *src;       /* current row */
+    uint64_t            word;       /* word being filled */
+    __m128i             v;          /* 16 sites */
+
+    nwords = PACKED_WORDS(nsites);
+    for (i=0; i<nsam; i++) {
+        src = data + (size_t)i*stride;
+        for (k=0; k<nwords; k++) {
+            word = 0;
+            for (j=64*k; j<64*k + 64 && j + 16 <= nsites; j+=16) {
+                v = _mm_loadu_si128((const __m128i *)(src + j));
+                word |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_slli_epi16(v, 7)) << (j & 63);
+            }
+            for (; j<64*k + 64 && j<nsites; j++)
+                word |= (uint64_t)(src[j] & 1) << (j & 63);
+            rowbits[(size_t)i*nwords + k] = word;
+        }
+    }
+}
+
+/*  Pack '0'/'1' rows into words, 32 sites at a time
+ *
+ *  Arguments and return as pack_rows_ascii()
+ */
+__attribute__((target("avx2")))
+static void pack_rows_ascii_avx2(int nsam, int nsites, const unsigned char *data,
+                                 size_t stride, uint64_t *rowbits)
+{
+    int                 i, j, k;    /* iterators */
+    int                 nwords;     /* words per packed row */
+    const unsigned char *src;       /* current row */
+    uint64_t            word;       /* word being filled */
+    __m256i             v;          /* 32 sites */
+
+    nwords = PACKED_WORDS(nsites);
+    for (i=0; i<nsam; i++) {
+        src = data + (size_t)i*stride;
+        for (k=0; k<nwords; k++) {
+            word = 0;
+            for (j=64*k; j<64*k + 64 && j + 32 <= nsites; j+=32) {
+                v = _mm256_loadu_si256((const __m256i *)(src + j));
+                word |= (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_slli_epi16(v, 7)) << (j & 63);
+            }
+            for (; j<64*k + 64 && j<nsites; j++)
+                word |= (uint64_t)(src[j] & 1) << (j & 63);
+            rowbits[(size_t)i*nwords + k] = word;
+        }
+    }
+}
+
+/*  Pack '0'/'1' rows into words, a whole word (64 sites) per test; the
+ *    last word of a row is read with a masked load, so nothing past the
+ *    end of the row is touched
+ *
+ *  Arguments and return as pack_rows_ascii()
+ */
+__attribute__((target("avx512f,avx512bw")))
+static void pack_rows_ascii_avx512(int nsam, int nsites, const unsigned char *data,
+                                   size_t stride, uint64_t *rowbits)
+{
+    int                 i, k;       /* iterators */
+    int                 nwords;     /* words per packed row */
+    const unsigned char *src;       /* current row */
+    __mmask64           live;       /* sites present in the current word */
+    __m512i             ones,       /* the bit that separates '0' and '1' */
+                        v;          /* 64 sites */
+
+    nwords = PACKED_WORDS(nsites);
+    ones = _mm512_set1_epi8(1);
+    for (i=0; i<nsam; i++) {
+        src = data + (size_t)i*stride;
+        for (k=0; k<nwords; k++) {
+            if (64*k + 64 <= nsites) {
+                v = _mm512_loadu_si512((const void *)(src + 64*k));
+            } else {
+                live = ((__mmask64)1 << (nsites - 64*k)) - 1;
+                v = _mm512_maskz_loadu_epi8(live, src + 64*k);
+            }
+            rowbits[(size_t)i*nwords + k] = (uint64_t)_mm512_test_epi8_mask(v, ones);
+        }
+    }
+}
+
+/*  Count the derived alleles at each site with the popcnt instruction
+ *
+ *  Arguments and return as packed_site_frequencies()
+ */
+__attribute__((target("popcnt")))
+static void site_frequencies_popcnt(int nsam, int nsites, const uint64_t *cols,
+                                    int *site_freqs)
+{
+    int     j;                      /* iterator */
+
+    if (nsam <= 64) {
+        for (j=0; j<nsites; j++)
+            site_freqs[j] = (int)_mm_popcnt_u64(cols[j]);
+    } else {
+        for (j=0; j<nsites; j++)
+            site_freqs[j] = (int)(_mm_popcnt_u64(cols[2*j]) + _mm_popcnt_u64(cols[2*j + 1]));
+    }
+}
+
+/*  Count the derived alleles at each site, 8 sites per vector popcount.
+ *    With two words per site the counts of the even and odd words are
+ *    pulled apart and added.
+ *
+ *  Arguments and return as packed_site_frequencies()
+ */
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+static void site_frequencies_avx512(int nsam, int nsites, const uint64_t *cols,
+                                    int *site_freqs)
+{
+    int     j;                      /* iterator */
+    __m512i a, b,                   /* column words */
+            even, odd;              /* index vectors picking words 2j and 2j+1 */
+
+    j = 0;
+    if (nsam <= 64) {
+        for (; j + 8 <= nsites; j+=8) {
+            a = _mm512_popcnt_epi64(_mm512_loadu_si512((const void *)(cols + j)));
+            _mm256_storeu_si256((__m256i *)(site_freqs + j), _mm512_cvtepi64_epi32(a));
+        }
+        for (; j<nsites; j++)
+            site_freqs[j] = (int)_mm_popcnt_u64(cols[j]);
+    } else {
+        even = _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0);
+        odd = _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1);
+        for (; j + 8 <= nsites; j+=8) {
+            a = _mm512_popcnt_epi64(_mm512_loadu_si512((const void *)(cols + 2*j)));
+            b = _mm512_popcnt_epi64(_mm512_loadu_si512((const void *)(cols + 2*j + 8)));
+            a = _mm512_add_epi64(_mm512_permutex2var_epi64(a, even, b),
+                                 _mm512_permutex2var_epi64(a, odd, b));
+            _mm256_storeu_si256((__m256i *)(site_freqs + j), _mm512_cvtepi64_epi32(a));
+        }
+        for (; j<nsites; j++)
+            site_freqs[j] = (int)(_mm_popcnt_u64(cols[2*j]) + _mm_popcnt_u64(cols[2*j + 1]));
+    }
+}
+
+/*  AND one column with a run of others and count with the popcnt
+ *    instruction
+ *
+ *  Arguments and return as packed_and_counts()
+ */
+__attribute__((target("popcnt")))
+static void and_counts_popcnt(int nwords, const uint64_t *a, const uint64_t *cols, int n,
+                              int *counts)
+{
+    int         j, g;               /* iterators */
+
+    if (nwords == 1) {
+        for (j=0; j<n; j++)
+            counts[j] = (int)_mm_popcnt_u64(a[0] & cols[j]);
+    } else if (nwords == 2) {
+        for (j=0; j<n; j++)
+            counts[j] = (int)(_mm_popcnt_u64(a[0] & cols[2*j])
+                              + _mm_popcnt_u64(a[1] & cols[2*j + 1]));
+    } else {
+        for (j=0; j<n; j++) {
+            counts[j] = 0;
+            for (g=0; g<nwords; g++)
+                counts[j] += (int)_mm_popcnt_u64(a[g] & cols[(size_t)j*nwords + g]);
+        }
+    }
+}
+
+/*  AND one column with a run of others and count, 8 words per vector
+ *    popcount; two word columns are added up as in site_frequencies_avx512
+ *
+ *  Arguments and return as packed_and_counts()
+ */
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+static void and_counts_avx512(int nwords, const uint64_t *a, const uint64_t *cols, int n,
+                              int *counts)
+{
+    int     j;                      /* iterator */
+    __m512i x, y,                   /* column words */
+            m,                      /* the one column, repeated */
+            even, odd;              /* index vectors picking words 2j and 2j+1 */
+
+    j = 0;
+    if (nwords == 1) {
+        m = _mm512_set1_epi64((long long)a[0]);
+        for (; j + 8 <= n; j+=8) {
+            x = _mm512_popcnt_epi64(_mm512_and_si512(m, _mm512_loadu_si512((const void *)(cols + j))));
+            _mm256_storeu_si256((__m256i *)(counts + j), _mm512_cvtepi64_epi32(x));
+        }
+        for (; j<n; j++)
+            counts[j] = (int)_mm_popcnt_u64(a[0] & cols[j]);
+    } else if (nwords == 2) {
+        m = _mm512_set_epi64((long long)a[1], (long long)a[0], (long long)a[1], (long long)a[0],
+                             (long long)a[1], (long long)a[0], (long long)a[1], (long long)a[0]);
+        even = _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0);
+        odd = _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1);
+        for (; j + 8 <= n; j+=8) {
+            x = _mm512_popcnt_epi64(_mm512_and_si512(m, _mm512_loadu_si512((const void *)(cols + 2*j))));
+            y = _mm512_popcnt_epi64(_mm512_and_si512(m, _mm512_loadu_si512((const void *)(cols + 2*j + 8))));
+            x = _mm512_add_epi64(_mm512_permutex2var_epi64(x, even, y),
+                                 _mm512_permutex2var_epi64(x, odd, y));
+            _mm256_storeu_si256((__m256i *)(counts + j), _mm512_cvtepi64_epi32(x));
+        }
+        for (; j<n; j++)
+            counts[j] = (int)(_mm_popcnt_u64(a[0] & cols[2*j])
+                              + _mm_popcnt_u64(a[1] & cols[2*j + 1]));
+    } else {
+        and_counts_popcnt(nwords, a, cols, n, counts);
+    }
+}
+
+/*  Turn joint counts into r^2, 4 pairs at a time
+ *
+ *  Arguments and return as ld_r2_row()
+ */
+__attribute__((target("avx2")))
+static double r2_row_avx2(int n, const int *counts, double inv_n, double pi, double rhi,
+                          const double *p, const double *rh, double *earlier)
+{
+    int     j;                      /* iterator */
+    double  d, r2,                  /* one pair, for the tail */
+            lanes[4];               /* the sums, spilled */
+    __m256d vinv, vpi, vrhi,        /* the constants */
+            x, sum;                 /* 4 pairs, running sums */
+
+    vinv = _mm256_set1_pd(inv_n);
+    vpi = _mm256_set1_pd(pi);
+    vrhi = _mm256_set1_pd(rhi);
+    sum = _mm256_setzero_pd();
+    for (j=0; j + 4 <= n; j+=4) {
+        x = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)(counts + j)));
+        x = _mm256_sub_pd(_mm256_mul_pd(x, vinv), _mm256_mul_pd(vpi, _mm256_loadu_pd(p + j)));
+        x = _mm256_mul_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(vrhi, _mm256_loadu_pd(rh + j)));
+        _mm256_storeu_pd(earlier + j, _mm256_add_pd(_mm256_loadu_pd(earlier + j), x));
+        sum = _mm256_add_pd(sum, x);
+    }
+    _mm256_storeu_pd(lanes, sum);
+    lanes[0] += lanes[2];
+    lanes[1] += lanes[3];
+    for (; j<n; j++) {
+        d = counts[j]*inv_n - pi*p[j];
+        r2 = d*d*(rhi*rh[j]);
+        earlier[j] += r2;
+        lanes[0] += r2;
+    }
+    return lanes[0] + lanes[1];
+}
+
+/*  Turn joint counts into r^2, 8 pairs at a time; the last few are
+ *    done with masked loads and stores
+ *
+ *  Arguments and return as ld_r2_row()
+ */
+__attribute__((target("avx512f")))
+static double r2_row_avx512(int n, const int *counts, double inv_n, double pi, double rhi,
+                            const double *p, const double *rh, double *earlier)
+{
+    int         j;                  /* iterator */
+    __mmask8    live;               /* pairs present in the last vector */
+    __m512d     vinv, vpi, vrhi,    /* the constants */
+                x, sum;             /* 8 pairs, running sums */
+
+    vinv = _mm512_set1_pd(inv_n);
+    vpi = _mm512_set1_pd(pi);
+    vrhi = _mm512_set1_pd(rhi);
+    sum = _mm512_setzero_pd();
+    for (j=0; j<n; j+=8) {
+        live = n - j >= 8 ? 0xFF : (__mmask8)((1u << (n - j)) - 1);
+        x = _mm512_cvtepi32_pd(_mm512_castsi512_si256(_mm512_maskz_loadu_epi32((__mmask16)live,
+                                                                                counts + j)));
+        x = _mm512_sub_pd(_mm512_mul_pd(x, vinv),
+                          _mm512_mul_pd(vpi, _mm512_maskz_loadu_pd(live, p + j)));
+        x = _mm512_mul_pd(_mm512_mul_pd(x, x),
+                          _mm512_mul_pd(vrhi, _mm512_maskz_loadu_pd(live, rh + j)));
+        _mm512_mask_storeu_pd(earlier + j, live,
+                              _mm512_add_pd(_mm512_maskz_loadu_pd(live, earlier + j), x));
+        sum = _mm512_add_pd(sum, x);
+    }
+    return _mm512_reduce_add_pd(sum);
+}
+
+/*  Hash each packed row with the SSE4.2 crc32 instruction
+ *
+ *  Arguments and return as packed_row_hashes()
+ */
+__attribute__((target("sse4.2")))
+static void row_hashes_crc32(int nsam, int nsites, const uint64_t *rowbits, uint64_t *hashes)
+{
+    int             i, k;           /* iterators */
+    int             nwords;         /* words per packed row */
+    const uint64_t  *a;             /* current row */
+    uint64_t        h;              /* hash being built */
+
+    nwords = PACKED_WORDS(nsites);
+    for (i=0; i<nsam; i++) {
+        a = rowbits + (size_t)i*nwords;
+        h = 0;
+        for (k=0; k<nwords; k++)
+            h = _mm_crc32_u64(h, a[k]);
+        hashes[i] = h;
+    }
+}
+
+/*  XOR one packed row with a run of others and count with the popcnt
+ *    instruction
+ *
+ *  Arguments and return as dist_xor_counts()
+ */
+__attribute__((target("popcnt")))
+static void xor_counts_popcnt(int nwords, const uint64_t *a, const uint64_t *rows, int n,
+                              int *counts)
+{
+    int         j, g;               /* iterators */
+    const uint64_t *b;              /* the other row */
+    uint64_t    c;                  /* running count */
+
+    for (j=0; j<n; j++) {
+        b = rows + (size_t)j*nwords;
+        c = 0;
+        for (g=0; g<nwords; g++)
+            c += _mm_popcnt_u64(a[g] ^ b[g]);
+        counts[j] = (int)c;
+    }
+}
+
+/*  XOR one packed nucleotide row with a run of others and count with the
+ *    popcnt instruction
+ *
+ *  Arguments and return as dist_xor2_counts()
+ */
+__attribute__((target("popcnt")))
+static void xor2_counts_popcnt(int nwords, const uint64_t *a, const uint64_t *rows, int n,
+                               int *counts)
+{
+    int         j, g,               /* iterators */
+                half;               /* words of codes */
+    const uint64_t *b;              /* the other row */
+    uint64_t    x,                  /* differing bits */
+                c;                  /* running count */
+
+    half = nwords/2;
+    for (j=0; j<n; j++) {
+        b = rows + (size_t)j*nwords;
+        c = 0;
+        for (g=0; g<half; g++) {
+            x = (a[g] ^ b[g]) & a[half + g] & b[half + g];
+            c += _mm_popcnt_u64((x | (x >> 1)) & 0x5555555555555555ULL);
+        }
+        counts[j] = (int)c;
+    }
+}
+
+/*  XOR one packed row with a run of others and count, 8 words of a row
+ *    per vector popcount
+ *
+ *  Arguments and return as dist_xor_counts()
+ */
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+static void xor_counts_avx512(int nwords, const uint64_t *a, const uint64_t *rows, int n,
+                              int *counts)
+{
+    int         j, g;               /* iterators */
+    const uint64_t *b;              /* the other row */
+    __m512i     c;                  /* running counts, per lane */
+    __mmask8    live;               /* words of the last vector in the row */
+    uint64_t    last;               /* count of the words past the vectors */
+
+    if (nwords < 8) {
+        xor_counts_popcnt(nwords, a, rows, n, counts);
+        return;
+    }
+    live = (__mmask8)((1u << (nwords % 8)) - 1);
+    for (j=0; j<n; j++) {
+        b = rows + (size_t)j*nwords;
+        c = _mm512_setzero_si512();
+        for (g=0; g + 8 <= nwords; g+=8)
+            c = _mm512_add_epi64(c, _mm512_popcnt_epi64(_mm512_xor_si512(
+                    _mm512_loadu_si512((const void *)(a + g)),
+                    _mm512_loadu_si512((const void *)(b + g)))));
+        last = 0;
+        if (live)
+            last = (uint64_t)_mm512_reduce_add_epi64(_mm512_popcnt_epi64(_mm512_xor_si512(
+                       _mm512_maskz_loadu_epi64(live, a + g),
+                       _mm512_maskz_loadu_epi64(live, b + g))));
+        counts[j] = (int)((uint64_t)_mm512_reduce_add_epi64(c) + last);
+    }
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+/* Kernel tables, worst to best */
+static const struct ss_kernels kernel_tables[] = {
+    { "generic", pack_rows_ascii,        packed_site_frequencies, packed_row_hashes,
+                 packed_and_counts,  ld_r2_row,
+                 dist_xor_counts,    dist_xor2_counts },
+#ifdef HAVE_X86_KERNELS
+    { "sse4.2",  pack_rows_ascii_sse42,  site_frequencies_popcnt, row_hashes_crc32,
+                 and_counts_popcnt,  ld_r2_row,
+                 xor_counts_popcnt,  xor2_counts_popcnt },
+    { "avx2",    pack_rows_ascii_avx2,   site_frequencies_popcnt, row_hashes_crc32,
+                 and_counts_popcnt,  r2_row_avx2,
+                 xor_counts_popcnt,  xor2_counts_popcnt },
+    { "avx512",  pack_rows_ascii_avx512, site_frequencies_avx512, row_hashes_crc32,
+                 and_counts_avx512,  r2_row_avx512,
+                 xor_counts_avx512,  xor2_counts_popcnt },
+#endif
+};
+
+#define NTABLES (int)(sizeof(kernel_tables) / sizeof(kernel_tables[0]))
+
+/* the table in use, bound on first use */
+static _Atomic(const struct ss_kernels *) current;
+
+/*  Check whether this CPU can run a kernel table
+ *
+ *      k           - the table
+ *
+ *  Returns 1 if it can, 0 if not
+ */
+static int supported(const struct ss_kernels *k)
+{
+#ifdef HAVE_X86_KERNELS
+    /* the compiler's cpuid probe; it also checks that the OS saves the
+     * AVX and AVX-512 registers */
+    __builtin_cpu_init();
+    if (!strcmp(k->name, "sse4.2"))
+        return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+    if (!strcmp(k->name, "avx2"))
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    if (!strcmp(k->name, "avx512"))
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+               && __builtin_cpu_supports("avx512vpopcntdq") && __builtin_cpu_supports("popcnt");
+#endif
+    return !strcmp(k->name, "generic");
+}
+
+/*  Find the best kernel table this CPU can run
+ *
+ *  Returns a pointer to the table
+ */
+static const struct ss_kernels *best(void)
+{
+    int     i;                      /* iterator */
+
+    for (i=NTABLES-1; i>0; i--) {
+        if (supported(&kernel_tables[i]))
+            return &kernel_tables[i];
+    }
+    return &kernel_tables[0];
+}
+
+/*  Get the kernel table in use, probing the CPU the first time through.
+ *    Threads racing here all bind the same table.
+ *
+ *  Returns a pointer to the table
+ */
+const struct ss_kernels *ss_kernels(void)
+{
+    const struct ss_kernels *k;
+
+    if ((k = atomic_load_explicit(&current, memory_order_acquire)) == NULL) {
+        k = best();
+        atomic_store_explicit(&current, k, memory_order_release);
+    }
+    return k;
+}
+
+/*  Choose the instruction set the kernels use
+ *
+ *      name        - "generic", "sse4.2", "avx2", "avx512", or "auto"
+ *                    for the best one this CPU supports
+ *
+ *  Returns SS_OK, or SS_EINVAL if the name is unknown or the CPU cannot
+ *    run that instruction set
+ */
+int ss_set_isa(const char *name)
+{
+    int     i;                      /* iterator */
+
+    if (name == NULL)
+        return SS_EINVAL;
+    if (!strcmp(name, "auto")) {
+        atomic_store_explicit(&current, best(), memory_order_release);
+        return SS_OK;
+    }
+    for (i=0; i<NTABLES; i++) {
+        if (!strcmp(name, kernel_tables[i].name)) {
+            if (!supported(&kernel_tables[i]))
+                return SS_EINVAL;
+            atomic_store_explicit(&current, &kernel_tables[i], memory_order_release);
+            return SS_OK;
+        }
+    }
+    return SS_EINVAL;
+}
+
+/*  Name the instruction set the kernels use
+ *
+ *  Returns a string such as "avx2"
+ */
+const char *ss_get_isa(void)
+{
+    return ss_kernels()->name;
+}
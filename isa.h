@@ -0,0 +1,51 @@
+#ifndef ISA_H
+#define ISA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Instruction set specific versions of the bit-packed kernels in packed.h.
+ *
+ * Each instruction set gets a table of function pointers, one per kernel
+ * family. The first time ss_kernels() is called the CPU is probed (cpuid)
+ * and the best table it can run is bound; ss_set_isa() in samplestats.h
+ * forces a particular one, so that the paths can be compared. The kernels
+ * are compiled with per-function target attributes, so one binary built
+ * with plain -O2 carries all of them. */
+
+struct ss_kernels {
+    const char  *name;                  /* as given to ss_set_isa() */
+
+    /* pack '0'/'1' rows into words (as pack_rows_ascii) */
+    void        (*pack_rows_ascii)(int nsam, int nsites, const unsigned char *data,
+                                   size_t stride, uint64_t *rowbits);
+
+    /* popcount the column words of each site (as packed_site_frequencies) */
+    void        (*site_frequencies)(int nsam, int nsites, const uint64_t *cols,
+                                    int *site_freqs);
+
+    /* hash the packed rows (as packed_row_hashes) */
+    void        (*row_hashes)(int nsam, int nsites, const uint64_t *rowbits,
+                              uint64_t *hashes);
+
+    /* AND one site column with a run of others and popcount (as
+     * packed_and_counts) */
+    void        (*and_counts)(int nwords, const uint64_t *a, const uint64_t *cols,
+                              int n, int *counts);
+
+    /* turn joint counts into r^2 (as ld_r2_row) */
+    double      (*r2_row)(int n, const int *counts, double inv_n, double pi, double rhi,
+                          const double *p, const double *rh, double *earlier);
+
+    /* XOR one packed row with a run of others and popcount (as
+     * dist_xor_counts), and the same for nucleotide rows (as
+     * dist_xor2_counts) */
+    void        (*xor_counts)(int nwords, const uint64_t *a, const uint64_t *rows,
+                              int n, int *counts);
+    void        (*xor2_counts)(int nwords, const uint64_t *a, const uint64_t *rows,
+                               int n, int *counts);
+};
+
+const struct ss_kernels *ss_kernels(void);
+
+#endif /* ISA_H */
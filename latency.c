@@ -0,0 +1,79 @@
+#include <string.h>
+#include <math.h>
+
+#include "latency.h"
+
+/*  Empty a histogram
+ *
+ *      h           - the histogram
+ *
+ *  Returns nothing
+ */
+void latency_clear(struct latency *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+/*  Add a time to a histogram
+ *
+ *      h           - the histogram
+ *      seconds     - the time
+ *
+ *  Returns nothing
+ */
+void latency_add(struct latency *h, double seconds)
+{
+    double  us;                 /* the time in microseconds */
+    int     k;                  /* its bucket */
+
+    us = seconds*1e6;
+    if (us < 1.0)
+        k = 0;
+    else if ((k = 1 + (int)(4.0*log2(us))) >= LATENCY_BUCKETS)
+        k = LATENCY_BUCKETS - 1;
+    h->count[k]++;
+    h->n++;
+    h->sum += seconds;
+    if (seconds > h->max)
+        h->max = seconds;
+}
+
+/*  The top of a bucket
+ *
+ *      bucket      - the bucket
+ *
+ *  Returns the time at which the bucket ends, in seconds (the last
+ *    one takes everything above that of the one before)
+ */
+double latency_bucket_top(int bucket)
+{
+    return pow(2.0, bucket/4.0)*1e-6;
+}
+
+/*  A percentile of the times in a histogram
+ *
+ *      h           - the histogram
+ *      q           - the share of the times that are to be no longer,
+ *                    0 .. 1 (0.5 for the median, 0.99 for p99)
+ *
+ *  Returns the top of the bucket it falls in, but no more than the
+ *    longest time, in seconds; 0 if the histogram is empty
+ */
+double latency_quantile(const struct latency *h, double q)
+{
+    long long seen;             /* times in the buckets so far */
+    int     k;                  /* iterator */
+    double  top;                /* end of the bucket the percentile is in */
+
+    if (h->n == 0)
+        return 0.0;
+    seen = 0;
+    for (k=0; k<LATENCY_BUCKETS - 1; k++) {
+        seen += h->count[k];
+        if (seen >= q*h->n && seen > 0)
+            break;
+    }
+    /* the last bucket has no top */
+    top = k < LATENCY_BUCKETS - 1 ? latency_bucket_top(k) : h->max;
+    return top < h->max ? top : h->max;
+}
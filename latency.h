@@ -0,0 +1,25 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+/* A histogram of how long each replicate took, in log-spaced buckets, from
+ * which percentiles come without keeping the times themselves: bucket 0
+ * holds everything under a microsecond, and bucket k > 0 the times from
+ * 2^((k-1)/4) up to 2^(k/4) microseconds, so a percentile is good to a
+ * quarter of an octave (19%) whatever the spread. The last bucket takes
+ * everything from about twelve days up. */
+
+#define LATENCY_BUCKETS     162
+
+struct latency {
+    long long   n,                          /* times added */
+                count[LATENCY_BUCKETS];     /* of them, per bucket */
+    double      sum,                        /* their total, in seconds */
+                max;                        /* and the longest */
+};
+
+void latency_clear(struct latency *h);
+void latency_add(struct latency *h, double seconds);
+double latency_quantile(const struct latency *h, double q);
+double latency_bucket_top(int bucket);
+
+#endif /* LATENCY_H */
@@ -0,0 +1,448 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "packed.h"
+#include "isa.h"
+#include "ld.h"
+
+/* Linkage disequilibrium summaries on bit-packed columns (see ld.h) */
+
+/* one thread's share of the tiles */
+struct ld_job {
+    const struct ld_scratch *s;     /* columns and frequencies */
+    int         nsites,             /* segregating sites */
+                nwords,             /* column words per site */
+                window,             /* largest j - i of a pair */
+                nthreads,           /* threads sharing the tiles */
+                id;                 /* this thread, 0 .. nthreads-1 */
+    double      inv_n;              /* 1/nsam */
+    const struct ss_kernels *k;     /* kernels for this CPU */
+};
+
+/*  Make sure the scratch space can hold a replicate
+ *
+ *      s           - the scratch space (zeroed before first use)
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      nthreads    - number of threads that will be used
+ *
+ *  Returns 0, or -1 if out of memory
+ */
+int ld_reserve(struct ld_scratch *s, int nsam, int nsites, int nthreads)
+{
+    void    *p;                 /* result of each reallocation */
+    int     nwords;             /* column words per site */
+
+    nwords = PACKED_WORDS(nsam);
+    if (nthreads > LD_MAXTHREADS)
+        nthreads = LD_MAXTHREADS;
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nsites <= s->maxsites && nwords <= s->maxwords && nthreads <= s->maxthreads)
+        return 0;
+
+    if (nsites < s->maxsites)
+        nsites = s->maxsites;
+    if (nwords < s->maxwords)
+        nwords = s->maxwords;
+    if (nthreads < s->maxthreads)
+        nthreads = s->maxthreads;
+
+    if (!(p = realloc(s->cols, (size_t)nsites*nwords*sizeof(uint64_t) + 1)))
+        return -1;
+    s->cols = (uint64_t *)p;
+    if (!(p = realloc(s->p, (size_t)nsites*sizeof(double) + 1)))
+        return -1;
+    s->p = (double *)p;
+    if (!(p = realloc(s->rh, (size_t)nsites*sizeof(double) + 1)))
+        return -1;
+    s->rh = (double *)p;
+    if (!(p = realloc(s->sums, (size_t)2*nsites*nthreads*sizeof(struct ld_sum) + 1)))
+        return -1;
+    s->sums = (struct ld_sum *)p;
+    if (!(p = realloc(s->counts, (size_t)LD_BLOCK*nthreads*sizeof(int))))
+        return -1;
+    s->counts = (int *)p;
+
+    s->maxsites = nsites;
+    s->maxwords = nwords;
+    s->maxthreads = nthreads;
+    return 0;
+}
+
+/*  Free what the scratch space holds
+ *
+ *      s           - the scratch space
+ *
+ *  Returns nothing
+ */
+void ld_scratch_free(struct ld_scratch *s)
+{
+    free(s->cols);
+    free(s->p);
+    free(s->rh);
+    free(s->sums);
+    free(s->counts);
+    memset(s, 0, sizeof(*s));
+}
+
+/*  Build site columns from '0'/'1' rows, for replicates too big for
+ *    packed_columns()
+ *
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      rows        - the rows
+ *      cols        - where to put the columns (nsites * PACKED_WORDS(nsam))
+ *
+ *  Returns nothing
+ */
+void ld_columns_rows(int nsam, int nsites, char **rows, uint64_t *cols)
+{
+    int     i, j;               /* iterators */
+    int     nwords;             /* column words per site */
+
+    nwords = PACKED_WORDS(nsam);
+    memset(cols, 0, (size_t)nsites*nwords*sizeof(uint64_t));
+    for (i=0; i<nsam; i++) {
+        for (j=0; j<nsites; j++) {
+            if (rows[i][j] == '1')
+                cols[(size_t)j*nwords + i/64] |= (uint64_t)1 << (i % 64);
+        }
+    }
+}
+
+/*  Turn the joint counts of one site with a run of others into r^2,
+ *    adding each to the other site's sum
+ *
+ *      n           - number of other sites
+ *      counts      - samples with the derived allele at both sites
+ *      inv_n       - 1/nsam
+ *      pi, rhi     - frequency and 1/(p*(1-p)) of the one site
+ *      p, rh       - the same for the others
+ *      earlier     - sums of the others, added to
+ *
+ *  Returns r^2 summed over the others
+ */
+double ld_r2_row(int n, const int *counts, double inv_n, double pi, double rhi,
+                 const double *p, const double *rh, double *earlier)
+{
+    int     j;                      /* iterator */
+    double  d,                      /* the disequilibrium */
+            r2[LD_BLOCK],           /* r^2 of each pair */
+            sum[4];                 /* r^2 summed, in four lanes so the
+                                     *   adds overlap */
+
+    /* kept free of reductions so that the compiler vectorises it */
+    for (j=0; j<n; j++) {
+        d = counts[j]*inv_n - pi*p[j];
+        r2[j] = d*d*rhi*rh[j];
+        earlier[j] += r2[j];
+    }
+
+    sum[0] = sum[1] = sum[2] = sum[3] = 0.0;
+    for (j=0; j + 4 <= n; j+=4) {
+        sum[0] += r2[j];
+        sum[1] += r2[j + 1];
+        sum[2] += r2[j + 2];
+        sum[3] += r2[j + 3];
+    }
+    for (; j<n; j++)
+        sum[0] += r2[j];
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+/* one whole in the fraction word of a struct ld_sum */
+#define LD_FRAC_ONE     ((int64_t)1 << 62)
+
+/*  Add to a fixed point sum
+ *
+ *      sum         - the sum
+ *      x           - what to add, 0 <= x < 2^62; the bits below 2^-62
+ *                    are dropped
+ *
+ *  Returns nothing
+ */
+static void ld_sum_add(struct ld_sum *sum, double x)
+{
+    int64_t w;                      /* the whole part of x */
+
+    w = (int64_t)x;
+    sum->whole += w;
+    sum->frac += (int64_t)((x - (double)w)*(double)LD_FRAC_ONE);
+    if (sum->frac >= LD_FRAC_ONE) {
+        sum->frac -= LD_FRAC_ONE;
+        sum->whole++;
+    }
+}
+
+/*  Add one fixed point sum to another
+ *
+ *      sum         - the sum added to
+ *      x           - the sum to add
+ *
+ *  Returns nothing
+ */
+static void ld_sum_merge(struct ld_sum *sum, const struct ld_sum *x)
+{
+    sum->whole += x->whole;
+    sum->frac += x->frac;
+    if (sum->frac >= LD_FRAC_ONE) {
+        sum->frac -= LD_FRAC_ONE;
+        sum->whole++;
+    }
+}
+
+/*  The value of a fixed point sum
+ *
+ *      sum         - the sum
+ *
+ *  Returns a double
+ */
+static double ld_sum_value(const struct ld_sum *sum)
+{
+    return (double)sum->whole + (double)sum->frac/(double)LD_FRAC_ONE;
+}
+
+/*  Work through the pairs between two blocks of sites, adding each r^2
+ *    to the sums of both its sites. The tile's own sums are added up in
+ *    doubles and go into the fixed point sums once at the end, so what it
+ *    adds does not depend on which thread does it or when.
+ *
+ *      job         - the job
+ *      bi, bj      - the blocks (bi <= bj)
+ *      earlier     - r^2 summed over the earlier partner, per site
+ *      later       - r^2 summed over the later partner, per site
+ *      counts      - room for LD_BLOCK ints
+ *      tile        - room for 2*LD_BLOCK doubles
+ *
+ *  Returns nothing
+ */
+static void ld_tile(const struct ld_job *job, int bi, int bj, struct ld_sum *earlier,
+                    struct ld_sum *later, int *counts, double *tile)
+{
+    int             i, j,           /* the earlier and later sites */
+                    iend,           /* last site + 1 of block bi */
+                    jend,           /* last site + 1 of block bj */
+                    j0, j1;         /* range of partners of site i */
+    const double    *p, *rh;        /* frequencies and 1/(p*(1-p)) */
+    double          *te, *tl;       /* the tile's sums over the earlier and
+                                     *   later partners, per site of bj, bi */
+
+    p = job->s->p;
+    rh = job->s->rh;
+    iend = (bi + 1)*LD_BLOCK < job->nsites ? (bi + 1)*LD_BLOCK : job->nsites;
+    jend = (bj + 1)*LD_BLOCK < job->nsites ? (bj + 1)*LD_BLOCK : job->nsites;
+    te = tile;
+    tl = tile + LD_BLOCK;
+    memset(tile, 0, 2*LD_BLOCK*sizeof(double));
+
+    for (i=bi*LD_BLOCK; i<iend; i++) {
+        j0 = bj*LD_BLOCK > i + 1 ? bj*LD_BLOCK : i + 1;
+        j1 = jend;
+        if (j1 - i > job->window)
+            j1 = i + job->window + 1;
+        if (j0 >= j1)
+            continue;
+
+        job->k->and_counts(job->nwords, job->s->cols + (size_t)i*job->nwords,
+                           job->s->cols + (size_t)j0*job->nwords, j1 - j0, counts);
+        tl[i - bi*LD_BLOCK] = job->k->r2_row(j1 - j0, counts, job->inv_n, p[i], rh[i],
+                                             p + j0, rh + j0, te + (j0 - bj*LD_BLOCK));
+    }
+
+    for (i=bi*LD_BLOCK; i<iend; i++)
+        ld_sum_add(later + i, tl[i - bi*LD_BLOCK]);
+    for (j=bj*LD_BLOCK; j<jend; j++)
+        ld_sum_add(earlier + j, te[j - bj*LD_BLOCK]);
+}
+
+/*  Work through one thread's share of the tiles: every nthreads'th tile,
+ *    counting along the rows of blocks
+ *
+ *      arg         - the job
+ *
+ *  Returns NULL
+ */
+static void *ld_tiles(void *arg)
+{
+    const struct ld_job *job;       /* what to do */
+    int         bi, bj,             /* blocks */
+                nblocks;            /* number of blocks */
+    long        k;                  /* tile number */
+    struct ld_sum *earlier, *later; /* this thread's sums */
+    int         *counts;            /* this thread's tile row */
+    double      tile[2*LD_BLOCK];   /* one tile's sums */
+
+    job = (const struct ld_job *)arg;
+    earlier = job->s->sums + (size_t)2*job->s->maxsites*job->id;
+    later = earlier + job->s->maxsites;
+    counts = job->s->counts + (size_t)LD_BLOCK*job->id;
+    memset(earlier, 0, job->nsites*sizeof(struct ld_sum));
+    memset(later, 0, job->nsites*sizeof(struct ld_sum));
+
+    nblocks = (job->nsites + LD_BLOCK - 1) / LD_BLOCK;
+    k = 0;
+    for (bi=0; bi<nblocks; bi++) {
+        /* skip tiles whose closest pair is further apart than the window */
+        for (bj=bi; bj<nblocks && (long)(bj - bi - 1)*LD_BLOCK + 1 <= job->window; bj++) {
+            if (k++ % job->nthreads == job->id)
+                ld_tile(job, bi, bj, earlier, later, counts, tile);
+        }
+    }
+    return NULL;
+}
+
+/*  Number of pairs no more than window sites apart
+ *
+ *      nsites      - number of sites
+ *      window      - largest distance, 1 .. nsites-1
+ *
+ *  Returns a long
+ */
+static long window_pairs(int nsites, int window)
+{
+    return (long)window*nsites - (long)window*(window + 1)/2;
+}
+
+/*  Calculate ZnS and omega from the r^2 of every pair of segregating sites
+ *    (or of every pair no more than a window apart). r^2 of a pair is
+ *    D^2/(p1*(1-p1)*p2*(1-p2)), D being the frequency of the derived allele
+ *    at both sites less p1*p2.
+ *
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      cols        - site columns, PACKED_WORDS(nsam) words per site (from
+ *                    packed_columns() or ld_columns_rows()); may be s->cols
+ *      site_freqs  - count of the derived allele per site
+ *      window      - only pair sites at most this many segregating sites
+ *                    apart; 0 for no limit
+ *      max_pairs   - if there would be more pairs than this, shrink the
+ *                    window until there are not; 0 for no limit
+ *      nthreads    - threads to share the tiles between; the sums are
+ *                    kept in fixed point, so the result is the same to
+ *                    the bit whatever the number of threads
+ *      s           - scratch space, from ld_reserve(nsam, nsites, nthreads)
+ *      out         - where to put the results
+ *
+ *  Returns nothing
+ */
+void ld_summarise(int nsam, int nsites, const uint64_t *cols, const int *site_freqs,
+                  int window, long max_pairs, int nthreads, struct ld_scratch *s,
+                  struct ld_summary *out)
+{
+    int             i, j, t,        /* iterators */
+                    nwords,         /* column words per site */
+                    seg,            /* segregating sites */
+                    nl, nd;         /* earlier / later partners of a site */
+    long            pairs,          /* pairs used */
+                    pl, pd;         /* pairs with both / the earlier site left
+                                     *   of a split */
+    struct ld_sum   *earlier,       /* r^2 summed over the earlier partner */
+                    *later,         /* r^2 summed over the later partner */
+                    *sums;          /* another thread's sums */
+    double          total,          /* r^2 summed over all pairs */
+                    sl, sd,         /* running sums of earlier and later */
+                    within, across, /* r^2 summed within and across the parts */
+                    omega;          /* omega at a split */
+    struct ld_job   jobs[LD_MAXTHREADS];
+    pthread_t       threads[LD_MAXTHREADS];
+    int             started[LD_MAXTHREADS];
+
+    memset(out, 0, sizeof(*out));
+    nwords = PACKED_WORDS(nsam);
+
+    /* keep only the sites that segregate */
+    seg = 0;
+    for (j=0; j<nsites; j++) {
+        if (site_freqs[j] <= 0 || site_freqs[j] >= nsam)
+            continue;
+        memmove(s->cols + (size_t)seg*nwords, cols + (size_t)j*nwords, nwords*sizeof(uint64_t));
+        s->p[seg] = (double)site_freqs[j]/nsam;
+        s->rh[seg] = 1.0/(s->p[seg]*(1.0 - s->p[seg]));
+        seg++;
+    }
+    out->nsites = seg;
+    if (seg < 2)
+        return;
+
+    if (window <= 0 || window > seg - 1)
+        window = seg - 1;
+    pairs = window_pairs(seg, window);
+    if (max_pairs > 0 && pairs > max_pairs) {
+        window = max_pairs / seg > 0 ? (int)(max_pairs / seg) : 1;
+        pairs = window_pairs(seg, window);
+    }
+    out->window = window;
+    out->pairs = pairs;
+
+    if (nthreads > s->maxthreads)
+        nthreads = s->maxthreads;
+    if (nthreads < 1 || seg <= LD_BLOCK)
+        nthreads = 1;
+
+    for (t=0; t<nthreads; t++) {
+        jobs[t].s = s;
+        jobs[t].nsites = seg;
+        jobs[t].nwords = nwords;
+        jobs[t].window = window;
+        jobs[t].nthreads = nthreads;
+        jobs[t].id = t;
+        jobs[t].inv_n = 1.0/nsam;
+        jobs[t].k = ss_kernels();
+    }
+    for (t=1; t<nthreads; t++)
+        started[t] = pthread_create(&threads[t], NULL, ld_tiles, &jobs[t]) == 0;
+    ld_tiles(&jobs[0]);
+    for (t=1; t<nthreads; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+        else
+            ld_tiles(&jobs[t]);
+    }
+
+    earlier = s->sums;
+    later = earlier + s->maxsites;
+    for (t=1; t<nthreads; t++) {
+        sums = s->sums + (size_t)2*s->maxsites*t;
+        for (i=0; i<seg; i++) {
+            ld_sum_merge(earlier + i, sums + i);
+            ld_sum_merge(later + i, sums + s->maxsites + i);
+        }
+    }
+
+    total = 0.0;
+    for (i=0; i<seg; i++)
+        total += ld_sum_value(later + i);
+    out->zns = total/pairs;
+
+    /* omega for a split after the first i sites is the mean r^2 of the
+     * pairs on the same side over the mean r^2 of the pairs across. Pairs
+     * whose later site is left of the split are left of it; those whose
+     * earlier site is right of it are right of it; the rest cross it */
+    sl = sd = 0.0;
+    pl = pd = 0;
+    for (i=1; i<seg; i++) {
+        sl += ld_sum_value(earlier + i - 1);
+        sd += ld_sum_value(later + i - 1);
+        nl = i - 1 < window ? i - 1 : window;
+        nd = seg - i < window ? seg - i : window;
+        pl += nl;
+        pd += nd;
+        if (i < 2 || i > seg - 2 || pd == pl)
+            continue;
+        within = sl + (total - sd);
+        across = sd - sl;
+        /* across comes from a difference of running sums, so it is only
+         * good to about 1e-16*total; treat it as nothing when it is that
+         * close to nothing */
+        if (across <= 1e-9*total)
+            continue;
+        omega = (within/(pl + pairs - pd))/(across/(pd - pl));
+        if (omega > out->omega) {
+            out->omega = omega;
+            out->omega_at = i;
+        }
+    }
+}
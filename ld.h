@@ -0,0 +1,66 @@
+#ifndef LD_H
+#define LD_H
+
+#include <stdint.h>
+
+/* Pairwise linkage disequilibrium on bit-packed site columns.
+ *
+ * Each segregating site is a column of PACKED_WORDS(nsam) words, one bit
+ * per sample, so the number of samples carrying the derived allele at both
+ * sites of a pair is an AND and a popcount. Sites are taken LD_BLOCK at a
+ * time, so that a pair of blocks of columns stays in the L1 cache while all
+ * the pairs between them are worked through, and the tiles of block pairs
+ * are shared out between threads. Only per site sums of r^2 are kept, which
+ * is all that Kelly's ZnS and Kim & Nielsen's omega need, so the memory
+ * used is O(nsites) however many pairs there are. */
+
+/* sites per block */
+#define LD_BLOCK        128
+
+/* most threads one call will use */
+#define LD_MAXTHREADS   64
+
+/* A sum of r^2 in fixed point: whole + frac/2^62. Each tile adds up its
+ * r^2 in doubles and adds them to the sums once, and fixed point addition
+ * does not depend on the order, so the sums come out the same to the bit
+ * however the tiles are shared between threads. */
+struct ld_sum {
+    int64_t     whole,
+                frac;               /* 0 .. 2^62-1 */
+};
+
+/* Scratch space, grown by ld_reserve() and kept between calls */
+struct ld_scratch {
+    int         maxsites,           /* sites there is room for */
+                maxwords,           /* column words per site there is room for */
+                maxthreads;         /* threads there is room for */
+    uint64_t    *cols;              /* segregating columns, compacted */
+    double      *p,                 /* derived allele frequency per site */
+                *rh;                /* 1/(p*(1-p)) per site */
+    struct ld_sum
+                *sums;              /* per thread: r^2 summed over the earlier
+                                     *   and the later partner of each site */
+    int         *counts;            /* per thread: one row of a tile */
+};
+
+struct ld_summary {
+    double      zns,                /* Kelly's ZnS: mean r^2 over the pairs used */
+                omega;              /* Kim & Nielsen's omega, maximised over the
+                                     *   split points (0 if there are none) */
+    int         omega_at,           /* sites left of the best split */
+                nsites,             /* segregating sites used */
+                window;             /* largest distance (in segregating sites)
+                                     *   between the two sites of a pair */
+    long        pairs;              /* pairs used */
+};
+
+int ld_reserve(struct ld_scratch *s, int nsam, int nsites, int nthreads);
+void ld_scratch_free(struct ld_scratch *s);
+void ld_columns_rows(int nsam, int nsites, char **rows, uint64_t *cols);
+double ld_r2_row(int n, const int *counts, double inv_n, double pi, double rhi,
+                 const double *p, const double *rh, double *earlier);
+void ld_summarise(int nsam, int nsites, const uint64_t *cols, const int *site_freqs,
+                  int window, long max_pairs, int nthreads, struct ld_scratch *s,
+                  struct ld_summary *out);
+
+#endif /* LD_H */
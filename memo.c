@@ -0,0 +1,365 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "memo.h"
+
+/* A cache of the statistics of recent replicates (see memo.h) */
+
+/*  The bytes of each row of a replicate, and which bits of the last one
+ *    hold sites
+ *
+ *      rep         - the replicate
+ *      last        - set to the mask of the last byte
+ *
+ *  Returns the number of bytes
+ */
+static size_t row_bytes(const struct ss_replicate *rep, unsigned char *last)
+{
+    *last = 0xFF;
+    if (rep->encoding != SS_BITS)
+        return (size_t)rep->nsites;
+    if (rep->nsites % 8 != 0)
+        *last = (unsigned char)((1u << (rep->nsites % 8)) - 1);
+    return ((size_t)rep->nsites + 7)/8;
+}
+
+/*  Whether a replicate goes through the cache at all: not if there is no
+ *    cache, nor if its rows come to more than MEMO_MAXBYTES
+ *
+ *      m           - the cache
+ *      rep         - the replicate
+ *
+ *  Returns 1 if it does, 0 if not
+ */
+int memo_keeps(const struct memo *m, const struct ss_replicate *rep)
+{
+    unsigned char   last;           /* mask of the last byte, unused */
+
+    return m->entries > 0 && row_bytes(rep, &last)*rep->nsam <= MEMO_MAXBYTES;
+}
+
+/*  Fold a word into a hash
+ *
+ *      h           - the hash so far
+ *      w           - the word
+ *
+ *  Returns the new hash
+ */
+static uint64_t mix(uint64_t h, uint64_t w)
+{
+    h ^= w;
+    h *= 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 29);
+}
+
+/*  Hash a replicate and the statistics asked of it
+ *
+ *      rep         - the replicate
+ *      mask        - the statistics
+ *
+ *  Returns the hash, never 0
+ */
+uint64_t memo_hash(const struct ss_replicate *rep, unsigned mask)
+{
+    int             i;              /* iterator */
+    size_t          j,              /* byte of the row */
+                    len;            /* bytes per row */
+    unsigned char   last,           /* mask of the last byte */
+                    tail[8];        /* the last 1 .. 8 bytes of a row */
+    const unsigned char *p;         /* the current row */
+    uint64_t        h,              /* the hash */
+                    w;              /* 8 bytes of a row */
+
+    len = row_bytes(rep, &last);
+    h = mix(mix(0x243F6A8885A308D3ULL, (uint64_t)rep->nsam << 32 | (uint32_t)rep->nsites),
+            (uint64_t)mask << 8 | (uint64_t)rep->alphabet << 4 | (uint64_t)rep->encoding);
+    for (i=0; i<rep->nsam && len > 0; i++) {
+        p = rep->data + (size_t)i*rep->stride;
+        for (j=0; j + 8 < len; j+=8) {
+            memcpy(&w, p + j, 8);
+            h = mix(h, w);
+        }
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail, p + j, len - j);
+        tail[len - j - 1] &= last;
+        memcpy(&w, tail, 8);
+        h = mix(h, w);
+    }
+    return h != 0 ? h : 1;
+}
+
+/*  Make room for a number of entries, emptying the cache
+ *
+ *      m           - the cache (zeroed before first use)
+ *      entries     - the number of replicates, and of Fs values, to keep;
+ *                    0 to keep none
+ *
+ *  Returns 0, or -1 if out of memory (in which case there are none)
+ */
+int memo_reserve(struct memo *m, int entries)
+{
+    memo_free(m);
+    if (entries <= 0)
+        return 0;
+    m->rep = (struct memo_entry *)calloc((size_t)entries, sizeof(struct memo_entry));
+    m->fs = (struct memo_fs *)calloc((size_t)entries, sizeof(struct memo_fs));
+    if (m->rep == NULL || m->fs == NULL) {
+        memo_free(m);
+        return -1;
+    }
+    m->entries = entries;
+    return 0;
+}
+
+/*  Free what the cache holds
+ *
+ *      m           - the cache
+ *
+ *  Returns nothing
+ */
+void memo_free(struct memo *m)
+{
+    int     i;                      /* iterator */
+
+    for (i=0; i<m->entries; i++) {
+        free(m->rep[i].rows);
+        free(m->rep[i].sfs);
+        free(m->rep[i].hfs);
+        free(m->rep[i].mismatch);
+    }
+    free(m->rep);
+    free(m->fs);
+    memset(m, 0, sizeof(*m));
+}
+
+/*  Forget every entry, keeping the room for them (for when the results
+ *    would change, as with new LD limits)
+ *
+ *      m           - the cache
+ *
+ *  Returns nothing
+ */
+void memo_clear(struct memo *m)
+{
+    int     i;                      /* iterator */
+
+    for (i=0; i<m->entries; i++) {
+        m->rep[i].hash = 0;
+        m->fs[i].nsam = 0;
+    }
+}
+
+/*  Check that an entry holds a replicate's rows
+ *
+ *      e           - the entry
+ *      rep         - the replicate
+ *
+ *  Returns 1 if it does, 0 if not
+ */
+static int same_rows(const struct memo_entry *e, const struct ss_replicate *rep)
+{
+    int             i;              /* iterator */
+    size_t          len;            /* bytes per row */
+    unsigned char   last;           /* mask of the last byte */
+    const unsigned char *p, *q;     /* the rows compared */
+
+    len = row_bytes(rep, &last);
+    if (len != e->rowlen)
+        return 0;
+    for (i=0; i<rep->nsam && len > 0; i++) {
+        p = rep->data + (size_t)i*rep->stride;
+        q = e->rows + (size_t)i*len;
+        if (memcmp(p, q, len - 1) != 0 || (p[len - 1] & last) != q[len - 1])
+            return 0;
+    }
+    return 1;
+}
+
+/*  Look a replicate up, and hand back its statistics if it is there
+ *
+ *      m           - the cache
+ *      rep         - the replicate
+ *      mask        - the statistics asked for
+ *      hash        - memo_hash(rep, mask)
+ *      out         - where to put the statistics; out->sfs, out->hfs and
+ *                    out->mismatch are kept and the arrays copied to them
+ *
+ *  Returns 1 if it was found, 0 if not
+ */
+int memo_fetch(struct memo *m, const struct ss_replicate *rep, unsigned mask, uint64_t hash,
+               struct ss_results *out)
+{
+    int             i;              /* iterator */
+    struct memo_entry *e;           /* the current entry */
+    int             *sfs, *hfs;     /* the caller's arrays */
+    long            *mismatch;
+
+    m->clock++;
+    for (i=0; i<m->entries; i++) {
+        e = m->rep + i;
+        if (e->hash != hash || e->mask != mask || e->nsam != rep->nsam
+            || e->nsites != rep->nsites || e->alphabet != rep->alphabet
+            || e->encoding != rep->encoding || !same_rows(e, rep))
+            continue;
+
+        sfs = out->sfs;
+        hfs = out->hfs;
+        mismatch = out->mismatch;
+        *out = e->res;
+        out->sfs = sfs;
+        out->hfs = hfs;
+        out->mismatch = mismatch;
+        if (mask & SS_SFS)
+            memcpy(sfs, e->sfs, e->res.sfs_len*sizeof(int));
+        if (mask & SS_HFS)
+            memcpy(hfs, e->hfs, e->res.hfs_len*sizeof(int));
+        if (mask & SS_MISMATCH)
+            memcpy(mismatch, e->mismatch, e->res.mismatch_len*sizeof(long));
+        e->last = m->clock;
+        m->hits++;
+        return 1;
+    }
+    m->misses++;
+    return 0;
+}
+
+/*  Grow a buffer
+ *
+ *      p           - the buffer
+ *      size        - bytes needed
+ *
+ *  Returns 0, or -1 if out of memory
+ */
+static int grow(void **p, size_t size)
+{
+    void    *q;                     /* the new buffer */
+
+    if (!(q = realloc(*p, size + 1)))
+        return -1;
+    *p = q;
+    return 0;
+}
+
+/*  Keep a replicate's statistics, in place of the entry least recently
+ *    used; replicates of more than MEMO_MAXBYTES are not kept, nor are
+ *    any if memory runs out
+ *
+ *      m           - the cache
+ *      rep         - the replicate
+ *      mask        - the statistics asked for
+ *      hash        - memo_hash(rep, mask)
+ *      res         - the statistics
+ *
+ *  Returns nothing
+ */
+void memo_store(struct memo *m, const struct ss_replicate *rep, unsigned mask, uint64_t hash,
+                const struct ss_results *res)
+{
+    int             i;              /* iterator */
+    size_t          len;            /* bytes per row */
+    unsigned char   last;           /* mask of the last byte */
+    struct memo_entry *e;           /* the entry used */
+
+    if (!memo_keeps(m, rep))
+        return;
+    len = row_bytes(rep, &last);
+    e = m->rep;
+    for (i=1; i<m->entries && e->hash != 0; i++)
+        if (m->rep[i].hash == 0 || m->rep[i].last < e->last)
+            e = m->rep + i;
+    e->hash = 0;
+
+    if (len*rep->nsam > e->size) {
+        if (grow((void **)&e->rows, len*rep->nsam) != 0)
+            return;
+        e->size = len*rep->nsam;
+    }
+    if ((mask & (SS_SFS | SS_HFS)) && rep->nsam > e->arrays_sam) {
+        if (grow((void **)&e->sfs, rep->nsam*sizeof(int)) != 0
+            || grow((void **)&e->hfs, rep->nsam*sizeof(int)) != 0)
+            return;
+        e->arrays_sam = rep->nsam;
+    }
+    if ((mask & SS_MISMATCH) && res->mismatch_len > e->mismatch_room) {
+        if (grow((void **)&e->mismatch, res->mismatch_len*sizeof(long)) != 0)
+            return;
+        e->mismatch_room = res->mismatch_len;
+    }
+
+    for (i=0; i<rep->nsam && len > 0; i++) {
+        memcpy(e->rows + (size_t)i*len, rep->data + (size_t)i*rep->stride, len);
+        e->rows[(size_t)i*len + len - 1] &= last;
+    }
+    e->res = *res;
+    if (mask & SS_SFS)
+        memcpy(e->sfs, res->sfs, res->sfs_len*sizeof(int));
+    if (mask & SS_HFS)
+        memcpy(e->hfs, res->hfs, res->hfs_len*sizeof(int));
+    if (mask & SS_MISMATCH)
+        memcpy(e->mismatch, res->mismatch, res->mismatch_len*sizeof(long));
+    e->res.sfs = e->sfs;
+    e->res.hfs = e->hfs;
+    e->res.mismatch = e->mismatch;
+    e->mask = mask;
+    e->nsam = rep->nsam;
+    e->nsites = rep->nsites;
+    e->alphabet = rep->alphabet;
+    e->encoding = rep->encoding;
+    e->rowlen = len;
+    e->last = m->clock;
+    e->hash = hash;
+}
+
+/*  Look up Fu's Fs
+ *
+ *      m           - the cache
+ *      nsam        - number of samples
+ *      pi          - nucleotide diversity
+ *      nh          - number of haplotypes
+ *      fs          - where to put Fs if it is there
+ *
+ *  Returns 1 if it was found, 0 if not
+ */
+int memo_fetch_fs(struct memo *m, int nsam, double pi, int nh, double *fs)
+{
+    int     i;                      /* iterator */
+
+    m->clock++;
+    for (i=0; i<m->entries; i++) {
+        if (m->fs[i].nsam == nsam && m->fs[i].nh == nh && m->fs[i].pi == pi) {
+            *fs = m->fs[i].fs;
+            m->fs[i].last = m->clock;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*  Keep Fu's Fs, in place of the value least recently used
+ *
+ *      m           - the cache
+ *      nsam        - number of samples
+ *      pi          - nucleotide diversity
+ *      nh          - number of haplotypes
+ *      fs          - Fs
+ *
+ *  Returns nothing
+ */
+void memo_store_fs(struct memo *m, int nsam, double pi, int nh, double fs)
+{
+    int     i;                      /* iterator */
+    struct memo_fs *e;              /* the entry used */
+
+    if (m->entries == 0)
+        return;
+    e = m->fs;
+    for (i=1; i<m->entries && e->nsam != 0; i++)
+        if (m->fs[i].nsam == 0 || m->fs[i].last < e->last)
+            e = m->fs + i;
+    e->nsam = nsam;
+    e->nh = nh;
+    e->pi = pi;
+    e->fs = fs;
+    e->last = m->clock;
+}
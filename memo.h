@@ -0,0 +1,79 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <stdint.h>
+
+#include "samplestats.h"
+
+/* A small cache of the statistics of recent replicates.
+ *
+ * With a small theta many replicates are the same: no segregating sites at
+ * all, or one of a handful of configurations. Each replicate is hashed as
+ * it is given (its rows, with its shape, encoding and the statistics asked
+ * for), and a hit hands back a copy of the results the same replicate had
+ * before. The rows are kept and compared on a hit, so a hash collision can
+ * only cost time. Replicates of more than MEMO_MAXBYTES are left out, not
+ * hashed, looked up or counted as misses: they seldom repeat.
+ *
+ * Fu's Fs, with its nsam x nsam table, depends only on nsam, pi and the
+ * number of haplotypes, which distinct replicates share far more often, so
+ * it has an entry of its own under that key.
+ *
+ * Both are least recently used caches of a few entries, searched in
+ * order. */
+
+/* most bytes of rows a cached replicate may have */
+#define MEMO_MAXBYTES   65536
+
+/* the results of one replicate */
+struct memo_entry {
+    uint64_t    hash;               /* of the replicate and mask, 0 if empty */
+    unsigned    mask;               /* the statistics asked for */
+    int         nsam,
+                nsites,
+                alphabet,
+                encoding;
+    size_t      rowlen,             /* bytes per row */
+                size;               /* bytes rows has room for */
+    unsigned char *rows;            /* the rows, nsam*rowlen */
+    struct ss_results res;          /* the statistics; res.sfs, res.hfs and
+                                     *   res.mismatch point at the copies below */
+    int         *sfs,               /* copies of the arrays, with room for */
+                *hfs,               /*   nsam ints each */
+                arrays_sam;         /*   this many samples */
+    long        *mismatch;          /* and for mismatch_room longs */
+    int         mismatch_room;
+    unsigned long last;             /* when it was last used */
+};
+
+/* Fu's Fs for one sample size, pi and number of haplotypes */
+struct memo_fs {
+    int         nsam,               /* 0 if empty */
+                nh;
+    double      pi,
+                fs;
+    unsigned long last;
+};
+
+struct memo {
+    int         entries;            /* number of entries, 0 for no cache */
+    struct memo_entry *rep;         /* the replicates */
+    struct memo_fs *fs;             /* the Fs values */
+    unsigned long clock;            /* counts the lookups, for last */
+    long        hits,               /* replicates found */
+                misses;             /* and not found */
+};
+
+int memo_reserve(struct memo *m, int entries);
+void memo_free(struct memo *m);
+void memo_clear(struct memo *m);
+int memo_keeps(const struct memo *m, const struct ss_replicate *rep);
+uint64_t memo_hash(const struct ss_replicate *rep, unsigned mask);
+int memo_fetch(struct memo *m, const struct ss_replicate *rep, unsigned mask, uint64_t hash,
+               struct ss_results *out);
+void memo_store(struct memo *m, const struct ss_replicate *rep, unsigned mask, uint64_t hash,
+                const struct ss_results *res);
+int memo_fetch_fs(struct memo *m, int nsam, double pi, int nh, double *fs);
+void memo_store_fs(struct memo *m, int nsam, double pi, int nh, double fs);
+
+#endif /* MEMO_H */
@@ -0,0 +1,315 @@
+#ifndef NSAM_TABLES_H
+#define NSAM_TABLES_H
+
+/* Constants that depend only on the number of samples, for sample sizes up
+ * to NSAM_TABLE_MAX. Each entry is written out as the same running sum that
+ * a1f() and a2f() in tajd.c compute, so the compiler folds them to exactly
+ * the values the loops would give:
+ *
+ *      A1_n    - sum of 1/i     for i = 1 .. n-1  (Watterson's a1)
+ *      A2_n    - sum of 1/(i*i) for i = 1 .. n-1  (Tajima's a2)
+ */
+
+#define NSAM_TABLE_MAX 128
+
+#define A1_0   0.0
+#define A1_1   0.0
+#define A1_2    (A1_1 + 1.0/1)
+#define A1_3    (A1_2 + 1.0/2)
+#define A1_4    (A1_3 + 1.0/3)
+#define A1_5    (A1_4 + 1.0/4)
+#define A1_6    (A1_5 + 1.0/5)
+#define A1_7    (A1_6 + 1.0/6)
+#define A1_8    (A1_7 + 1.0/7)
+#define A1_9    (A1_8 + 1.0/8)
+#define A1_10   (A1_9 + 1.0/9)
+#define A1_11   (A1_10 + 1.0/10)
+#define A1_12   (A1_11 + 1.0/11)
+#define A1_13   (A1_12 + 1.0/12)
+#define A1_14   (A1_13 + 1.0/13)
+#define A1_15   (A1_14 + 1.0/14)
+#define A1_16   (A1_15 + 1.0/15)
+#define A1_17   (A1_16 + 1.0/16)
+#define A1_18   (A1_17 + 1.0/17)
+#define A1_19   (A1_18 + 1.0/18)
+#define A1_20   (A1_19 + 1.0/19)
+#define A1_21   (A1_20 + 1.0/20)
+#define A1_22   (A1_21 + 1.0/21)
+#define A1_23   (A1_22 + 1.0/22)
+#define A1_24   (A1_23 + 1.0/23)
+#define A1_25   (A1_24 + 1.0/24)
+#define A1_26   (A1_25 + 1.0/25)
+#define A1_27   (A1_26 + 1.0/26)
+#define A1_28   (A1_27 + 1.0/27)
+#define A1_29   (A1_28 + 1.0/28)
+#define A1_30   (A1_29 + 1.0/29)
+#define A1_31   (A1_30 + 1.0/30)
+#define A1_32   (A1_31 + 1.0/31)
+#define A1_33   (A1_32 + 1.0/32)
+#define A1_34   (A1_33 + 1.0/33)
+#define A1_35   (A1_34 + 1.0/34)
+#define A1_36   (A1_35 + 1.0/35)
+#define A1_37   (A1_36 + 1.0/36)
+#define A1_38   (A1_37 + 1.0/37)
+#define A1_39   (A1_38 + 1.0/38)
+#define A1_40   (A1_39 + 1.0/39)
+#define A1_41   (A1_40 + 1.0/40)
+#define A1_42   (A1_41 + 1.0/41)
+#define A1_43   (A1_42 + 1.0/42)
+#define A1_44   (A1_43 + 1.0/43)
+#define A1_45   (A1_44 + 1.0/44)
+#define A1_46   (A1_45 + 1.0/45)
+#define A1_47   (A1_46 + 1.0/46)
+#define A1_48   (A1_47 + 1.0/47)
+#define A1_49   (A1_48 + 1.0/48)
+#define A1_50   (A1_49 + 1.0/49)
+#define A1_51   (A1_50 + 1.0/50)
+#define A1_52   (A1_51 + 1.0/51)
+#define A1_53   (A1_52 + 1.0/52)
+#define A1_54   (A1_53 + 1.0/53)
+#define A1_55   (A1_54 + 1.0/54)
+#define A1_56   (A1_55 + 1.0/55)
+#define A1_57   (A1_56 + 1.0/56)
+#define A1_58   (A1_57 + 1.0/57)
+#define A1_59   (A1_58 + 1.0/58)
+#define A1_60   (A1_59 + 1.0/59)
+#define A1_61   (A1_60 + 1.0/60)
+#define A1_62   (A1_61 + 1.0/61)
+#define A1_63   (A1_62 + 1.0/62)
+#define A1_64   (A1_63 + 1.0/63)
+#define A1_65   (A1_64 + 1.0/64)
+#define A1_66   (A1_65 + 1.0/65)
+#define A1_67   (A1_66 + 1.0/66)
+#define A1_68   (A1_67 + 1.0/67)
+#define A1_69   (A1_68 + 1.0/68)
+#define A1_70   (A1_69 + 1.0/69)
+#define A1_71   (A1_70 + 1.0/70)
+#define A1_72   (A1_71 + 1.0/71)
+#define A1_73   (A1_72 + 1.0/72)
+#define A1_74   (A1_73 + 1.0/73)
+#define A1_75   (A1_74 + 1.0/74)
+#define A1_76   (A1_75 + 1.0/75)
+#define A1_77   (A1_76 + 1.0/76)
+#define A1_78   (A1_77 + 1.0/77)
+#define A1_79   (A1_78 + 1.0/78)
+#define A1_80   (A1_79 + 1.0/79)
+#define A1_81   (A1_80 + 1.0/80)
+#define A1_82   (A1_81 + 1.0/81)
+#define A1_83   (A1_82 + 1.0/82)
+#define A1_84   (A1_83 + 1.0/83)
+#define A1_85   (A1_84 + 1.0/84)
+#define A1_86   (A1_85 + 1.0/85)
+#define A1_87   (A1_86 + 1.0/86)
+#define A1_88   (A1_87 + 1.0/87)
+#define A1_89   (A1_88 + 1.0/88)
+#define A1_90   (A1_89 + 1.0/89)
+#define A1_91   (A1_90 + 1.0/90)
+#define A1_92   (A1_91 + 1.0/91)
+#define A1_93   (A1_92 + 1.0/92)
+#define A1_94   (A1_93 + 1.0/93)
+#define A1_95   (A1_94 + 1.0/94)
+#define A1_96   (A1_95 + 1.0/95)
+#define A1_97   (A1_96 + 1.0/96)
+#define A1_98   (A1_97 + 1.0/97)
+#define A1_99   (A1_98 + 1.0/98)
+#define A1_100  (A1_99 + 1.0/99)
+#define A1_101  (A1_100 + 1.0/100)
+#define A1_102  (A1_101 + 1.0/101)
+#define A1_103  (A1_102 + 1.0/102)
+#define A1_104  (A1_103 + 1.0/103)
+#define A1_105  (A1_104 + 1.0/104)
+#define A1_106  (A1_105 + 1.0/105)
+#define A1_107  (A1_106 + 1.0/106)
+#define A1_108  (A1_107 + 1.0/107)
+#define A1_109  (A1_108 + 1.0/108)
+#define A1_110  (A1_109 + 1.0/109)
+#define A1_111  (A1_110 + 1.0/110)
+#define A1_112  (A1_111 + 1.0/111)
+#define A1_113  (A1_112 + 1.0/112)
+#define A1_114  (A1_113 + 1.0/113)
+#define A1_115  (A1_114 + 1.0/114)
+#define A1_116  (A1_115 + 1.0/115)
+#define A1_117  (A1_116 + 1.0/116)
+#define A1_118  (A1_117 + 1.0/117)
+#define A1_119  (A1_118 + 1.0/118)
+#define A1_120  (A1_119 + 1.0/119)
+#define A1_121  (A1_120 + 1.0/120)
+#define A1_122  (A1_121 + 1.0/121)
+#define A1_123  (A1_122 + 1.0/122)
+#define A1_124  (A1_123 + 1.0/123)
+#define A1_125  (A1_124 + 1.0/124)
+#define A1_126  (A1_125 + 1.0/125)
+#define A1_127  (A1_126 + 1.0/126)
+#define A1_128  (A1_127 + 1.0/127)
+
+#define A2_0   0.0
+#define A2_1   0.0
+#define A2_2    (A2_1 + 1.0/(1*1))
+#define A2_3    (A2_2 + 1.0/(2*2))
+#define A2_4    (A2_3 + 1.0/(3*3))
+#define A2_5    (A2_4 + 1.0/(4*4))
+#define A2_6    (A2_5 + 1.0/(5*5))
+#define A2_7    (A2_6 + 1.0/(6*6))
+#define A2_8    (A2_7 + 1.0/(7*7))
+#define A2_9    (A2_8 + 1.0/(8*8))
+#define A2_10   (A2_9 + 1.0/(9*9))
+#define A2_11   (A2_10 + 1.0/(10*10))
+#define A2_12   (A2_11 + 1.0/(11*11))
+#define A2_13   (A2_12 + 1.0/(12*12))
+#define A2_14   (A2_13 + 1.0/(13*13))
+#define A2_15   (A2_14 + 1.0/(14*14))
+#define A2_16   (A2_15 + 1.0/(15*15))
+#define A2_17   (A2_16 + 1.0/(16*16))
+#define A2_18   (A2_17 + 1.0/(17*17))
+#define A2_19   (A2_18 + 1.0/(18*18))
+#define A2_20   (A2_19 + 1.0/(19*19))
+#define A2_21   (A2_20 + 1.0/(20*20))
+#define A2_22   (A2_21 + 1.0/(21*21))
+#define A2_23   (A2_22 + 1.0/(22*22))
+#define A2_24   (A2_23 + 1.0/(23*23))
+#define A2_25   (A2_24 + 1.0/(24*24))
+#define A2_26   (A2_25 + 1.0/(25*25))
+#define A2_27   (A2_26 + 1.0/(26*26))
+#define A2_28   (A2_27 + 1.0/(27*27))
+#define A2_29   (A2_28 + 1.0/(28*28))
+#define A2_30   (A2_29 + 1.0/(29*29))
+#define A2_31   (A2_30 + 1.0/(30*30))
+#define A2_32   (A2_31 + 1.0/(31*31))
+#define A2_33   (A2_32 + 1.0/(32*32))
+#define A2_34   (A2_33 + 1.0/(33*33))
+#define A2_35   (A2_34 + 1.0/(34*34))
+#define A2_36   (A2_35 + 1.0/(35*35))
+#define A2_37   (A2_36 + 1.0/(36*36))
+#define A2_38   (A2_37 + 1.0/(37*37))
+#define A2_39   (A2_38 + 1.0/(38*38))
+#define A2_40   (A2_39 + 1.0/(39*39))
+#define A2_41   (A2_40 + 1.0/(40*40))
+#define A2_42   (A2_41 + 1.0/(41*41))
+#define A2_43   (A2_42 + 1.0/(42*42))
+#define A2_44   (A2_43 + 1.0/(43*43))
+#define A2_45   (A2_44 + 1.0/(44*44))
+#define A2_46   (A2_45 + 1.0/(45*45))
+#define A2_47   (A2_46 + 1.0/(46*46))
+#define A2_48   (A2_47 + 1.0/(47*47))
+#define A2_49   (A2_48 + 1.0/(48*48))
+#define A2_50   (A2_49 + 1.0/(49*49))
+#define A2_51   (A2_50 + 1.0/(50*50))
+#define A2_52   (A2_51 + 1.0/(51*51))
+#define A2_53   (A2_52 + 1.0/(52*52))
+#define A2_54   (A2_53 + 1.0/(53*53))
+#define A2_55   (A2_54 + 1.0/(54*54))
+#define A2_56   (A2_55 + 1.0/(55*55))
+#define A2_57   (A2_56 + 1.0/(56*56))
+#define A2_58   (A2_57 + 1.0/(57*57))
+#define A2_59   (A2_58 + 1.0/(58*58))
+#define A2_60   (A2_59 + 1.0/(59*59))
+#define A2_61   (A2_60 + 1.0/(60*60))
+#define A2_62   (A2_61 + 1.0/(61*61))
+#define A2_63   (A2_62 + 1.0/(62*62))
+#define A2_64   (A2_63 + 1.0/(63*63))
+#define A2_65   (A2_64 + 1.0/(64*64))
+#define A2_66   (A2_65 + 1.0/(65*65))
+#define A2_67   (A2_66 + 1.0/(66*66))
+#define A2_68   (A2_67 + 1.0/(67*67))
+#define A2_69   (A2_68 + 1.0/(68*68))
+#define A2_70   (A2_69 + 1.0/(69*69))
+#define A2_71   (A2_70 + 1.0/(70*70))
+#define A2_72   (A2_71 + 1.0/(71*71))
+#define A2_73   (A2_72 + 1.0/(72*72))
+#define A2_74   (A2_73 + 1.0/(73*73))
+#define A2_75   (A2_74 + 1.0/(74*74))
+#define A2_76   (A2_75 + 1.0/(75*75))
+#define A2_77   (A2_76 + 1.0/(76*76))
+#define A2_78   (A2_77 + 1.0/(77*77))
+#define A2_79   (A2_78 + 1.0/(78*78))
+#define A2_80   (A2_79 + 1.0/(79*79))
+#define A2_81   (A2_80 + 1.0/(80*80))
+#define A2_82   (A2_81 + 1.0/(81*81))
+#define A2_83   (A2_82 + 1.0/(82*82))
+#define A2_84   (A2_83 + 1.0/(83*83))
+#define A2_85   (A2_84 + 1.0/(84*84))
+#define A2_86   (A2_85 + 1.0/(85*85))
+#define A2_87   (A2_86 + 1.0/(86*86))
+#define A2_88   (A2_87 + 1.0/(87*87))
+#define A2_89   (A2_88 + 1.0/(88*88))
+#define A2_90   (A2_89 + 1.0/(89*89))
+#define A2_91   (A2_90 + 1.0/(90*90))
+#define A2_92   (A2_91 + 1.0/(91*91))
+#define A2_93   (A2_92 + 1.0/(92*92))
+#define A2_94   (A2_93 + 1.0/(93*93))
+#define A2_95   (A2_94 + 1.0/(94*94))
+#define A2_96   (A2_95 + 1.0/(95*95))
+#define A2_97   (A2_96 + 1.0/(96*96))
+#define A2_98   (A2_97 + 1.0/(97*97))
+#define A2_99   (A2_98 + 1.0/(98*98))
+#define A2_100  (A2_99 + 1.0/(99*99))
+#define A2_101  (A2_100 + 1.0/(100*100))
+#define A2_102  (A2_101 + 1.0/(101*101))
+#define A2_103  (A2_102 + 1.0/(102*102))
+#define A2_104  (A2_103 + 1.0/(103*103))
+#define A2_105  (A2_104 + 1.0/(104*104))
+#define A2_106  (A2_105 + 1.0/(105*105))
+#define A2_107  (A2_106 + 1.0/(106*106))
+#define A2_108  (A2_107 + 1.0/(107*107))
+#define A2_109  (A2_108 + 1.0/(108*108))
+#define A2_110  (A2_109 + 1.0/(109*109))
+#define A2_111  (A2_110 + 1.0/(110*110))
+#define A2_112  (A2_111 + 1.0/(111*111))
+#define A2_113  (A2_112 + 1.0/(112*112))
+#define A2_114  (A2_113 + 1.0/(113*113))
+#define A2_115  (A2_114 + 1.0/(114*114))
+#define A2_116  (A2_115 + 1.0/(115*115))
+#define A2_117  (A2_116 + 1.0/(116*116))
+#define A2_118  (A2_117 + 1.0/(117*117))
+#define A2_119  (A2_118 + 1.0/(118*118))
+#define A2_120  (A2_119 + 1.0/(119*119))
+#define A2_121  (A2_120 + 1.0/(120*120))
+#define A2_122  (A2_121 + 1.0/(121*121))
+#define A2_123  (A2_122 + 1.0/(122*122))
+#define A2_124  (A2_123 + 1.0/(123*123))
+#define A2_125  (A2_124 + 1.0/(124*124))
+#define A2_126  (A2_125 + 1.0/(125*125))
+#define A2_127  (A2_126 + 1.0/(126*126))
+#define A2_128  (A2_127 + 1.0/(127*127))
+
+#define A1_TABLE { \
+    A1_0, A1_1, A1_2, A1_3, A1_4, A1_5, A1_6, A1_7, \
+    A1_8, A1_9, A1_10, A1_11, A1_12, A1_13, A1_14, A1_15, \
+    A1_16, A1_17, A1_18, A1_19, A1_20, A1_21, A1_22, A1_23, \
+    A1_24, A1_25, A1_26, A1_27, A1_28, A1_29, A1_30, A1_31, \
+    A1_32, A1_33, A1_34, A1_35, A1_36, A1_37, A1_38, A1_39, \
+    A1_40, A1_41, A1_42, A1_43, A1_44, A1_45, A1_46, A1_47, \
+    A1_48, A1_49, A1_50, A1_51, A1_52, A1_53, A1_54, A1_55, \
+    A1_56, A1_57, A1_58, A1_59, A1_60, A1_61, A1_62, A1_63, \
+    A1_64, A1_65, A1_66, A1_67, A1_68, A1_69, A1_70, A1_71, \
+    A1_72, A1_73, A1_74, A1_75, A1_76, A1_77, A1_78, A1_79, \
+    A1_80, A1_81, A1_82, A1_83, A1_84, A1_85, A1_86, A1_87, \
+    A1_88, A1_89, A1_90, A1_91, A1_92, A1_93, A1_94, A1_95, \
+    A1_96, A1_97, A1_98, A1_99, A1_100, A1_101, A1_102, A1_103, \
+    A1_104, A1_105, A1_106, A1_107, A1_108, A1_109, A1_110, A1_111, \
+    A1_112, A1_113, A1_114, A1_115, A1_116, A1_117, A1_118, A1_119, \
+    A1_120, A1_121, A1_122, A1_123, A1_124, A1_125, A1_126, A1_127, \
+    A1_128 \
+}
+
+#define A2_TABLE { \
+    A2_0, A2_1, A2_2, A2_3, A2_4, A2_5, A2_6, A2_7, \
+    A2_8, A2_9, A2_10, A2_11, A2_12, A2_13, A2_14, A2_15, \
+    A2_16, A2_17, A2_18, A2_19, A2_20, A2_21, A2_22, A2_23, \
+    A2_24, A2_25, A2_26, A2_27, A2_28, A2_29, A2_30, A2_31, \
+    A2_32, A2_33, A2_34, A2_35, A2_36, A2_37, A2_38, A2_39, \
+    A2_40, A2_41, A2_42, A2_43, A2_44, A2_45, A2_46, A2_47, \
+    A2_48, A2_49, A2_50, A2_51, A2_52, A2_53, A2_54, A2_55, \
+    A2_56, A2_57, A2_58, A2_59, A2_60, A2_61, A2_62, A2_63, \
+    A2_64, A2_65, A2_66, A2_67, A2_68, A2_69, A2_70, A2_71, \
+    A2_72, A2_73, A2_74, A2_75, A2_76, A2_77, A2_78, A2_79, \
+    A2_80, A2_81, A2_82, A2_83, A2_84, A2_85, A2_86, A2_87, \
+    A2_88, A2_89, A2_90, A2_91, A2_92, A2_93, A2_94, A2_95, \
+    A2_96, A2_97, A2_98, A2_99, A2_100, A2_101, A2_102, A2_103, \
+    A2_104, A2_105, A2_106, A2_107, A2_108, A2_109, A2_110, A2_111, \
+    A2_112, A2_113, A2_114, A2_115, A2_116, A2_117, A2_118, A2_119, \
+    A2_120, A2_121, A2_122, A2_123, A2_124, A2_125, A2_126, A2_127, \
+    A2_128 \
+}
+
+#endif /* NSAM_TABLES_H */
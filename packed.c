@@ -0,0 +1,447 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "packed.h"
+
+/* Bit-packed kernels for small binary replicates (see packed.h) */
+
+#define LOW_BITS    0x0101010101010101ULL   /* bit 0 of every byte */
+#define GATHER      0x0102040810204080ULL   /* moves bit 0 of byte k to bit 56+k */
+
+#if defined(__GNUC__)
+#define popcount64(x)   __builtin_popcountll(x)
+#define ctz64(x)        __builtin_ctzll(x)
+#else
+static int popcount64(uint64_t x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * LOW_BITS) >> 56);
+}
+
+static int ctz64(uint64_t x)
+{
+    int     n;
+
+    for (n=0; !(x & 1); n++)
+        x >>= 1;
+    return n;
+}
+#endif
+
+/*  Load 8 bytes so that the first one ends up in the low byte
+ *
+ *      p           - the bytes
+ *
+ *  Returns a 64 bit word
+ */
+static uint64_t load8(const unsigned char *p)
+{
+    uint64_t    x;
+
+    memcpy(&x, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    x = __builtin_bswap64(x);
+#endif
+    return x;
+}
+
+/*  Pack rows of '0'/'1' characters into words. Only the low bit of
+ *    each character is looked at, which is what separates '0' and '1'.
+ *
+ *      nsam        - number of rows
+ *      nsites      - number of sites per row
+ *      data        - first row
+ *      stride      - bytes from one row to the next
+ *      rowbits     - where to put the packed rows (nsam * PACKED_WORDS(nsites))
+ *
+ *  Returns nothing
+ */
+void pack_rows_ascii(int nsam, int nsites, const unsigned char *data, size_t stride,
+                     uint64_t *rowbits)
+{
+    int                 i, j, k;    /* iterators */
+    int                 nwords;     /* words per packed row */
+    const unsigned char *src;       /* current row */
+    uint64_t            word;       /* word being filled */
+
+    nwords = PACKED_WORDS(nsites);
+    for (i=0; i<nsam; i++) {
+        src = data + (size_t)i*stride;
+        for (k=0; k<nwords; k++) {
+            word = 0;
+            /* 8 sites at a time: gather the low bit of each byte */
+            for (j=64*k; j<64*k + 64 && j + 8 <= nsites; j+=8)
+                word |= (((load8(src + j) & LOW_BITS) * GATHER) >> 56) << (j & 63);
+            for (; j<64*k + 64 && j<nsites; j++)
+                word |= (uint64_t)(src[j] & 1) << (j & 63);
+            rowbits[(size_t)i*nwords + k] = word;
+        }
+    }
+}
+
+/*  Pack rows of 0/1 bytes into words. Any non-zero byte counts as a 1.
+ *
+ *      nsam        - number of rows
+ *      nsites      - number of sites per row
+ *      data        - first row
+ *      stride      - bytes from one row to the next
+ *      rowbits     - where to put the packed rows (nsam * PACKED_WORDS(nsites))
+ *
+ *  Returns nothing
+ */
+void pack_rows_bytes(int nsam, int nsites, const unsigned char *data, size_t stride,
+                     uint64_t *rowbits)
+{
+    int                 i, j, k;    /* iterators */
+    int                 nwords;     /* words per packed row */
+    const unsigned char *src;       /* current row */
+    uint64_t            word,       /* word being filled */
+                        x;          /* 8 sites */
+
+    nwords = PACKED_WORDS(nsites);
+    for (i=0; i<nsam; i++) {
+        src = data + (size_t)i*stride;
+        for (k=0; k<nwords; k++) {
+            word = 0;
+            for (j=64*k; j<64*k + 64 && j + 8 <= nsites; j+=8) {
+                /* fold each byte onto its low bit */
+                x = load8(src + j);
+                x |= x >> 4;
+                x |= x >> 2;
+                x |= x >> 1;
+                word |= (((x & LOW_BITS) * GATHER) >> 56) << (j & 63);
+            }
+            for (; j<64*k + 64 && j<nsites; j++)
+                word |= (uint64_t)(src[j] != 0) << (j & 63);
+            rowbits[(size_t)i*nwords + k] = word;
+        }
+    }
+}
+
+/*  Pack rows that are already one bit per site (SS_BITS) into words
+ *
+ *      nsam        - number of rows
+ *      nsites      - number of sites per row
+ *      data        - first row
+ *      stride      - bytes from one row to the next
+ *      rowbits     - where to put the packed rows (nsam * PACKED_WORDS(nsites))
+ *
+ *  Returns nothing
+ */
+void pack_rows_bits(int nsam, int nsites, const unsigned char *data, size_t stride,
+                    uint64_t *rowbits)
+{
+    int                 i, k, b;    /* iterators */
+    int                 nwords,     /* words per packed row */
+                        nbytes;     /* bytes per row holding sites */
+    const unsigned char *src;       /* current row */
+    uint64_t            word;       /* word being filled */
+
+    nwords = PACKED_WORDS(nsites);
+    nbytes = (nsites + 7) / 8;
+    for (i=0; i<nsam; i++) {
+        src = data + (size_t)i*stride;
+        for (k=0; k<nwords; k++) {
+            if (8*k + 8 <= nbytes) {
+                word = load8(src + 8*k);
+            } else {
+                word = 0;
+                for (b=8*k; b<nbytes; b++)
+                    word |= (uint64_t)src[b] << (8*(b - 8*k));
+            }
+            /* clear anything past the last site */
+            if (64*k + 64 > nsites)
+                word &= ((uint64_t)1 << (nsites - 64*k)) - 1;
+            rowbits[(size_t)i*nwords + k] = word;
+        }
+    }
+}
+
+/*  Transpose a 64 x 64 bit matrix in place: bit c of a[r] is swapped
+ *    with bit r of a[c]. Works by swapping ever smaller off-diagonal
+ *    blocks (32 x 32, then 16 x 16, ...).
+ *
+ *      a           - the matrix, one row per word
+ *
+ *  Returns nothing
+ */
+static void transpose64(uint64_t *a)
+{
+    int         j, k;               /* block size, row */
+    uint64_t    m,                  /* low j bits of each 2j bit group */
+                t;                  /* bits to swap */
+
+    for (j=32, m=0x00000000FFFFFFFFULL; j; j>>=1, m^=m<<j) {
+        for (k=0; k<64; k=((k | j) + 1) & ~j) {
+            t = ((a[k] >> j) ^ a[k | j]) & m;
+            a[k | j] ^= t;
+            a[k] ^= t << j;
+        }
+    }
+}
+
+/* Kernels specialised on the number of column words per site, W. Columns
+ * are stored site by site, W words each, bit r of word g being sample
+ * 64*g + r. */
+#define PACKED_KERNELS(W)                                                   \
+                                                                            \
+static void columns_##W(int nsam, int nsites, const uint64_t *rowbits,      \
+                        uint64_t *cols)                                     \
+{                                                                           \
+    uint64_t    a[64];          /* one 64 x 64 block */                     \
+    int         nwords,         /* words per packed row */                  \
+                g, k, r, c;     /* iterators */                             \
+                                                                            \
+    nwords = PACKED_WORDS(nsites);                                          \
+    for (g=0; g<W; g++) {                                                   \
+        for (k=0; k<nwords; k++) {                                          \
+            for (r=0; r<64; r++)                                            \
+                a[r] = 64*g + r < nsam ?                                    \
+                       rowbits[(size_t)(64*g + r)*nwords + k] : 0;          \
+            transpose64(a);                                                 \
+            for (c=0; c<64 && 64*k + c < nsites; c++)                       \
+                cols[(size_t)(64*k + c)*W + g] = a[c];                      \
+        }                                                                   \
+    }                                                                       \
+}                                                                           \
+                                                                            \
+static void site_frequencies_##W(int nsites, const uint64_t *cols,          \
+                                 int *site_freqs)                           \
+{                                                                           \
+    int     j, g;               /* iterators */                             \
+                                                                            \
+    for (j=0; j<nsites; j++) {                                              \
+        site_freqs[j] = 0;                                                  \
+        for (g=0; g<W; g++)                                                 \
+            site_freqs[j] += popcount64(cols[(size_t)j*W + g]);             \
+    }                                                                       \
+}                                                                           \
+                                                                            \
+static void unic_frequencies_##W(int nsites, const uint64_t *cols,          \
+                                 const int *site_freqs, int *unic_freqs)    \
+{                                                                           \
+    int     j, g;               /* iterators */                             \
+                                                                            \
+    for (j=0; j<nsites; j++) {                                              \
+        if (site_freqs[j] != 1)                                             \
+            continue;                                                       \
+        for (g=0; g<W; g++) {                                               \
+            if (cols[(size_t)j*W + g]) {                                    \
+                unic_freqs[64*g + ctz64(cols[(size_t)j*W + g])] += 1;       \
+                break;                                                      \
+            }                                                               \
+        }                                                                   \
+    }                                                                       \
+}
+
+PACKED_KERNELS(1)
+PACKED_KERNELS(2)
+
+/*  Transpose packed rows into per site column words
+ *
+ *      nsam        - number of samples (at most PACKED_MAXSAM)
+ *      nsites      - number of sites
+ *      rowbits     - the packed rows
+ *      cols        - where to put the columns (nsites * PACKED_COLWORDS(nsam))
+ *
+ *  Returns nothing
+ */
+void packed_columns(int nsam, int nsites, const uint64_t *rowbits, uint64_t *cols)
+{
+    if (nsam <= 64)
+        columns_1(nsam, nsites, rowbits, cols);
+    else
+        columns_2(nsam, nsites, rowbits, cols);
+}
+
+/*  Store a word so that its low byte comes first, as load8() reads it
+ *
+ *      p           - where to put it
+ *      x           - the word
+ *
+ *  Returns nothing
+ */
+static void store8(unsigned char *p, uint64_t x)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    x = __builtin_bswap64(x);
+#endif
+    memcpy(p, &x, 8);
+}
+
+/*  Transpose per site columns of any number of samples back into rows of
+ *    a bit per site, laid out as SS_BITS has them (site j of a row in bit
+ *    j % 8 of byte j / 8), for data that comes a site at a time
+ *
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      cols        - the columns, <colwords> words per site, sample 64*g + r
+ *                    in bit r of word g (bits past nsam ignored)
+ *      colwords    - words per column (at least PACKED_WORDS(nsam))
+ *      data        - where to put the rows
+ *      stride      - bytes from one row to the next (at least
+ *                    8 * PACKED_WORDS(nsites))
+ *
+ *  Returns nothing
+ */
+void packed_column_rows(int nsam, int nsites, const uint64_t *cols, size_t colwords,
+                        unsigned char *data, size_t stride)
+{
+    uint64_t    a[64];          /* one 64 x 64 block */
+    int         g, k, r, c;     /* iterators */
+
+    for (g=0; g<PACKED_WORDS(nsam); g++) {
+        for (k=0; k<PACKED_WORDS(nsites); k++) {
+            for (c=0; c<64; c++)
+                a[c] = 64*k + c < nsites ? cols[(size_t)(64*k + c)*colwords + g] : 0;
+            transpose64(a);
+            for (r=0; r<64 && 64*g + r < nsam; r++)
+                store8(data + (size_t)(64*g + r)*stride + 8*k, a[r]);
+        }
+    }
+}
+
+/*  Count the samples carrying the derived allele at each site
+ *
+ *      nsam        - number of samples (at most PACKED_MAXSAM)
+ *      nsites      - number of sites
+ *      cols        - column words from packed_columns()
+ *      site_freqs  - array to fill (length nsites)
+ *
+ *  Returns nothing (fills in the array given)
+ */
+void packed_site_frequencies(int nsam, int nsites, const uint64_t *cols, int *site_freqs)
+{
+    if (nsam <= 64)
+        site_frequencies_1(nsites, cols, site_freqs);
+    else
+        site_frequencies_2(nsites, cols, site_freqs);
+}
+
+/*  Count the sites unique to each sample (as count_binary_unic_frequencies)
+ *
+ *      nsam        - number of samples (at most PACKED_MAXSAM)
+ *      nsites      - number of sites
+ *      cols        - column words from packed_columns()
+ *      site_freqs  - counts of the derived allele per site
+ *      unic_freqs  - array to fill (length nsam)
+ *
+ *  Returns nothing (fills in the array given)
+ */
+void packed_unic_frequencies(int nsam, int nsites, const uint64_t *cols,
+                             const int *site_freqs, int *unic_freqs)
+{
+    int     i;                      /* iterator */
+
+    for (i=0; i<nsam; i++)
+        unic_freqs[i] = 0;
+
+    if (nsam <= 64)
+        unic_frequencies_1(nsites, cols, site_freqs, unic_freqs);
+    else
+        unic_frequencies_2(nsites, cols, site_freqs, unic_freqs);
+}
+
+/*  Hash each packed row, so that haplotypes can be told apart by
+ *    comparing one word before comparing whole rows
+ *
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      rowbits     - the packed rows
+ *      hashes      - array to fill (length nsam)
+ *
+ *  Returns nothing (fills in the array given)
+ */
+void packed_row_hashes(int nsam, int nsites, const uint64_t *rowbits, uint64_t *hashes)
+{
+    int             i, k;           /* iterators */
+    int             nwords;         /* words per packed row */
+    const uint64_t  *a;             /* current row */
+    uint64_t        h;              /* hash being built */
+
+    nwords = PACKED_WORDS(nsites);
+    for (i=0; i<nsam; i++) {
+        a = rowbits + (size_t)i*nwords;
+        h = 0;
+        for (k=0; k<nwords; k++) {
+            h = (h ^ a[k]) * 0x9E3779B97F4A7C15ULL;
+            h ^= h >> 29;
+        }
+        hashes[i] = h;
+    }
+}
+
+/*  Count up the haplotypes (as count_haplotype_frequencies). Rows are
+ *    only compared word by word when their hashes match.
+ *
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      rowbits     - the packed rows
+ *      hashes      - row hashes, from any of the row hash kernels
+ *      hap_freqs   - array to fill (length nsam)
+ *
+ *  Returns nothing (fills in the array given)
+ */
+void packed_haplotype_frequencies(int nsam, int nsites, const uint64_t *rowbits,
+                                  const uint64_t *hashes, int *hap_freqs)
+{
+    int             i, j, k;        /* iterators */
+    int             nwords;         /* words per packed row */
+    const uint64_t  *a, *b;         /* the two rows being compared */
+
+    nwords = PACKED_WORDS(nsites);
+    for (i=0; i<nsam; i++)
+        hap_freqs[i] = 0;
+
+    for (i=0; i<nsam; i++) {
+        if (hap_freqs[i] != 0)
+            continue;
+        hap_freqs[i] = 1;
+        a = rowbits + (size_t)i*nwords;
+        for (j=i+1; j<nsam; j++) {
+            if (hap_freqs[j] != 0 || hashes[j] != hashes[i])
+                continue;
+            b = rowbits + (size_t)j*nwords;
+            for (k=0; k<nwords && a[k] == b[k]; k++)
+                ;
+            if (k == nwords) {
+                hap_freqs[i] += 1;
+                hap_freqs[j] = -9;
+            }
+        }
+    }
+}
+
+/*  Count the samples carrying the derived allele at both of a pair of
+ *    sites, for one site against a run of others
+ *
+ *      nwords      - column words per site
+ *      a           - the column of the one site
+ *      cols        - the columns of the others
+ *      n           - number of others
+ *      counts      - array to fill (length n)
+ *
+ *  Returns nothing (fills in the array given)
+ */
+void packed_and_counts(int nwords, const uint64_t *a, const uint64_t *cols, int n,
+                       int *counts)
+{
+    int         j, g;               /* iterators */
+
+    if (nwords == 1) {
+        for (j=0; j<n; j++)
+            counts[j] = popcount64(a[0] & cols[j]);
+    } else if (nwords == 2) {
+        for (j=0; j<n; j++)
+            counts[j] = popcount64(a[0] & cols[2*j]) + popcount64(a[1] & cols[2*j + 1]);
+    } else {
+        for (j=0; j<n; j++) {
+            counts[j] = 0;
+            for (g=0; g<nwords; g++)
+                counts[j] += popcount64(a[g] & cols[(size_t)j*nwords + g]);
+        }
+    }
+}
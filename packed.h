@@ -0,0 +1,47 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bit-packed kernels for binary replicates of up to PACKED_MAXSAM samples.
+ *
+ * Rows are packed 64 sites to a word (site j in bit j%64 of word j/64) and
+ * then transposed so that each site becomes one or two column words holding
+ * a bit per sample. Site frequencies are then popcounts, singleton owners
+ * are the position of the single set bit, and haplotypes are compared a
+ * word at a time. The column kernels come in a one word (nsam <= 64) and a
+ * two word (nsam <= 128) version, generated from the same macro so that the
+ * word loop is unrolled at compile time.
+ *
+ * The functions here are the portable versions; isa.h has faster ones for
+ * particular instruction sets and picks between them at run time. */
+
+#define PACKED_MAXSAM       128
+
+/* number of 64 bit words needed for n sites */
+#define PACKED_WORDS(n)     (((n) + 63) / 64)
+
+/* number of column words per site for a sample size */
+#define PACKED_COLWORDS(nsam) ((nsam) <= 64 ? 1 : 2)
+
+void pack_rows_ascii(int nsam, int nsites, const unsigned char *data, size_t stride,
+                     uint64_t *rowbits);
+void pack_rows_bytes(int nsam, int nsites, const unsigned char *data, size_t stride,
+                     uint64_t *rowbits);
+void pack_rows_bits(int nsam, int nsites, const unsigned char *data, size_t stride,
+                    uint64_t *rowbits);
+
+void packed_columns(int nsam, int nsites, const uint64_t *rowbits, uint64_t *cols);
+void packed_column_rows(int nsam, int nsites, const uint64_t *cols, size_t colwords,
+                        unsigned char *data, size_t stride);
+void packed_site_frequencies(int nsam, int nsites, const uint64_t *cols, int *site_freqs);
+void packed_unic_frequencies(int nsam, int nsites, const uint64_t *cols,
+                             const int *site_freqs, int *unic_freqs);
+void packed_row_hashes(int nsam, int nsites, const uint64_t *rowbits, uint64_t *hashes);
+void packed_haplotype_frequencies(int nsam, int nsites, const uint64_t *rowbits,
+                                  const uint64_t *hashes, int *hap_freqs);
+void packed_and_counts(int nwords, const uint64_t *a, const uint64_t *cols, int n,
+                       int *counts);
+
+#endif /* PACKED_H */
@@ -0,0 +1,114 @@
+#include <string.h>
+#include <errno.h>
+
+#include "perf.h"
+
+#if defined(__linux__)
+#define HAVE_PERF_EVENTS 1
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char *names[PERF_COUNTERS] = {
+    "cycles", "instructions", "cache-misses", "branch-misses"
+};
+
+#ifdef HAVE_PERF_EVENTS
+static const unsigned long long configs[PERF_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+};
+#endif
+
+/*  Open the counters for the calling thread, counting from now on
+ *
+ *      pc          - where to keep them
+ *
+ *  Returns the number of counters open; 0 if perf events are not
+ *    available, with pc->error saying why
+ */
+int perf_open(struct perf_counters *pc)
+{
+    int     i;                  /* iterator */
+#ifdef HAVE_PERF_EVENTS
+    struct perf_event_attr attr;
+                                /* what to count */
+#endif
+
+    pc->nopen = 0;
+    pc->error = 0;
+    for (i=0; i<PERF_COUNTERS; i++) {
+        pc->fd[i] = -1;
+#ifdef HAVE_PERF_EVENTS
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;       /* take in the LD and distance threads */
+        pc->fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (pc->fd[i] >= 0)
+            pc->nopen++;
+        else if (pc->error == 0)
+            pc->error = errno;
+#else
+        pc->error = ENOSYS;
+#endif
+    }
+    return pc->nopen;
+}
+
+/*  Read the counters
+ *
+ *      pc          - the counters
+ *      values      - where to put their counts so far (PERF_COUNTERS of
+ *                    them; 0 for those not open)
+ *
+ *  Returns nothing
+ */
+void perf_read(const struct perf_counters *pc, unsigned long long *values)
+{
+    int     i;                  /* iterator */
+
+    for (i=0; i<PERF_COUNTERS; i++) {
+        values[i] = 0;
+#ifdef HAVE_PERF_EVENTS
+        if (pc->fd[i] >= 0 && read(pc->fd[i], &values[i], sizeof(values[i]))
+                              != (ssize_t)sizeof(values[i]))
+            values[i] = 0;
+#endif
+    }
+}
+
+/*  Close the counters
+ *
+ *      pc          - the counters
+ *
+ *  Returns nothing
+ */
+void perf_close(struct perf_counters *pc)
+{
+    int     i;                  /* iterator */
+
+    for (i=0; i<PERF_COUNTERS; i++) {
+#ifdef HAVE_PERF_EVENTS
+        if (pc->fd[i] >= 0)
+            close(pc->fd[i]);
+#endif
+        pc->fd[i] = -1;
+    }
+    pc->nopen = 0;
+}
+
+/*  Name a counter
+ *
+ *      counter     - the counter (PERF_*)
+ *
+ *  Returns its name, as perf(1) calls it, or NULL if there is no such one
+ */
+const char *perf_name(int counter)
+{
+    return counter >= 0 && counter < PERF_COUNTERS ? names[counter] : NULL;
+}
@@ -0,0 +1,33 @@
+#ifndef PERF_H
+#define PERF_H
+
+/* Hardware performance counters of the calling thread (and the threads it
+ * starts afterwards), through Linux's perf_event_open(). Only user space
+ * is counted, which is all that perf_event_paranoid 2 allows.
+ *
+ * Where perf events are not there at all (other systems, containers that
+ * filter the system call, virtual machines without a PMU) perf_open()
+ * says so and the counters read as zero, so callers need no special
+ * cases beyond reporting it. A counter the CPU does not have is left out
+ * on its own (its fd is -1). */
+
+/* the counters, in the order perf_read() gives them (the same as
+ * SS_PROF_CYCLES ... in samplestats.h) */
+#define PERF_CYCLES         0
+#define PERF_INSTRUCTIONS   1
+#define PERF_CACHE_MISSES   2   /* last level cache */
+#define PERF_BRANCH_MISSES  3
+#define PERF_COUNTERS       4
+
+struct perf_counters {
+    int     fd[PERF_COUNTERS];  /* one per counter, -1 if not open */
+    int     nopen;              /* number open */
+    int     error;              /* errno of the first that failed to open */
+};
+
+int perf_open(struct perf_counters *pc);
+void perf_read(const struct perf_counters *pc, unsigned long long *values);
+void perf_close(struct perf_counters *pc);
+const char *perf_name(int counter);
+
+#endif /* PERF_H */
@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "pops.h"
+
+/* Per population and per subsample site counts on bit-packed columns
+ * (see pops.h) */
+
+#if defined(__GNUC__)
+#define popcount64(x)   __builtin_popcountll(x)
+#else
+static int popcount64(uint64_t x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+}
+#endif
+
+/*  Build the sample mask of each population
+ *
+ *      npop        - number of populations (up to POPS_MAX)
+ *      sizes       - samples in each, in the order they come
+ *      nwords      - words per site column
+ *      masks       - where to put the masks (npop * nwords words)
+ *
+ *  Returns nothing
+ */
+void pops_masks(int npop, const int *sizes, int nwords, uint64_t *masks)
+{
+    int     p, i,               /* iterators */
+            first;              /* first sample of the population */
+
+    memset(masks, 0, (size_t)npop*nwords*sizeof(uint64_t));
+    first = 0;
+    for (p=0; p<npop; p++) {
+        for (i=first; i<first + sizes[p]; i++)
+            masks[(size_t)p*nwords + i/64] |= (uint64_t)1 << (i % 64);
+        first += sizes[p];
+    }
+}
+
+/*  Build the sample mask of each subsample
+ *
+ *      nsets       - number of subsamples
+ *      sizes       - samples in each
+ *      samples     - the samples of each, one subsample after the other,
+ *                    or NULL for the first sizes[s] samples
+ *      nwords      - words per site column
+ *      masks       - where to put the masks (nsets * nwords words)
+ *
+ *  Returns 0, or -1 if a subsample lists a sample twice
+ */
+int pops_subsample_masks(int nsets, const int *sizes, const int *samples, int nwords,
+                         uint64_t *masks)
+{
+    int     s, i,               /* iterators */
+            k;                  /* the current sample */
+    uint64_t *m,                /* the current mask */
+            bit;                /* the sample's bit in it */
+
+    memset(masks, 0, (size_t)nsets*nwords*sizeof(uint64_t));
+    for (s=0; s<nsets; s++) {
+        m = masks + (size_t)s*nwords;
+        for (i=0; i<sizes[s]; i++) {
+            k = samples ? *samples++ : i;
+            bit = (uint64_t)1 << (k % 64);
+            if (m[k/64] & bit)
+                return -1;
+            m[k/64] |= bit;
+        }
+    }
+    return 0;
+}
+
+/*  Histogram the derived allele counts of every subsample over the sites,
+ *    giving each its unfolded spectrum in the one pass
+ *
+ *      nsites      - number of sites
+ *      nwords      - words per site column
+ *      cols        - the site columns
+ *      nsets       - number of subsamples
+ *      masks       - their masks, from pops_subsample_masks()
+ *      len         - entries per histogram (more than the largest subsample)
+ *      hist        - where to put the histograms (nsets * len ints):
+ *                    hist[s*len + c] is the number of sites where c
+ *                    samples of subsample s carry the derived allele
+ *
+ *  Returns nothing
+ */
+void pops_spectra(int nsites, int nwords, const uint64_t *cols, int nsets,
+                  const uint64_t *masks, int len, int *hist)
+{
+    int         j, s, g,            /* iterators */
+                c;                  /* derived count of the subsample */
+    const uint64_t *col,            /* the current site */
+                *m;                 /* the current mask */
+
+    memset(hist, 0, (size_t)nsets*len*sizeof(int));
+    for (j=0; j<nsites; j++) {
+        col = cols + (size_t)j*nwords;
+        for (s=0, m=masks; s<nsets; s++, m+=nwords) {
+            c = 0;
+            for (g=0; g<nwords; g++)
+                c += popcount64(col[g] & m[g]);
+            hist[(size_t)s*len + c]++;
+        }
+    }
+}
+
+/*  Count the derived alleles of every population at every site, and sum
+ *    up what pi, S and dxy need
+ *
+ *      nsites      - number of sites
+ *      nwords      - words per site column
+ *      cols        - the site columns
+ *      npop        - number of populations
+ *      sizes       - samples in each
+ *      masks       - their masks, from pops_masks()
+ *      sums        - where to put the sums
+ *
+ *  Returns nothing
+ */
+void pops_sweep(int nsites, int nwords, const uint64_t *cols, int npop, const int *sizes,
+                const uint64_t *masks, struct pops_sums *sums)
+{
+    int         j, p, q, g;         /* iterators */
+    int64_t     c[POPS_MAX];        /* derived count of each population */
+    const uint64_t *col;            /* the current site */
+
+    memset(sums, 0, sizeof(*sums));
+    for (j=0; j<nsites; j++) {
+        col = cols + (size_t)j*nwords;
+        for (p=0; p<npop; p++) {
+            c[p] = 0;
+            for (g=0; g<nwords; g++)
+                c[p] += popcount64(col[g] & masks[(size_t)p*nwords + g]);
+            sums->within[p] += c[p]*(sizes[p] - c[p]);
+            sums->seg[p] += c[p] > 0 && c[p] < sizes[p];
+        }
+        for (p=0; p<npop; p++)
+            for (q=p+1; q<npop; q++)
+                sums->between[p][q] += c[p]*(sizes[q] - c[q]) + c[q]*(sizes[p] - c[p]);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef POPS_H
+#define POPS_H
+
+#include <stdint.h>
+
+/* Site counts of structured samples, as ms -I lays them out: the samples
+ * of population 0 first, then those of population 1, and so on.
+ *
+ * Each population has a bit mask over the samples, laid out like a site
+ * column (PACKED_WORDS(nsam) words), so the derived allele count of a
+ * population at a site is an AND and a popcount per column word, and all
+ * the populations are counted in the one pass over the sites. Only integer
+ * sums are kept, from which pi, S and D within each population and dxy
+ * between each pair follow.
+ *
+ * Subsamples (any set of samples, such as the first n) get masks the same
+ * way, and the histogram of their derived allele counts over the sites is
+ * their site frequency spectrum, again for all of them in one pass. */
+
+/* most populations (the same as SS_MAXPOPS) */
+#define POPS_MAX        16
+
+struct pops_sums {
+    int64_t     within[POPS_MAX],   /* c(n-c) summed over the sites, per
+                                     *   population, c being the derived count */
+                between[POPS_MAX][POPS_MAX];
+                                    /* c1(n2-c2) + c2(n1-c1) summed over the
+                                     *   sites, per pair (first < second) */
+    int         seg[POPS_MAX];      /* sites segregating within each population */
+};
+
+void pops_masks(int npop, const int *sizes, int nwords, uint64_t *masks);
+void pops_sweep(int nsites, int nwords, const uint64_t *cols, int npop, const int *sizes,
+                const uint64_t *masks, struct pops_sums *sums);
+int pops_subsample_masks(int nsets, const int *sizes, const int *samples, int nwords,
+                         uint64_t *masks);
+void pops_spectra(int nsites, int nwords, const uint64_t *cols, int nsets,
+                  const uint64_t *masks, int len, int *hist);
+
+#endif /* POPS_H */
@@ -0,0 +1,507 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "prefetch.h"
+
+/* A buffered input stream whose blocks are filled by a helper thread.
+ *
+ * While the main program parses and analyses the replicate in the current
+ * block, the helper thread is already reading the following blocks, so the
+ * disk (or the program at the other end of a pipe) never sits idle waiting
+ * for the statistics to be computed. */
+
+struct prefetch_block {
+    char    *data;                  /* block contents */
+    size_t  len;                    /* number of valid bytes in data */
+    struct prefetch_block *next;    /* next block in the full or free list */
+};
+
+struct prefetch {
+    int     fd;                     /* file descriptor being read */
+    int     is_file;                /* 1 if fd is a regular file */
+    int     threaded;               /* 1 if the helper thread is running */
+    int     maxblocks,              /* maximum number of blocks to allocate */
+            nblocks;                /* number of blocks allocated so far */
+    off_t   offset;                 /* bytes read so far (for readahead hints) */
+    long long consumed;             /* bytes of the blocks already parsed */
+
+    struct prefetch_block
+            *full_head,             /* filled blocks waiting to be parsed */
+            *full_tail,
+            *free_list,             /* parsed blocks ready to be refilled */
+            *cur;                   /* block currently being parsed */
+    size_t  pos;                    /* parse position in the current block */
+
+    int     eof,                    /* 1 once the helper thread hits end of input */
+            closing;                /* 1 when prefetch_close has been called */
+
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  filled,         /* signalled when a block is queued */
+                    emptied;        /* signalled when a block is freed */
+};
+
+/*  Allocate a new, empty block
+ *
+ *  Returns a pointer to the block, or NULL if out of memory
+ */
+static struct prefetch_block *new_block(void)
+{
+    struct prefetch_block *b;
+
+    if (!(b = (struct prefetch_block *)malloc(sizeof(struct prefetch_block))))
+        return NULL;
+    if (!(b->data = (char *)malloc(PREFETCH_BLOCKSIZE))) {
+        free(b);
+        return NULL;
+    }
+    b->len = 0;
+    b->next = NULL;
+
+    return b;
+}
+
+/*  Read from the file descriptor into the unused tail of a block,
+ *    retrying on interrupts
+ *
+ *      pf          - the stream
+ *      b           - the block to fill
+ *
+ *  Returns the number of bytes read, 0 at end of input, -1 on error
+ */
+static ssize_t fill_block(struct prefetch *pf, struct prefetch_block *b)
+{
+    ssize_t n;
+
+    do {
+        n = read(pf->fd, b->data + b->len, PREFETCH_BLOCKSIZE - b->len);
+    } while (n < 0 && errno == EINTR);
+
+    if (n > 0) {
+        b->len += n;
+        pf->offset += n;
+    }
+
+    return n;
+}
+
+/*  Tell whether more input can be read at once, without blocking
+ *
+ *      fd          - the file descriptor
+ *
+ *  Returns 1 if a read would not block (data, end of input or an error
+ *    waiting), 0 otherwise
+ */
+static int input_ready(int fd)
+{
+    struct pollfd p;
+
+    p.fd = fd;
+    p.events = POLLIN;
+    p.revents = 0;
+    return poll(&p, 1, 0) > 0;
+}
+
+/*  Body of the helper thread. Keeps taking free blocks (allocating new
+ *    ones up to maxblocks), fills them and appends them to the full list.
+ *    A partially filled block is handed over as soon as nothing more can
+ *    be read at once, so that the parser is never kept from data already
+ *    read while a producer pauses or a pipe is held open.
+ */
+static void *reader_thread(void *arg)
+{
+    struct prefetch         *pf;    /* the stream */
+    struct prefetch_block   *b;     /* block being filled */
+    ssize_t                 n;      /* bytes read by the last call */
+    int                     hand_over;
+
+    pf = (struct prefetch *)arg;
+
+    /* we can only be cancelled while blocked in read() */
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+    for (;;) {
+        pthread_mutex_lock(&pf->lock);
+        while (pf->free_list == NULL && pf->nblocks >= pf->maxblocks && !pf->closing)
+            pthread_cond_wait(&pf->emptied, &pf->lock);
+        if (pf->closing) {
+            pthread_mutex_unlock(&pf->lock);
+            break;
+        }
+        if (pf->free_list != NULL) {
+            b = pf->free_list;
+            pf->free_list = b->next;
+        } else {
+            b = NULL;
+            pf->nblocks++;
+        }
+        pthread_mutex_unlock(&pf->lock);
+
+        if (b == NULL && (b = new_block()) == NULL) {
+            perror("alloc error in prefetch reader");
+            n = -1;
+        } else {
+            b->len = 0;
+            b->next = NULL;
+
+            /* let the kernel start on the block after this one */
+            if (pf->is_file)
+                posix_fadvise(pf->fd, pf->offset + PREFETCH_BLOCKSIZE,
+                              PREFETCH_BLOCKSIZE, POSIX_FADV_WILLNEED);
+
+            hand_over = 0;
+            do {
+                pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+                n = fill_block(pf, b);
+                pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+                if (n > 0 && b->len < PREFETCH_BLOCKSIZE)
+                    hand_over = !input_ready(pf->fd);
+            } while (n > 0 && b->len < PREFETCH_BLOCKSIZE && !hand_over);
+
+            if (n < 0)
+                perror("read error in prefetch reader");
+        }
+
+        pthread_mutex_lock(&pf->lock);
+        if (b != NULL && b->len > 0) {
+            if (pf->full_tail != NULL)
+                pf->full_tail->next = b;
+            else
+                pf->full_head = b;
+            pf->full_tail = b;
+        } else if (b != NULL) {
+            b->next = pf->free_list;
+            pf->free_list = b;
+        }
+        if (n <= 0)
+            pf->eof = 1;
+        pthread_cond_signal(&pf->filled);
+        pthread_mutex_unlock(&pf->lock);
+
+        if (n <= 0)
+            break;
+    }
+
+    return NULL;
+}
+
+/*  Open a prefetching stream on a file descriptor and start the
+ *    helper thread. If the thread cannot be started, the stream
+ *    falls back to reading synchronously.
+ *
+ *      fd          - the file descriptor to read (e.g. fileno(stdin))
+ *
+ *  Returns a pointer to the stream
+ */
+struct prefetch *prefetch_open(int fd)
+{
+    struct prefetch *pf;        /* the stream we are creating here */
+    struct stat     st;         /* to tell regular files from pipes */
+
+    if (!(pf = (struct prefetch *)calloc(1, sizeof(struct prefetch)))) {
+        perror("alloc error in prefetch_open");
+        exit(EXIT_FAILURE);
+    }
+
+    pf->fd = fd;
+    pf->is_file = (fstat(fd, &st) == 0 && S_ISREG(st.st_mode));
+
+    if (pf->is_file) {
+        pf->maxblocks = PREFETCH_FILE_BLOCKS;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    } else {
+        pf->maxblocks = PREFETCH_PIPE_BLOCKS;
+#ifdef F_SETPIPE_SZ
+        /* a bigger pipe lets the upstream program run further ahead */
+        fcntl(fd, F_SETPIPE_SZ, PREFETCH_BLOCKSIZE);
+#endif
+    }
+
+    pthread_mutex_init(&pf->lock, NULL);
+    pthread_cond_init(&pf->filled, NULL);
+    pthread_cond_init(&pf->emptied, NULL);
+
+    pf->threaded = (pthread_create(&pf->thread, NULL, reader_thread, pf) == 0);
+
+    return pf;
+}
+
+/*  Retire the current block and make the next full block current.
+ *    Blocks (waiting on the helper thread) until data is available.
+ *
+ *      pf          - the stream
+ *
+ *  Returns 1 if a new block is current, 0 at end of input
+ */
+static int next_block(struct prefetch *pf)
+{
+    ssize_t n;
+
+    if (!pf->threaded) {
+        /* synchronous fallback; a single block is reused */
+        if (pf->cur == NULL && (pf->cur = new_block()) == NULL) {
+            perror("alloc error in prefetch reader");
+            return 0;
+        }
+        pf->consumed += pf->cur->len;
+        pf->cur->len = 0;
+        pf->pos = 0;
+        if ((n = fill_block(pf, pf->cur)) < 0)
+            perror("read error in prefetch reader");
+        return n > 0;
+    }
+
+    pthread_mutex_lock(&pf->lock);
+    if (pf->cur != NULL) {
+        pf->consumed += pf->cur->len;
+        pf->cur->next = pf->free_list;
+        pf->free_list = pf->cur;
+        pf->cur = NULL;
+        pthread_cond_signal(&pf->emptied);
+    }
+    while (pf->full_head == NULL && !pf->eof)
+        pthread_cond_wait(&pf->filled, &pf->lock);
+    if (pf->full_head != NULL) {
+        pf->cur = pf->full_head;
+        pf->full_head = pf->cur->next;
+        if (pf->full_head == NULL)
+            pf->full_tail = NULL;
+        pf->pos = 0;
+    }
+    pthread_mutex_unlock(&pf->lock);
+
+    return pf->cur != NULL;
+}
+
+/*  Count the input parsed so far
+ *
+ *      pf          - the stream
+ *
+ *  Returns the number of bytes handed to the parser
+ */
+long long prefetch_consumed(const struct prefetch *pf)
+{
+    return pf->consumed + (pf->cur != NULL ? (long long)pf->pos : 0);
+}
+
+/*  Read a line, with the same semantics as fgets
+ *
+ *      s           - buffer to fill
+ *      size        - size of s; at most size-1 characters are read
+ *      pf          - the stream
+ *
+ *  Returns s, or NULL if at end of input and nothing was read
+ */
+char *prefetch_gets(char *s, int size, struct prefetch *pf)
+{
+    int     n;                  /* characters copied so far */
+    size_t  avail,              /* characters left in the current block */
+            take;               /* characters to copy from the current block */
+    char    *start,             /* where we are in the current block */
+            *nl;                /* end of line in the current block, if any */
+
+    n = 0;
+
+    while (n < size - 1) {
+        if (pf->cur == NULL || pf->pos >= pf->cur->len) {
+            if (!next_block(pf))
+                break;
+        }
+        start = pf->cur->data + pf->pos;
+        avail = pf->cur->len - pf->pos;
+        take = (size_t)(size - 1 - n) < avail ? (size_t)(size - 1 - n) : avail;
+
+        nl = (char *)memchr(start, '\n', take);
+        if (nl != NULL)
+            take = nl - start + 1;
+
+        memcpy(s + n, start, take);
+        n += take;
+        pf->pos += take;
+
+        if (nl != NULL)
+            break;
+    }
+
+    if (n == 0)
+        return NULL;
+    s[n] = '\0';
+
+    return s;
+}
+
+/*  Read a whole line, however long, into a buffer that is grown to fit,
+ *    as getline() does
+ *
+ *      line        - the buffer, or NULL to have one allocated (updated)
+ *      size        - its size (updated)
+ *      pf          - the stream
+ *
+ *  Returns the length of the line, newline included, or -1 at end of input
+ *    or if out of memory
+ */
+long prefetch_getline(char **line, size_t *size, struct prefetch *pf)
+{
+    size_t  n,                  /* characters copied so far */
+            avail,              /* characters left in the current block */
+            take,               /* characters to copy from the current block */
+            want;               /* room needed for them */
+    char    *start,             /* where we are in the current block */
+            *nl,                /* end of line in the current block, if any */
+            *p;                 /* result of growing the buffer */
+
+    n = 0;
+    for (;;) {
+        if (pf->cur == NULL || pf->pos >= pf->cur->len) {
+            if (!next_block(pf))
+                break;
+        }
+        start = pf->cur->data + pf->pos;
+        avail = pf->cur->len - pf->pos;
+        nl = (char *)memchr(start, '\n', avail);
+        take = nl != NULL ? (size_t)(nl - start + 1) : avail;
+
+        for (want = *line != NULL ? *size : 0; want < n + take + 1; want = want ? 2*want : 4096)
+            ;
+        if (want > *size || *line == NULL) {
+            if (!(p = (char *)realloc(*line, want)))
+                return -1;
+            *line = p;
+            *size = want;
+        }
+        memcpy(*line + n, start, take);
+        n += take;
+        pf->pos += take;
+
+        if (nl != NULL)
+            break;
+    }
+
+    if (n == 0)
+        return -1;
+    (*line)[n] = '\0';
+
+    return (long)n;
+}
+
+/*  Read a whitespace delimited word, as fscanf(" %s") would. Characters
+ *    beyond the buffer size are consumed and dropped.
+ *
+ *      s           - buffer to fill
+ *      size        - size of s; at most size-1 characters are stored
+ *      pf          - the stream
+ *
+ *  Returns 1 on success, EOF if the input ended before a word was found
+ */
+int prefetch_word(char *s, int size, struct prefetch *pf)
+{
+    int     n;                  /* characters stored so far */
+    char    c;                  /* current character */
+
+    /* skip leading whitespace */
+    for (;;) {
+        if (pf->cur == NULL || pf->pos >= pf->cur->len) {
+            if (!next_block(pf))
+                return EOF;
+        }
+        c = pf->cur->data[pf->pos];
+        if (c != ' ' && c != '\n' && c != '\t' && c != '\r' && c != '\v' && c != '\f')
+            break;
+        pf->pos++;
+    }
+
+    /* copy the word */
+    n = 0;
+    for (;;) {
+        if (pf->pos >= pf->cur->len) {
+            if (!next_block(pf))
+                break;
+        }
+        c = pf->cur->data[pf->pos];
+        if (c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f')
+            break;
+        if (n < size - 1)
+            s[n++] = c;
+        pf->pos++;
+    }
+    s[n] = '\0';
+
+    return 1;
+}
+
+/*  Discard everything up to and including the next newline
+ *
+ *      pf          - the stream
+ *
+ *  Returns 1 if a newline was found, 0 at end of input
+ */
+int prefetch_skip_line(struct prefetch *pf)
+{
+    char    *start,             /* where we are in the current block */
+            *nl;                /* end of line, if in the current block */
+
+    for (;;) {
+        if (pf->cur == NULL || pf->pos >= pf->cur->len) {
+            if (!next_block(pf))
+                return 0;
+        }
+        start = pf->cur->data + pf->pos;
+        nl = (char *)memchr(start, '\n', pf->cur->len - pf->pos);
+        if (nl != NULL) {
+            pf->pos += nl - start + 1;
+            return 1;
+        }
+        pf->pos = pf->cur->len;
+    }
+}
+
+/*  Stop the helper thread and free the stream
+ *
+ *      pf          - the stream
+ *
+ *  Returns nothing
+ */
+void prefetch_close(struct prefetch *pf)
+{
+    struct prefetch_block *b;
+
+    if (pf->threaded) {
+        pthread_mutex_lock(&pf->lock);
+        pf->closing = 1;
+        pthread_cond_signal(&pf->emptied);
+        pthread_mutex_unlock(&pf->lock);
+        pthread_cancel(pf->thread);
+        pthread_join(pf->thread, NULL);
+    }
+
+    if (pf->cur != NULL) {
+        pf->cur->next = pf->full_head;
+        pf->full_head = pf->cur;
+    }
+    while (pf->full_head != NULL) {
+        b = pf->full_head;
+        pf->full_head = b->next;
+        free(b->data);
+        free(b);
+    }
+    while (pf->free_list != NULL) {
+        b = pf->free_list;
+        pf->free_list = b->next;
+        free(b->data);
+        free(b);
+    }
+
+    pthread_mutex_destroy(&pf->lock);
+    pthread_cond_destroy(&pf->filled);
+    pthread_cond_destroy(&pf->emptied);
+    free(pf);
+}
@@ -0,0 +1,25 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stddef.h>
+
+/* Size of each block of input pulled in by the background reader */
+#define PREFETCH_BLOCKSIZE   (1 << 20)
+
+/* Maximum number of blocks held in memory at once. Regular files only need
+ * to stay a couple of blocks ahead of the parser; pipes are drained as far
+ * as this allows so that the upstream program never stalls on a full pipe. */
+#define PREFETCH_FILE_BLOCKS 4
+#define PREFETCH_PIPE_BLOCKS 64
+
+struct prefetch;
+
+struct prefetch *prefetch_open(int fd);
+char *prefetch_gets(char *s, int size, struct prefetch *pf);
+long prefetch_getline(char **line, size_t *size, struct prefetch *pf);
+int prefetch_word(char *s, int size, struct prefetch *pf);
+int prefetch_skip_line(struct prefetch *pf);
+long long prefetch_consumed(const struct prefetch *pf);
+void prefetch_close(struct prefetch *pf);
+
+#endif /* PREFETCH_H */
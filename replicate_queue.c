@@ -0,0 +1,397 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "replicate_queue.h"
+
+#define CACHE_LINE 64
+
+/* A single-producer, single-consumer ring of slot pointers. Every ring is
+ * at least as big as the number of slots, and a slot is only ever in one
+ * ring at a time, so pushing never finds the ring full. head and tail are
+ * kept on separate cache lines so the two ends do not fight over one. */
+struct ss_ring {
+    _Atomic size_t  head;               /* next entry to pop (consumer side) */
+    char            pad1[CACHE_LINE - sizeof(size_t)];
+    _Atomic size_t  tail;               /* next entry to fill (producer side) */
+    char            pad2[CACHE_LINE - sizeof(size_t)];
+    size_t          mask;               /* capacity - 1 (capacity is a power of 2) */
+    struct ss_slot  **items;
+};
+
+/* slots padded out to whole cache lines, so that workers writing results
+ * into neighbouring slots do not share lines */
+union ss_padded_slot {
+    struct ss_slot  slot;
+    char            pad[CACHE_LINE * ((sizeof(struct ss_slot) + CACHE_LINE - 1) / CACHE_LINE)];
+};
+
+struct ss_worker {
+    struct ss_queue *q;                 /* the queue this worker belongs to */
+    int             id;                 /* index into the queue's rings */
+    pthread_t       thread;
+};
+
+struct ss_queue {
+    int             nworkers,           /* number of worker rings */
+                    nstarted,           /* number of statistics threads running */
+                    nslots;             /* number of preallocated slots */
+    union ss_padded_slot *slots;
+    unsigned char   *buffers;           /* genotype buffers of all slots */
+    int             *sfs,               /* site frequency spectra of all slots */
+                    *hfs;               /* and haplotype frequency spectra */
+    long            *mismatch;          /* mismatch distributions of all slots */
+    struct ss_ring  free_ring,          /* collector -> producer: slots to reuse */
+                    *in,                /* producer -> worker i: replicates to do */
+                    *out;               /* worker i -> collector: finished replicates */
+    struct ss_worker *workers;
+    _Atomic int     stop;               /* set when the queue is being freed */
+    _Atomic unsigned long submitted;    /* replicates submitted so far */
+    unsigned long   collected;          /* replicates collected so far (collector only) */
+};
+
+/*  Set up an empty ring with room for at least n entries
+ *
+ *      r           - the ring
+ *      n           - number of entries needed
+ *
+ *  Returns 0 on success, -1 if out of memory
+ */
+static int ring_init(struct ss_ring *r, int n)
+{
+    size_t  cap;                        /* capacity, rounded up to a power of 2 */
+
+    for (cap = 1; cap < (size_t)n; cap <<= 1)
+        ;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    r->mask = cap - 1;
+    r->items = (struct ss_slot **)malloc(cap*sizeof(struct ss_slot *));
+
+    return r->items == NULL ? -1 : 0;
+}
+
+/*  Add a slot to the ring (producer side only)
+ *
+ *      r           - the ring
+ *      slot        - the slot
+ *
+ *  Returns nothing
+ */
+static void ring_push(struct ss_ring *r, struct ss_slot *slot)
+{
+    size_t  t;
+
+    t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    r->items[t & r->mask] = slot;
+    atomic_store_explicit(&r->tail, t + 1, memory_order_release);
+}
+
+/*  Take the oldest slot from the ring (consumer side only)
+ *
+ *      r           - the ring
+ *
+ *  Returns the slot, or NULL if the ring is empty
+ */
+static struct ss_slot *ring_pop(struct ss_ring *r)
+{
+    size_t          h;
+    struct ss_slot  *slot;
+
+    h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (h == atomic_load_explicit(&r->tail, memory_order_acquire))
+        return NULL;
+    slot = r->items[h & r->mask];
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+
+    return slot;
+}
+
+/*  Wait a little before polling a ring again: spin at first, then
+ *    yield, then sleep, so that idle threads do not burn a core
+ *
+ *      spins       - how many times we have waited so far (updated)
+ *
+ *  Returns nothing
+ */
+static void backoff(int *spins)
+{
+    struct timespec ts;
+
+    if (*spins < 64) {
+        (*spins)++;
+    } else if (*spins < 128) {
+        (*spins)++;
+        sched_yield();
+    } else {
+        ts.tv_sec = 0;
+        ts.tv_nsec = 50000;
+        nanosleep(&ts, NULL);
+    }
+}
+
+/*  Body of each statistics thread: take replicates from this worker's
+ *    input ring, compute them and pass them on to its output ring
+ */
+static void *worker_thread(void *arg)
+{
+    struct ss_worker    *w;             /* this worker */
+    struct ss_workspace *ws;            /* scratch space, private to this thread */
+    struct ss_slot      *slot;          /* the replicate being worked on */
+    int                 spins;          /* for backing off when idle */
+
+    w = (struct ss_worker *)arg;
+    ws = ss_workspace_new();
+    spins = 0;
+
+    for (;;) {
+        if ((slot = ring_pop(&w->q->in[w->id])) == NULL) {
+            if (atomic_load_explicit(&w->q->stop, memory_order_acquire))
+                break;
+            backoff(&spins);
+            continue;
+        }
+        spins = 0;
+        if (ws == NULL)
+            slot->status = SS_ENOMEM;
+        else
+            slot->status = ss_compute(&slot->rep, slot->mask, ws, &slot->res);
+        ring_push(&w->q->out[w->id], slot);
+    }
+
+    ss_workspace_free(ws);
+
+    return NULL;
+}
+
+/*  Create a queue, its slots and its worker threads
+ *
+ *      nworkers    - number of statistics threads
+ *      nslots      - number of replicate slots (how far the producer may
+ *                    run ahead of the collector)
+ *      maxsam      - largest number of samples a slot can hold
+ *      maxsites    - largest number of sites a slot can hold
+ *      alphabet    - SS_BINARY or SS_AGCT
+ *      encoding    - SS_ASCII, SS_BYTES or SS_BITS
+ *
+ *  Returns a pointer to the queue, or NULL on failure
+ */
+struct ss_queue *ss_queue_new(int nworkers, int nslots, int maxsam, int maxsites,
+                              int alphabet, int encoding)
+{
+    struct ss_queue *q;                 /* the queue we are creating here */
+    struct ss_slot  *slot;              /* slot being set up */
+    size_t          stride;             /* bytes per row of a slot's buffer */
+    int             i;                  /* iterator */
+
+    if (nworkers < 1 || nslots < 1 || maxsam < 1 || maxsites < 0)
+        return NULL;
+
+    if (encoding == SS_BITS)
+        stride = (maxsites + 7) / 8;
+    else if (encoding == SS_BYTES)
+        stride = maxsites;
+    else
+        stride = maxsites + 1;
+    if (stride == 0)
+        stride = 1;
+
+    if (!(q = (struct ss_queue *)calloc(1, sizeof(struct ss_queue))))
+        return NULL;
+    q->nworkers = nworkers;
+    q->nslots = nslots;
+    atomic_init(&q->stop, 0);
+    atomic_init(&q->submitted, 0);
+
+    q->slots = (union ss_padded_slot *)calloc(nslots, sizeof(union ss_padded_slot));
+    q->buffers = (unsigned char *)calloc((size_t)nslots*maxsam, stride);
+    q->sfs = (int *)calloc((size_t)nslots*maxsam, sizeof(int));
+    q->hfs = (int *)calloc((size_t)nslots*maxsam, sizeof(int));
+    q->mismatch = (long *)calloc((size_t)nslots*(maxsites + 1), sizeof(long));
+    q->in = (struct ss_ring *)calloc(nworkers, sizeof(struct ss_ring));
+    q->out = (struct ss_ring *)calloc(nworkers, sizeof(struct ss_ring));
+    q->workers = (struct ss_worker *)calloc(nworkers, sizeof(struct ss_worker));
+    if (q->slots == NULL || q->buffers == NULL || q->sfs == NULL || q->hfs == NULL
+        || q->mismatch == NULL || q->in == NULL || q->out == NULL || q->workers == NULL || ring_init(&q->free_ring, nslots) != 0) {
+        ss_queue_free(q);
+        return NULL;
+    }
+    for (i=0; i<nworkers; i++) {
+        if (ring_init(&q->in[i], nslots) != 0 || ring_init(&q->out[i], nslots) != 0) {
+            ss_queue_free(q);
+            return NULL;
+        }
+    }
+
+    /* every slot starts out free */
+    for (i=0; i<nslots; i++) {
+        slot = &q->slots[i].slot;
+        slot->rep.nsam = maxsam;
+        slot->rep.nsites = 0;
+        slot->rep.alphabet = alphabet;
+        slot->rep.encoding = encoding;
+        slot->rep.data = q->buffers + (size_t)i*maxsam*stride;
+        slot->rep.stride = stride;
+        slot->res.sfs = q->sfs + (size_t)i*maxsam;
+        slot->res.hfs = q->hfs + (size_t)i*maxsam;
+        slot->res.mismatch = q->mismatch + (size_t)i*(maxsites + 1);
+        ring_push(&q->free_ring, slot);
+    }
+
+    for (i=0; i<nworkers; i++) {
+        q->workers[i].q = q;
+        q->workers[i].id = i;
+        if (pthread_create(&q->workers[i].thread, NULL, worker_thread, &q->workers[i]) != 0)
+            break;
+        q->nstarted++;
+    }
+    /* run with the workers we managed to start */
+    if (q->nstarted == 0) {
+        ss_queue_free(q);
+        return NULL;
+    }
+
+    return q;
+}
+
+/*  Stop the worker threads and free the queue. Replicates still in
+ *    flight are finished first; their results are discarded.
+ *
+ *      q           - the queue
+ *
+ *  Returns nothing
+ */
+void ss_queue_free(struct ss_queue *q)
+{
+    int     i;                          /* iterator */
+
+    if (q == NULL)
+        return;
+
+    atomic_store_explicit(&q->stop, 1, memory_order_release);
+    if (q->workers != NULL) {
+        for (i=0; i<q->nstarted; i++)
+            pthread_join(q->workers[i].thread, NULL);
+    }
+
+    if (q->in != NULL && q->out != NULL) {
+        for (i=0; i<q->nworkers; i++) {
+            free(q->in[i].items);
+            free(q->out[i].items);
+        }
+    }
+    free(q->free_ring.items);
+    free(q->in);
+    free(q->out);
+    free(q->workers);
+    free(q->buffers);
+    free(q->sfs);
+    free(q->hfs);
+    free(q->mismatch);
+    free(q->slots);
+    free(q);
+}
+
+/*  Get a free slot to write the next replicate into (producer only)
+ *
+ *      q           - the queue
+ *
+ *  Returns a slot, or NULL if none is free right now
+ */
+struct ss_slot *ss_queue_try_acquire(struct ss_queue *q)
+{
+    return ring_pop(&q->free_ring);
+}
+
+/*  Get a free slot to write the next replicate into, waiting for the
+ *    collector to release one if necessary (producer only)
+ *
+ *      q           - the queue
+ *
+ *  Returns a slot
+ */
+struct ss_slot *ss_queue_acquire(struct ss_queue *q)
+{
+    struct ss_slot  *slot;
+    int             spins;
+
+    spins = 0;
+    while ((slot = ring_pop(&q->free_ring)) == NULL)
+        backoff(&spins);
+
+    return slot;
+}
+
+/*  Hand a filled slot to the statistics threads (producer only).
+ *    Replicates are dealt out to the workers in turn.
+ *
+ *      q           - the queue
+ *      slot        - a slot from ss_queue_acquire, with rep filled in
+ *      mask        - the statistics wanted (SS_PI | SS_D | ...)
+ *
+ *  Returns nothing
+ */
+void ss_queue_submit(struct ss_queue *q, struct ss_slot *slot, unsigned mask)
+{
+    unsigned long   n;
+
+    n = atomic_load_explicit(&q->submitted, memory_order_relaxed);
+    slot->mask = mask;
+    slot->seq = n;
+    ring_push(&q->in[n % q->nstarted], slot);
+    atomic_store_explicit(&q->submitted, n + 1, memory_order_release);
+}
+
+/*  Get the next finished replicate, in submission order (collector only)
+ *
+ *      q           - the queue
+ *
+ *  Returns the slot, or NULL if it is not finished yet
+ */
+struct ss_slot *ss_queue_try_collect(struct ss_queue *q)
+{
+    struct ss_slot  *slot;
+
+    if ((slot = ring_pop(&q->out[q->collected % q->nstarted])) != NULL)
+        q->collected++;
+
+    return slot;
+}
+
+/*  Get the next finished replicate, in submission order, waiting for
+ *    it if necessary (collector only)
+ *
+ *      q           - the queue
+ *
+ *  Returns the slot, or NULL if nothing has been submitted that has
+ *    not already been collected
+ */
+struct ss_slot *ss_queue_collect(struct ss_queue *q)
+{
+    struct ss_slot  *slot;
+    int             spins;
+
+    if (q->collected == atomic_load_explicit(&q->submitted, memory_order_acquire))
+        return NULL;
+
+    spins = 0;
+    while ((slot = ss_queue_try_collect(q)) == NULL)
+        backoff(&spins);
+
+    return slot;
+}
+
+/*  Give a collected slot back to the producer for reuse (collector only)
+ *
+ *      q           - the queue
+ *      slot        - a slot from ss_queue_collect
+ *
+ *  Returns nothing
+ */
+void ss_queue_release(struct ss_queue *q, struct ss_slot *slot)
+{
+    ring_push(&q->free_ring, slot);
+}
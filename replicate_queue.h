@@ -0,0 +1,47 @@
+#ifndef REPLICATE_QUEUE_H
+#define REPLICATE_QUEUE_H
+
+#include <stddef.h>
+
+#include "samplestats.h"
+
+/* A pool of statistics threads fed through lock-free single-producer,
+ * single-consumer rings of preallocated replicate slots.
+ *
+ * One thread (the producer, e.g. a simulator) acquires a free slot, writes
+ * a replicate into the slot's buffer and submits it with a stat mask. The
+ * worker threads compute the statistics with ss_compute() and hand the
+ * slots back through a second set of rings, where one thread (the
+ * collector) picks them up in submission order and releases them for
+ * reuse. Nothing is allocated after ss_queue_new(). */
+
+struct ss_slot {
+    struct ss_replicate rep;    /* the replicate; rep.data points at this slot's
+                                 *   buffer and rep.stride is fixed by the queue.
+                                 *   The producer sets rep.nsam (up to the queue's
+                                 *   maximum) and rep.nsites before submitting */
+    unsigned        mask;       /* statistics wanted, set by ss_queue_submit */
+    unsigned long   seq;        /* submission number, starting at 0 */
+    int             status;     /* return code of ss_compute() */
+    struct ss_results res;      /* the statistics, once collected; res.sfs and
+                                 *   res.hfs point at room for the queue's maxsam
+                                 *   ints each, res.mismatch at maxsites + 1
+                                 *   longs */
+    void            *user;      /* free for the caller to use */
+};
+
+struct ss_queue;
+
+struct ss_queue *ss_queue_new(int nworkers, int nslots, int maxsam, int maxsites,
+                              int alphabet, int encoding);
+void ss_queue_free(struct ss_queue *q);
+
+struct ss_slot *ss_queue_acquire(struct ss_queue *q);
+struct ss_slot *ss_queue_try_acquire(struct ss_queue *q);
+void ss_queue_submit(struct ss_queue *q, struct ss_slot *slot, unsigned mask);
+
+struct ss_slot *ss_queue_collect(struct ss_queue *q);
+struct ss_slot *ss_queue_try_collect(struct ss_queue *q);
+void ss_queue_release(struct ss_queue *q, struct ss_slot *slot);
+
+#endif /* REPLICATE_QUEUE_H */
@@ -1,11 +1,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <glob.h>
+#include <sys/sysinfo.h>
+#include <pthread.h>
 
 #include "simple_getopt.h"
-#include "fs.h"
-#include "r2.h"
-#include "tajd.h"
+#include "samplestats.h"
+#include "prefetch.h"
+#include "perf.h"
+#include "latency.h"
+#include "work_pool.h"
+#include "vcf.h"
+#include "packed.h"
 
 #define PACKAGE "sample_stats2"
 #define VERSION "0.0.1"
@@ -13,35 +20,94 @@
 /* String containing name the program is called with. */
 const char *program_name;
 
-/* global count of the current maximum number of sites
- * used to allocate memory for the data array */
+/* global count of the starting maximum number of sites
+ * used to allocate memory for the data array (each replicate
+ * buffer grows from here as it needs to) */
 int maxsites = 1000 ;
 
-/*  Calculates the frequency of an allele at a particular site
- *    across all chromosomes
- *
- *      allele      - the allele to count, either "1" or "0"
- *      site        - the position to count, in the range 0, number of sites - 1 
- *      nsam        - the number of samples in the dataset (number of rows in list)
- *      list        - a matrix containing the data, samples in rows, positions in columns
- *
- *  Returns an integer
- */
-int frequency( char allele,int site,int nsam,  char **list) {
-    int     i,                  /* iterator */
-            count;              /* running count of allele */
-
-    count = 0;
-
-    for( i=0; i<nsam; i++) {
-        count += ( list[i][site] == allele ? 1: 0 );
-    }
-
-    return( count);
-} 
+/* the statistics to output (SS_PI | SS_SS | ...), and those of the
+ * populations (SS_POP_PI | ...) */
+unsigned stats = 0,
+         pop_stats = 0;
+
+/* limits on the pairwise LD statistics, from the long options */
+int ld_window = 0,
+    ld_threads = 1;
+long ld_max_pairs = 0;
+
+/* sliding windows, from the long options: width and step as fractions
+ * of the locus, as the ms positions are (no windows if the width is 0) */
+double win_width = 0.0,
+       win_step = 0.0;
+int nwin = 0;                   /* windows per replicate */
+
+/* the populations, in the order ms -I writes their samples, from --pops
+ * or the ms command line (no population statistics if there are none) */
+int npops = 0,
+    pop_sizes[SS_MAXPOPS];
+
+/* subsamples, from the long options: their sizes, and a seed to draw them
+ * at random in each replicate (0: take the first samples) */
+#define MAXSUBSAMPLES 64
+int nsubs = 0,
+    sub_sizes[MAXSUBSAMPLES];
+unsigned long sub_seed = 0;
+
+/* --profile: wall time and calls of each phase of the replicate loop, and
+ * of the library's phases within them, printed to stderr at exit */
+#define PROF_PARSE      0       /* reading a replicate in */
+#define PROF_COMPUTE    1       /* the statistics */
+#define PROF_OUTPUT     2       /* printing them */
+#define PROF_LOOP       3
+int profiling = 0;
+double prof_begin,
+       prof_seconds[PROF_LOOP];
+long prof_calls[PROF_LOOP];
+struct ss_profile lib_profile;
+
+/* --counters: the hardware events of the same phases as well, per
+ * replicate size bucket (SS_PROF_BUCKET() of the segregating sites) */
+int counting = 0,
+    prof_bucket = 0;
+struct perf_counters perf;
+unsigned long long perf_last[PERF_COUNTERS],
+                   prof_events[SS_PROF_BUCKETS][PROF_LOOP][PERF_COUNTERS];
+long prof_bucket_calls[SS_PROF_BUCKETS][PROF_LOOP];
+
+/* --cache: keep the statistics of this many recent distinct replicates,
+ * to hand back when one comes again (0: none) */
+int cache_entries = 64;
+long cache_hits = 0,
+     cache_misses = 0;
+
+/* --progress and --status-file: every progress_every seconds, report the
+ * replicates done, the input read, the throughput, the time left and how
+ * long the replicates took (0: no reports) */
+double progress_every = 0.0;
+const char *status_file = NULL;
+double progress_begin,          /* when the first replicate started */
+       progress_next,           /* when the next report is due */
+       rep_begin = 0.0;         /* when the current replicate started */
+long long reps_done = 0;
+int reps_total = 0;             /* replicates the ms header promises */
+struct latency latencies;       /* how long each replicate took */
+struct prefetch *progress_input;
+
+/* input files, from the command line: each is worked out into a file of
+ * the same name plus out_suffix, the replicates of all of them shared out
+ * between jobs threads (0: one per processor) */
+int jobs = 0;
+const char *out_suffix = ".stats";
+
+/* --vcf: stdin is phased VCF, worked out a window of vcf_width bases at a
+ * time along each chromosome (0: a window per chromosome) */
+int vcf_input = 0;
+long vcf_width = 100000;
 
 /*  Allocates space for a sample by positions list as
- *  a two dimensional matrix of chars
+ *  a two dimensional matrix of chars. The rows are laid out
+ *  one after the other in a single block, <len> chars apart,
+ *  so that the whole matrix can be handed to ss_compute().
  *
  *      nsam        - the number of samples (rows)
  *      len         - the number of positions on the chromosome (columns)
@@ -58,13 +124,14 @@ char ** create_list(int nsam, int len) {
         perror("alloc error in create_list");
     }
 
-    /* Now walk through that intial array and try to allocate enough
-     * memory for a char array of length "len" for each row (sample).
+    /* Now try to allocate one block big enough for "nsam" rows of
+     * length "len" and point each row into it.
      * Throw an error if it fails. */
-    for( i=0; i<nsam; i++) {
-        if( ! ( list[i] = (char *) malloc( (unsigned) (len*sizeof( char )) ))) {
-            perror("alloc error in cmatric. 2");
-        }
+    if( ! ( list[0] = (char *) malloc( (size_t)nsam*len*sizeof( char ) ))) {
+        perror("alloc error in cmatric. 2");
+    }
+    for( i=1; i<nsam; i++) {
+        list[i] = list[0] + (size_t)i*len;
     }
     
     return( list );
@@ -73,7 +140,8 @@ char ** create_list(int nsam, int len) {
 /*  Allocate more space for positions in each entry of the data list
  *
  *      nsam        - total number of samples in data list
- *      nmax        - new maximum number of positions
+ *      nmax        - new maximum number of positions (the caller keeps
+ *                    track of it)
  *      list        - the data ( samples by positions matrix of chars )
  *
  *  Returns nothing
@@ -81,429 +149,1643 @@ char ** create_list(int nsam, int len) {
 void biggerlist(int nsam, unsigned nmax, char** list ) {
     int     i;                  /* iterator */
 
-    /* change the global maxsites number to the new, larger value */
-    maxsites = nmax;
+    /* attempt to expand the size of the block holding the rows
+     * (the data is about to be overwritten, so it is not copied
+     * over) and point the rows into the new block */
+    free( list[0] );
+    list[0] = (char *)malloc( (size_t)nsam*(nmax+1)*sizeof(char) ) ;
+    if( list[0] == NULL ) {
+        perror( "realloc error. bigger");
+    }
+    for( i=1; i<nsam; i++) {
+        list[i] = list[0] + (size_t)i*(nmax+1);
+    }
+}                        
+
+/* Print help info. */
+static void print_help (void) {
+  printf ("Usage: %s [OPTIONS] [FILE...]\n", program_name);
+
+  puts ("");
+  fputs ("\
+    -h        display this help and exit\n\
+    -v        display version information and exit\n\
+    --isa=ISA use the kernels for instruction set ISA: generic, sse4.2,\n\
+              avx2, avx512 or auto (the default, the best this CPU has)\n\
+    --ld-window=N     pair sites for ZnS and omega only when at most N\n\
+                      segregating sites apart (default: all pairs)\n\
+    --ld-max-pairs=N  narrow the window so at most N pairs are used\n\
+    --threads=N       share the pairs of sites (ZnS, omega) or of samples\n\
+                      (-m, -V, -r) of a replicate between N threads\n\
+    --cache=N         hand back the statistics of any of the last N distinct\n\
+                      replicates that comes again instead of working them\n\
+                      out afresh (default 64; 0 for none)\n\
+    --window W        give the statistics in windows W wide along the locus,\n\
+                      using the ms positions (0 < W <= 1); windows give\n\
+                      pi, ss, D, thetaH, H, thetaW, the haplotype counts\n\
+                      and H1, H12 and H2H1\n\
+    --step D          start a window every D (default: W, windows abut);\n\
+                      if W and D do not tile the locus, the last window\n\
+                      is moved back to end at 1\n\
+    --pops=N1,N2,...  the samples come from populations of N1, N2, ...\n\
+                      (default: the sizes after -I on the ms command line)\n\
+    --subsample=N1,N2,...  give the statistics for subsamples of N1, N2, ...\n\
+                      samples instead, each on its own line, counting the\n\
+                      sites segregating in the subsample; subsamples give\n\
+                      pi, ss, D, thetaH, H, thetaW, nss, the sfs and the\n\
+                      Fu & Li, normalised H and E tests\n\
+    --subsample-seed=S  draw each subsample at random in every replicate,\n\
+                      seeded with S (default: the first N samples)\n\
+    --profile         print the time spent reading, computing and printing,\n\
+                      and in each part of the computation, to stderr at exit\n\
+    --counters        --profile, with the cycles, instructions, cache misses\n\
+                      and branch misses of each part, by replicate size\n\
+                      (Linux perf events; timing only where there are none)\n\
+    --progress=SECS   every SECS seconds, report to stderr the replicates\n\
+                      done, the input read, the throughput, the time left\n\
+                      and the p50, p99 and longest time per replicate;\n\
+                      the latency histogram follows the report at exit\n\
+    --status-file=FILE  write the reports, with the histogram, to FILE\n\
+                      instead, replacing it each time (every 10 seconds\n\
+                      unless --progress says otherwise)\n\
+    --jobs=N          with input files, work them out on N threads (default:\n\
+                      one per processor)\n\
+    --suffix=S        with input files, write the statistics of each to a\n\
+                      file of the same name plus S (default .stats)\n\
+    --vcf             read phased VCF on stdin instead of ms output, a\n\
+                      window of the chromosome at a time; each line ends\n\
+                      with the chromosome and the window, REF is taken as\n\
+                      ancestral and --pops sizes count haplotypes\n\
+    --vcf-window=BP   the windows, in bases (default 100000; 0 for one\n\
+                      per chromosome); implies --vcf\n", stdout);
+
+  puts ("");
+  fputs ("\
+  Use these options to calculate:\n\
+    -p        pi:     nucleotide diversity\n\
+    -S        ss:     number of segregating sites\n\
+    -F        thetaH: Fay's H\n\
+    -d        H:      difference between pi and Fay's H\n\
+    -W        thetaW: Watterson's theta\n\
+    -D        D:      Tajima's D\n\
+    -H        ho:     Homozygosity\n\
+    -n        nh:     number of haplotypes\n\
+    -s        ns:     number of singletons\n\
+    -N        nss:    number of singleton sites\n\
+    -f        hf:     mean haplotype frequency\n\
+    -i        ih:     max number identical haplotypes\n\
+    -R        R2:     Ramos-Onsins & Rozas' R2\n\
+    -U        Fs:     Fu's Fs\n\
+    -l        FuLiD:  Fu & Li's D\n\
+    -L        FuLiF:  Fu & Li's F\n\
+    -k        FuLiDstar: Fu & Li's D*\n\
+    -K        FuLiFstar: Fu & Li's F*\n\
+    -z        Hnorm:  Fay & Wu's H normalised by its variance\n\
+    -E        E:      Zeng et al's E\n\
+    -Z        ZnS:    Kelly's ZnS (mean r^2 over pairs of sites)\n\
+    -o        omega_max: Kim & Nielsen's omega, maximised over split points\n\
+    -I        iHS:    largest |iHS| (Voight et al), standardised within the\n\
+                      replicate in derived allele frequency bins\n\
+    -J        nSL:    largest |nSL| (Ferrer-Admetlla et al), standardised\n\
+                      the same way\n\
+    -G        H1, H12, H2H1: Garud et al's haplotype homozygosity statistics\n\
+    -X        sfs:    unfolded site frequency spectrum (nsam-1 counts)\n\
+    -Y        hfs:    haplotype frequency spectrum (haplotype counts, largest\n\
+                      first)\n\
+    -m        mismatch: mismatch distribution (pairs of samples differing at\n\
+                      0, 1, 2 ... sites)\n\
+    -V        mismatch_var: variance of the mismatch distribution\n\
+    -r        raggedness: Harpending's raggedness index\n\
+    -P        pi_1, ss_1, D_1, ...: pi, segregating sites and Tajima's D\n\
+                      within each population\n\
+    -B        dxy_1_2, Fst_1_2, ...: divergence and Hudson's Fst between\n\
+                      each pair of populations\n\
+    -Q        Snn:    Hudson's nearest neighbour statistic\n", stdout);
+
+  puts ("");
+  fputs ("\
+Calculate summary statistics from 'ms' output. With no options specified,\n\
+the core set calculated by Hudson's original 'sample_stats' program will be\n\
+written to the screen.  This original set is: pi, ss, D, thetaH, H\n\
+\n\
+This modified version of Hudson's original program has been optimized to\n\
+calculate this original set about 40% faster.  In addition, it implements\n\
+methods to calculate 4 more statistics: thetaW, ho, nh, and ns.\n\
+\n\
+Given FILEs (or patterns such as 'runs/*.ms', expanded here), work out\n\
+each of them instead of stdin, sharing the replicates of all of them out\n\
+between the threads; the options come before the files.\n\
+\n\
+Examples:\n\
+      ms 10 1 -t 5 | sample_stats2\n\
+      ms 10 1 -t 5 | sample_stats2 -SW\n\
+      ms 10 1 -t 5 | sample_stats2 -pSFdWDHns\n\
+      sample_stats2 -pSD --jobs=8 'runs/*.ms'\n\
+      sample_stats2 -pSDG --vcf-window=50000 < phased.vcf", stdout);
+  printf ("\n");
+}
+
+/* Print version and copyright information.  */
+static void print_version (void) {
+  printf ("(%s) version %s\n", PACKAGE, VERSION);
+  printf ("kernels: %s\n", ss_get_isa());
+}
+
+/*  The value of a long option, given either as "--name=VALUE" or as
+ *    "--name VALUE"; for the second, optind is moved past the value
+ *
+ *      opt         - the option, as simple_getopt left it in optarg
+ *      name        - the option being looked for, starting with "--"
+ *      argc, argv  - the command line
+ *
+ *  Returns the value, or NULL if <opt> is not <name>; exits if the value
+ *    is missing
+ */
+static const char *option_value(const char *opt, const char *name, int argc, char *argv[]) {
+    size_t  len;                /* length of the name */
+
+    len = strlen(name);
+    if (strncmp(opt, name, len) != 0)
+        return NULL;
+    if (opt[len] == '=')
+        return opt + len + 1;
+    if (opt[len] != '\0')
+        return NULL;
+    if (optind >= argc) {
+        fprintf (stderr, "Option `%s' needs a value.\n", name);
+        exit (EXIT_FAILURE);
+    }
+    return argv[optind++];
+}
 
-    /* run through the list and attempt to expand the size of each 
-     * positions array */
-    for( i=0; i<nsam; i++) {
-        list[i] = (char *)realloc( list[i],maxsites*sizeof(char) ) ;
-        if( list[i] == NULL ) {
-            perror( "realloc error. bigger");
+/*  Add the time since <t0> to a phase of the replicate loop, when
+ *    profiling
+ *
+ *      phase       - the phase (PROF_*), or -1 to only read the clock
+ *      t0          - when the phase started
+ *
+ *  Returns the time now, to start the next phase from (0 if not profiling)
+ */
+static double lap(int phase, double t0) {
+    double  t;                  /* the time now */
+    unsigned long long now[PERF_COUNTERS];
+                                /* and the event counts */
+    int     k;                  /* iterator */
+
+    if (!profiling)
+        return 0.0;
+    t = ss_clock();
+    if (phase >= 0) {
+        prof_seconds[phase] += t - t0;
+        prof_calls[phase]++;
+    }
+    if (counting) {
+        perf_read(&perf, now);
+        if (phase >= 0) {
+            for (k=0; k<PERF_COUNTERS; k++)
+                prof_events[prof_bucket][phase][k] += now[k] - perf_last[k];
+            prof_bucket_calls[prof_bucket][phase]++;
         }
+        memcpy(perf_last, now, sizeof(now));
     }
-}                        
+    return t;
+}
 
-/*  Calculate pi (nucleotide diversity)
+/*  Print a row of the hardware event table: the events per call of one
+ *    phase in one size bucket
  *
- *      nsam            - total number of samples
- *      segsites        - total number of segregating sites 
- *                        ( length of data in site_freqs array )
- *      site_freqs      - array with counts of '1' per site 
+ *      name        - the phase
+ *      nested      - 1 for the library's phases, within compute
+ *      bucket      - the size bucket
+ *      calls       - calls in it
+ *      events      - the events they took (PERF_COUNTERS of them)
  *
- *  Returns a double 
+ *  Returns nothing
  */
-double theta_pi( int nsam, int segsites, int *site_freqs) {
-    int     s;                  /* iterator */
-    double  pi,                 /* what we are calculating */
-            p1,                 /* site frequency of derived allele */
-            nd,                 /* nsam cast to double value */
-            nnm1;               /* (N / (N Minus 1)) */
+static void print_events(const char *name, int nested, int bucket, long calls,
+                         const unsigned long long *events) {
+    static const char *sizes[SS_PROF_BUCKETS] = { "<100", "<1000", "<10000", ">=10000" };
+
+    fprintf(stderr, "%s%-*s %8s %10ld %14.0f %14.0f %6.2f %12.1f %12.1f\n", nested ? "  " : "",
+            nested ? 20 : 22, name, sizes[bucket], calls, (double)events[PERF_CYCLES]/calls,
+            (double)events[PERF_INSTRUCTIONS]/calls,
+            events[PERF_CYCLES] > 0
+                ? (double)events[PERF_INSTRUCTIONS]/events[PERF_CYCLES] : 0.0,
+            (double)events[PERF_CACHE_MISSES]/calls, (double)events[PERF_BRANCH_MISSES]/calls);
+}
 
-    pi = 0.0 ;
+/*  Print the time spent in each phase to stderr; registered with atexit()
+ *    so that it comes out however the replicate loop ends
+ *
+ *  Returns nothing
+ */
+static void print_profile(void) {
+    static const char *names[PROF_LOOP] = { "parse", "compute", "output" };
+    int     i, b;               /* iterators */
+    double  total;              /* wall time since the start */
+
+    total = ss_clock() - prof_begin;
+    if (total <= 0.0)
+        total = 1e-9;
+    fprintf(stderr, "%-22s %10s %12s %12s %7s\n", "phase", "calls", "seconds", "us/call",
+            "share");
+    for (i=0; i<PROF_LOOP; i++)
+        fprintf(stderr, "%-22s %10ld %12.6f %12.3f %6.1f%%\n", names[i], prof_calls[i],
+                prof_seconds[i], prof_calls[i] ? prof_seconds[i]/prof_calls[i]*1e6 : 0.0,
+                100.0*prof_seconds[i]/total);
+    /* the library's phases, all within compute */
+    for (i=0; i<SS_PROF_PHASES; i++)
+        if (lib_profile.calls[i] > 0)
+            fprintf(stderr, "  %-20s %10ld %12.6f %12.3f %6.1f%%\n", ss_profile_name(i),
+                    lib_profile.calls[i], lib_profile.seconds[i],
+                    lib_profile.seconds[i]/lib_profile.calls[i]*1e6,
+                    100.0*lib_profile.seconds[i]/total);
+    if (cache_entries > 0)
+        fprintf(stderr, "  %-20s %10ld of %ld replicates\n", "cache hits", cache_hits,
+                cache_hits + cache_misses);
+    fprintf(stderr, "%-22s %10s %12.6f %12s %6.1f%%\n", "total", "", total, "", 100.0);
+
+    /* the hardware events, per call, by replicate size */
+    if (!counting)
+        return;
+    fprintf(stderr, "\n%-22s %8s %10s %14s %14s %6s %12s %12s\n", "phase", "sites", "calls",
+            "cycles", "instructions", "IPC", "cache-misses", "branch-misses");
+    for (i=0; i<PROF_LOOP; i++)
+        for (b=0; b<SS_PROF_BUCKETS; b++)
+            if (prof_bucket_calls[b][i] > 0)
+                print_events(names[i], 0, b, prof_bucket_calls[b][i], prof_events[b][i]);
+    if (lib_profile.counters)
+        for (i=0; i<SS_PROF_PHASES; i++)
+            for (b=0; b<SS_PROF_BUCKETS; b++)
+                if (lib_profile.bucket_calls[b][i] > 0)
+                    print_events(ss_profile_name(i), 1, b, lib_profile.bucket_calls[b][i],
+                                 lib_profile.events[b][i]);
+}
+
+/*  Write a length of time the way a person would read it
+ *
+ *      seconds     - the time
+ *      buf         - room for 32 chars
+ *
+ *  Returns buf
+ */
+static const char *span(double seconds, char *buf) {
+    long    whole;              /* whole seconds, for the long ones */
+
+    if (seconds < 1e-3)
+        sprintf(buf, "%.1fus", seconds*1e6);
+    else if (seconds < 1.0)
+        sprintf(buf, "%.2fms", seconds*1e3);
+    else if (seconds < 60.0)
+        sprintf(buf, "%.2fs", seconds);
+    else {
+        whole = (long)seconds;
+        sprintf(buf, "%ldh%02ldm%02lds", whole/3600, whole/60 % 60, whole % 60);
+    }
+    return buf;
+}
 
-    /* create a double with the value of nsam */
-    nd = nsam;
+/*  Write a progress report: the replicates done, the input read, the
+ *    throughput, the time left and the latency percentiles on one line,
+ *    then with <histogram> the latency histogram
+ *
+ *      out         - where to write it
+ *      now         - the time now
+ *      histogram   - 1 to add the histogram
+ *
+ *  Returns nothing
+ */
+static void write_progress(FILE *out, double now, int histogram) {
+    double  elapsed,            /* time since the first replicate started */
+            rate;               /* replicates per second */
+    long long bytes;            /* input read */
+    int     k;                  /* iterator */
+    char    b1[32], b2[32], b3[32], b4[32];
+                                /* the times, written out */
+
+    elapsed = now - progress_begin;
+    rate = elapsed > 0.0 ? reps_done/elapsed : 0.0;
+    bytes = prefetch_consumed(progress_input);
+    fprintf(out, "progress: %lld/%d replicates (%.1f%%), %.1f MB read, %.1f replicates/s"
+            " (%.2f MB/s), ", reps_done, reps_total,
+            reps_total > 0 ? 100.0*reps_done/reps_total : 0.0, bytes/1e6, rate,
+            elapsed > 0.0 ? bytes/1e6/elapsed : 0.0);
+    if (reps_done < reps_total && rate > 0.0)
+        fprintf(out, "ETA %s", span((reps_total - reps_done)/rate, b1));
+    else
+        fprintf(out, "elapsed %s", span(elapsed, b1));
+    fprintf(out, ", latency p50 %s p99 %s max %s\n", span(latency_quantile(&latencies, 0.5), b2),
+            span(latency_quantile(&latencies, 0.99), b3), span(latencies.max, b4));
+    if (histogram)
+        for (k=0; k<LATENCY_BUCKETS; k++)
+            if (latencies.count[k] > 0)
+                fprintf(out, "  latency %s %-10s %12lld\n", k < LATENCY_BUCKETS - 1 ? "< " : ">=",
+                        span(latency_bucket_top(k < LATENCY_BUCKETS - 1 ? k : k - 1), b1),
+                        latencies.count[k]);
+    fflush(out);
+}
 
-    nnm1 = nd/(nd-1.0);
+/*  Report progress to stderr, or rewrite the status file, replacing it
+ *    in one step so that readers never see half a report
+ *
+ *      now         - the time now
+ *      final       - 1 for the report at exit
+ *
+ *  Returns nothing
+ */
+static void report_progress(double now, int final) {
+    FILE    *out;               /* the status file, as it is written */
+    char    tmp[4096];          /* its name until it is complete */
 
-    for( s = 0; s < segsites; s++) {
-        /* calculate site frequency of '1' */
-        p1 = site_freqs[s]/nd ;
-        /* sum up the per site average distances */
-        pi += 2.0*p1*(1.0 -p1)*nnm1 ;
+    if (status_file == NULL) {
+        write_progress(stderr, now, final);
+        return;
     }
-    
-    return( pi ) ;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", status_file);
+    if ((out = fopen(tmp, "w")) == NULL) {
+        perror(tmp);
+        return;
+    }
+    write_progress(out, now, 1);
+    if (final)
+        fprintf(out, "done\n");
+    fclose(out);
+    if (rename(tmp, status_file) != 0)
+        perror(status_file);
 }
 
-/*  Calculates Fay's theta_H
+/*  Note that a replicate is done (or, at the top of the loop, that the
+ *    one before it is), timing it from the previous call, and report if
+ *    a report is due
  *
- *      nsam            - total number of samples in data list
- *      segsites        - total number of segregating sites 
- *      site_freqs      - array with counts of '1' per site 
+ *      start       - 1 if another replicate starts now
  *
- *  Returns a double with the calculated value
+ *  Returns nothing
  */
-double theta_h(int nsam, int segsites, int *site_freqs) 
-{
-    int     s;                  /* iterator */
-    double  pi,                 /* what we are calculating */
-            p1,                 /* site count of derived allele */
-            nd,                 /* nsam cast to double value */
-            nnm1;               /* (N / (N Minus 1)) */
+static void replicate_done(int start) {
+    double  t;                  /* the time now */
 
-    pi = 0.0 ;
+    t = ss_clock();
+    if (rep_begin > 0.0) {
+        latency_add(&latencies, t - rep_begin);
+        reps_done++;
+    }
+    rep_begin = start ? t : 0.0;
+    if (t >= progress_next) {
+        report_progress(t, 0);
+        progress_next = t + progress_every;
+    }
+}
 
-    /* create a double with the value of nsam */
-    nd = nsam;
+/*  The report at exit; registered with atexit()
+ *
+ *  Returns nothing
+ */
+static void final_progress(void) {
+    report_progress(ss_clock(), 1);
+}
 
-    nnm1 = nd/(nd-1.0) ;
-    
-    for (s = 0; s<segsites; s++) {
-        p1 = site_freqs[s];
-        pi += p1*p1; 
+/*  Read a list of sizes such as "10,20,5"
+ *
+ *      list        - the sizes, separated by commas or spaces
+ *      sizes       - where to put them
+ *      max         - room in sizes
+ *
+ *  Returns the number of sizes, or -1 if the list is no good
+ */
+static int parse_sizes(const char *list, int *sizes, int max) {
+    char    copy[1001],         /* a copy for strtok to cut up */
+            *tok;               /* one size */
+    int     n;                  /* number of sizes */
+
+    strncpy(copy, list, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+    n = 0;
+    for (tok = strtok(copy, ", \t\n"); tok != NULL; tok = strtok(NULL, ", \t\n")) {
+        if (n == max || (sizes[n++] = atoi(tok)) < 1)
+            return -1;
     }
-    
-    return pi*2.0/(nd*(nd-1.0));
+    return n > 0 ? n : -1;
+}
+
+/*  Find the population sizes on the ms command line, which has them as
+ *    "-I npop n1 n2 ... [4Nm]"
+ *
+ *      line        - the first line of the ms output
+ *      sizes       - where to put them (room for SS_MAXPOPS)
+ *
+ *  Returns the number of populations, or 0 if there is no -I
+ */
+static int ms_populations(const char *line, int *sizes) {
+    char    copy[1001],         /* a copy for strtok to cut up */
+            *tok;               /* one word of the command line */
+    int     n,                  /* number of populations */
+            i;                  /* iterator */
+
+    strncpy(copy, line, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+    for (tok = strtok(copy, " \t\n"); tok != NULL; tok = strtok(NULL, " \t\n")) {
+        if (strcmp(tok, "-I") != 0)
+            continue;
+        if ((tok = strtok(NULL, " \t\n")) == NULL || (n = atoi(tok)) < 1 || n > SS_MAXPOPS)
+            return 0;
+        for (i=0; i<n; i++) {
+            if ((tok = strtok(NULL, " \t\n")) == NULL)
+                return 0;
+            sizes[i] = atoi(tok);
+        }
+        return n;
+    }
+    return 0;
 }
 
-/*  Calculates Watterson's theta
+/*  Handle a long option. simple_getopt stops at these and leaves
+ *    them in optarg.
  *
- *      nsam            - total number of samples in data list
- *      segsites        - total number of segregating sites 
- *                        ( length of positions array )
- *      site_freqs      - array with counts of '1' per site 
+ *      opt         - the option, starting with "--"
+ *      argc, argv  - the command line, for values given as separate words
  *
- *  Returns a double with the calculated value
+ *  Returns nothing; exits if the option is not understood
  */
-double theta_w( int nsam, int segsites, int *site_freqs) {
-    int     s;                  /* iterator */
-    double  pi,                 /* what we are calculating */
-            denom;              /* denominator of Watterson's theta */
+static void long_option(const char *opt, int argc, char *argv[]) {
+    const char *value;          /* the option's value */
+
+    if (strcmp(opt, "--profile") == 0) {
+        profiling = 1;
+        return;
+    }
+    if (strcmp(opt, "--counters") == 0) {
+        profiling = counting = 1;
+        return;
+    }
+    if ((value = option_value(opt, "--progress", argc, argv)) != NULL) {
+        if ((progress_every = atof(value)) <= 0.0) {
+            fprintf (stderr, "Bad --progress value `%s'.\n", value);
+            exit (EXIT_FAILURE);
+        }
+        return;
+    }
+    if ((value = option_value(opt, "--status-file", argc, argv)) != NULL) {
+        status_file = value;
+        return;
+    }
+    if ((value = option_value(opt, "--isa", argc, argv)) != NULL) {
+        if (ss_set_isa(value) != SS_OK) {
+            fprintf (stderr, "Unknown or unsupported instruction set `%s'.\n", value);
+            exit (EXIT_FAILURE);
+        }
+        return;
+    }
+    if ((value = option_value(opt, "--ld-window", argc, argv)) != NULL) {
+        ld_window = atoi(value);
+        return;
+    }
+    if ((value = option_value(opt, "--ld-max-pairs", argc, argv)) != NULL) {
+        ld_max_pairs = atol(value);
+        return;
+    }
+    if ((value = option_value(opt, "--cache", argc, argv)) != NULL) {
+        if ((cache_entries = atoi(value)) < 0) {
+            fprintf (stderr, "Bad --cache value `%s'.\n", value);
+            exit (EXIT_FAILURE);
+        }
+        return;
+    }
+    if ((value = option_value(opt, "--threads", argc, argv)) != NULL) {
+        ld_threads = atoi(value);
+        return;
+    }
+    if ((value = option_value(opt, "--window", argc, argv)) != NULL) {
+        win_width = atof(value);
+        return;
+    }
+    if ((value = option_value(opt, "--step", argc, argv)) != NULL) {
+        win_step = atof(value);
+        return;
+    }
+    if ((value = option_value(opt, "--pops", argc, argv)) != NULL) {
+        if ((npops = parse_sizes(value, pop_sizes, SS_MAXPOPS)) < 0) {
+            fprintf (stderr, "Bad --pops value `%s'.\n", value);
+            exit (EXIT_FAILURE);
+        }
+        return;
+    }
+    if ((value = option_value(opt, "--jobs", argc, argv)) != NULL) {
+        if ((jobs = atoi(value)) < 1) {
+            fprintf (stderr, "Bad --jobs value `%s'.\n", value);
+            exit (EXIT_FAILURE);
+        }
+        return;
+    }
+    if (strcmp(opt, "--vcf") == 0) {
+        vcf_input = 1;
+        return;
+    }
+    if ((value = option_value(opt, "--vcf-window", argc, argv)) != NULL) {
+        if ((vcf_width = atol(value)) < 0) {
+            fprintf (stderr, "Bad --vcf-window value `%s'.\n", value);
+            exit (EXIT_FAILURE);
+        }
+        vcf_input = 1;
+        return;
+    }
+    if ((value = option_value(opt, "--suffix", argc, argv)) != NULL) {
+        out_suffix = value;
+        return;
+    }
+    if ((value = option_value(opt, "--subsample-seed", argc, argv)) != NULL) {
+        sub_seed = strtoul(value, NULL, 10);
+        return;
+    }
+    if ((value = option_value(opt, "--subsample", argc, argv)) != NULL) {
+        if ((nsubs = parse_sizes(value, sub_sizes, MAXSUBSAMPLES)) < 0) {
+            fprintf (stderr, "Bad --subsample value `%s'.\n", value);
+            exit (EXIT_FAILURE);
+        }
+        return;
+    }
+
+    fprintf (stderr, "Unknown option `%s'.\nTry '%s -h' for help\n", opt, program_name);
+    exit (EXIT_FAILURE);
+}
 
-    pi = 0.0 ;
+/*  Print the statistics asked for, tab-delimited, in the order
+ *    sample_stats2 has always used
+ *
+ *      out         - where to print them
+ *      stats       - the statistics to print
+ *      res         - their values
+ *      probflag    - 1 if the replicate came with a "prob:" line
+ *      prob        - the value on it
+ *
+ *  Returns nothing
+ */
+static void print_results(FILE *out, unsigned stats, const struct ss_results *res,
+                          int probflag, double prob) {
+    int     i;                  /* iterator */
 
-    denom = 0.0;
-    for (s=1; s < nsam; s++) {
-        denom += 1.0/s;
+    if ( stats & SS_PI )
+        fprintf(out, "pi:\t%lf\t", res->pi);
+    if ( stats & SS_SS )
+        fprintf(out, "ss:\t%d\t", res->ss);
+    if ( stats & SS_D )
+        fprintf(out, "D:\t%lf\t", res->D);
+    if ( stats & SS_THETAH )
+        fprintf(out, "thetaH:\t%lf\t", res->thetaH);
+    if ( stats & SS_H )
+        fprintf(out, "H:\t%lf\t", res->H);
+    if ( stats & SS_THETAW )
+        fprintf(out, "thetaW:\t%lf\t", res->thetaW);
+    if ( stats & SS_NH )
+        fprintf(out, "num_haplotypes:\t%d\t", res->nh);
+    if ( stats & SS_NS )
+        fprintf(out, "num_singletons:\t%d\t", res->ns);
+    if ( stats & SS_HO )
+        fprintf(out, "homozygosity:\t%lf\t", res->ho);
+    if ( probflag )
+        fprintf(out, "prob:\t%g\t", prob);
+    if ( stats & SS_NSS )
+        fprintf(out, "nss:\t%d\t", res->nss);
+    if ( stats & SS_HF )
+        fprintf(out, "hf:\t%lf\t", res->hf);
+    if ( stats & SS_IH )
+        fprintf(out, "ih:\t%d\t", res->ih);
+    if ( stats & SS_R2 )
+        fprintf(out, "r2:\t%lf\t", res->r2);
+    if ( stats & SS_FS )
+        fprintf(out, "Fs:\t%lf\t", res->fs);
+    if ( stats & SS_FULID )
+        fprintf(out, "FuLiD:\t%lf\t", res->fuliD);
+    if ( stats & SS_FULIF )
+        fprintf(out, "FuLiF:\t%lf\t", res->fuliF);
+    if ( stats & SS_FULIDS )
+        fprintf(out, "FuLiDstar:\t%lf\t", res->fuliDs);
+    if ( stats & SS_FULIFS )
+        fprintf(out, "FuLiFstar:\t%lf\t", res->fuliFs);
+    if ( stats & SS_HNORM )
+        fprintf(out, "Hnorm:\t%lf\t", res->Hn);
+    if ( stats & SS_ZENGE )
+        fprintf(out, "E:\t%lf\t", res->E);
+    if ( stats & SS_ZNS )
+        fprintf(out, "ZnS:\t%lf\t", res->zns);
+    if ( stats & SS_OMEGA )
+        fprintf(out, "omega_max:\t%lf\t", res->omega);
+    if ( stats & SS_IHS )
+        fprintf(out, "iHS:\t%lf\t", res->ihs);
+    if ( stats & SS_NSL )
+        fprintf(out, "nSL:\t%lf\t", res->nsl);
+    if ( stats & SS_H1 )
+        fprintf(out, "H1:\t%lf\t", res->h1);
+    if ( stats & SS_H12 )
+        fprintf(out, "H12:\t%lf\t", res->h12);
+    if ( stats & SS_H2H1 )
+        fprintf(out, "H2H1:\t%lf\t", res->h2h1);
+    if ( stats & SS_MMVAR )
+        fprintf(out, "mismatch_var:\t%lf\t", res->mmvar);
+    if ( stats & SS_RAGGED )
+        fprintf(out, "raggedness:\t%lf\t", res->ragged);
+    if ( stats & SS_SFS ) {
+        fprintf(out, "sfs:\t");
+        for ( i=0; i<res->sfs_len; i++ )
+            fprintf(out, i ? ",%d" : "%d", res->sfs[i]);
+        fprintf(out, "\t");
+    }
+    if ( stats & SS_HFS ) {
+        fprintf(out, "hfs:\t");
+        for ( i=0; i<res->hfs_len; i++ )
+            fprintf(out, i ? ",%d" : "%d", res->hfs[i]);
+        fprintf(out, "\t");
+    }
+    if ( stats & SS_MISMATCH ) {
+        fprintf(out, "mismatch:\t");
+        for ( i=0; i<res->mismatch_len; i++ )
+            fprintf(out, i ? ",%ld" : "%ld", res->mismatch[i]);
+        fprintf(out, "\t");
     }
+}
 
-    for( s = 0; s <segsites; s++) {
-        pi += 1.0/denom; 
+/*  Draw each subsample afresh, as samples taken without replacement, from
+ *    a generator seeded by --subsample-seed
+ *
+ *      nsam        - number of samples
+ *      order       - scratch for a shuffle of the samples (length nsam)
+ *      samples     - where to put the subsamples, one after the other
+ *
+ *  Returns nothing
+ */
+static void draw_subsamples(int nsam, int *order, int *samples) {
+    static unsigned long long state = 0;
+                                /* the generator's state */
+    int     s, i, j,            /* iterators */
+            k;                  /* sample being swapped */
+
+    if (state == 0)
+        state = sub_seed;
+    for (s=0; s<nsubs; s++) {
+        for (i=0; i<nsam; i++)
+            order[i] = i;
+        /* the first sub_sizes[s] places of a Fisher-Yates shuffle */
+        for (i=0; i<sub_sizes[s]; i++) {
+            state = state*6364136223846793005ULL + 1442695040888963407ULL;
+            j = i + (int)((state >> 33) % (unsigned long long)(nsam - i));
+            k = order[i];
+            order[i] = order[j];
+            order[j] = k;
+            *samples++ = order[i];
+        }
     }
-    
-    return( pi ) ;
 }
 
-/*  Count up the haplotype frequencies in the data
+/*  Print the population statistics asked for, after the others
+ *
+ *      out         - where to print them
+ *      stats       - the statistics to print (SS_POP_PI | ...)
+ *      res         - their values
+ *
+ *  Returns nothing
+ */
+static void print_pop_results(FILE *out, unsigned stats, const struct ss_pop_results *res) {
+    int     p, q;               /* iterators */
+
+    for ( p=0; p<res->npop; p++ ) {
+        if ( stats & SS_POP_PI )
+            fprintf(out, "pi_%d:\t%lf\t", p + 1, res->pi[p]);
+        if ( stats & SS_POP_SS )
+            fprintf(out, "ss_%d:\t%d\t", p + 1, res->ss[p]);
+        if ( stats & SS_POP_D )
+            fprintf(out, "D_%d:\t%lf\t", p + 1, res->D[p]);
+    }
+    for ( p=0; p<res->npop; p++ ) {
+        for ( q=p+1; q<res->npop; q++ ) {
+            if ( stats & SS_POP_DXY )
+                fprintf(out, "dxy_%d_%d:\t%lf\t", p + 1, q + 1, res->dxy[p][q]);
+            if ( stats & SS_POP_FST )
+                fprintf(out, "Fst_%d_%d:\t%lf\t", p + 1, q + 1, res->fst[p][q]);
+        }
+    }
+    if ( stats & SS_POP_SNN )
+        fprintf(out, "Snn:\t%lf\t", res->snn);
+}
+
+/* A replicate as read in: its data, the positions of its sites and the
+ * 'tbs' parameters of its "//" line */
+struct ms_replicate {
+    int     nsam,               /* number of samples */
+            room,               /* rows <list> has room for */
+            maxsites,           /* sites each row has room for */
+            segsites,           /* the number of sites */
+            probflag;           /* 0 or 1, whether a "prob: ##" line has been seen */
+    double  prob;               /* the value on the last one */
+    char    **list;             /* the data, samples in rows, positions in columns */
+    const unsigned char *bits;  /* or, if not NULL, the data as SS_BITS rows */
+    size_t  bits_stride;        /* bytes from one of those rows to the next */
+    double  *positions;         /* the positions of the sites, when needed */
+    char    slashline[1001];    /* 'tbs' parameters are placed tab-delimited on a
+                                 *   line beginning with "//". As the data are read in
+                                 *   the text following any line starting with "//" is
+                                 *   copied to the <slashline> and printed out following
+                                 *   the summary statistics */
+};
+
+/*  Make sure a replicate can hold a number of samples; the first time,
+ *    set it up with room for maxsites sites
  *
- *      nsam            - total number of samples in data list
- *      segsites        - total number of segregating sites 
- *                        ( length of positions array )
- *      list            - the data ( samples by positions matrix of chars )
- *      hap_freqs       - the (initialized) array of integers to fill (length nsam)
+ *      r           - the replicate (zeroed before first use)
+ *      nsam        - number of samples
+ *      need_positions - 1 if the positions line is read in
  *
- *  Returns nothing (fills in the array given)
+ *  Returns nothing
  */
-void count_haplotype_frequencies( int nsam, int segsites, char **list, int *hap_freqs ) {
-    int     i, j;               /* iterators */
+static void replicate_room(struct ms_replicate *r, int nsam, int need_positions) {
+    r->nsam = nsam;
+    if ( r->list != NULL && r->room >= nsam )
+        return;
+    if ( r->list != NULL ) {
+        free(r->list[0]);
+        free(r->list);
+    } else {
+        r->maxsites = maxsites;
+    }
+    r->room = nsam > 0 ? nsam : 1;
+    r->list = create_list(r->room, r->maxsites+1);
+    if ( need_positions && r->positions == NULL
+         && (r->positions = (double *)malloc(r->maxsites*sizeof(double))) == NULL ) {
+        perror("alloc error for the positions");
+        exit(EXIT_FAILURE);
+    }
+}
 
-    /* first initialize all haplotype counts to 0 */
-    for (i=0; i < nsam; i++) {
-        hap_freqs[i] = 0;
+/*  Free what a replicate holds
+ *
+ *      r           - the replicate
+ *
+ *  Returns nothing
+ */
+static void free_replicate(struct ms_replicate *r) {
+    if ( r->list != NULL ) {
+        free(r->list[0]);
+        free(r->list);
     }
+    free(r->positions);
+}
 
-    /* If there are no segregating sites, then there is only one haplotype.
-     * Set the haplotype count of the first haplotype to the number
-     * of samples and all the rest to -9 */
-    if ( segsites == 0 ) {
-        hap_freqs[0] = nsam;
-        for (i=1; i < nsam; i++) {
-            hap_freqs[i] = -9;
+/*  Read the next replicate of an ms output
+ *
+ *      input       - the ms output, past its first two lines
+ *      need_positions - 1 if the positions line is read in
+ *      r           - where to put the replicate (see replicate_room())
+ *      probflag    - 1 once the input has had a "prob:" line (updated)
+ *      prob        - the value on the last one (updated)
+ *
+ *  Returns 0, or -1 if the input ends first
+ */
+static int read_replicate(struct prefetch *input, int need_positions, struct ms_replicate *r,
+                          int *probflag, double *prob) {
+    int     i;                  /* iterator */
+    char    line[1001];         /* each line as it gets pulled from the input */
+    char    word[64];           /* one entry of the positions line */
+    char    *slashline;         /* the text of the "//" line */
+
+    /* initialize slashline as a simple linefeed */
+    slashline = r->slashline;
+    slashline[0] = '\n';
+
+    /* read in a sample */
+    do {
+        /* bail out if there's no data */
+        if( prefetch_gets( line, 1000, input) == NULL ) {
+            return -1;
         }
-    } else {
-        /* step through the data list, comparing each haplotype
-         * to all those following it */
-        for (i=0; i < nsam; i++) {
-            /* if a haplotype has not been seen, it's count in the 
-             * hap_freqs array will be 0 */
-            if (hap_freqs[i] == 0) {
-                /* we automatically have one of this haplotype */
-                hap_freqs[i] = 1;
-                /* compare the current haplotype to all following in the list */
-                for (j=i+1; j < nsam; j++) {
-                    if (! strcmp(list[i], list[j])) {
-                        /* if we have a match, up the current haplotype's count
-                         * and set the count of the matching position to -9 so
-                         * we know we've already counted it */
-                        hap_freqs[i] += 1;
-                        hap_freqs[j] = -9;
-                    }
-                }
+        /* if this is the "//" line, then push the data into <slashline> */
+        if( line[0] == '/' ) {
+            /* but if there is no data on the line
+             * just put a linefeed into slashline */
+            if( line[2] == '\n' ) {
+                slashline[0] == '\n';
+            } else {
+                strcpy(slashline,line+3);
+            }
+        }
+        /* otherwise, just read and throw away lines until we get to either a
+         * "segsites: <...> " or a "prob: <...> " line */
+    } while ( (line[0] != 's') && (line[0] != 'p' ) ) ;
+
+    /* if we've hit the prob line, read it in. this line will only be present 
+     * if both the "-s" and "-t" flags were used to generate the data in ms
+     * (note that the ms documentation says that this will come after the
+     *  "segsites: <...>" line, but in actuality it comes before).*/
+    if( line[0] == 'p') {
+        sscanf( line, "  prob: %lf", prob );
+        *probflag = 1 ;
+        /* bail out if the input ends */
+        if( prefetch_gets( line, 1000, input) == NULL ) {
+            return -1;
+        }
+    }
+    r->probflag = *probflag;
+    r->prob = *prob;
+
+    /* read in the number of segregating sites for this replicate */
+    sscanf( line, "  segsites: %d", &r->segsites );
+
+    /* increase the replicate's maxsites if it has more sites than we are
+     * currently prepared to deal with.  Also increase the size of the data
+     * list to accomodate the larger amount of data about to be read in. */
+    if( r->segsites >= r->maxsites){
+        r->maxsites = r->segsites + 10;
+        biggerlist(r->room, r->maxsites, r->list) ;
+        if ( need_positions && (r->positions = (double *)realloc(r->positions,
+                                        r->maxsites*sizeof(double))) == NULL ) {
+            perror("realloc error. couldn't make the positions bigger");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* if this replicate has any segregating sites... */
+    if( r->segsites > 0) {
+        /* There is a line following segsites that looks like:
+         *   positions: #.#### #.#### #.####
+         * with as many numeric entries as there are segregating sites.
+         * 
+         * Only the windows and iHS use these data; otherwise we want to pull
+         * this line off and discard it, however long it is. */
+        if ( need_positions ) {
+            prefetch_word(word, sizeof(word), input);
+            for( i=0; i<r->segsites; i++) {
+                prefetch_word(word, sizeof(word), input);
+                r->positions[i] = atof(word);
             }
+        } else {
+            prefetch_skip_line(input);
         }
+
+        /* now pull off each line of data (each sample) into list */
+        for( i=0; i<r->nsam;i++) prefetch_word(r->list[i], r->maxsites+1, input);
     }
+    return 0;
 }
 
-/*  Count the total number of haplotypes
+/*  Check the subsamples and populations asked for against the samples of
+ *    an ms output; exits if they do not fit
  *
- *      nsam            - total number of samples in data list
- *      hap_freqs       - an array with counts per haplotype
- *                         (each entry corresponds to a row in the
- *                          original data; all entries should have 
- *                          an integer value; a value of -9 indicates 
- *                          that the entry at that row has already been
- *                          counted)
+ *      name        - the input file, or NULL for stdin
+ *      nsam        - number of samples
+ *      line        - the first line of the ms output
+ *      npop        - number of populations, from --pops or else found
+ *                    here (updated)
+ *      sizes       - their sizes (room for SS_MAXPOPS)
  *
- *  Returns an integer
+ *  Returns nothing
  */
-int num_haplotypes(int nsam, int* hap_freqs) {
+static void check_samples(const char *name, int nsam, const char *line, int *npop,
+                          int *sizes) {
     int     i,                  /* iterator */
-            count;              /* running total */
+            count;              /* samples in all the populations */
+
+    /* subsamples give a line each, so neither windows nor the population
+     * statistics go with them */
+    if ( nsubs > 0 ) {
+        for ( i=0; i<nsubs; i++ ) {
+            if ( sub_sizes[i] < 2 || sub_sizes[i] > nsam ) {
+                if ( name != NULL )
+                    fprintf(stderr, "%s: ", name);
+                fprintf(stderr, "Subsamples must have 2 to %d samples.\n", nsam);
+                exit(EXIT_FAILURE);
+            }
+        }
+        if ( pop_stats != 0 || win_width != 0.0 || win_step != 0.0 ) {
+            fprintf(stderr, "--subsample does not go with --window, -P, -B or -Q.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    count = 0;
+    /* the populations are given by --pops, or else by ms's -I */
+    if ( pop_stats != 0 ) {
+        if ( *npop == 0 )
+            *npop = ms_populations(line, sizes);
+        for ( i=0, count=0; i<*npop; i++ )
+            count += sizes[i];
+        if ( *npop == 0 || count != nsam ) {
+            if ( name != NULL )
+                fprintf(stderr, "%s: ", name);
+            fprintf(stderr, "-P, -B and -Q need populations adding up to %d samples"
+                    " (--pops or ms -I).\n", nsam);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
 
-    for (i=0; i < nsam; i++) {
-        if ( hap_freqs[i] > 0 ) {
-            count++;
+/* What a thread needs to work out the statistics of replicates: its
+ * scratch space, and room for the results */
+struct compute_state {
+    struct ss_workspace *ws;    /* scratch space reused across replicates */
+    struct ss_results res;      /* the statistics calculated for a replicate */
+    struct ss_pop_results pres; /* and those of its populations */
+    struct ss_results *subres;  /* and of its subsamples */
+    int     *subsamples,        /* the samples of each, when drawn at random */
+            *order;             /* scratch for drawing them */
+    struct ss_window *windows;  /* the statistics of each window */
+    int     maxsam,             /* samples the spectra have room for */
+            maxsites;           /* sites the mismatch distribution has room for */
+};
+
+/*  Make sure the results have room for a replicate
+ *
+ *      s           - the state
+ *      nsam        - number of samples
+ *      nsites      - most sites
+ *
+ *  Returns nothing
+ */
+static void state_room(struct compute_state *s, int nsam, int nsites) {
+    int     i;                  /* iterator */
+
+    if ( nsam < 1 )
+        nsam = 1;
+    if ( nsam > s->maxsam ) {
+        if ( (s->res.sfs = (int *)realloc(s->res.sfs, nsam*sizeof(int))) == NULL ) {
+            perror("alloc error for the site frequency spectrum");
+            exit(EXIT_FAILURE);
+        }
+        if ( (s->res.hfs = (int *)realloc(s->res.hfs, nsam*sizeof(int))) == NULL ) {
+            perror("alloc error for the haplotype frequency spectrum");
+            exit(EXIT_FAILURE);
         }
+        if ( nsubs > 0 ) {
+            if ( (s->subsamples = (int *)realloc(s->subsamples,
+                                                 nsubs*nsam*sizeof(int))) == NULL
+                 || (s->order = (int *)realloc(s->order, nsam*sizeof(int))) == NULL ) {
+                perror("alloc error for the subsamples");
+                exit(EXIT_FAILURE);
+            }
+            for ( i=0; i<nsubs; i++ ) {
+                if ( (s->subres[i].sfs = (int *)realloc(s->subres[i].sfs,
+                                                        nsam*sizeof(int))) == NULL ) {
+                    perror("alloc error for the subsamples");
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
+        s->maxsam = nsam;
+    }
+    if ( nsites > s->maxsites ) {
+        if ( (s->res.mismatch = (long *)realloc(s->res.mismatch,
+                                                (nsites + 1)*sizeof(long))) == NULL ) {
+            perror("realloc error. couldn't make the mismatch distribution bigger");
+            exit(EXIT_FAILURE);
+        }
+        s->maxsites = nsites;
     }
-    
-    return (count);
 }
 
-/*  The size of the largest group of identical haplotypes
+/*  Set up the scratch space and the room for the windows and subsamples
+ *    asked for
  *
- *      nsam            - total number of samples in data list
- *      hap_freqs       - an array with counts per haplotype
- *                         (each entry corresponds to a row in the
- *                          original data; all entries should have 
- *                          an integer value; a value of -9 indicates 
- *                          that the entry at that row has already been
- *                          counted)
+ *      s           - the state
  *
- *  Returns an integer
+ *  Returns nothing; exits if out of memory or the options are no good
  */
-int max_identical_haplotypes(int nsam, int* hap_freqs) {
-    int     i,                  /* iterator */
-            max_num;            /* running largest value */
+static void state_init(struct compute_state *s) {
+    memset(s, 0, sizeof(*s));
+    if ( (s->ws = ss_workspace_new()) == NULL ) {
+        perror("alloc error in ss_workspace_new");
+        exit(EXIT_FAILURE);
+    }
+    if ( ss_set_ld(s->ws, ld_window, ld_max_pairs, ld_threads) != SS_OK ) {
+        fprintf(stderr, "Bad --ld-window, --ld-max-pairs or --threads value.\n");
+        exit(EXIT_FAILURE);
+    }
+    if ( ss_set_cache(s->ws, cache_entries) != SS_OK ) {
+        perror("alloc error in ss_set_cache");
+        exit(EXIT_FAILURE);
+    }
+    if ( nwin > 0
+         && (s->windows = (struct ss_window *)malloc(nwin*sizeof(struct ss_window))) == NULL ) {
+        perror("alloc error for the windows");
+        exit(EXIT_FAILURE);
+    }
+    if ( nsubs > 0
+         && (s->subres = (struct ss_results *)calloc(nsubs, sizeof(struct ss_results))) == NULL ) {
+        perror("alloc error for the subsamples");
+        exit(EXIT_FAILURE);
+    }
+}
 
-    max_num = 0;
+/*  Free what a state holds
+ *
+ *      s           - the state
+ *
+ *  Returns nothing
+ */
+static void state_free(struct compute_state *s) {
+    int     i;                  /* iterator */
+
+    ss_workspace_free(s->ws);
+    free(s->res.sfs);
+    free(s->res.hfs);
+    free(s->res.mismatch);
+    free(s->windows);
+    for ( i=0; i<nsubs && s->subres != NULL; i++ )
+        free(s->subres[i].sfs);
+    free(s->subres);
+    free(s->subsamples);
+    free(s->order);
+}
 
-    for (i=0; i < nsam; i++) {
-        if ( hap_freqs[i] > max_num ) {
-            max_num = hap_freqs[i];
+/*  Work out the statistics asked for of a replicate: per window, per
+ *    subsample, or of the whole and its populations
+ *
+ *      s           - the state to work them out in
+ *      r           - the replicate
+ *      npop        - number of populations
+ *      sizes       - their sizes
+ *
+ *  Returns nothing; exits on error
+ */
+static void compute_replicate(struct compute_state *s, const struct ms_replicate *r, int npop,
+                              const int *sizes) {
+    struct ss_replicate rep;    /* the replicate, as seen by the library */
+
+    state_room(s, r->nsam, r->maxsites);
+
+    /* hand the data matrix over to the library */
+    rep.nsam = r->nsam;
+    rep.alphabet = SS_BINARY;
+    rep.nsites = r->segsites;
+    if ( r->bits != NULL ) {
+        rep.encoding = SS_BITS;
+        rep.data = r->bits;
+        rep.stride = r->bits_stride;
+    } else {
+        rep.encoding = SS_ASCII;
+        rep.data = (unsigned char *)r->list[0];
+        rep.stride = r->maxsites + 1;
+    }
+
+    if ( nwin > 0 ) {
+        if ( ss_compute_windows(&rep, r->positions, 1.0, win_width, win_step,
+                                stats, s->ws, s->windows) != nwin ) {
+            perror("error in ss_compute_windows");
+            exit(EXIT_FAILURE);
         }
+        return;
+    }
+
+    if ( nsubs > 0 ) {
+        if ( sub_seed != 0 )
+            draw_subsamples(r->nsam, s->order, s->subsamples);
+        if ( ss_compute_subsamples(&rep, nsubs, sub_sizes, sub_seed ? s->subsamples : NULL,
+                                   stats, s->ws, s->subres) != SS_OK ) {
+            perror("error in ss_compute_subsamples");
+            exit(EXIT_FAILURE);
+        }
+        return;
+    }
+
+    if ( ss_compute(&rep, stats, s->ws, &s->res) != SS_OK ) {
+        perror("error in ss_compute");
+        exit(EXIT_FAILURE);
+    }
+    if ( (stats & (SS_IHS | SS_NSL))
+         && ss_compute_ehh(&rep, r->positions, stats, s->ws, &s->res, NULL, NULL) != SS_OK ) {
+        perror("error in ss_compute_ehh");
+        exit(EXIT_FAILURE);
+    }
+    if ( pop_stats != 0
+         && ss_compute_pops(&rep, npop, sizes, pop_stats, s->ws, &s->pres) != SS_OK ) {
+        perror("error in ss_compute_pops");
+        exit(EXIT_FAILURE);
     }
-    
-    return (max_num);
 }
 
-/*  Count the total number of singletons (haplotypes with only
- *    one occurence.
+/*  Print the statistics compute_replicate() worked out: with windows, one
+ *    line per window, and with subsamples one per subsample, each ending
+ *    with the 'tbs' parameters of the replicate
  *
- *      nsam            - total number of samples in data list
- *      hap_freqs       - an array with counts per haplotype
- *                         (each entry corresponds to a row in the
- *                          original data; all entries should have 
- *                          an integer value; a value of -9 indicates 
- *                          that the entry at that row has already been
- *                          counted)
+ *      out         - where to print them
+ *      s           - the state they were worked out in
+ *      r           - the replicate
  *
- *  Returns an integer
+ *  Returns nothing
  */
-int num_singletons(int nsam, int* hap_freqs) {
-    int     i,                  /* iterator */
-            count;              /* running total */
+static void print_replicate(FILE *out, const struct compute_state *s,
+                            const struct ms_replicate *r) {
+    int     i;                  /* iterator */
 
-    count = 0;
+    if ( nwin > 0 ) {
+        for( i=0; i<nwin; i++) {
+            fprintf(out, "window_start:\t%lf\twindow_end:\t%lf\t", s->windows[i].start,
+                    s->windows[i].end);
+            print_results(out, stats & SS_WINDOW_STATS, &s->windows[i].res, r->probflag,
+                          r->prob);
+            fprintf(out, "%s", r->slashline);
+        }
+        return;
+    }
 
-    for (i=0; i < nsam; i++) {
-        if ( hap_freqs[i] == 1 ) {
-            count++;
+    if ( nsubs > 0 ) {
+        for( i=0; i<nsubs; i++) {
+            fprintf(out, "subsample:\t%d\t", sub_sizes[i]);
+            print_results(out, stats & SS_SUBSAMPLE_STATS, &s->subres[i], r->probflag,
+                          r->prob);
+            fprintf(out, "%s", r->slashline);
         }
+        return;
     }
-    
-    return (count);
+
+    print_results(out, stats, &s->res, r->probflag, r->prob);
+    if ( pop_stats != 0 )
+        print_pop_results(out, pop_stats, &s->pres);
+    fprintf(out, "%s", r->slashline);
 }
 
-/*  Count the total number of singleton sites in the data.
- *    This is the number of variant sites appearing once
- *    and only once in the entire dataset.
+/* Files mode: the replicates of every input file are read a few at a time
+ * into tasks, and the tasks shared out between the threads of a work
+ * stealing pool (work_pool.h). Each thread works out the statistics of its
+ * tasks with its own state and prints them into the task; the tasks of a
+ * file are then written to its output in the order they were read, those
+ * that finish early waiting on the file's list of pending tasks. At most
+ * jobs files are read at once, and at most TASKS_PER_JOB*jobs tasks are in
+ * hand, so memory stays bounded however many files there are. */
+#define TASKS_PER_JOB   4       /* tasks in hand per thread */
+#define READ_AHEAD      4       /* most replicates read in one go */
+
+struct input_file {
+    const char *name;           /* the input */
+    char    *out_name;          /* and the output */
+    pthread_mutex_t read_lock,  /* held while its replicates are read */
+            write_lock;         /* held while its output is written */
+    FILE    *in;                /* the input, while it is read */
+    struct prefetch *input;     /* and read ahead */
+    FILE    *out;               /* the output, until it is all written */
+    int     nsam,               /* number of samples in the file */
+            howmany,            /* number of replicates it promises */
+            npop,               /* its populations */
+            pop_sizes[SS_MAXPOPS],
+            probflag;           /* as in main() */
+    double  prob;
+    long    nread,              /* replicates read so far */
+            nwritten;           /* and written */
+    int     reading,            /* 1 while it is being read */
+            exhausted;          /* 1 once it is all read */
+    struct task *pending;       /* worked out, waiting on earlier ones, in order */
+};
+
+struct task {
+    struct input_file *file;    /* the file the replicate came from */
+    long    seq;                /* its number in the file */
+    struct ms_replicate r;      /* the replicate */
+    char    *text;              /* its output, once worked out */
+    size_t  len;
+    struct task *next;          /* in the free list, or the file's pending list */
+};
+
+struct file_set {
+    struct input_file *files;   /* the input files */
+    int     nfiles,
+            next_file,          /* next to start reading */
+            nreading,           /* how many are being read */
+            need_positions;     /* 1 if the positions line is read in */
+    struct input_file **reading;/* those being read */
+    pthread_mutex_t lock;       /* guards the above, and the tasks */
+    struct task *free_tasks;    /* tasks ready for a replicate */
+    int     ntasks,             /* tasks made so far */
+            maxtasks;           /* and the most there may be */
+    struct compute_state *states;
+                                /* a state per thread */
+};
+
+/*  Close a file's output once every replicate of it has been written
+ *    (with its write_lock held)
  *
- *      segsites        - total number of segregating sites 
- *                        ( length of positions array )
- *      site_freqs      - array with counts of '1' per site 
+ *      f           - the file
  *
- *  Returns an integer
+ *  Returns nothing; exits if the output cannot be written
  */
-int num_singleton_sites(int segsites, int *site_freqs) {
-    int     i,                  /* iterator */
-            count;              /* running total */
+static void finish_output(struct input_file *f) {
+    if ( !f->exhausted || f->nwritten < f->nread || f->out == NULL )
+        return;
+    if ( fclose(f->out) != 0 ) {
+        perror(f->out_name);
+        exit(EXIT_FAILURE);
+    }
+    f->out = NULL;
+}
 
-    count = 0;
+/*  Start reading a file: open it and its output and read its first two
+ *    lines (with its read_lock held)
+ *
+ *      f           - the file
+ *
+ *  Returns nothing; exits if it cannot be opened
+ */
+static void open_input(struct input_file *f) {
+    char    line[1001],         /* each of the first two lines */
+            dum[20];            /* "ms", thrown away */
 
-    for( i = 0; i < segsites; i++) {
-        /* calculate site frequency of '1' */
-        if (site_freqs[i] == 1) {
-          count++;
-        }
+    if ( (f->in = fopen(f->name, "r")) == NULL ) {
+        perror(f->name);
+        exit(EXIT_FAILURE);
     }
-    
-    return (count);
+    if ( (f->out = fopen(f->out_name, "w")) == NULL ) {
+        perror(f->out_name);
+        exit(EXIT_FAILURE);
+    }
+    f->input = prefetch_open(fileno(f->in));
+
+    /* the ms command line, then the seeds; a file without them has no
+     * replicates */
+    if ( prefetch_gets(line, 1000, f->input) == NULL
+         || sscanf(line," %19s  %d %d", dum, &f->nsam, &f->howmany) != 3 ) {
+        f->howmany = 0;
+        return;
+    }
+    f->npop = npops;
+    memcpy(f->pop_sizes, pop_sizes, sizeof(pop_sizes));
+    check_samples(f->name, f->nsam, line, &f->npop, f->pop_sizes);
+    prefetch_gets(line, 1000, f->input);
 }
 
-/*  Calculate homozygosity.  This is done by summing up the squares
- *    of haplotype proportions.
+/*  Stop reading a file that is all read (with its read_lock held)
  *
- *      nsam            - total number of samples in data list
- *      hap_freqs       - an array with counts per haplotype
- *                         (each entry corresponds to a row in the
- *                          original data; all entries should have 
- *                          an integer value; a value of -9 indicates 
- *                          that the entry at that row has already been
- *                          counted)
+ *      fs          - the files
+ *      f           - the file
  *
- *  Returns a double
+ *  Returns nothing
  */
-double homozygosity(int nsam, int* hap_freqs) {
+static void close_input(struct file_set *fs, struct input_file *f) {
     int     i;                  /* iterator */
-    double  total,              /* double value for the total number of samples */
-            count,              /* temporary holder for each haplotype count */
-            proportion,         /* temporary holder for each haplotype proportion */
-            ho;                 /* calculated as we go (sum of per site homozygosities) */
 
-    ho = 0.0;
-    total = nsam;
+    prefetch_close(f->input);
+    fclose(f->in);
+    f->input = NULL;
+
+    pthread_mutex_lock(&fs->lock);
+    for ( i=0; fs->reading[i] != f; i++ )
+        ;
+    fs->reading[i] = fs->reading[--fs->nreading];
+    f->reading = 0;
+    pthread_mutex_unlock(&fs->lock);
+
+    pthread_mutex_lock(&f->write_lock);
+    f->exhausted = 1;
+    finish_output(f);
+    pthread_mutex_unlock(&f->write_lock);
+}
 
-    for (i=0; i < nsam; i++) {
-        if ( hap_freqs[i] > 0 ) {
-            count = hap_freqs[i];
-            proportion = count/total;
-            ho += proportion*proportion;
+/*  Take a task to read a replicate into, making one if there is room
+ *
+ *      fs          - the files
+ *
+ *  Returns the task, or NULL if all are in hand
+ */
+static struct task *take_task(struct file_set *fs) {
+    struct task *t;             /* the task */
+
+    pthread_mutex_lock(&fs->lock);
+    if ( (t = fs->free_tasks) != NULL )
+        fs->free_tasks = t->next;
+    else if ( fs->ntasks < fs->maxtasks ) {
+        if ( (t = (struct task *)calloc(1, sizeof(struct task))) == NULL ) {
+            perror("alloc error for the tasks");
+            exit(EXIT_FAILURE);
         }
+        fs->ntasks++;
     }
-    
-    return (ho);
+    pthread_mutex_unlock(&fs->lock);
+    return t;
 }
 
-/* Print help info. */
-static void print_help (void) {
-  printf ("Usage: %s [OPTIONS]\n", program_name);
+/*  Hand a task back for another replicate
+ *
+ *      fs          - the files
+ *      t           - the task
+ *
+ *  Returns nothing
+ */
+static void give_task(struct file_set *fs, struct task *t) {
+    pthread_mutex_lock(&fs->lock);
+    t->next = fs->free_tasks;
+    fs->free_tasks = t;
+    pthread_mutex_unlock(&fs->lock);
+}
 
-  puts ("");
-  fputs ("\
-    -h        display this help and exit\n\
-    -v        display version information and exit\n", stdout);
+/*  Read the next few replicates of a file no other thread is reading into
+ *    tasks for this thread (work_fill_fn)
+ *
+ *      pool        - the pool
+ *      worker      - this thread
+ *      arg         - the files
+ *
+ *  Returns the number of tasks pushed, 0 when every file is all read, or
+ *    -1 if there is nothing to read just now
+ */
+static int fill_tasks(struct work_pool *pool, int worker, void *arg) {
+    struct file_set *fs;        /* the files */
+    struct input_file *f;       /* the one to read */
+    struct task *t;             /* a task read into */
+    int     i,                  /* iterator */
+            n;                  /* tasks pushed */
 
-  puts ("");
-  fputs ("\
-  Use these options to calculate:\n\
-    -p        pi:     nucleotide diversity\n\
-    -S        ss:     number of segregating sites\n\
-    -F        thetaH: Fay's H\n\
-    -d        H:      difference between pi and Fay's H\n\
-    -W        thetaW: Watterson's theta\n\
-    -D        D:      Tajima's D\n\
-    -H        ho:     Homozygosity\n\
-    -n        nh:     number of haplotypes\n\
-    -s        ns:     number of singletons\n\
-    -N        nss:    number of singleton sites\n\
-    -f        hf:     mean haplotype frequency\n\
-    -i        ih:     max number identical haplotypes\n\
-    -R        R2:     Ramos-Onsins & Rozas' R2\n\
-    -U        Fs:     Fu's Fs\n", stdout);
+    fs = (struct file_set *)arg;
 
-  puts ("");
-  fputs ("\
-Calculate summary statistics from 'ms' output. With no options specified,\n\
-the core set calculated by Hudson's original 'sample_stats' program will be\n\
-written to the screen.  This original set is: pi, ss, D, thetaH, H\n\
-\n\
-This modified version of Hudson's original program has been optimized to\n\
-calculate this original set about 40% faster.  In addition, it implements\n\
-methods to calculate 4 more statistics: thetaW, ho, nh, and ns.\n\
-\n\
-Examples:\n\
-      ms 10 1 -t 5 | sample_stats2\n\
-      ms 10 1 -t 5 | sample_stats2 -SW\n\
-      ms 10 1 -t 5 | sample_stats2 -pSFdWDHns", stdout);
-  printf ("\n");
+    /* a file being read that no one else is reading, or else the next */
+    f = NULL;
+    pthread_mutex_lock(&fs->lock);
+    for ( i=0; i<fs->nreading && f == NULL; i++ ) {
+        f = fs->reading[(worker + i) % fs->nreading];
+        if ( pthread_mutex_trylock(&f->read_lock) != 0 )
+            f = NULL;
+    }
+    if ( f == NULL && fs->next_file < fs->nfiles && fs->nreading < jobs ) {
+        f = &fs->files[fs->next_file++];
+        fs->reading[fs->nreading++] = f;
+        f->reading = 1;
+        pthread_mutex_lock(&f->read_lock);
+        pthread_mutex_unlock(&fs->lock);
+        open_input(f);
+    } else {
+        if ( f == NULL ) {
+            n = fs->nreading > 0 || fs->next_file < fs->nfiles ? -1 : 0;
+            pthread_mutex_unlock(&fs->lock);
+            return n;
+        }
+        pthread_mutex_unlock(&fs->lock);
+    }
+
+    for ( n=0; n<READ_AHEAD && f->nread < f->howmany; n++ ) {
+        if ( (t = take_task(fs)) == NULL )
+            break;
+        replicate_room(&t->r, f->nsam, fs->need_positions);
+        if ( read_replicate(f->input, fs->need_positions, &t->r, &f->probflag,
+                            &f->prob) != 0 ) {
+            /* a truncated file ends there */
+            give_task(fs, t);
+            f->howmany = f->nread;
+            break;
+        }
+        t->file = f;
+        t->seq = f->nread++;
+        if ( work_push(pool, worker, t) != 0 ) {
+            perror("alloc error for the tasks");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if ( f->nread == f->howmany )
+        close_input(fs, f);
+    pthread_mutex_unlock(&f->read_lock);
+
+    return n > 0 ? n : -1;
 }
 
-/* Print version and copyright information.  */
-static void print_version (void) {
-  printf ("(%s) version %s\n", PACKAGE, VERSION);
+/*  Work out a task, then write it and any that were waiting on it to the
+ *    file's output (work_run_fn)
+ *
+ *      task        - the task
+ *      worker      - this thread
+ *      arg         - the files
+ *
+ *  Returns nothing
+ */
+static void run_task(void *task, int worker, void *arg) {
+    struct file_set *fs;        /* the files */
+    struct input_file *f;       /* the file of the task */
+    struct task *t,             /* the task */
+                **p;            /* where it goes in the pending list */
+    FILE    *out;               /* its output, as it is printed */
+
+    fs = (struct file_set *)arg;
+    t = (struct task *)task;
+    f = t->file;
+
+    compute_replicate(&fs->states[worker], &t->r, f->npop, f->pop_sizes);
+    if ( (out = open_memstream(&t->text, &t->len)) == NULL ) {
+        perror("alloc error for the output");
+        exit(EXIT_FAILURE);
+    }
+    print_replicate(out, &fs->states[worker], &t->r);
+    fclose(out);
+
+    pthread_mutex_lock(&f->write_lock);
+    for ( p=&f->pending; *p != NULL && (*p)->seq < t->seq; p=&(*p)->next )
+        ;
+    t->next = *p;
+    *p = t;
+    while ( (t = f->pending) != NULL && t->seq == f->nwritten ) {
+        f->pending = t->next;
+        fwrite(t->text, 1, t->len, f->out);
+        free(t->text);
+        t->text = NULL;
+        f->nwritten++;
+        give_task(fs, t);
+    }
+    finish_output(f);
+    pthread_mutex_unlock(&f->write_lock);
+}
+
+/*  Work out every replicate of a list of files, each into a file of the
+ *    same name plus out_suffix
+ *
+ *      nnames      - number of names
+ *      names       - the names, which may be glob(3) patterns
+ *      need_positions - 1 if the positions line is read in
+ *
+ *  Returns the exit status
+ */
+static int run_files(int nnames, char **names, int need_positions) {
+    struct file_set fs;         /* the files */
+    struct task *t;             /* a task being freed */
+    glob_t  g;                  /* the names, with patterns expanded */
+    int     i;                  /* iterator */
+
+    if ( profiling || progress_every > 0.0 || status_file != NULL || sub_seed != 0 ) {
+        fprintf(stderr, "--profile, --counters, --progress, --status-file and"
+                " --subsample-seed do not go with input files.\n");
+        return EXIT_FAILURE;
+    }
+    if ( jobs == 0 && (jobs = get_nprocs()) < 1 )
+        jobs = 1;
+
+    /* a pattern that matches nothing stays as it is, and fails to open */
+    for ( i=0; i<nnames; i++ ) {
+        if ( glob(names[i], GLOB_NOCHECK | (i > 0 ? GLOB_APPEND : 0), NULL, &g) != 0 ) {
+            fprintf(stderr, "Cannot expand `%s'.\n", names[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    memset(&fs, 0, sizeof(fs));
+    fs.nfiles = (int)g.gl_pathc;
+    fs.need_positions = need_positions;
+    fs.maxtasks = TASKS_PER_JOB*jobs;
+    if ( (fs.files = (struct input_file *)calloc(fs.nfiles, sizeof(struct input_file))) == NULL
+         || (fs.reading = (struct input_file **)malloc(jobs*sizeof(struct input_file *))) == NULL
+         || (fs.states = (struct compute_state *)malloc(jobs*sizeof(struct compute_state))) == NULL ) {
+        perror("alloc error for the input files");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&fs.lock, NULL);
+    for ( i=0; i<fs.nfiles; i++ ) {
+        fs.files[i].name = g.gl_pathv[i];
+        if ( (fs.files[i].out_name = (char *)malloc(strlen(g.gl_pathv[i])
+                                                    + strlen(out_suffix) + 1)) == NULL ) {
+            perror("alloc error for the input files");
+            exit(EXIT_FAILURE);
+        }
+        strcat(strcpy(fs.files[i].out_name, g.gl_pathv[i]), out_suffix);
+        pthread_mutex_init(&fs.files[i].read_lock, NULL);
+        pthread_mutex_init(&fs.files[i].write_lock, NULL);
+    }
+    for ( i=0; i<jobs; i++ )
+        state_init(&fs.states[i]);
+
+    if ( work_pool_run(jobs, fill_tasks, run_task, &fs) < 0 ) {
+        perror("alloc error in work_pool_run");
+        exit(EXIT_FAILURE);
+    }
+
+    for ( i=0; i<jobs; i++ )
+        state_free(&fs.states[i]);
+    while ( (t = fs.free_tasks) != NULL ) {
+        fs.free_tasks = t->next;
+        free_replicate(&t->r);
+        free(t);
+    }
+    for ( i=0; i<fs.nfiles; i++ ) {
+        free(fs.files[i].out_name);
+        pthread_mutex_destroy(&fs.files[i].read_lock);
+        pthread_mutex_destroy(&fs.files[i].write_lock);
+    }
+    pthread_mutex_destroy(&fs.lock);
+    free(fs.files);
+    free(fs.reading);
+    free(fs.states);
+    globfree(&g);
+
+    return EXIT_SUCCESS;
+}
+
+/*  Work out phased VCF on stdin a window at a time (vcf.h). Each window
+ *    is a replicate of a haplotype per chromosome copy, its sites placed
+ *    between 0 and 1 across the window for --window and iHS, and its
+ *    lines end with the chromosome and the window instead of the 'tbs'
+ *    parameters.
+ *
+ *      need_positions - 1 if the positions of the sites are needed
+ *
+ *  Returns the exit status
+ */
+static int run_vcf(int need_positions) {
+    struct prefetch *input;     /* stdin, read ahead */
+    struct vcf *v;              /* the VCF reader */
+    struct vcf_window w;        /* the sites of the current window */
+    struct ms_replicate r;      /* the window as a replicate */
+    struct compute_state state; /* the scratch space and results for it */
+    unsigned char *bits;        /* its rows, a bit per site */
+    size_t  stride;             /* bytes from one row to the next */
+    double  width;              /* bases in the window */
+    int     nhap,               /* haplotypes */
+            n,                  /* sites in the window, or a VCF_ code */
+            j,                  /* iterator */
+            status;             /* the exit status */
+
+    if ( profiling || progress_every > 0.0 || status_file != NULL ) {
+        fprintf(stderr, "--profile, --counters, --progress and --status-file"
+                " do not go with --vcf.\n");
+        return EXIT_FAILURE;
+    }
+
+    input = prefetch_open(fileno(stdin));
+    if ( (v = vcf_open(input)) == NULL ) {
+        fprintf(stderr, "No #CHROM line with samples on it; is the input VCF?\n");
+        prefetch_close(input);
+        return EXIT_FAILURE;
+    }
+    nhap = 2*vcf_nsamples(v);
+    check_samples(NULL, nhap, "", &npops, pop_sizes);
+    state_init(&state);
+
+    memset(&r, 0, sizeof(r));
+    memset(&w, 0, sizeof(w));
+    r.nsam = nhap;
+    bits = NULL;
+    stride = 0;
+    while ( (n = vcf_read_window(v, vcf_width, &w)) >= 0 ) {
+        /* the windows grow their room for sites as needed, and so do we */
+        if ( w.maxsites > r.maxsites ) {
+            r.maxsites = w.maxsites;
+            stride = 8*PACKED_WORDS(r.maxsites);
+            free(bits);
+            if ( (bits = (unsigned char *)malloc((size_t)nhap*stride)) == NULL
+                 || (need_positions && (r.positions = (double *)realloc(r.positions,
+                                            r.maxsites*sizeof(double))) == NULL) ) {
+                perror("alloc error for the VCF window");
+                exit(EXIT_FAILURE);
+            }
+        }
+        packed_column_rows(nhap, n, w.cols, w.colwords, bits, stride);
+        r.bits = bits;
+        r.bits_stride = stride;
+        r.segsites = n;
+        if ( need_positions ) {
+            width = (double)(w.end - w.start + 1);
+            for ( j=0; j<n; j++ )
+                r.positions[j] = (w.positions[j] - w.start + 0.5)/width;
+        }
+        snprintf(r.slashline, sizeof(r.slashline), "chrom:\t%s\tstart:\t%ld\tend:\t%ld\n",
+                 w.chrom, w.start, w.end);
+
+        compute_replicate(&state, &r, npops, pop_sizes);
+        print_replicate(stdout, &state, &r);
+    }
+
+    status = EXIT_SUCCESS;
+    if ( n == VCF_EBAD ) {
+        fprintf(stderr, "Malformed or out of order VCF record, or a chromosome"
+                " seen before, at line %ld.\n", vcf_line(v));
+        status = EXIT_FAILURE;
+    } else if ( n == VCF_ENOMEM ) {
+        perror("alloc error in the VCF reader");
+        status = EXIT_FAILURE;
+    }
+    if ( vcf_skipped(v) > 0 )
+        fprintf(stderr, "Skipped %ld VCF records: not biallelic, or with a genotype"
+                " missing, haploid or unphased.\n", vcf_skipped(v));
+
+    state_free(&state);
+    free(bits);
+    free(r.positions);
+    vcf_window_free(&w);
+    vcf_close(v);
+    prefetch_close(input);
+    return status;
 }
 
 int main(int argc, char *argv[]) {
-    int     i,                  /* iterator */
-            nsam,               /* number of samples in the dataset */
-            howmany;            /* number of replicates in the dataset */
+    int     nsam,               /* number of samples in the dataset */
+            howmany,            /* number of replicates in the dataset */
+            need_positions;     /* 1 if the positions line is read in */
 
-    char    **list,             /* a matrix containing the data, 
-                                 *   samples in rows, positions in columns*/
-            line[1001],         /* temporary string to hold each line as it gets
+    char    line[1001];         /* temporary string to hold each line as it gets
                                  *   pulled from stdin */
-            slashline[1001];    /* 'tbs' parameters are placed tab-delimited on a
-                                 *   line beginning with "//". As the data are read in
-                                 *   the text following any line starting with "//" is
-                                 *   copied to the <slashline> and printed out following
-                                 *   the summary statistics */
 
-    int     segsites,           /* the number of sites for each replicate */
-            count,              /* running tally of how many replicates have been processed */
-            nh,                 /* the number of haplotypes */
+    int     count,              /* running tally of how many replicates have been processed */
             probflag;           /* 0 or 1, whether or not the input data includes 
                                  *   a "prob: ##" line*/
 
-    double  pi,                 /* nucleotide diversity */
-            th,                 /* Fay's theta H*/
-            prob;               /* the prob value from the input */
+    double  prob;               /* the prob value from the input */
+    double  t0;                 /* when the current phase started (--profile) */
     char    dum[20];            /* throwaway string, used when parsing first line of input file */
-    
-    int     *site_frequencies,  /* array holding the total count of '1's per site */
-            *hap_frequencies,   /* array holding unique haplotypes counts */
-            *unic_frequencies;  /* array holding count of unique sites per sequence */
-
-    int     ss_flag,            /* 0 or 1; output the number of segregating sites */
-            pi_flag,            /* 0 or 1; output nucleotide diversity */
-            th_flag,            /* 0 or 1; output Fay's H (thetaH) */
-            d_flag,             /* 0 or 1; output the difference between pi and Fay's H */
-            tw_flag,            /* 0 or 1; output Watterson's theta (thetaW) */
-            nh_flag,            /* 0 or 1; output the number of haplotypes */
-            ns_flag,            /* 0 or 1; output the number of singleton haplotypes */
-            ho_flag,            /* 0 or 1; output homozygosity */
-            td_flag,            /* 0 or 1; output Tajima's D */
-            nss_flag,           /* 0 or 1; output the number of singleton sites */
-            hf_flag,            /* 0 or 1; output mean number of samples per haplotype */
-            ih_flag,            /* 0 or 1; output max number of identical haplotypes */
-            r2_flag,            /* 0 or 1; output Romas-Onsins & Rozas' R2 */
-            fs_flag;            /* 0 or 1; output Fu's Fs */
+
+    struct ms_replicate r;      /* the current replicate, as read in */
+    struct compute_state state; /* the scratch space and results for it */
     
     char    ch;                 /* current character iterator for getopt option parsing */
-    int     remaining;          /* used to keep track of the number of remaining chars
-                                 * when skipping through the 'positions' line */
+    struct prefetch *input;     /* stdin, read ahead in the background while
+                                 *   each replicate is being analysed */
 
     program_name = argv[0];
 
-    /* by default, we print the same set as the original sample_stats */
-    ss_flag = 1;
-    pi_flag = 1;
-    th_flag = 1;
-     d_flag = 1;
-    tw_flag = 0;
-    nh_flag = 0;
-    ns_flag = 0;
-    ho_flag = 0;
-    td_flag = 1;
-    nss_flag = 0;
-    hf_flag = 0;
-    ih_flag = 0;
-    r2_flag = 0;
-    fs_flag = 0;
-
-    /* However, if there are command line options, zero out all flags and
-     * print only those specified in the options */
-    if (argc > 1) {
-      ss_flag = 0;
-      pi_flag = 0;
-      th_flag = 0;
-       d_flag = 0;
-      td_flag = 0;
-    }
-
     /* Use getopt to parse the following flags:
      *      S - number of segregating sites
      *      p - pi
@@ -519,50 +1801,134 @@ int main(int argc, char *argv[]) {
      *      i - max number identical haplotypes
      *      R - Ramos-Onsins & Rozas' R2
      *      U - Fu's Fs
-     *      */
-    while ((ch = getopt(argc, argv, "SpFdWDHnsNfiRUhv")) != -1) {
+     *      l - Fu & Li's D
+     *      L - Fu & Li's F
+     *      k - Fu & Li's D*
+     *      K - Fu & Li's F*
+     *      z - normalised Fay & Wu's H
+     *      E - Zeng et al's E
+     *      Z - Kelly's ZnS
+     *      o - Kim & Nielsen's omega
+     *      I - iHS
+     *      J - nSL
+     *      G - Garud's H1, H12 and H2/H1
+     *      X - unfolded site frequency spectrum
+     *      Y - haplotype frequency spectrum
+     *      m - mismatch distribution
+     *      V - variance of the mismatch distribution
+     *      r - raggedness index
+     *      P - pi, ss and D within each population
+     *      B - dxy and Fst between each pair of populations
+     *      Q - Snn
+     *
+     * and the long options handled in long_option() */
+    for (;;) {
+        if ((ch = getopt(argc, argv, "SpFdWDHnsNfiRUlLkKzEZoIJGXYmVrPBQhv")) == -1) {
+            if (optarg != NULL && strncmp(optarg, "--", 2) == 0) {
+                long_option(optarg, argc, argv);
+                continue;
+            }
+            break;
+        }
         switch (ch) {
 	        case 'S':
-		        ss_flag = 1;
+		        stats |= SS_SS;
 		        break;
             case 'p':
-                pi_flag = 1;
+                stats |= SS_PI;
                 break;
             case 'F':
-                th_flag = 1;
+                stats |= SS_THETAH;
                 break;
             case 'd':
-                d_flag = 1;
+                stats |= SS_H;
                 break;
             case 'W':
-                tw_flag = 1;
+                stats |= SS_THETAW;
                 break;
             case 'H':
-                ho_flag = 1;
+                stats |= SS_HO;
                 break;
             case 'n':
-                nh_flag = 1;
+                stats |= SS_NH;
                 break;
             case 's':
-                ns_flag = 1;
+                stats |= SS_NS;
                 break;
             case 'D':
-                td_flag = 1;
+                stats |= SS_D;
                 break;
             case 'N':
-                nss_flag = 1;
+                stats |= SS_NSS;
                 break;
             case 'f':
-                hf_flag = 1;
+                stats |= SS_HF;
                 break;
             case 'i':
-                ih_flag = 1;
+                stats |= SS_IH;
                 break;
             case 'R':
-                r2_flag = 1;
+                stats |= SS_R2;
                 break;
             case 'U':
-                fs_flag = 1;
+                stats |= SS_FS;
+                break;
+            case 'l':
+                stats |= SS_FULID;
+                break;
+            case 'L':
+                stats |= SS_FULIF;
+                break;
+            case 'k':
+                stats |= SS_FULIDS;
+                break;
+            case 'K':
+                stats |= SS_FULIFS;
+                break;
+            case 'z':
+                stats |= SS_HNORM;
+                break;
+            case 'E':
+                stats |= SS_ZENGE;
+                break;
+            case 'Z':
+                stats |= SS_ZNS;
+                break;
+            case 'o':
+                stats |= SS_OMEGA;
+                break;
+            case 'I':
+                stats |= SS_IHS;
+                break;
+            case 'J':
+                stats |= SS_NSL;
+                break;
+            case 'G':
+                stats |= SS_H1 | SS_H12 | SS_H2H1;
+                break;
+            case 'X':
+                stats |= SS_SFS;
+                break;
+            case 'Y':
+                stats |= SS_HFS;
+                break;
+            case 'm':
+                stats |= SS_MISMATCH;
+                break;
+            case 'V':
+                stats |= SS_MMVAR;
+                break;
+            case 'r':
+                stats |= SS_RAGGED;
+                break;
+            case 'P':
+                pop_stats |= SS_POP_PI | SS_POP_SS | SS_POP_D;
+                break;
+            case 'B':
+                pop_stats |= SS_POP_DXY | SS_POP_FST;
+                break;
+            case 'Q':
+                pop_stats |= SS_POP_SNN;
                 break;
             case 'h':
                 print_help();
@@ -579,28 +1945,89 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    /* by default, we print the same set as the original sample_stats;
+     * however, if any statistics were asked for, print only those */
+    if (stats == 0 && pop_stats == 0)
+        stats = SS_PI | SS_SS | SS_D | SS_THETAH | SS_H;
+
+    /* the windows, if any; the ms positions run from 0 to 1 */
+    if ( win_width != 0.0 || win_step != 0.0 ) {
+        if ( win_step == 0.0 )
+            win_step = win_width;
+        if ( win_width <= 0.0 || win_width > 1.0 || win_step <= 0.0
+             || (nwin = ss_num_windows(1.0, win_width, win_step)) <= 0 ) {
+            fprintf(stderr, "Bad --window or --step value.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* the windows and iHS need the positions of the sites */
+    need_positions = nwin > 0 || (stats & SS_IHS);
+
+    /* with input files named, work those out instead of stdin */
+    if (optind < argc) {
+        if (vcf_input) {
+            fprintf(stderr, "--vcf reads stdin only.\n");
+            exit (EXIT_FAILURE);
+        }
+        exit (run_files(argc - optind, argv + optind, need_positions));
+    }
+
+    /* or phased VCF on stdin, instead of ms output */
+    if (vcf_input)
+        exit (run_vcf(need_positions));
+
+    /* with --profile, the clock starts here */
+    if (profiling) {
+        prof_begin = ss_clock();
+        atexit(print_profile);
+    }
+
+    /* start reading ahead on stdin */
+    input = prefetch_open(fileno(stdin));
+
+    /* with --progress or --status-file, the reports start after the first
+     * period and end with one at exit */
+    if (status_file != NULL && progress_every == 0.0)
+        progress_every = 10.0;
+
     /* read in first line of the ms output */
-    fgets(line, 1000, stdin);
+    prefetch_gets(line, 1000, input);
     /* the first line has the complete ms command that created this dataset
      * and is of the form "ms NSAMPLES NREPETITIONS [FLAGS]"
      * scan in the NSAMPLES and NREPETITIONS values, dropping "ms" via the
      * <dum> variable and ignoring everything else on this line */
     sscanf(line," %s  %d %d", dum,  &nsam, &howmany);
 
-    /* pull off the second line (random number seeds) and throw it away */
-    fgets(line, 1000, stdin);
-
-    /* initialize the two dimensional char matrix <list> that will hold our data */
-    list = create_list(nsam,maxsites+1);
-
-    /* allocate enough space for the number of sites in the data */
-    site_frequencies = (int *)malloc( maxsites*sizeof( int ));
+    if (progress_every > 0.0) {
+        reps_total = howmany;
+        progress_input = input;
+        progress_begin = ss_clock();
+        progress_next = progress_begin + progress_every;
+        atexit(final_progress);
+    }
 
-    /* allocate enough space for the number of samples in the data */
-    hap_frequencies = (int *)malloc( nsam*sizeof( int ));
+    /* the subsamples and populations must fit the samples */
+    check_samples(NULL, nsam, line, &npops, pop_sizes);
 
-    /* allocate enough space for the number of samples in the data */
-    unic_frequencies = (int *)malloc( nsam*sizeof( int ));
+    /* pull off the second line (random number seeds) and throw it away */
+    prefetch_gets(line, 1000, input);
+
+    /* initialize the two dimensional char matrix that will hold our data */
+    memset(&r, 0, sizeof(r));
+    replicate_room(&r, nsam, need_positions);
+
+    /* set up the scratch space for the statistics, and room for them */
+    state_init(&state);
+    state_room(&state, nsam, r.maxsites);
+    if ( counting && perf_open(&perf) == 0 ) {
+        fprintf(stderr, "Hardware counters unavailable (%s); timing only.\n",
+                strerror(perf.error));
+        counting = 0;
+    }
+    lib_profile.counters = counting;
+    if ( profiling && ss_set_profile(state.ws, &lib_profile) != SS_OK )
+        fprintf(stderr, "Hardware counters unavailable in the library; timing only.\n");
 
     count=0;
     probflag=0;
@@ -610,141 +2037,31 @@ int main(int argc, char *argv[]) {
      *  the sum has been calculated and the while test evaluated) */
     while( howmany - count++ ) {
 
-        /* initialize slashline as a simple linefeed */
-        slashline[0] = '\n';
+        t0 = lap(-1, 0.0);
+        if (progress_every > 0.0)
+            replicate_done(1);
 
-        /* read in a sample */
-        do {
-            /* bail out if there's no data */
-            if( fgets( line, 1000, stdin) == NULL ) {
-                exit(0);
-            }
-            /* if this is the "//" line, then push the data into <slashline> */
-            if( line[0] == '/' ) {
-                /* but if there is no data on the line
-                 * just put a linefeed into slashline */
-                if( line[2] == '\n' ) {
-                    slashline[0] == '\n';
-                } else {
-                    strcpy(slashline,line+3);
-                }
-            }
-            /* otherwise, just read and throw away lines until we get to either a
-             * "segsites: <...> " or a "prob: <...> " line */
-        } while ( (line[0] != 's') && (line[0] != 'p' ) ) ;
- 
-        /* if we've hit the prob line, read it in. this line will only be present 
-         * if both the "-s" and "-t" flags were used to generate the data in ms
-         * (note that the ms documentation says that this will come after the
-         *  "segsites: <...>" line, but in actuality it comes before).*/
-        if( line[0] == 'p') {
-            sscanf( line, "  prob: %lf", &prob );
-            probflag = 1 ;
-            /* bail out if the input ends */
-            if( fgets( line, 1000, stdin) == NULL ) {
-                exit(0);
-            }
-        }
-
-        /* read in the number of segregating sites for this replicate */
-        sscanf( line, "  segsites: %d", &segsites );
+        /* read in a sample; bail out if there's no data */
+        if ( read_replicate(input, need_positions, &r, &probflag, &prob) != 0 )
+            exit(0);
+        prof_bucket = SS_PROF_BUCKET(r.segsites);
+        t0 = lap(PROF_PARSE, t0);
 
-        /* increase the global maxsites variable if the current replicate has
-         * more sites than we are currently prepared to deal with.  Also increase
-         * the size of the data list to accomodate the larger amount of data about
-         * to be read in. */
-        if( segsites >= maxsites){
-            maxsites = segsites + 10 ;
-            site_frequencies = (int *)realloc( site_frequencies, maxsites*sizeof( int ));
-            biggerlist(nsam,maxsites, list) ;
-        }
-
-        /* if this replicate has any segregating sites... */
-        if( segsites > 0) {
-            /* There is a line following segsites that looks like:
-             *   positions: #.#### #.#### #.####
-             * with as many numeric entries as there are segregating sites.
-             * 
-             * We're not using these data, so we want to pull this line off
-             * and discard it.  However, as our line buffer is only 1000 characters,
-             * anything over 142 segregating sites won't fit in one line read. 
-             * So we need to make sure we get it all.
-             * 
-             * The 'remaining' variable is initialized with the total number
-             * of characters on this line: 
-             *   11 chars for 'position: '
-             *   1  char  for the end of line '\0'
-             *   7  chars for each segsite entry */
-            remaining = segsites * 7 + 11 + 1;
-            do {
-                fgets( line, 1000, stdin);
-                remaining = remaining - 1000;
-            } while (remaining > 0);
-
-            /* now pull off each line of data (each sample) into list */
-            for( i=0; i<nsam;i++) fscanf(stdin," %s", list[i] );
-        }
-
-        /* fill in the site_frequencies array */
-        for(i=0; i < segsites ; i++) {
-            site_frequencies[i] = frequency('1', i, nsam, list);
-        }
-
-        /* fill in the unic_frequencies array if necessary */
-        if (r2_flag) {
-            count_binary_unic_frequencies(nsam, segsites, list, site_frequencies, unic_frequencies);
-        }
-
-        /* count up the haplotype frequencies if we are going to use them */
-        if (nh_flag || ns_flag || ho_flag || hf_flag || fs_flag || r2_flag ) {
-            count_haplotype_frequencies(nsam, segsites, list, hap_frequencies);
-        }
-
-        /* calculate pi if necessary */
-        if ( pi_flag || d_flag || fs_flag || r2_flag )
-            pi = theta_pi(nsam, segsites, site_frequencies);
+        compute_replicate(&state, &r, npops, pop_sizes);
+        if ( profiling )
+            ss_cache_counts(state.ws, &cache_hits, &cache_misses);
+        t0 = lap(PROF_COMPUTE, t0);
     
-        /* calculate Fay's H if necessary */
-        if ( th_flag || d_flag )
-            th = theta_h(nsam, segsites, site_frequencies);
-
-        /* calculate the number of haplotypes if necessary */
-        if (nh_flag || hf_flag || fs_flag)
-            nh = num_haplotypes(nsam, hap_frequencies);
-    
-        if ( pi_flag )
-            printf("pi:\t%lf\t", pi);
-        if ( ss_flag )
-            printf("ss:\t%d\t", segsites);
-        if ( td_flag )
-            printf("D:\t%lf\t", tajd(nsam,segsites,pi));
-        if ( th_flag )
-            printf("thetaH:\t%lf\t", th);
-        if (  d_flag )
-            printf("H:\t%lf\t", pi - th);
-        if ( tw_flag )
-            printf("thetaW:\t%lf\t", theta_w(nsam, segsites, site_frequencies));
-        if ( nh_flag )
-            printf("num_haplotypes:\t%d\t", nh);
-        if ( ns_flag )
-            printf("num_singletons:\t%d\t", num_singletons(nsam, hap_frequencies));
-        if ( ho_flag )
-            printf("homozygosity:\t%lf\t", homozygosity(nsam, hap_frequencies));
-        if ( probflag )
-            printf("prob:\t%g\t", prob);
-        if ( nss_flag )
-            printf("nss:\t%d\t", num_singleton_sites(segsites, site_frequencies));
-        if ( hf_flag )
-            printf("hf:\t%lf\t", (double)nsam/(double)nh);
-        if ( ih_flag )
-            printf("ih:\t%d\t", max_identical_haplotypes(nsam, hap_frequencies));
-        if ( r2_flag )
-            printf("r2:\t%lf\t", R2(unic_frequencies, pi, nsam, segsites));
-        if ( fs_flag )
-            printf("Fs:\t%lf\t", Fs(nsam, pi, nh));
-        printf("%s", slashline);
+        print_replicate(stdout, &state, &r);
+        lap(PROF_OUTPUT, t0);
        
     }
+    if (progress_every > 0.0)
+        replicate_done(0);
+
+    state_free(&state);
+    free_replicate(&r);
+    prefetch_close(input);
     
     exit (EXIT_SUCCESS);
 }
@@ -3,9 +3,7 @@
 #include <string.h>
 
 #include "simple_getopt.h"
-#include "fs.h"
-#include "r2.h"
-#include "tajd.h"
+#include "samplestats.h"
 
 #define PACKAGE "sample_stats3"
 #define VERSION "0.0.1"
@@ -13,33 +11,21 @@
 /* String containing name the program is called with. */
 const char *program_name;
 
-/*  Calculates the frequency of an allele at a particular site
- *    across all chromosomes
- *
- *      allele      - the allele to count, "A", "G", "C"
- *      site        - the position to count, in the range 0, number of sites - 1 
- *      nsam        - the number of samples in the dataset (number of rows in list)
- *      list        - a matrix containing the data, samples in rows, positions in 
- *                    columns
- *
- *  Returns an integer
- */
-int frequency(char allele, int site, int nsam, char **list) 
-{
-    int     i,                  /* iterator */
-            count;              /* running count of allele */
-
-    count = 0;
+/* sliding windows, from the long options: width and step in alignment
+ * columns (no windows if the width is 0) */
+double win_width = 0.0,
+       win_step = 0.0;
 
-    for (i=0; i<nsam; i++) {
-        count += (list[i][site] == allele ? 1 : 0);
-    }
+/* threads sharing the pairs of samples, from the long options */
+int nthreads = 1;
 
-    return count;
-} 
+/* replicates read in and worked out together, from the long options */
+int batch_size = SS_BATCH;
 
 /*  Allocates space for a sample by positions list as
- *  a two dimensional matrix of chars
+ *  a two dimensional matrix of chars. The rows are laid out
+ *  one after the other in a single block, <len> chars apart,
+ *  so that the whole matrix can be handed to ss_compute().
  *
  *      nsam        - the number of samples (rows)
  *      len         - the number of positions on the chromosome (columns)
@@ -57,325 +43,60 @@ char **create_list(int nsam, int len)
         perror("alloc error in create_list");
     }
 
-    /* Now walk through that intial array and try to allocate enough
-     * memory for a char array of length "len" for each row (sample).
+    /* Now try to allocate one block big enough for "nsam" rows of
+     * length "len" and point each row into it.
      * Throw an error if it fails. */
-    for (i=0; i<nsam; i++) {
-        if (!(list[i] = (char *)malloc((unsigned)(len*sizeof(char))))) {
-            perror("alloc error in cmatric. 2");
-        }
+    if (!(list[0] = (char *)malloc((size_t)nsam*len*sizeof(char)))) {
+        perror("alloc error in cmatric. 2");
+    }
+    for (i=1; i<nsam; i++) {
+        list[i] = list[0] + (size_t)i*len;
     }
     
     return list;
 }       
 
-/*  Allocate more space for positions in each entry of the data list
+/*  Free a list created with create_list
  *
- *      nsam        - total number of samples in data list
- *      nmax        - new maximum number of positions
  *      list        - the data ( samples by positions matrix of chars )
  *
  *  Returns nothing
  */
-void biggerlist(int nsam, unsigned nmax, char** list ) 
+void free_list(char **list) 
 {
-    int     i;                  /* iterator */
-
-    /* run through the list and attempt to expand the size of each 
-     * positions array */
-    for (i=0; i<nsam; i++) {
-        list[i] = (char *)realloc(list[i], nmax*sizeof(char)) ;
-        if (list[i] == NULL) {
-            perror("realloc error. bigger");
-        }
-    }
+    free(list[0]);
+    free(list);
 }      
 
-/* Calculate the frequencies of 'A', 'G', 'C', and 'T' at each site
- * in the data list. For each site, the site_frequencies array has
- * an array with four positions. The convention in this program is 
- * that 0 -> 'A', 1 -> 'G', 2 -> 'C', 3 -> 'T'.
- *
- *      nsam        - total number of samples in data list
- *      nsites      - total number of positions
- *      list        - the data ( samples by positions matrix of chars )
- *      site_freqs  - 2D matrix with enough rows for each site and 4 int columns
- * 
- * Returns nothing (updates the passed-by-references site_frequencies 
- */
-void calculate_site_frequencies(int   nsam, 
-                                int   nsites, 
-                                char  **list, 
-                                int   **site_freqs)
-{
-    int     i;                  /* iterator */
-
-    for (i=0; i<nsites; i++) {
-        site_freqs[i][0] = frequency( 'A', i, nsam, list );
-        site_freqs[i][1] = frequency( 'G', i, nsam, list );
-        site_freqs[i][2] = frequency( 'C', i, nsam, list );
-        site_freqs[i][3] = frequency( 'T', i, nsam, list );
-    }
-}
-
-/*  Calculate the number of segregating sites
+/*  Make room for a batch of replicates: a list for each, and the arrays
+ *    their results are put in. Whatever was there before is lost.
  *
- *      nsam            - total number of samples
- *      nsites          - total number of sites 
- *      site_freqs      - array with nucleotide counts per site 
+ *      n           - the number of replicates in a batch
+ *      nsam        - the number of samples there must be room for
+ *      nsites      - the number of sites there must be room for
+ *      lists       - the list of each replicate (NULL or from create_list)
+ *      res         - the results of each replicate
  *
- *  Returns an integer
+ *  Returns nothing; exits if there is not enough memory
  */
-int num_segregating_sites(int nsam, int nsites, int **site_freqs) 
-{
-    int     i,j,                /* iterators */
-            addone,             /* flag to say if we should increment the 
-                                 * count */
-            count;              /* running count of segregating sites */
-
-    count = 0;
-
-    /* run through site_freqs, upping the segregating site count every
-     * time we find a site where one of the individual nucleotide counts
-     * is neither 0 nor the max (which means there must be variation!) */
-    for (i=0; i<nsites; i++) {
-        addone = 0;
-        for (j=0; j<4; j++) {
-            if (site_freqs[i][j] != 0 && site_freqs[i][j] != nsam) {
-                addone = 1;
-            }
-        }
-        if (addone) {
-            count++;
-        }
-    }
-    
-    return count;
-}
-
-/*  Calculate pi (nucleotide diversity)
- *
- *      nsam            - total number of samples
- *      nsites          - total number of sites 
- *      site_freqs      - array with counts of '1' per site 
- *
- *  Returns a double 
- */
-double theta_pi(int nsam, int nsites, int **site_freqs) 
-{
-    int     i,j;                /* iterators */
-    double  pi,                 /* what we are calculating */
-            ssh,                /* sum of site homozygosity */
-            nd,                 /* nsam cast to double value */
-            denom;              /* nsam * (nsam - 1) */
-
-    pi = 0.0 ;
-
-    /* create a double with the value of nsam */
-    nd = nsam;
-    denom = nd * (nd - 1.0);
-
-    for (i=0; i<nsites; i++) {
-        ssh = 0.0;
-        for (j=0; j<4; j++) {
-            ssh += (site_freqs[i][j] * (site_freqs[i][j] - 1.0))/denom;
-        }
-        pi += 1.0 - ssh;
-    }
-    
-    return pi;
-}
-
-/*  Calculates Watterson's theta
- *
- *      nsam            - total number of samples in data list
- *      segsites        - total number of segregating sites 
- *
- *  Returns a double with the calculated value
- */
-double theta_w(int nsam, int segsites) 
+static void make_room(int n, int nsam, int nsites, char ***lists, struct ss_results *res)
 {
     int     i;                  /* iterator */
-    double  dsegsites,          /* segregating sites as double */
-            denom;              /* denominator of Watterson's theta */
-
-    dsegsites = segsites;
-
-    denom = 0.0;
-    for (i=1; i<nsam; i++) {
-        denom += 1.0/i;
-    }
-    
-    return segsites/denom;
-}
-
-/*  Count up the haplotype frequencies in the data
- *
- *      nsam            - total number of samples in data list
- *      list            - the data ( samples by positions matrix of chars )
- *      hap_freqs       - the (initialized) array of integers to fill (length nsam)
- *
- *  Returns nothing (fills in the array given)
- */
-void count_haplotype_frequencies(int nsam, char **list, int *hap_freqs) 
-{
-    int     i, j;               /* iterators */
 
-    /* first initialize all haplotype counts to 0 */
-    for (i=0; i<nsam; i++) {
-        hap_freqs[i] = 0;
-    }
-
-    /* step through the data list, comparing each haplotype
-     * to all those following it */
-    for (i=0; i<nsam; i++) {
-        /* if a haplotype has not been seen, it's count in the 
-         * hap_freqs array will be 0 */
-        if (hap_freqs[i] == 0) {
-            /* we automatically have one of this haplotype */
-            hap_freqs[i] = 1;
-            /* compare the current haplotype to all following in the list */
-            for (j=i+1; j<nsam; j++) {
-                if (! strcmp(list[i], list[j])) {
-                    /* if we have a match, up the current haplotype's count
-                     * and set the count of the matching position to -9 so
-                     * we know we've already counted it */
-                    hap_freqs[i] += 1;
-                    hap_freqs[j] = -9;
-                }
-            }
+    for (i=0; i<n; i++) {
+        if (lists[i] != NULL)
+            free_list(lists[i]);
+        lists[i] = create_list(nsam, nsites+1);
+        res[i].sfs = (int *)realloc(res[i].sfs, nsam*sizeof(int));
+        res[i].hfs = (int *)realloc(res[i].hfs, nsam*sizeof(int));
+        res[i].mismatch = (long *)realloc(res[i].mismatch, (nsites + 1)*sizeof(long));
+        if (res[i].sfs == NULL || res[i].hfs == NULL || res[i].mismatch == NULL) {
+            perror("alloc error for the spectra and mismatch distribution");
+            exit(EXIT_FAILURE);
         }
-
     }
 }
 
-/*  Count the total number of haplotypes
- *
- *      nsam            - total number of samples in data list
- *      hap_freqs       - an array with counts per haplotype
- *                         (each entry corresponds to a row in the
- *                          original data; all entries should have 
- *                          an integer value; a value of -9 indicates 
- *                          that the entry at that row has already been
- *                          counted)
- *
- *  Returns an integer
- */
-int num_haplotypes(int nsam, int* hap_freqs) 
-{
-    int     i,                  /* iterator */
-            count;              /* running total */
-
-    count = 0;
-
-    for (i=0; i<nsam; i++) {
-        if (hap_freqs[i] > 0) {
-            count++;
-        }
-    }
-    
-    return count;
-}
-
-/*  Count the total number of singletons (haplotypes with only
- *    one occurence.
- *
- *      nsam            - total number of samples in data list
- *      hap_freqs       - an array with counts per haplotype
- *                         (each entry corresponds to a row in the
- *                          original data; all entries should have 
- *                          an integer value; a value of -9 indicates 
- *                          that the entry at that row has already been
- *                          counted)
- *
- *  Returns an integer
- */
-int num_singletons(int nsam, int* hap_freqs) 
-{
-    int     i,                  /* iterator */
-            count;              /* running total */
-
-    count = 0;
-
-    for (i=0; i<nsam; i++) {
-        if (hap_freqs[i] == 1) {
-            count++;
-        }
-    }
-    
-    return count;
-}
-
-/*  Count the total number of singleton sites in the data.
- *    This is the number of variant sites appearing once
- *    and only once in the entire dataset.
- *
- *      nsites          - total number of sites 
- *      site_freqs      - array with counts of '1' per site 
- *
- *  Returns an integer
- */
-int num_singleton_sites(int nsites, int **site_freqs) 
-{
-    int     i,j,                /* iterators */
-            num_ones,           /* how many sites have a frequency of 1 */
-            num_gt_zero,        /* how many sites have a frequency > 0 */
-            count;              /* running total */
-
-    count = 0;
-
-    for (i=0; i<nsites; i++) {
-        num_ones = 0;
-        num_gt_zero = 0;
-        for (j=0; j<4; j++) {
-            if (site_freqs[i][j] == 1)
-                num_ones++;
-            if (site_freqs[i][j] > 0)
-                num_gt_zero++;
-        }
-        if (num_ones == 1 && num_gt_zero == 2)
-          count++;
-    }
-    
-    return count;
-}
-
-/*  Calculate homozygosity.  This is done by summing up the squares
- *    of haplotype proportions.
- *
- *      nsam            - total number of samples in data list
- *      hap_freqs       - an array with counts per haplotype
- *                         (each entry corresponds to a row in the
- *                          original data; all entries should have 
- *                          an integer value; a value of -9 indicates 
- *                          that the entry at that row has already been
- *                          counted)
- *
- *  Returns a double
- */
-double homozygosity(int nsam, int* hap_freqs) 
-{
-    int     i;              /* iterator */
-    double  total,          /* double value for the total number of samples */
-            count,          /* temporary holder for each haplotype count */
-            proportion,     /* temporary holder for each haplotype proportion */
-            ho;             /* calculated as we go 
-                             * (sum of per site homozygosities) */
-
-    ho = 0.0;
-    total = nsam;
-
-    for (i=0; i<nsam; i++) {
-        if (hap_freqs[i] > 0) {
-            count = hap_freqs[i];
-            proportion = count/total;
-            ho += proportion*proportion;
-        }
-    }
-    
-    return ho;
-}
-
 /* Print help info. */
 static void print_help (void) 
 {
@@ -384,7 +105,17 @@ static void print_help (void)
   puts ("");
   fputs ("\
     -h        display this help and exit\n\
-    -v        display version information and exit\n", stdout);
+    -v        display version information and exit\n\
+    --window W        give the statistics in windows of W alignment columns;\n\
+                      windows give pi, ss, D, thetaW, the haplotype counts\n\
+                      and H1, H12 and H2H1\n\
+    --step D          start a window every D columns (default: W); if W\n\
+                      and D do not tile the alignment, the last window\n\
+                      is moved back to end at its last column\n\
+    --threads=N       share the pairs of samples (-m, -V, -r) of a replicate\n\
+                      between N threads\n\
+    --batch=N         read in and work out N replicates at a time (default 16);\n\
+                      with 1, each is worked out on its own\n", stdout);
 
   puts ("");
   fputs ("\
@@ -398,7 +129,17 @@ static void print_help (void)
     -s        ns:     number of singletons\n\
     -N        nss:    number of singleton sites\n\
     -R        r2:     Ramos-Onsins and Rozas' R2\n\
-    -U        Fs:     Fu's Fs\n", stdout);
+    -U        Fs:     Fu's Fs\n\
+    -k        FuLiDstar: Fu & Li's D* (biallelic sites)\n\
+    -K        FuLiFstar: Fu & Li's F* (biallelic sites)\n\
+    -G        H1, H12, H2H1: Garud et al's haplotype homozygosity statistics\n\
+    -X        folded_sfs: folded site frequency spectrum (nsam/2 counts)\n\
+    -Y        hfs:    haplotype frequency spectrum (haplotype counts, largest\n\
+                      first)\n\
+    -m        mismatch: mismatch distribution (pairs of samples differing at\n\
+                      0, 1, 2 ... sites where both have a base)\n\
+    -V        mismatch_var: variance of the mismatch distribution\n\
+    -r        raggedness: Harpending's raggedness index\n", stdout);
 
   puts ("");
   fputs ("\
@@ -427,49 +168,158 @@ static void print_version (void)
   printf ("(%s) version %s\n", PACKAGE, VERSION);
 }
 
+/*  The value of a long option, given either as "--name=VALUE" or as
+ *    "--name VALUE"; for the second, optind is moved past the value
+ *
+ *      opt         - the option, as simple_getopt left it in optarg
+ *      name        - the option being looked for, starting with "--"
+ *      argc, argv  - the command line
+ *
+ *  Returns the value, or NULL if <opt> is not <name>; exits if the value
+ *    is missing
+ */
+static const char *option_value(const char *opt, const char *name, int argc, char *argv[])
+{
+    size_t  len;                /* length of the name */
+
+    len = strlen(name);
+    if (strncmp(opt, name, len) != 0)
+        return NULL;
+    if (opt[len] == '=')
+        return opt + len + 1;
+    if (opt[len] != '\0')
+        return NULL;
+    if (optind >= argc) {
+        fprintf (stderr, "Option `%s' needs a value.\n", name);
+        exit (EXIT_FAILURE);
+    }
+    return argv[optind++];
+}
+
+/*  Handle a long option. simple_getopt stops at these and leaves
+ *    them in optarg.
+ *
+ *      opt         - the option, starting with "--"
+ *      argc, argv  - the command line, for values given as separate words
+ *
+ *  Returns nothing; exits if the option is not understood
+ */
+static void long_option(const char *opt, int argc, char *argv[])
+{
+    const char *value;          /* the option's value */
+
+    if ((value = option_value(opt, "--window", argc, argv)) != NULL) {
+        win_width = atof(value);
+        return;
+    }
+    if ((value = option_value(opt, "--step", argc, argv)) != NULL) {
+        win_step = atof(value);
+        return;
+    }
+    if ((value = option_value(opt, "--threads", argc, argv)) != NULL) {
+        nthreads = atoi(value);
+        return;
+    }
+    if ((value = option_value(opt, "--batch", argc, argv)) != NULL) {
+        batch_size = atoi(value);
+        return;
+    }
+
+    fprintf (stderr, "Unknown option `%s'.\nTry '%s -h' for help\n", opt, program_name);
+    exit (EXIT_FAILURE);
+}
+
+/*  Print the statistics asked for, tab-delimited
+ *
+ *      stats       - the statistics to print
+ *      res         - their values
+ *
+ *  Returns nothing
+ */
+static void print_results(unsigned stats, const struct ss_results *res)
+{
+    int     i;                  /* iterator */
+
+    if (stats & SS_PI)
+        printf("pi:\t%lf\t", res->pi);
+    if (stats & SS_SS)
+        printf("ss:\t%d\t", res->ss);
+    if (stats & SS_D)
+        printf("D:\t%lf\t", res->D);
+    if (stats & SS_THETAW)
+        printf("thetaW:\t%lf\t", res->thetaW);
+    if (stats & SS_NH)
+        printf("num_haplotypes:\t%d\t", res->nh);
+    if (stats & SS_NS)
+        printf("num_singletons:\t%d\t", res->ns);
+    if (stats & SS_HO)
+        printf("homozygosity:\t%lf\t", res->ho);
+    if (stats & SS_NSS)
+        printf("nss:\t%d\t", res->nss);
+    if (stats & SS_R2)
+        printf("r2:\t%lf\t", res->r2);
+    if (stats & SS_FS)
+        printf("Fs:\t%lf\t", res->fs);
+    if ( stats & SS_FULIDS )
+        printf("FuLiDstar:\t%lf\t", res->fuliDs);
+    if ( stats & SS_FULIFS )
+        printf("FuLiFstar:\t%lf\t", res->fuliFs);
+    if (stats & SS_H1)
+        printf("H1:\t%lf\t", res->h1);
+    if (stats & SS_H12)
+        printf("H12:\t%lf\t", res->h12);
+    if (stats & SS_H2H1)
+        printf("H2H1:\t%lf\t", res->h2h1);
+    if (stats & SS_MMVAR)
+        printf("mismatch_var:\t%lf\t", res->mmvar);
+    if (stats & SS_RAGGED)
+        printf("raggedness:\t%lf\t", res->ragged);
+    if (stats & SS_SFS) {
+        printf("folded_sfs:\t");
+        for (i=0; i<res->sfs_len; i++)
+            printf(i ? ",%d" : "%d", res->sfs[i]);
+        printf("\t");
+    }
+    if (stats & SS_HFS) {
+        printf("hfs:\t");
+        for (i=0; i<res->hfs_len; i++)
+            printf(i ? ",%d" : "%d", res->hfs[i]);
+        printf("\t");
+    }
+    if (stats & SS_MISMATCH) {
+        printf("mismatch:\t");
+        for (i=0; i<res->mismatch_len; i++)
+            printf(i ? ",%ld" : "%ld", res->mismatch[i]);
+        printf("\t");
+    }
+}
+
 int main(int argc, char *argv[]) {
     int     i,                  /* iterator */
             maxline,            /* size of the line buffer */
             nsam,               /* number of samples in the dataset */
             nsites,             /* number of sites in the dataset */
-            segsites,           /* number of segregating sites in the dataset */
-            nextsam,            /* number of samples in the next replicate */
-            nextsites,          /* number of sites in the next replicate */
-            nh,                 /* number of haplotypes */
-            intbuf,             /* integer buffer used for input processing */
-            throwaway;          /* integer buffer used for input processing */
+            r,                  /* replicate of the batch */
+            nrep,               /* number of replicates in the batch */
+            maxsam,             /* number of samples the lists have room for */
+            maxsites,           /* number of sites the lists have room for */
+            nwin,               /* number of windows in this replicate */
+            maxwin;             /* number of windows there is room for */
     
-    char    **list,             /* a matrix containing the data, 
-                                 *   samples in rows, positions in columns*/
+    char    ***lists,           /* a matrix containing the data of each
+                                 *   replicate of the batch, samples in rows,
+                                 *   positions in columns */
             smallbuf[100],      /* small character buffer used to read in the 
                                  * first line of the phylip formatted data */
             *line;              /* temporary string to hold each line as it gets
                                  *   pulled from stdin */
-    
-    double  pi;                 /* nucleotide diversity */
-    
-    int     **site_frequencies, /* Array holding the nucleotide counts per site. 
-                                 *   This is a 2D array with rows corresponding
-                                 *   to sites and 4 columns, indexed in the normal
-                                 *   C-style ( 0, 1, 2, 3 ) corresponding to
-                                 *   'A', 'G', 'C', 'T' respectively. */
-            *hap_frequencies,   /* array holding unique haplotypes counts */
-            *unic_frequencies;  /* array holding count of unique sites per 
-                                 *   sequence */
-
-    int     ss_flag,            /* 0 or 1; output the number of segregating 
-                                 *         sites */
-            pi_flag,            /* 0 or 1; output nucleotide diversity */
-            tw_flag,            /* 0 or 1; output Watterson's theta (thetaW) */
-            nh_flag,            /* 0 or 1; output the number of haplotypes */
-            ns_flag,            /* 0 or 1; output the number of singleton 
-                                 *         haplotypes */
-            ho_flag,            /* 0 or 1; output homozygosity */
-            nss_flag,           /* 0 or 1; output the number of singleton 
-                                 *         sites */
-            td_flag,            /* 0 or 1; output Tajima's D */
-            r2_flag,            /* 0 or 1; output Romas-Onsins & Rozas' R2 */
-            fs_flag;            /* 0 or 1; output Fu's Fs */
+
+    unsigned stats;             /* the statistics to output (SS_PI | SS_SS | ...) */
+
+    struct ss_replicate *reps;  /* the replicates of the batch, as seen by the library */
+    struct ss_results *res;     /* the statistics calculated for them */
+    struct ss_workspace *ws;    /* scratch space reused across replicates */
+    struct ss_window *windows;  /* the statistics of each window */
     
     char    ch;                 /* current character iterator for getopt 
                                  *   option parsing */
@@ -481,25 +331,10 @@ int main(int argc, char *argv[]) {
      *  while it is easy to know this in ms output - 1 is the derived state - 
      *  we would have to estimate it in some way for seq-gen generated 
      *  sequence data. So we skip Fay's H and, by extention, H, the difference
-     *  between nucleotide diversity (pi) and Fay's H.) */
-    ss_flag = 1;
-    pi_flag = 1;
-    tw_flag = 0;
-    nh_flag = 0;
-    ns_flag = 0;
-    ho_flag = 0;
-    nss_flag= 0;
-    td_flag = 1;
-    r2_flag = 0;
-    fs_flag = 0;
-
-    /* However, if there are command line options, zero out all flags and
-     * print only those specified in the options */
-    if (argc > 1) {
-      ss_flag = 0;
-      pi_flag = 0;
-      td_flag = 0;
-    }
+     *  between nucleotide diversity (pi) and Fay's H.) 
+     * However, if there are command line options, print only those 
+     * specified in the options */
+    stats = 0;
 
     /* Use getopt to parse the following flags:
      *      S - number of segregating sites
@@ -512,38 +347,78 @@ int main(int argc, char *argv[]) {
      *      N - number of singleton sites
      *      R - Ramos-Onsins & Rozas' R2
      *      U - Fu's Fs
-     *      */
-    while ((ch = getopt(argc, argv, "SpWDHnshvNRU")) != -1) {
+     *      k - Fu & Li's D*
+     *      K - Fu & Li's F*
+     *      G - Garud's H1, H12 and H2/H1
+     *      X - folded site frequency spectrum
+     *      Y - haplotype frequency spectrum
+     *      m - mismatch distribution
+     *      V - variance of the mismatch distribution
+     *      r - raggedness index
+     *
+     * and the long options handled in long_option() */
+    for (;;) {
+        if ((ch = getopt(argc, argv, "SpWDHnshvNRUkKGXYmVr")) == -1) {
+            if (optarg != NULL && strncmp(optarg, "--", 2) == 0) {
+                long_option(optarg, argc, argv);
+                continue;
+            }
+            break;
+        }
         switch (ch) {
 	        case 'S':
-		        ss_flag = 1;
+		        stats |= SS_SS;
 		        break;
             case 'p':
-                pi_flag = 1;
+                stats |= SS_PI;
                 break;
             case 'W':
-                tw_flag = 1;
+                stats |= SS_THETAW;
                 break;
             case 'H':
-                ho_flag = 1;
+                stats |= SS_HO;
                 break;
             case 'n':
-                nh_flag = 1;
+                stats |= SS_NH;
                 break;
             case 's':
-                ns_flag = 1;
+                stats |= SS_NS;
                 break;
             case 'D':
-                td_flag = 1;
+                stats |= SS_D;
                 break;
             case 'N':
-                nss_flag = 1;
+                stats |= SS_NSS;
                 break;
             case 'R':
-                r2_flag = 1;
+                stats |= SS_R2;
                 break;
             case 'U':
-                fs_flag = 1;
+                stats |= SS_FS;
+                break;
+            case 'k':
+                stats |= SS_FULIDS;
+                break;
+            case 'K':
+                stats |= SS_FULIFS;
+                break;
+            case 'G':
+                stats |= SS_H1 | SS_H12 | SS_H2H1;
+                break;
+            case 'X':
+                stats |= SS_SFS;
+                break;
+            case 'Y':
+                stats |= SS_HFS;
+                break;
+            case 'm':
+                stats |= SS_MISMATCH;
+                break;
+            case 'V':
+                stats |= SS_MMVAR;
+                break;
+            case 'r':
+                stats |= SS_RAGGED;
                 break;
             case 'h':
                 print_help();
@@ -560,8 +435,28 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if (stats == 0)
+        stats = SS_SS | SS_PI | SS_D;
+
+    /* windows abut unless a step was given */
+    if (win_width != 0.0 || win_step != 0.0) {
+        if (win_step == 0.0)
+            win_step = win_width;
+        if (win_width <= 0.0 || win_step <= 0.0) {
+            fprintf(stderr, "Bad --window or --step value.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (batch_size < 1) {
+        fprintf(stderr, "Bad --batch value.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    windows = NULL;
+    maxwin = 0;
+
     /* read in the first line, bail out if no data */
-    if (fgets(smallbuf, 1000, stdin) == NULL)
+    if (fgets(smallbuf, sizeof(smallbuf), stdin) == NULL)
         exit(EXIT_FAILURE);
 
     /* first line should be phylip-style " NSAM NSITES", so pull that data out */
@@ -570,137 +465,140 @@ int main(int argc, char *argv[]) {
     if (nsam <= 0 || nsites <= 0)
         exit(EXIT_FAILURE);
 
-    /* initialize the two dimensional char matrix <list> that will hold our data */
-    list = create_list(nsam,nsites+1);
+    /* initialize the two dimensional char matrix that will hold the data of
+     * each replicate of a batch, and room for their site and haplotype
+     * frequency spectra and mismatch distributions */
+    lists = (char ***)calloc(batch_size, sizeof(char **));
+    reps = (struct ss_replicate *)calloc(batch_size, sizeof(struct ss_replicate));
+    res = (struct ss_results *)calloc(batch_size, sizeof(struct ss_results));
+    if (lists == NULL || reps == NULL || res == NULL) {
+        perror("alloc error for the batch");
+        exit(EXIT_FAILURE);
+    }
+    maxsam = nsam;
+    maxsites = nsites;
+    make_room(batch_size, maxsam, maxsites, lists, res);
 
     maxline = nsites + 100;
 
     /* initialize the line buffer */
     line = (char *)malloc((maxline+1)*sizeof(char));
 
-    /* allocate enough space for the number of sites in the data */
-    site_frequencies = (int **)malloc(nsites*sizeof(int*));
-
-    /* initialize each site array */
-    for (i=0; i<nsites; i++)
-        site_frequencies[i] = (int *)malloc((4*sizeof(int)));
-
-    /* allocate enough space for the number of samples in the data */
-    hap_frequencies = (int *)malloc(nsam*sizeof(int));
-
-    /* allocate enough space for the number of samples in the data */
-    unic_frequencies = (int *)malloc(nsam*sizeof(int));
+    /* set up the scratch space for the statistics */
+    if ((ws = ss_workspace_new()) == NULL) {
+        perror("alloc error in ss_workspace_new");
+        exit(EXIT_FAILURE);
+    }
+    if (ss_set_ld(ws, 0, 0, nthreads) != SS_OK) {
+        fprintf(stderr, "Bad --threads value.\n");
+        exit(EXIT_FAILURE);
+    }
 
     /* repeat while we still find data (see the end of the loop) */
     while (nsam > 0 && nsites > 0) {
-        
-        /* for the number of samples, read in each line, first
-         * pulling off the sample identifier. */
-        for (i=0; i<nsam; i++) {
-            if (fgets(line, maxline, stdin) == NULL)
-                exit(EXIT_FAILURE);
-            sscanf(line, "%s %s", smallbuf, list[i]);
-        }
 
-        /* only perform calculations we need to */
-        
-        if (pi_flag || td_flag || tw_flag || ss_flag || nss_flag || r2_flag || fs_flag) 
-            calculate_site_frequencies(nsam, nsites, list, site_frequencies);
-
-        if (nh_flag || ns_flag || ho_flag || fs_flag) 
-            count_haplotype_frequencies(nsam, list, hap_frequencies);
-        
-        /* fill in the unic_frequencies array if necessary */
-        if (r2_flag)
-            count_agct_unic_frequencies(nsam, nsites, list, 
-                                        site_frequencies, unic_frequencies);
-
-        if (pi_flag || td_flag || r2_flag || fs_flag) 
-            pi = theta_pi(nsam, nsites, site_frequencies);
-
-        if (ss_flag || tw_flag || td_flag || r2_flag) 
-            segsites = num_segregating_sites(nsam, nsites, site_frequencies);
-
-        if (nh_flag || fs_flag)
-            nh = num_haplotypes(nsam, hap_frequencies);
-        
-        if (pi_flag)
-            printf("pi:\t%lf\t", pi);
-        if (ss_flag)
-            printf("ss:\t%d\t", segsites);
-        if (td_flag)
-            printf("D:\t%lf\t", tajd(nsam, segsites, pi));
-        if (tw_flag)
-            printf("thetaW:\t%lf\t", theta_w(nsam, segsites));
-        if (nh_flag)
-            printf("num_haplotypes:\t%d\t", nh);
-        if (ns_flag)
-            printf("num_singletons:\t%d\t", num_singletons(nsam, hap_frequencies));
-        if (ho_flag)
-            printf("homozygosity:\t%lf\t", homozygosity(nsam, hap_frequencies));
-        if (nss_flag)
-            printf("nss:\t%d\t", num_singleton_sites(nsites, site_frequencies));
-        if (r2_flag)
-            printf("r2:\t%lf\t", R2(unic_frequencies, pi, nsam, segsites));
-        if (fs_flag)
-            printf("Fs:\t%lf\t", Fs(nsam, pi, nh));
-        puts("");
-
-        /* see if there's another replicate coming, check the number of samples
-         * and sites advertised if there is, and reallocate space if the current
-         * data structures aren't big enough to handle the next set */
-        if (fgets(line, maxline, stdin) != NULL) {
-       
-            /* again, first line should be phylip-style " NSAM NSITES", 
-             * so pull that data out */
-            sscanf(line, " %d %d", &nextsam, &nextsites);
-
-            /* if nextsam or nextsites are greater than the current,
-             * we will have to update the sizes of our data structures */
-            if (nextsam > nsam) {
-                /* first free the old list */
-                for (i=0; i<nsam; i++) 
-                    free(list[i]);
-                free(list);
-                /* now create a new list */
-                list = create_list(nextsam, nextsites+1);
-                /* hap_frequencies needs to be expanded as well */
-                hap_frequencies = (int *)realloc(hap_frequencies, 
-                                                 nextsam*sizeof(int));
-                /* expand unic_frequencies as well */
-                unic_frequencies = (int *)realloc(unic_frequencies, 
-                                                  nextsam*sizeof(int));
+        /* read replicates into the batch until it is full, the data runs
+         * out or the next replicate is too big for the lists */
+        nrep = 0;
+        do {
+            /* for the number of samples, read in each line, first
+             * pulling off the sample identifier. */
+            for (i=0; i<nsam; i++) {
+                if (fgets(line, maxline, stdin) == NULL)
+                    exit(EXIT_FAILURE);
+                sscanf(line, "%s %s", smallbuf, lists[nrep][i]);
+            }
+
+            /* hand the data matrix over to the library */
+            reps[nrep].nsam = nsam;
+            reps[nrep].nsites = nsites;
+            reps[nrep].alphabet = SS_AGCT;
+            reps[nrep].encoding = SS_ASCII;
+            reps[nrep].data = (unsigned char *)lists[nrep][0];
+            reps[nrep].stride = maxsites + 1;
+            nrep++;
+
+            /* see if there's another replicate coming; again, its first
+             * line should be phylip-style " NSAM NSITES". If not, zero out
+             * nsam and nsites to kill the loops that are running this */
+            if (fgets(line, maxline, stdin) != NULL) {
+                sscanf(line, " %d %d", &nsam, &nsites);
+            } else {
+                nsam = 0;
+                nsites = 0;
+            }
+        } while (nrep < batch_size && nsam > 0 && nsites > 0
+                 && nsam <= maxsam && nsites <= maxsites);
+
+        if (win_width > 0.0) {
+            /* one line per window, which are laid out on the columns */
+            for (r=0; r<nrep; r++) {
+                nwin = ss_num_windows(reps[r].nsites, win_width, win_step);
+                if (nwin > maxwin) {
+                    maxwin = nwin;
+                    windows = (struct ss_window *)realloc(windows, maxwin*sizeof(struct ss_window));
+                    if (windows == NULL) {
+                        perror("realloc error. couldn't make room for the windows");
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                if (ss_compute_windows(reps + r, NULL, reps[r].nsites, win_width, win_step,
+                                       stats, ws, windows) != nwin) {
+                    perror("error in ss_compute_windows");
+                    exit(EXIT_FAILURE);
+                }
+                for (i=0; i<nwin; i++) {
+                    printf("window_start:\t%g\twindow_end:\t%g\t", windows[i].start, windows[i].end);
+                    print_results(stats & SS_WINDOW_STATS, &windows[i].res);
+                    puts("");
+                }
             }
-            if (nextsites > nsites) {
-                /* first, we'll need a bigger line buffer */
-                maxline = nextsites + 100;
-                line = (char *)realloc(line, (maxline+1)*sizeof(char));
-                if (line == NULL)
-                    perror("realloc error. couldn't make line bigger");
-
-                /* free up and re-create site_frequencies structure */
-                for (i=0; i<nsites; i++)
-                    free(site_frequencies[i]);
-                free(site_frequencies);
-                /* now reallocate enough space for the number of sites in the data */
-                site_frequencies = (int **)malloc(nextsites*sizeof(int*));
-                /* initialize each site array */
-                for (i=0; i<nextsites; i++)
-                    site_frequencies[i] = (int *)malloc((4*sizeof(int)));
-                
-                /* finally, if nextsam is not bigger than the current nsam, 
-                 * then we need to reallocate space in the list */
-                biggerlist(nsam, nextsites, list);
-            } 
-            nsam = nextsam;
-            nsites = nextsites;
         } else {
-            /* we're at the end of the file, zero out nsam or segsites to
-             * kill the while loop that's running this */
-            nsam = 0;
-            nsites = 0;
+            if (batch_size == 1) {
+                if (ss_compute(reps, stats, ws, res) != SS_OK) {
+                    perror("error in ss_compute");
+                    exit(EXIT_FAILURE);
+                }
+            } else if (ss_compute_batch(reps, nrep, stats, ws, res) != SS_OK) {
+                perror("error in ss_compute_batch");
+                exit(EXIT_FAILURE);
+            }
+            for (r=0; r<nrep; r++) {
+                print_results(stats, res + r);
+                puts("");
+            }
+        }
+
+        /* if the next replicate has more samples or sites than the lists
+         * have room for, we will have to make bigger lists */
+        if (nsam > maxsam || nsites > maxsites) {
+            if (nsam > maxsam)
+                maxsam = nsam;
+            if (nsites > maxsites)
+                maxsites = nsites;
+            make_room(batch_size, maxsam, maxsites, lists, res);
         }
+        if (nsites + 100 > maxline) {
+            /* we'll need a bigger line buffer */
+            maxline = nsites + 100;
+            line = (char *)realloc(line, (maxline+1)*sizeof(char));
+            if (line == NULL)
+                perror("realloc error. couldn't make line bigger");
+        } 
+    }
+
+    ss_workspace_free(ws);
+    for (r=0; r<batch_size; r++) {
+        free_list(lists[r]);
+        free(res[r].sfs);
+        free(res[r].hfs);
+        free(res[r].mismatch);
     }
+    free(lists);
+    free(reps);
+    free(res);
+    free(line);
+    free(windows);
     
     exit(EXIT_SUCCESS);
 }
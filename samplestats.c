@@ -0,0 +1,1813 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#include "samplestats.h"
+#include "haplotypes.h"
+#include "binary_sites.h"
+#include "agct_sites.h"
+#include "fs.h"
+#include "r2.h"
+#include "tajd.h"
+#include "sfs_tests.h"
+#include "ld.h"
+#include "ehh.h"
+#include "distance.h"
+#include "pops.h"
+#include "packed.h"
+#include "isa.h"
+#include "perf.h"
+#include "memo.h"
+#include "batch.h"
+
+/* A sample's window hash, for sorting the samples by it */
+struct win_entry {
+    uint64_t hash;              /* the hash */
+    int     sample;             /* the sample (-1 once counted) */
+};
+
+/* Scratch space reused from one replicate to the next. Arrays only ever
+ * grow, so once the largest replicate has been seen no more memory is
+ * allocated. */
+struct ss_workspace {
+    int     maxsam,             /* number of samples we have room for */
+            maxsites;           /* number of sites we have room for */
+    char    **rows;             /* row pointers into the data (or unpacked) */
+    char    *unpacked;          /* rows converted to '0'/'1' chars, when the
+                                 *   caller's encoding is not ASCII */
+    int     *site_freqs,        /* binary: count of '1's per site */
+            *agct_counts,       /* agct: 4 counts per site, contiguous */
+            **agct_freqs,       /* agct: per site pointers into agct_counts */
+            *hap_freqs,         /* counts per haplotype (length nsam) */
+            *hap_counts,        /* the same counts, largest first (length nsam) */
+            *unic_freqs,        /* unique sites per sample (length nsam) */
+            *sfs;               /* site frequency spectrum (length nsam+1; for
+                                 *   binary data sfs[i] counts the sites with
+                                 *   i derived alleles, fixed ones included) */
+    uint64_t *rowbits,          /* small binary replicates: packed rows, */
+            *cols,              /*   per site column words */
+            *hashes;            /*   and row hashes (length nsam) */
+    size_t  rowbits_size,       /* number of words rowbits has room for */
+            cols_size;          /* number of words cols has room for */
+    double  *qew;               /* Fu's Fs table (FS_QEW_SIZE(qew_sam)) */
+    int     qew_sam;            /* number of samples the Fs table has room for */
+    struct fu_li_coeffs
+            fl;                 /* Fu & Li coefficients for fl.nsam samples */
+    struct ld_scratch
+            ld;                 /* pairwise LD columns and sums */
+    int     ld_window,          /* limits set by ss_set_ld() */
+            ld_threads;
+    long    ld_max_pairs;
+    struct ehh_scratch
+            ehh;                /* iHS and nSL scans */
+    struct dist_scratch
+            dist;               /* pairwise differences between samples */
+    int     *pop_labels;        /* population of each sample (length nsam) */
+    uint64_t *pop_masks;        /* sample mask of each population
+                                 *   (SS_MAXPOPS * PACKED_WORDS(nsam)) */
+    uint64_t *sub_masks;        /* sample mask of each subsample */
+    int     *sub_hist;          /* spectrum of each subsample (nsam+1 each) */
+    size_t  sub_masks_size,     /* number of words sub_masks has room for */
+            sub_hist_size;      /* number of ints sub_hist has room for */
+    int64_t *win_sums;          /* windows: WIN_SUMS running sums per site */
+    uint64_t *win_hashes;       /* windows: a hash per sample */
+    struct win_entry
+            *win_sorted;        /* and the samples sorted by it */
+    int     win_sites,          /* number of sites win_sums has room for */
+            win_sam;            /* number of samples win_hashes has room for */
+    struct ss_profile
+            *prof;              /* where the phases are timed, or NULL */
+    int     prof_bucket;        /* size bucket of the current replicate */
+    struct perf_counters
+            perf;               /* hardware event counters, for prof */
+    unsigned long long
+            perf_start[PERF_COUNTERS];
+                                /* their counts when the phase started */
+    struct memo
+            memo;               /* recent replicates' results (ss_set_cache()) */
+    struct batch_scratch
+            batch;              /* base counts of a batch (ss_compute_batch()) */
+};
+
+/* Statistics worked out from the site frequency spectrum */
+#define SFS_STATS   (SS_PI | SS_D | SS_THETAH | SS_H | SS_THETAW | SS_R2 | SS_FS | SS_SFS \
+                     | SS_FULID | SS_FULIF | SS_FULIDS | SS_FULIFS | SS_HNORM | SS_ZENGE)
+
+/* Pairwise LD statistics, binary data only */
+#define LD_STATS    (SS_ZNS | SS_OMEGA)
+
+/* Statistics that need the ancestral state, so binary data only */
+#define UNFOLDED_STATS (SS_THETAH | SS_H | SS_FULID | SS_FULIF | SS_HNORM | SS_ZENGE)
+
+/* Statistics worked out from the pairwise differences between samples */
+#define DIST_STATS  (SS_MISMATCH | SS_MMVAR | SS_RAGGED)
+
+/* Statistics worked out from the sorted haplotype count table */
+#define GARUD_STATS (SS_H1 | SS_H12 | SS_H2H1 | SS_HFS)
+
+/* Statistics that need the haplotype counts */
+#define HAP_STATS   (SS_NH | SS_NS | SS_HO | SS_HF | SS_IH | SS_FS | GARUD_STATS)
+
+/* Statistics ss_compute_batch() works out from the base counts of a batch */
+#define BATCH_STATS (SS_PI | SS_SS | SS_D | SS_THETAW | SS_NSS | SS_R2 | HAP_STATS)
+
+/* Running sums kept per site for the windows: entry WIN_SUMS*j + k holds
+ * the sum over the sites before j, so a window's sums are one subtraction */
+#define WIN_SS      0           /* sites counted by ss */
+#define WIN_PI      1           /* pi * n(n-1)/2, an integer per site */
+#define WIN_TH      2           /* theta H * n(n-1)/2 (binary data) */
+#define WIN_NSS     3           /* singleton sites */
+#define WIN_SUMS    4
+
+/* names of the profiled phases, in SS_PROF_* order */
+static const char *prof_names[SS_PROF_PHASES] = {
+    "load", "site frequencies", "spectrum", "unique sites", "haplotypes", "Fs",
+    "pairwise LD", "distances", "EHH", "windows", "populations", "subsamples"
+};
+
+/*  Read the monotonic clock
+ *
+ *  Returns the time in seconds from some fixed point
+ */
+double ss_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/*  Start timing a phase
+ *
+ *      ws          - the workspace
+ *
+ *  Returns the time it started, or 0 if nothing is being profiled
+ */
+static double prof_start(struct ss_workspace *ws)
+{
+    if (ws->prof == NULL)
+        return 0.0;
+    if (ws->prof->counters)
+        perf_read(&ws->perf, ws->perf_start);
+    return ss_clock();
+}
+
+/*  Stop timing a phase and add it to the profile, with the events it
+ *    took in the current replicate's size bucket
+ *
+ *      ws          - the workspace
+ *      phase       - the phase (SS_PROF_*)
+ *      t0          - what prof_start() gave
+ *
+ *  Returns nothing
+ */
+static void prof_end(struct ss_workspace *ws, int phase, double t0)
+{
+    unsigned long long now[PERF_COUNTERS];
+                                /* the event counts at the end */
+    int     k;                  /* iterator */
+
+    if (ws->prof == NULL)
+        return;
+    ws->prof->seconds[phase] += ss_clock() - t0;
+    ws->prof->calls[phase]++;
+    if (ws->prof->counters) {
+        perf_read(&ws->perf, now);
+        for (k=0; k<PERF_COUNTERS; k++)
+            ws->prof->events[ws->prof_bucket][phase][k] += now[k] - ws->perf_start[k];
+        ws->prof->bucket_calls[ws->prof_bucket][phase]++;
+    }
+}
+
+/*  Create an empty workspace
+ *
+ *  Returns a pointer to the workspace, or NULL if out of memory
+ */
+struct ss_workspace *ss_workspace_new(void)
+{
+    struct ss_workspace *ws;
+
+    if ((ws = (struct ss_workspace *)calloc(1, sizeof(struct ss_workspace))) != NULL)
+        ws->ld_threads = 1;
+    return ws;
+}
+
+/*  Free a workspace and everything it holds
+ *
+ *      ws          - the workspace
+ *
+ *  Returns nothing
+ */
+void ss_workspace_free(struct ss_workspace *ws)
+{
+    if (ws == NULL)
+        return;
+    free(ws->rows);
+    free(ws->unpacked);
+    free(ws->site_freqs);
+    free(ws->agct_counts);
+    free(ws->agct_freqs);
+    free(ws->hap_freqs);
+    free(ws->hap_counts);
+    free(ws->unic_freqs);
+    free(ws->sfs);
+    free(ws->rowbits);
+    free(ws->cols);
+    free(ws->hashes);
+    free(ws->qew);
+    ld_scratch_free(&ws->ld);
+    ehh_scratch_free(&ws->ehh);
+    dist_scratch_free(&ws->dist);
+    free(ws->pop_labels);
+    free(ws->pop_masks);
+    free(ws->sub_masks);
+    free(ws->sub_hist);
+    free(ws->win_sums);
+    free(ws->win_hashes);
+    free(ws->win_sorted);
+    if (ws->perf.nopen > 0)
+        perf_close(&ws->perf);
+    memo_free(&ws->memo);
+    batch_scratch_free(&ws->batch);
+    free(ws);
+}
+
+/*  Make sure the workspace can hold a replicate of the given size
+ *
+ *      ws          - the workspace
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *      unpack      - 1 if room for unpacked rows is needed
+ *      packed      - 1 if room for packed rows and columns is needed
+ *      fs          - 1 if room for the Fu's Fs table is needed
+ *
+ *  Returns SS_OK or SS_ENOMEM
+ */
+static int reserve(struct ss_workspace *ws, int nsam, int nsites, int unpack, int packed,
+                   int fs)
+{
+    void    *p;                 /* result of each reallocation */
+    size_t  n;                  /* number of words needed */
+    int     i;                  /* iterator */
+    int     grow_sam,           /* 1 if the sample arrays must grow */
+            grow_sites;         /* 1 if the site arrays must grow */
+
+    grow_sam = nsam > ws->maxsam;
+    grow_sites = nsites > ws->maxsites;
+
+    if (grow_sam) {
+        if (!(p = realloc(ws->rows, nsam*sizeof(char *))))
+            return SS_ENOMEM;
+        ws->rows = (char **)p;
+        if (!(p = realloc(ws->hap_freqs, nsam*sizeof(int))))
+            return SS_ENOMEM;
+        ws->hap_freqs = (int *)p;
+        if (!(p = realloc(ws->hap_counts, nsam*sizeof(int))))
+            return SS_ENOMEM;
+        ws->hap_counts = (int *)p;
+        if (!(p = realloc(ws->unic_freqs, nsam*sizeof(int))))
+            return SS_ENOMEM;
+        ws->unic_freqs = (int *)p;
+        if (!(p = realloc(ws->sfs, (nsam + 1)*sizeof(int))))
+            return SS_ENOMEM;
+        ws->sfs = (int *)p;
+        if (!(p = realloc(ws->hashes, nsam*sizeof(uint64_t))))
+            return SS_ENOMEM;
+        ws->hashes = (uint64_t *)p;
+        if (!(p = realloc(ws->pop_labels, nsam*sizeof(int))))
+            return SS_ENOMEM;
+        ws->pop_labels = (int *)p;
+        if (!(p = realloc(ws->pop_masks, (size_t)SS_MAXPOPS*PACKED_WORDS(nsam)*sizeof(uint64_t))))
+            return SS_ENOMEM;
+        ws->pop_masks = (uint64_t *)p;
+    }
+
+    if (grow_sites) {
+        if (!(p = realloc(ws->site_freqs, nsites*sizeof(int))))
+            return SS_ENOMEM;
+        ws->site_freqs = (int *)p;
+        if (!(p = realloc(ws->agct_counts, 4*nsites*sizeof(int))))
+            return SS_ENOMEM;
+        ws->agct_counts = (int *)p;
+        if (!(p = realloc(ws->agct_freqs, nsites*sizeof(int *))))
+            return SS_ENOMEM;
+        ws->agct_freqs = (int **)p;
+        for (i=0; i<nsites; i++)
+            ws->agct_freqs[i] = ws->agct_counts + 4*i;
+    }
+
+    if (grow_sam || grow_sites) {
+        /* unpacked rows are laid out by maxsites, so start them over */
+        free(ws->unpacked);
+        ws->unpacked = NULL;
+        if (grow_sam)
+            ws->maxsam = nsam;
+        if (grow_sites)
+            ws->maxsites = nsites;
+    }
+
+    if (unpack && ws->unpacked == NULL) {
+        if (!(ws->unpacked = (char *)malloc((size_t)ws->maxsam*(ws->maxsites + 1))))
+            return SS_ENOMEM;
+    }
+
+    if (packed) {
+        n = (size_t)nsam*PACKED_WORDS(nsites);
+        if (n > ws->rowbits_size) {
+            if (!(p = realloc(ws->rowbits, n*sizeof(uint64_t))))
+                return SS_ENOMEM;
+            ws->rowbits = (uint64_t *)p;
+            ws->rowbits_size = n;
+        }
+        n = (size_t)nsites*PACKED_COLWORDS(nsam);
+        if (n > ws->cols_size) {
+            if (!(p = realloc(ws->cols, n*sizeof(uint64_t))))
+                return SS_ENOMEM;
+            ws->cols = (uint64_t *)p;
+            ws->cols_size = n;
+        }
+    }
+
+    if (fs && nsam > ws->qew_sam) {
+        if (!(p = realloc(ws->qew, FS_QEW_SIZE(nsam)*sizeof(double))))
+            return SS_ENOMEM;
+        ws->qew = (double *)p;
+        ws->qew_sam = nsam;
+    }
+
+    return SS_OK;
+}
+
+/*  Point the workspace rows at the replicate's data, converting it to
+ *    '0'/'1' characters first if it is not already ASCII
+ *
+ *      rep         - the replicate
+ *      ws          - the workspace
+ *
+ *  Returns nothing
+ */
+static void load_rows(const struct ss_replicate *rep, struct ss_workspace *ws)
+{
+    int                 i, j;   /* iterators */
+    const unsigned char *src;   /* current row of the caller's buffer */
+    char                *dst;   /* current unpacked row */
+
+    for (i=0; i<rep->nsam; i++) {
+        src = rep->data + (size_t)i*rep->stride;
+        if (rep->encoding == SS_ASCII) {
+            ws->rows[i] = (char *)src;
+            continue;
+        }
+        dst = ws->unpacked + (size_t)i*(ws->maxsites + 1);
+        if (rep->encoding == SS_BYTES) {
+            for (j=0; j<rep->nsites; j++)
+                dst[j] = src[j] ? '1' : '0';
+        } else {
+            for (j=0; j<rep->nsites; j++)
+                dst[j] = (src[j >> 3] >> (j & 7)) & 1 ? '1' : '0';
+        }
+        dst[rep->nsites] = '\0';
+        ws->rows[i] = dst;
+    }
+}
+
+/*  Pack the rows of a small binary replicate into words
+ *
+ *      rep         - the replicate
+ *      ws          - the workspace
+ *
+ *  Returns nothing
+ */
+static void pack_rows(const struct ss_replicate *rep, struct ss_workspace *ws)
+{
+    if (rep->encoding == SS_ASCII)
+        ss_kernels()->pack_rows_ascii(rep->nsam, rep->nsites, rep->data, rep->stride, ws->rowbits);
+    else if (rep->encoding == SS_BYTES)
+        pack_rows_bytes(rep->nsam, rep->nsites, rep->data, rep->stride, ws->rowbits);
+    else
+        pack_rows_bits(rep->nsam, rep->nsites, rep->data, rep->stride, ws->rowbits);
+}
+
+/*  Calculate Fu's Fs, or find it in the cache
+ *
+ *      ws          - the workspace, with room for the Fs table
+ *      nsam        - number of samples
+ *      pi          - nucleotide diversity
+ *      nh          - number of haplotypes
+ *
+ *  Returns Fs
+ */
+static double fu_fs(struct ss_workspace *ws, int nsam, double pi, int nh)
+{
+    double  fs;                 /* the result */
+
+    if (ws->memo.entries > 0 && memo_fetch_fs(&ws->memo, nsam, pi, nh, &fs))
+        return fs;
+    fs = Fs_qew(nsam, pi, nh, ws->qew);
+    memo_store_fs(&ws->memo, nsam, pi, nh, fs);
+    return fs;
+}
+
+/*  Sort the haplotype counts into a table, largest first, and fill in
+ *    Garud's H statistics and the haplotype frequency spectrum from it
+ *
+ *      nsam        - number of samples
+ *      mask        - the statistics wanted
+ *      ws          - the workspace, with hap_freqs filled in
+ *      out         - where to put the results
+ *
+ *  Returns nothing
+ */
+static void haplotype_table(int nsam, unsigned mask, struct ss_workspace *ws,
+                            struct ss_results *out)
+{
+    int     nh;                 /* number of haplotypes */
+    double  h1, h12, h2h1;      /* Garud's H statistics */
+
+    nh = haplotype_count_table(nsam, ws->hap_freqs, ws->hap_counts);
+    garud_h(nsam, nh, ws->hap_counts, &h1, &h12, &h2h1);
+    if (mask & SS_H1)
+        out->h1 = h1;
+    if (mask & SS_H12)
+        out->h12 = h12;
+    if (mask & SS_H2H1)
+        out->h2h1 = h2h1;
+    if (mask & SS_HFS) {
+        memcpy(out->hfs, ws->hap_counts, nh*sizeof(int));
+        out->hfs_len = nh;
+    }
+}
+
+/*  Fill in the mismatch distribution and the statistics of its shape
+ *    from the pairwise differences in the workspace
+ *
+ *      nsam        - number of samples
+ *      mask        - the statistics wanted
+ *      ws          - the workspace, with the distance matrix filled in
+ *      out         - where to put the results
+ *
+ *  Returns nothing
+ */
+static void mismatch_stats(int nsam, unsigned mask, struct ss_workspace *ws,
+                           struct ss_results *out)
+{
+    int     len;                /* classes of the distribution */
+    double  mean, var, rag;     /* its moments and raggedness */
+
+    len = dist_mismatch(nsam, ws->dist.dist, ws->dist.counts);
+    dist_mismatch_moments(len, ws->dist.counts, &mean, &var, &rag);
+    if (mask & SS_MMVAR)
+        out->mmvar = var;
+    if (mask & SS_RAGGED)
+        out->ragged = rag;
+    if (mask & SS_MISMATCH) {
+        memcpy(out->mismatch, ws->dist.counts, len*sizeof(long));
+        out->mismatch_len = len;
+    }
+}
+
+/*  Calculate the requested statistics for binary data. Replicates of up
+ *    to PACKED_MAXSAM samples go through the bit-packed kernels, bigger
+ *    ones through the character rows.
+ *
+ *      rep         - the replicate
+ *      mask        - the statistics wanted
+ *      ws          - the workspace, with rows loaded (or packed)
+ *      out         - where to put the results
+ *
+ *  Returns nothing
+ */
+static void compute_binary(const struct ss_replicate *rep, unsigned mask,
+                           struct ss_workspace *ws, struct ss_results *out)
+{
+    int     i,                  /* iterator */
+            nsam,               /* number of samples */
+            segsites,           /* number of segregating sites */
+            nh,                 /* number of haplotypes */
+            packed,             /* 1 if the rows were packed */
+            *sfs,               /* the spectrum proper (classes 1..nsam-1) */
+            eta,                /* sites that really segregate */
+            single;             /* singletons, derived or ancestral */
+    const struct ss_kernels *k; /* kernels for this CPU */
+    struct ld_summary ld;       /* pairwise LD summaries */
+    double  pi,                 /* nucleotide diversity */
+            th,                 /* Fay's theta H */
+            tl,                 /* Zeng et al's theta L */
+            t0;                 /* when the current phase started */
+
+    nsam = rep->nsam;
+    segsites = rep->nsites;
+    packed = nsam <= PACKED_MAXSAM;
+    k = ss_kernels();
+    pi = th = 0.0;
+    nh = eta = 0;
+
+    /* fill in the site frequencies array */
+    if (mask & (SFS_STATS | SS_NSS | LD_STATS)) {
+        t0 = prof_start(ws);
+        if (packed) {
+            packed_columns(nsam, segsites, ws->rowbits, ws->cols);
+            k->site_frequencies(nsam, segsites, ws->cols, ws->site_freqs);
+        } else {
+            for (i=0; i<segsites; i++)
+                ws->site_freqs[i] = frequency('1', i, nsam, ws->rows);
+        }
+        prof_end(ws, SS_PROF_SITES, t0);
+    }
+
+    /* histogram the site frequencies; the site frequency statistics all
+     * come from here. Sites the data lists that do not segregate go in
+     * classes 0 and nsam, where theta H and theta W still count them */
+    sfs = ws->sfs + 1;
+    if (mask & SFS_STATS) {
+        t0 = prof_start(ws);
+        for (i=0; i<=nsam; i++)
+            ws->sfs[i] = 0;
+        for (i=0; i<segsites; i++)
+            ws->sfs[ws->site_freqs[i]]++;
+        eta = sfs_segsites(nsam - 1, sfs);
+        if (mask & SS_SFS) {
+            memcpy(out->sfs, sfs, (nsam - 1)*sizeof(int));
+            out->sfs_len = nsam - 1;
+        }
+        prof_end(ws, SS_PROF_SFS, t0);
+    }
+
+    /* fill in the unic_frequencies array if necessary */
+    if (mask & SS_R2) {
+        t0 = prof_start(ws);
+        if (packed)
+            packed_unic_frequencies(nsam, segsites, ws->cols, ws->site_freqs, ws->unic_freqs);
+        else
+            count_binary_unic_frequencies(nsam, segsites, ws->rows, ws->site_freqs, ws->unic_freqs);
+        prof_end(ws, SS_PROF_UNIC, t0);
+    }
+
+    /* count up the haplotype frequencies if we are going to use them */
+    if (mask & HAP_STATS) {
+        t0 = prof_start(ws);
+        if (packed) {
+            k->row_hashes(nsam, segsites, ws->rowbits, ws->hashes);
+            packed_haplotype_frequencies(nsam, segsites, ws->rowbits, ws->hashes, ws->hap_freqs);
+        } else {
+            count_haplotype_frequencies(nsam, segsites, ws->rows, ws->hap_freqs);
+        }
+        prof_end(ws, SS_PROF_HAPLOTYPES, t0);
+    }
+
+    if (mask & (SS_PI | SS_D | SS_H | SS_R2 | SS_FS | SS_FULIF | SS_FULIFS | SS_HNORM))
+        pi = sfs_theta_pi(nsam, nsam - 1, sfs);
+
+    if (mask & (SS_THETAH | SS_H))
+        th = sfs_theta_h(nsam, nsam, sfs);
+
+    if (mask & (SS_NH | SS_HF | SS_FS))
+        nh = num_haplotypes(nsam, ws->hap_freqs);
+
+    out->pi = pi;
+    out->ss = segsites;
+    out->thetaH = th;
+    out->nh = nh;
+    if (mask & SS_D)
+        out->D = tajd(nsam, segsites, pi);
+    if (mask & SS_H)
+        out->H = pi - th;
+    if (mask & SS_THETAW)
+        out->thetaW = segsites/a1f(nsam);
+    if (mask & SS_NS)
+        out->ns = num_singletons(nsam, ws->hap_freqs);
+    if (mask & SS_HO)
+        out->ho = homozygosity(nsam, ws->hap_freqs);
+    if (mask & SS_NSS)
+        out->nss = num_singleton_sites(segsites, ws->site_freqs);
+    if (mask & SS_HF)
+        out->hf = (double)nsam/(double)nh;
+    if (mask & SS_IH)
+        out->ih = max_identical_haplotypes(nsam, ws->hap_freqs);
+    if (mask & GARUD_STATS)
+        haplotype_table(nsam, mask, ws, out);
+    if (mask & SS_R2)
+        out->r2 = R2(ws->unic_freqs, pi, nsam, segsites);
+    if (mask & SS_FS) {
+        t0 = prof_start(ws);
+        out->fs = fu_fs(ws, nsam, pi, nh);
+        prof_end(ws, SS_PROF_FS, t0);
+    }
+    if (mask & SS_FULID)
+        out->fuliD = fu_li_d(&ws->fl, eta, sfs[0]);
+    if (mask & SS_FULIF)
+        out->fuliF = fu_li_f(&ws->fl, eta, sfs[0], pi);
+    if (mask & (SS_FULIDS | SS_FULIFS)) {
+        single = nsam > 2 ? sfs[0] + sfs[nsam-2] : eta;
+        if (mask & SS_FULIDS)
+            out->fuliDs = fu_li_d_star(&ws->fl, eta, single);
+        if (mask & SS_FULIFS)
+            out->fuliFs = fu_li_f_star(&ws->fl, eta, single, pi);
+    }
+    if (mask & (SS_HNORM | SS_ZENGE)) {
+        tl = sfs_theta_l(nsam, sfs);
+        if (mask & SS_HNORM)
+            out->Hn = fay_wu_h_norm(nsam, eta, pi, tl);
+        if (mask & SS_ZENGE)
+            out->E = zeng_e(nsam, eta, tl);
+    }
+    if (mask & LD_STATS) {
+        t0 = prof_start(ws);
+        /* big replicates get their columns built here, in the LD scratch */
+        if (!packed)
+            ld_columns_rows(nsam, segsites, ws->rows, ws->ld.cols);
+        ld_summarise(nsam, segsites, packed ? ws->cols : ws->ld.cols, ws->site_freqs,
+                     ws->ld_window, ws->ld_max_pairs, ws->ld_threads, &ws->ld, &ld);
+        out->zns = ld.zns;
+        out->omega = ld.omega;
+        prof_end(ws, SS_PROF_LD, t0);
+    }
+    if (mask & DIST_STATS) {
+        t0 = prof_start(ws);
+        /* big replicates get their rows packed here, in the distance scratch */
+        if (!packed)
+            dist_pack_rows(nsam, segsites, ws->rows, ws->dist.rows);
+        dist_matrix(nsam, PACKED_WORDS(segsites), packed ? ws->rowbits : ws->dist.rows, 0,
+                    ws->ld_threads, ws->dist.dist);
+        mismatch_stats(nsam, mask, ws, out);
+        prof_end(ws, SS_PROF_DIST, t0);
+    }
+
+    out->mask = mask;
+}
+
+/*  Fill in the statistics of a nucleotide replicate that follow from pi,
+ *    the number of segregating sites and the haplotype and unique site
+ *    counts in the workspace
+ *
+ *      nsam        - number of samples
+ *      mask        - the statistics wanted
+ *      ws          - the workspace, with hap_freqs and unic_freqs filled
+ *                    in if they are needed
+ *      pi          - nucleotide diversity
+ *      segsites    - number of segregating sites
+ *      out         - where to put the results
+ *
+ *  Returns nothing
+ */
+static void agct_stats(int nsam, unsigned mask, struct ss_workspace *ws, double pi,
+                       int segsites, struct ss_results *out)
+{
+    int     nh;                 /* number of haplotypes */
+    double  t0;                 /* when the current phase started */
+
+    nh = 0;
+    if (mask & (SS_NH | SS_HF | SS_FS))
+        nh = num_haplotypes(nsam, ws->hap_freqs);
+
+    out->pi = pi;
+    out->ss = segsites;
+    out->nh = nh;
+    if (mask & SS_D)
+        out->D = tajd(nsam, segsites, pi);
+    if (mask & SS_THETAW)
+        out->thetaW = agct_theta_w(nsam, segsites);
+    if (mask & SS_NS)
+        out->ns = num_singletons(nsam, ws->hap_freqs);
+    if (mask & SS_HO)
+        out->ho = homozygosity(nsam, ws->hap_freqs);
+    if (mask & SS_HF)
+        out->hf = (double)nsam/(double)nh;
+    if (mask & SS_IH)
+        out->ih = max_identical_haplotypes(nsam, ws->hap_freqs);
+    if (mask & GARUD_STATS)
+        haplotype_table(nsam, mask, ws, out);
+    if (mask & SS_R2)
+        out->r2 = R2(ws->unic_freqs, pi, nsam, segsites);
+    if (mask & SS_FS) {
+        t0 = prof_start(ws);
+        out->fs = fu_fs(ws, nsam, pi, nh);
+        prof_end(ws, SS_PROF_FS, t0);
+    }
+}
+
+/*  Calculate the requested statistics for nucleotide data. The
+ *    statistics that need the ancestral state to be known (Fay's H, H,
+ *    Fu & Li's D and F, normalised H and E) and the pairwise LD ones are
+ *    never filled in, and D*
+ *    and F* use the folded spectrum, which only counts biallelic sites.
+ *
+ *      rep         - the replicate
+ *      mask        - the statistics wanted
+ *      ws          - the workspace, with rows loaded
+ *      out         - where to put the results
+ *
+ *  Returns nothing
+ */
+static void compute_agct(const struct ss_replicate *rep, unsigned mask,
+                         struct ss_workspace *ws, struct ss_results *out)
+{
+    int     nsam,               /* number of samples */
+            nsites,             /* number of sites */
+            segsites,           /* number of segregating sites */
+            len,                /* length of the folded spectrum */
+            eta;                /* biallelic sites */
+    double  pi,                 /* nucleotide diversity */
+            fpi,                /* pi over the biallelic sites only */
+            t0;                 /* when the current phase started */
+
+    nsam = rep->nsam;
+    nsites = rep->nsites;
+    mask &= ~(UNFOLDED_STATS | LD_STATS);
+    pi = 0.0;
+    segsites = 0;
+
+    if (mask & (SFS_STATS | SS_SS | SS_NSS)) {
+        t0 = prof_start(ws);
+        calculate_site_frequencies(nsam, nsites, ws->rows, ws->agct_freqs);
+        prof_end(ws, SS_PROF_SITES, t0);
+    }
+
+    if (mask & (SS_SFS | SS_FULIDS | SS_FULIFS)) {
+        t0 = prof_start(ws);
+        len = folded_site_frequency_spectrum(nsam, nsites, ws->agct_freqs, ws->sfs);
+        if (mask & SS_SFS) {
+            memcpy(out->sfs, ws->sfs, len*sizeof(int));
+            out->sfs_len = len;
+        }
+        eta = sfs_segsites(len, ws->sfs);
+        fpi = sfs_theta_pi(nsam, len, ws->sfs);
+        if (mask & SS_FULIDS)
+            out->fuliDs = fu_li_d_star(&ws->fl, eta, len > 0 ? ws->sfs[0] : 0);
+        if (mask & SS_FULIFS)
+            out->fuliFs = fu_li_f_star(&ws->fl, eta, len > 0 ? ws->sfs[0] : 0, fpi);
+        prof_end(ws, SS_PROF_SFS, t0);
+    }
+
+    if (mask & HAP_STATS) {
+        t0 = prof_start(ws);
+        count_haplotype_frequencies(nsam, nsites, ws->rows, ws->hap_freqs);
+        prof_end(ws, SS_PROF_HAPLOTYPES, t0);
+    }
+
+    /* fill in the unic_frequencies array if necessary */
+    if (mask & SS_R2) {
+        t0 = prof_start(ws);
+        count_agct_unic_frequencies(nsam, nsites, ws->rows, ws->agct_freqs, ws->unic_freqs);
+        prof_end(ws, SS_PROF_UNIC, t0);
+    }
+
+    /* pi counts the multiallelic sites too, so it comes from the sites */
+    if (mask & (SS_PI | SS_D | SS_R2 | SS_FS))
+        pi = (double)agct_pair_differences(nsam, nsites, ws->agct_freqs)*2.0
+             /((double)nsam*(nsam - 1));
+
+    if (mask & (SS_SS | SS_THETAW | SS_D | SS_R2))
+        segsites = num_segregating_sites(nsam, nsites, ws->agct_freqs);
+
+    if (mask & SS_NSS)
+        out->nss = agct_num_singleton_sites(nsites, ws->agct_freqs);
+    agct_stats(nsam, mask, ws, pi, segsites, out);
+    if (mask & DIST_STATS) {
+        t0 = prof_start(ws);
+        dist_pack_agct(nsam, nsites, ws->rows, ws->dist.rows);
+        dist_matrix(nsam, DIST_AGCT_WORDS(nsites), ws->dist.rows, 1, ws->ld_threads,
+                    ws->dist.dist);
+        mismatch_stats(nsam, mask, ws, out);
+        prof_end(ws, SS_PROF_DIST, t0);
+    }
+
+    out->mask = mask;
+}
+
+/*  Check a replicate description
+ *
+ *      rep         - the replicate
+ *
+ *  Returns 1 if it can be worked on, 0 if not
+ */
+static int valid_replicate(const struct ss_replicate *rep)
+{
+    if (rep == NULL)
+        return 0;
+    if (rep->nsam < 1 || rep->nsites < 0 || (rep->data == NULL && rep->nsites > 0))
+        return 0;
+    if (rep->alphabet != SS_BINARY && rep->alphabet != SS_AGCT)
+        return 0;
+    if (rep->encoding != SS_ASCII && (rep->alphabet != SS_BINARY ||
+                                      (rep->encoding != SS_BYTES && rep->encoding != SS_BITS)))
+        return 0;
+    return 1;
+}
+
+/*  Calculate summary statistics for one replicate
+ *
+ *      rep         - the replicate (caller-owned genotype buffer)
+ *      mask        - the statistics wanted (SS_PI | SS_D | ...)
+ *      ws          - a workspace from ss_workspace_new()
+ *      out         - where to put the results; out->mask tells which
+ *                    fields were filled in. For SS_SFS and SS_HFS,
+ *                    out->sfs and out->hfs must point at room for
+ *                    rep->nsam ints, and for SS_MISMATCH out->mismatch
+ *                    at room for rep->nsites + 1 longs
+ *
+ *  Returns SS_OK, or SS_EINVAL / SS_ENOMEM on failure
+ */
+int ss_compute(const struct ss_replicate *rep, unsigned mask,
+               struct ss_workspace *ws, struct ss_results *out)
+{
+    int     rc,                 /* return code */
+            packed;             /* 1 if the bit-packed kernels will be used */
+    double  t0;                 /* when loading started */
+    uint64_t hash;              /* of the replicate, for the cache */
+
+    if (!valid_replicate(rep) || ws == NULL || out == NULL)
+        return SS_EINVAL;
+    if ((mask & SS_SFS) && out->sfs == NULL)
+        return SS_EINVAL;
+    if ((mask & SS_HFS) && out->hfs == NULL)
+        return SS_EINVAL;
+    if ((mask & SS_MISMATCH) && out->mismatch == NULL)
+        return SS_EINVAL;
+
+    /* replicates too big to keep are not even hashed */
+    hash = 0;
+    if (memo_keeps(&ws->memo, rep)) {
+        hash = memo_hash(rep, mask);
+        if (memo_fetch(&ws->memo, rep, mask, hash, out))
+            return SS_OK;
+    }
+
+    packed = rep->alphabet == SS_BINARY && rep->nsam <= PACKED_MAXSAM;
+    if ((rc = reserve(ws, rep->nsam, rep->nsites, !packed && rep->encoding != SS_ASCII,
+                      packed, (mask & SS_FS) != 0)) != SS_OK)
+        return rc;
+    if ((mask & LD_STATS) && rep->alphabet == SS_BINARY
+        && ld_reserve(&ws->ld, rep->nsam, rep->nsites, ws->ld_threads) != 0)
+        return SS_ENOMEM;
+    if ((mask & DIST_STATS)
+        && dist_reserve(&ws->dist, rep->nsam, rep->nsites, rep->alphabet == SS_AGCT) != 0)
+        return SS_ENOMEM;
+    if ((mask & (SS_FULID | SS_FULIF | SS_FULIDS | SS_FULIFS)) && ws->fl.nsam != rep->nsam) {
+        if (fu_li_coefficients(rep->nsam, &ws->fl) != 0) {
+            ws->fl.nsam = 0;
+            return SS_ENOMEM;
+        }
+    }
+    ws->prof_bucket = SS_PROF_BUCKET(rep->nsites);
+    t0 = prof_start(ws);
+    if (packed)
+        pack_rows(rep, ws);
+    else
+        load_rows(rep, ws);
+    prof_end(ws, SS_PROF_LOAD, t0);
+
+    if (rep->alphabet == SS_BINARY)
+        compute_binary(rep, mask, ws, out);
+    else
+        compute_agct(rep, mask, ws, out);
+
+    if (hash != 0)
+        memo_store(&ws->memo, rep, mask, hash, out);
+    return SS_OK;
+}
+
+/*  Calculate the statistics of a small nucleotide replicate from its
+ *    base counts, as compute_agct() does from its site frequencies
+ *
+ *      rep         - the replicate
+ *      mask        - the statistics wanted, within BATCH_STATS
+ *      ws          - the workspace, with room for the replicate
+ *      counts      - the replicate's base counts, from batch_counts()
+ *      out         - where to put the results
+ *
+ *  Returns nothing
+ */
+static void compute_counts(const struct ss_replicate *rep, unsigned mask,
+                           struct ss_workspace *ws, const uint64_t *counts,
+                           struct ss_results *out)
+{
+    int     nsam,               /* number of samples */
+            nsites,             /* number of sites */
+            segsites;           /* number of segregating sites */
+    double  pi,                 /* nucleotide diversity */
+            t0;                 /* when the current phase started */
+    struct batch_sums
+            sums;               /* the per-site sums */
+
+    nsam = rep->nsam;
+    nsites = rep->nsites;
+    pi = 0.0;
+    segsites = 0;
+
+    if (mask & (SFS_STATS | SS_SS | SS_NSS)) {
+        t0 = prof_start(ws);
+        batch_sites(nsam, nsites, rep->data, rep->stride, counts, &sums,
+                    (mask & SS_R2) ? ws->unic_freqs : NULL);
+        prof_end(ws, SS_PROF_SITES, t0);
+        if (mask & (SS_PI | SS_D | SS_R2 | SS_FS))
+            pi = (double)sums.diffs*2.0/((double)nsam*(nsam - 1));
+        if (mask & (SS_SS | SS_THETAW | SS_D | SS_R2))
+            segsites = sums.ss;
+        if (mask & SS_NSS)
+            out->nss = sums.nss;
+    }
+
+    if (mask & HAP_STATS) {
+        t0 = prof_start(ws);
+        batch_haplotypes(nsam, nsites, rep->data, rep->stride, ws->hashes, ws->hap_freqs);
+        prof_end(ws, SS_PROF_HAPLOTYPES, t0);
+    }
+
+    agct_stats(nsam, mask, ws, pi, segsites, out);
+    out->mask = mask;
+}
+
+/*  Check whether a replicate can go into a batch
+ *
+ *      rep         - the replicate
+ *      mask        - the statistics wanted, less those for binary data only
+ *      ws          - the workspace
+ *
+ *  Returns 1 if it can, 0 if it has to go through ss_compute()
+ */
+static int batchable(const struct ss_replicate *rep, unsigned mask,
+                     const struct ss_workspace *ws)
+{
+    return rep->alphabet == SS_AGCT && rep->encoding == SS_ASCII
+           && rep->nsam <= BATCH_MAXSAM && rep->nsites <= BATCH_MAXSITES
+           && (mask & ~BATCH_STATS) == 0 && ws->memo.entries == 0;
+}
+
+/*  Calculate summary statistics for many replicates, taking the small
+ *    nucleotide ones SS_BATCH at a time
+ *
+ *      reps        - the replicates
+ *      n           - number of replicates
+ *      mask        - the statistics wanted (SS_PI | SS_D | ...)
+ *      ws          - a workspace from ss_workspace_new()
+ *      out         - where to put the results, one per replicate, each
+ *                    set up as for ss_compute()
+ *
+ *  Returns SS_OK, or SS_EINVAL / SS_ENOMEM on failure
+ */
+int ss_compute_batch(const struct ss_replicate *reps, int n, unsigned mask,
+                     struct ss_workspace *ws, struct ss_results *out)
+{
+    int     i, j,               /* iterators */
+            rc,                 /* return code */
+            nbatch,             /* replicates in the current batch */
+            batch[SS_BATCH];    /* and which they are */
+    size_t  nwords,             /* words of counts of the batch */
+            first[SS_BATCH];    /* the first word of counts of each replicate */
+    unsigned agct;              /* the mask as compute_agct() takes it */
+    double  t0;                 /* when counting started */
+    const struct ss_replicate
+            *rep;               /* the current replicate */
+
+    if (reps == NULL || n < 0 || ws == NULL || out == NULL)
+        return SS_EINVAL;
+    for (i=0; i<n; i++) {
+        if (!valid_replicate(reps + i))
+            return SS_EINVAL;
+        if (((mask & SS_SFS) && out[i].sfs == NULL) || ((mask & SS_HFS) && out[i].hfs == NULL)
+            || ((mask & SS_MISMATCH) && out[i].mismatch == NULL))
+            return SS_EINVAL;
+    }
+    agct = mask & ~(UNFOLDED_STATS | LD_STATS);
+
+    i = 0;
+    while (i < n) {
+        /* gather a batch, working out the rest as they come */
+        nbatch = 0;
+        nwords = 0;
+        for (; i<n && nbatch<SS_BATCH; i++) {
+            if (!batchable(reps + i, agct, ws)) {
+                if ((rc = ss_compute(reps + i, mask, ws, out + i)) != SS_OK)
+                    return rc;
+                continue;
+            }
+            batch[nbatch] = i;
+            first[nbatch] = nwords;
+            nwords += BATCH_WORDS(reps[i].nsites);
+            nbatch++;
+        }
+        if (nbatch == 0)
+            continue;
+
+        /* the base counts of the whole batch in one go, then the
+         * statistics of each replicate from its block of them */
+        if (batch_reserve(&ws->batch, nwords) != 0)
+            return SS_ENOMEM;
+        ws->prof_bucket = SS_PROF_BUCKET(reps[batch[0]].nsites);
+        t0 = prof_start(ws);
+        for (j=0; j<nbatch; j++) {
+            rep = reps + batch[j];
+            batch_counts(rep->nsam, rep->nsites, rep->data, rep->stride,
+                         ws->batch.counts + first[j]);
+        }
+        prof_end(ws, SS_PROF_LOAD, t0);
+        for (j=0; j<nbatch; j++) {
+            rep = reps + batch[j];
+            if ((rc = reserve(ws, rep->nsam, rep->nsites, 0, 0, (agct & SS_FS) != 0)) != SS_OK)
+                return rc;
+            ws->prof_bucket = SS_PROF_BUCKET(rep->nsites);
+            compute_counts(rep, agct, ws, ws->batch.counts + first[j], out + batch[j]);
+        }
+    }
+    return SS_OK;
+}
+
+/*  Scan a binary replicate for extended haplotype homozygosity
+ *
+ *      rep         - the replicate (caller-owned genotype buffer)
+ *      positions   - position of each site, not decreasing, or NULL to
+ *                    use the site's index
+ *      mask        - the statistics wanted (SS_IHS, SS_NSL)
+ *      ws          - a workspace from ss_workspace_new()
+ *      out         - where to put the results; the statistics are added
+ *                    to out->mask
+ *      ihs, nsl    - where to put the unstandardised value at each site,
+ *                    or NULL
+ *
+ *  Returns SS_OK, or SS_EINVAL / SS_ENOMEM on failure
+ */
+int ss_compute_ehh(const struct ss_replicate *rep, const double *positions, unsigned mask,
+                   struct ss_workspace *ws, struct ss_results *out,
+                   double *ihs, double *nsl)
+{
+    int     rc,                 /* return code */
+            j;                  /* iterator */
+    double  t0;                 /* when the scan started */
+
+    if (!valid_replicate(rep) || rep->alphabet != SS_BINARY || ws == NULL || out == NULL)
+        return SS_EINVAL;
+    if (positions != NULL)
+        for (j=1; j<rep->nsites; j++)
+            if (positions[j] < positions[j-1])
+                return SS_EINVAL;
+
+    if ((rc = reserve(ws, rep->nsam, rep->nsites, rep->encoding != SS_ASCII, 0, 0)) != SS_OK)
+        return rc;
+    if (ld_reserve(&ws->ld, rep->nsam, rep->nsites, ws->ld_threads) != 0
+        || ehh_reserve(&ws->ehh, rep->nsam, rep->nsites) != 0)
+        return SS_ENOMEM;
+    if (ihs == NULL)
+        ihs = ws->ehh.ihs;
+    if (nsl == NULL)
+        nsl = ws->ehh.nsl;
+
+    /* the columns go in the LD scratch, which has room for any sample size */
+    ws->prof_bucket = SS_PROF_BUCKET(rep->nsites);
+    t0 = prof_start(ws);
+    load_rows(rep, ws);
+    ld_columns_rows(rep->nsam, rep->nsites, ws->rows, ws->ld.cols);
+    ehh_scan(rep->nsam, rep->nsites, ws->ld.cols, positions, &ws->ehh, ihs, nsl);
+
+    if (mask & SS_IHS)
+        out->ihs = ehh_standardise(rep->nsam, rep->nsites, ws->ehh.derived, ihs);
+    if (mask & SS_NSL)
+        out->nsl = ehh_standardise(rep->nsam, rep->nsites, ws->ehh.derived, nsl);
+    out->mask |= mask & (SS_IHS | SS_NSL);
+    prof_end(ws, SS_PROF_EHH, t0);
+
+    return SS_OK;
+}
+
+/*  Load a binary replicate and build its site columns: small replicates
+ *    are packed and transposed as usual, big ones get their columns built
+ *    in the LD scratch
+ *
+ *      rep         - the replicate
+ *      ws          - the workspace
+ *      cols        - where to put a pointer to the columns
+ *                    (nsites * PACKED_WORDS(nsam) words)
+ *
+ *  Returns SS_OK or SS_ENOMEM
+ */
+static int site_columns(const struct ss_replicate *rep, struct ss_workspace *ws,
+                        uint64_t **cols)
+{
+    int     rc,                 /* return code */
+            packed;             /* 1 if the bit-packed kernels will be used */
+
+    packed = rep->nsam <= PACKED_MAXSAM;
+    if ((rc = reserve(ws, rep->nsam, rep->nsites, !packed && rep->encoding != SS_ASCII,
+                      packed, 0)) != SS_OK)
+        return rc;
+    if (!packed && ld_reserve(&ws->ld, rep->nsam, rep->nsites, ws->ld_threads) != 0)
+        return SS_ENOMEM;
+
+    if (packed) {
+        pack_rows(rep, ws);
+        packed_columns(rep->nsam, rep->nsites, ws->rowbits, ws->cols);
+        *cols = ws->cols;
+    } else {
+        load_rows(rep, ws);
+        ld_columns_rows(rep->nsam, rep->nsites, ws->rows, ws->ld.cols);
+        *cols = ws->ld.cols;
+    }
+    return SS_OK;
+}
+
+/*  Calculate statistics within and between the populations of a binary
+ *    replicate. The derived allele count of every population at a site
+ *    comes from one AND and popcount per population on the site's column,
+ *    and pi, S and dxy are summed as integers over the one pass; Snn comes
+ *    from the pairwise differences.
+ *
+ *      rep         - the replicate (caller-owned genotype buffer), the
+ *                    samples coming population by population
+ *      npop        - number of populations (1 .. SS_MAXPOPS)
+ *      sizes       - samples in each population, adding up to rep->nsam
+ *      mask        - the statistics wanted (SS_POP_PI | SS_POP_DXY | ...)
+ *      ws          - a workspace from ss_workspace_new()
+ *      out         - where to put the results
+ *
+ *  Returns SS_OK, or SS_EINVAL / SS_ENOMEM on failure
+ */
+int ss_compute_pops(const struct ss_replicate *rep, int npop, const int *sizes,
+                    unsigned mask, struct ss_workspace *ws, struct ss_pop_results *out)
+{
+    int     rc,                 /* return code */
+            i, p, q,            /* iterators */
+            nsam,               /* number of samples */
+            nsites,             /* number of sites */
+            nwords,             /* column words per site */
+            total,              /* samples in the populations so far */
+            packed;             /* 1 if the bit-packed kernels will be used */
+    uint64_t *cols;             /* the site columns */
+    struct pops_sums sums;      /* integer sums over the sites */
+    double  np, nq,             /* sizes of a pair of populations */
+            t0;                 /* when the work started */
+
+    if (!valid_replicate(rep) || rep->alphabet != SS_BINARY || ws == NULL || out == NULL)
+        return SS_EINVAL;
+    if (npop < 1 || npop > SS_MAXPOPS || sizes == NULL)
+        return SS_EINVAL;
+    total = 0;
+    for (p=0; p<npop; p++) {
+        if (sizes[p] < 1)
+            return SS_EINVAL;
+        total += sizes[p];
+    }
+    if (total != rep->nsam)
+        return SS_EINVAL;
+
+    nsam = rep->nsam;
+    nsites = rep->nsites;
+    nwords = PACKED_WORDS(nsam);
+    packed = nsam <= PACKED_MAXSAM;
+    if ((mask & SS_POP_SNN) && dist_reserve(&ws->dist, nsam, nsites, 0) != 0)
+        return SS_ENOMEM;
+    ws->prof_bucket = SS_PROF_BUCKET(rep->nsites);
+    t0 = prof_start(ws);
+    if ((rc = site_columns(rep, ws, &cols)) != SS_OK)
+        return rc;
+    pops_masks(npop, sizes, nwords, ws->pop_masks);
+    pops_sweep(nsites, nwords, cols, npop, sizes, ws->pop_masks, &sums);
+
+    memset(out, 0, sizeof(*out));
+    out->npop = npop;
+    for (p=0; p<npop; p++) {
+        np = sizes[p];
+        out->pi[p] = sizes[p] > 1 ? sums.within[p]/(np*(np - 1)/2.0) : 0.0;
+        out->ss[p] = sums.seg[p];
+        if ((mask & SS_POP_D) && sizes[p] > 1)
+            out->D[p] = tajd(sizes[p], sums.seg[p], out->pi[p]);
+    }
+    for (p=0; p<npop; p++) {
+        for (q=p+1; q<npop; q++) {
+            np = sizes[p];
+            nq = sizes[q];
+            out->dxy[p][q] = out->dxy[q][p] = sums.between[p][q]/(np*nq);
+            if (out->dxy[p][q] > 0.0)
+                out->fst[p][q] = out->fst[q][p]
+                    = 1.0 - (out->pi[p] + out->pi[q])/2.0/out->dxy[p][q];
+        }
+    }
+
+    if (mask & SS_POP_SNN) {
+        for (p=0, i=0; p<npop; p++)
+            for (q=0; q<sizes[p]; q++)
+                ws->pop_labels[i++] = p;
+        if (!packed)
+            dist_pack_rows(nsam, nsites, ws->rows, ws->dist.rows);
+        dist_matrix(nsam, PACKED_WORDS(nsites), packed ? ws->rowbits : ws->dist.rows, 0,
+                    ws->ld_threads, ws->dist.dist);
+        out->snn = dist_snn(nsam, ws->dist.dist, ws->pop_labels);
+    }
+
+    out->mask = mask & (SS_POP_PI | SS_POP_SS | SS_POP_D | SS_POP_DXY | SS_POP_FST
+                        | SS_POP_SNN);
+    prof_end(ws, SS_PROF_POPS, t0);
+    return SS_OK;
+}
+
+/*  Make sure the workspace has room for the subsample masks and spectra
+ *
+ *      ws          - the workspace
+ *      nsub        - number of subsamples
+ *      nsam        - number of samples
+ *
+ *  Returns SS_OK or SS_ENOMEM
+ */
+static int reserve_subsamples(struct ss_workspace *ws, int nsub, int nsam)
+{
+    void    *p;                 /* result of each reallocation */
+    size_t  n;                  /* number of entries needed */
+
+    n = (size_t)nsub*PACKED_WORDS(nsam);
+    if (n > ws->sub_masks_size) {
+        if (!(p = realloc(ws->sub_masks, n*sizeof(uint64_t))))
+            return SS_ENOMEM;
+        ws->sub_masks = (uint64_t *)p;
+        ws->sub_masks_size = n;
+    }
+    n = (size_t)nsub*(nsam + 1);
+    if (n > ws->sub_hist_size) {
+        if (!(p = realloc(ws->sub_hist, n*sizeof(int))))
+            return SS_ENOMEM;
+        ws->sub_hist = (int *)p;
+        ws->sub_hist_size = n;
+    }
+    return SS_OK;
+}
+
+/*  Calculate the site frequency statistics of several subsamples of a
+ *    binary replicate. Each subsample's spectrum is the histogram of an
+ *    AND and popcount of its mask with every site column, and all of them
+ *    are filled in over the one pass, with no copy of the rows.
+ *
+ *      rep         - the replicate (caller-owned genotype buffer)
+ *      nsub        - number of subsamples
+ *      sizes       - samples in each (2 .. rep->nsam)
+ *      samples     - the samples of each, one subsample after the other,
+ *                    or NULL for the first sizes[s] samples
+ *      mask        - the statistics wanted (SS_PI | SS_D | ...); only those
+ *                    in SS_SUBSAMPLE_STATS are filled in
+ *      ws          - a workspace from ss_workspace_new()
+ *      out         - where to put the results (nsub of them); out[s].sfs
+ *                    must point at room for sizes[s] ints for SS_SFS
+ *
+ *  Returns SS_OK, or SS_EINVAL / SS_ENOMEM on failure
+ */
+int ss_compute_subsamples(const struct ss_replicate *rep, int nsub, const int *sizes,
+                          const int *samples, unsigned mask, struct ss_workspace *ws,
+                          struct ss_results *out)
+{
+    int     rc,                 /* return code */
+            s, i,               /* iterators */
+            nsam,               /* number of samples */
+            n,                  /* samples in the current subsample */
+            total,              /* samples listed in all the subsamples */
+            eta,                /* sites segregating in it */
+            *sfs;               /* its spectrum (classes 1..n-1) */
+    uint64_t *cols;             /* the site columns */
+    struct ss_results *res;     /* results of the current subsample */
+    double  pi,                 /* nucleotide diversity */
+            th,                 /* Fay's theta H */
+            tl,                 /* Zeng et al's theta L */
+            t0;                 /* when the work started */
+
+    if (!valid_replicate(rep) || rep->alphabet != SS_BINARY || ws == NULL || out == NULL)
+        return SS_EINVAL;
+    if (nsub < 1 || sizes == NULL)
+        return SS_EINVAL;
+    nsam = rep->nsam;
+    mask &= SS_SUBSAMPLE_STATS;
+    total = 0;
+    for (s=0; s<nsub; s++) {
+        if (sizes[s] < 2 || sizes[s] > nsam || ((mask & SS_SFS) && out[s].sfs == NULL))
+            return SS_EINVAL;
+        total += sizes[s];
+    }
+    if (samples != NULL)
+        for (i=0; i<total; i++)
+            if (samples[i] < 0 || samples[i] >= nsam)
+                return SS_EINVAL;
+
+    if ((rc = reserve_subsamples(ws, nsub, nsam)) != SS_OK)
+        return rc;
+    if (pops_subsample_masks(nsub, sizes, samples, PACKED_WORDS(nsam), ws->sub_masks) != 0)
+        return SS_EINVAL;
+    ws->prof_bucket = SS_PROF_BUCKET(rep->nsites);
+    t0 = prof_start(ws);
+    if ((rc = site_columns(rep, ws, &cols)) != SS_OK)
+        return rc;
+    pops_spectra(rep->nsites, PACKED_WORDS(nsam), cols, nsub, ws->sub_masks, nsam + 1,
+                 ws->sub_hist);
+
+    for (s=0; s<nsub; s++) {
+        n = sizes[s];
+        sfs = ws->sub_hist + (size_t)s*(nsam + 1) + 1;
+        res = &out[s];
+        if ((mask & (SS_FULID | SS_FULIF | SS_FULIDS | SS_FULIFS)) && ws->fl.nsam != n) {
+            if (fu_li_coefficients(n, &ws->fl) != 0) {
+                ws->fl.nsam = 0;
+                return SS_ENOMEM;
+            }
+        }
+
+        /* only the classes 1..n-1 count: sites fixed in the subsample are
+         * not segregating in it */
+        eta = sfs_segsites(n - 1, sfs);
+        pi = sfs_theta_pi(n, n - 1, sfs);
+        th = sfs_theta_h(n, n - 1, sfs);
+        res->mask = mask;
+        res->pi = pi;
+        res->ss = eta;
+        res->thetaH = th;
+        if (mask & SS_D)
+            res->D = tajd(n, eta, pi);
+        if (mask & SS_H)
+            res->H = pi - th;
+        if (mask & SS_THETAW)
+            res->thetaW = eta/a1f(n);
+        if (mask & SS_NSS)
+            res->nss = sfs[0];
+        if (mask & SS_SFS) {
+            memcpy(res->sfs, sfs, (n - 1)*sizeof(int));
+            res->sfs_len = n - 1;
+        }
+        if (mask & SS_FULID)
+            res->fuliD = fu_li_d(&ws->fl, eta, sfs[0]);
+        if (mask & SS_FULIF)
+            res->fuliF = fu_li_f(&ws->fl, eta, sfs[0], pi);
+        if (mask & SS_FULIDS)
+            res->fuliDs = fu_li_d_star(&ws->fl, eta, n > 2 ? sfs[0] + sfs[n-2] : eta);
+        if (mask & SS_FULIFS)
+            res->fuliFs = fu_li_f_star(&ws->fl, eta, n > 2 ? sfs[0] + sfs[n-2] : eta, pi);
+        if (mask & (SS_HNORM | SS_ZENGE)) {
+            tl = sfs_theta_l(n, sfs);
+            if (mask & SS_HNORM)
+                res->Hn = fay_wu_h_norm(n, eta, pi, tl);
+            if (mask & SS_ZENGE)
+                res->E = zeng_e(n, eta, tl);
+        }
+    }
+    prof_end(ws, SS_PROF_SUBSAMPLES, t0);
+
+    return SS_OK;
+}
+
+/*  Set the limits on the pairwise LD statistics
+ *
+ *      ws          - the workspace
+ *      window      - pair only sites at most this many segregating sites
+ *                    apart, or 0 for every pair
+ *      max_pairs   - most pairs to look at (the window is shrunk to fit),
+ *                    or 0 for no cap
+ *      nthreads    - threads to share the pairs of a replicate between
+ *                    (at most LD_MAXTHREADS)
+ *
+ *  Returns SS_OK, or SS_EINVAL if a limit is out of range
+ */
+int ss_set_ld(struct ss_workspace *ws, int window, long max_pairs, int nthreads)
+{
+    if (ws == NULL || window < 0 || max_pairs < 0 || nthreads < 1 || nthreads > LD_MAXTHREADS)
+        return SS_EINVAL;
+    /* the threads make no difference to the results, the limits do */
+    if (window != ws->ld_window || max_pairs != ws->ld_max_pairs)
+        memo_clear(&ws->memo);
+    ws->ld_window = window;
+    ws->ld_max_pairs = max_pairs;
+    ws->ld_threads = nthreads;
+    return SS_OK;
+}
+
+/*  Keep the results of recent replicates, to hand back when one comes
+ *    again
+ *
+ *      ws          - the workspace
+ *      entries     - the number of replicates to keep; 0 to stop
+ *
+ *  Returns SS_OK, or SS_EINVAL / SS_ENOMEM on failure
+ */
+int ss_set_cache(struct ss_workspace *ws, int entries)
+{
+    if (ws == NULL || entries < 0)
+        return SS_EINVAL;
+    return memo_reserve(&ws->memo, entries) == 0 ? SS_OK : SS_ENOMEM;
+}
+
+/*  Count the replicates found in the cache and not
+ *
+ *      ws          - the workspace
+ *      hits        - set to the replicates ss_compute() found there
+ *      misses      - set to those it had to work out
+ *
+ *  Returns nothing
+ */
+void ss_cache_counts(const struct ss_workspace *ws, long *hits, long *misses)
+{
+    *hits = ws->memo.hits;
+    *misses = ws->memo.misses;
+}
+
+/*  Start or stop timing the phases of the work on each replicate
+ *
+ *      ws          - the workspace
+ *      prof        - where to add up the times and calls of each phase,
+ *                    and with prof->counters set the hardware events, or
+ *                    NULL to stop
+ *
+ *  Returns SS_OK, or SS_EINVAL if the events cannot be counted (in which
+ *    case prof->counters is cleared and only the times are kept)
+ */
+int ss_set_profile(struct ss_workspace *ws, struct ss_profile *prof)
+{
+    if (ws == NULL)
+        return SS_EINVAL;
+    ws->prof = prof;
+    if (ws->perf.nopen > 0)
+        perf_close(&ws->perf);
+    if (prof != NULL && prof->counters && perf_open(&ws->perf) == 0) {
+        prof->counters = 0;
+        return SS_EINVAL;
+    }
+    return SS_OK;
+}
+
+/*  Name a profiled phase
+ *
+ *      phase       - the phase (SS_PROF_*)
+ *
+ *  Returns its name, or NULL if there is no such phase
+ */
+const char *ss_profile_name(int phase)
+{
+    return phase >= 0 && phase < SS_PROF_PHASES ? prof_names[phase] : NULL;
+}
+
+/*  Make sure the workspace has room for the window sums and hashes
+ *
+ *      ws          - the workspace
+ *      nsam        - number of samples
+ *      nsites      - number of sites
+ *
+ *  Returns SS_OK or SS_ENOMEM
+ */
+static int reserve_windows(struct ss_workspace *ws, int nsam, int nsites)
+{
+    void    *p;                 /* result of each reallocation */
+
+    if (nsites > ws->win_sites || ws->win_sums == NULL) {
+        if (!(p = realloc(ws->win_sums, (size_t)WIN_SUMS*(nsites + 1)*sizeof(int64_t))))
+            return SS_ENOMEM;
+        ws->win_sums = (int64_t *)p;
+        ws->win_sites = nsites;
+    }
+    if (nsam > ws->win_sam) {
+        if (!(p = realloc(ws->win_hashes, (size_t)nsam*sizeof(uint64_t))))
+            return SS_ENOMEM;
+        ws->win_hashes = (uint64_t *)p;
+        if (!(p = realloc(ws->win_sorted, (size_t)nsam*sizeof(struct win_entry))))
+            return SS_ENOMEM;
+        ws->win_sorted = (struct win_entry *)p;
+        ws->win_sam = nsam;
+    }
+    return SS_OK;
+}
+
+/*  Fill in the running sums over the sites of a replicate
+ *
+ *      rep         - the replicate
+ *      ws          - the workspace, with rows loaded
+ *
+ *  Returns nothing
+ */
+static void window_sums(const struct ss_replicate *rep, struct ss_workspace *ws)
+{
+    int     i, j, k,            /* iterators */
+            nsam,               /* number of samples */
+            nsites,             /* number of sites */
+            f,                  /* derived (or nucleotide) count */
+            seg,                /* 1 if an agct site segregates */
+            ones,               /* nucleotides seen once at a site */
+            seen;               /* nucleotides seen at a site */
+    int64_t *s,                 /* sums before the current site */
+            *t,                 /* and after it */
+            hom;                /* pairs of samples that match at a site */
+    const char *row;            /* current row */
+
+    nsam = rep->nsam;
+    nsites = rep->nsites;
+
+    /* binary sites are counted a row at a time, which reads each row
+     * straight through */
+    if (rep->alphabet == SS_BINARY) {
+        for (j=0; j<nsites; j++)
+            ws->site_freqs[j] = 0;
+        for (i=0; i<nsam; i++) {
+            row = ws->rows[i];
+            for (j=0; j<nsites; j++)
+                ws->site_freqs[j] += row[j] == '1';
+        }
+    } else {
+        calculate_site_frequencies(nsam, nsites, ws->rows, ws->agct_freqs);
+    }
+
+    s = ws->win_sums;
+    for (k=0; k<WIN_SUMS; k++)
+        s[k] = 0;
+    for (j=0; j<nsites; j++, s += WIN_SUMS) {
+        t = s + WIN_SUMS;
+        if (rep->alphabet == SS_BINARY) {
+            f = ws->site_freqs[j];
+            t[WIN_SS] = s[WIN_SS] + 1;
+            t[WIN_PI] = s[WIN_PI] + (int64_t)f*(nsam - f);
+            t[WIN_TH] = s[WIN_TH] + (int64_t)f*f;
+            t[WIN_NSS] = s[WIN_NSS] + (f == 1);
+        } else {
+            hom = 0;
+            seg = ones = seen = 0;
+            for (k=0; k<4; k++) {
+                f = ws->agct_freqs[j][k];
+                hom += (int64_t)f*(f - 1);
+                seg |= f != 0 && f != nsam;
+                ones += f == 1;
+                seen += f > 0;
+            }
+            t[WIN_SS] = s[WIN_SS] + seg;
+            t[WIN_PI] = s[WIN_PI] + ((int64_t)nsam*(nsam - 1) - hom)/2;
+            t[WIN_TH] = 0;
+            t[WIN_NSS] = s[WIN_NSS] + (ones == 1 && seen == 2);
+        }
+    }
+}
+
+/*  A random looking 64 bit key for a state at a site (splitmix64)
+ *
+ *      site        - the site
+ *      c           - the character there
+ *
+ *  Returns the key
+ */
+static uint64_t site_key(int site, int c)
+{
+    uint64_t z;                 /* the key being mixed */
+
+    z = ((uint64_t)site << 8 | (unsigned char)c) + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/*  Add sites to, or take them out of, the window hashes. Each sample's
+ *    hash is the XOR of the keys of its states at the sites in the window
+ *    (for binary data, of its '1's), so doing it twice undoes it.
+ *
+ *      rep         - the replicate
+ *      ws          - the workspace, with rows loaded
+ *      from        - first site
+ *      to          - one past the last site
+ *
+ *  Returns nothing
+ */
+static void toggle_sites(const struct ss_replicate *rep, struct ss_workspace *ws,
+                         int from, int to)
+{
+    int     i, j;               /* iterators */
+    uint64_t h;                 /* hash of the current sample */
+    const char *row;            /* current row */
+
+    for (i=0; i<rep->nsam; i++) {
+        row = ws->rows[i];
+        h = ws->win_hashes[i];
+        if (rep->alphabet == SS_BINARY) {
+            for (j=from; j<to; j++)
+                if (row[j] == '1')
+                    h ^= site_key(j, '1');
+        } else {
+            for (j=from; j<to; j++)
+                h ^= site_key(j, row[j]);
+        }
+        ws->win_hashes[i] = h;
+    }
+}
+
+/*  qsort() comparison of two samples by hash, then by sample */
+static int compare_hashes(const void *a, const void *b)
+{
+    const struct win_entry *x = (const struct win_entry *)a,
+                           *y = (const struct win_entry *)b;
+
+    if (x->hash != y->hash)
+        return x->hash < y->hash ? -1 : 1;
+    return x->sample - y->sample;
+}
+
+/*  Turn the window hashes into haplotype counts, in the form
+ *    count_haplotype_frequencies() leaves them. Samples whose hashes
+ *    differ have different haplotypes; those that share a hash are
+ *    compared site by site, so that a collision cannot merge two.
+ *
+ *      nsam        - number of samples
+ *      ws          - the workspace, with rows loaded
+ *      a, b        - the sites of the window: a..b-1
+ *
+ *  Returns nothing
+ */
+static void window_haplotypes(int nsam, struct ss_workspace *ws, int a, int b)
+{
+    int     i, j, k, m,         /* iterators */
+            nh;                 /* haplotypes so far */
+    const char *lead;           /* the first sample of a haplotype, in the window */
+    struct win_entry *sorted;   /* the samples in hash order */
+
+    sorted = ws->win_sorted;
+    for (i=0; i<nsam; i++) {
+        sorted[i].hash = ws->win_hashes[i];
+        sorted[i].sample = i;
+    }
+    qsort(sorted, nsam, sizeof(struct win_entry), compare_hashes);
+
+    for (i=0; i<nsam; i++)
+        ws->hap_freqs[i] = 0;
+    nh = 0;
+    for (i=0; i<nsam; i=j) {
+        /* the run of samples sharing a hash: nearly always one haplotype,
+         * in which case each is compared with the first once */
+        for (j=i+1; j<nsam && sorted[j].hash == sorted[i].hash; j++)
+            ;
+        for (k=i; k<j; k++) {
+            if (sorted[k].sample < 0)
+                continue;
+            lead = ws->rows[sorted[k].sample] + a;
+            ws->hap_freqs[nh]++;
+            for (m=k+1; m<j; m++) {
+                if (sorted[m].sample >= 0
+                    && memcmp(ws->rows[sorted[m].sample] + a, lead, b - a) == 0) {
+                    ws->hap_freqs[nh]++;
+                    sorted[m].sample = -1;
+                }
+            }
+            nh++;
+        }
+    }
+}
+
+/*  How many windows there are along a replicate: those that fit, and
+ *    if the next one would start before the end but not fit, one more
+ *    moved back to end at the end, so that no sites are left past the
+ *    last window
+ *
+ *      length      - length of the replicate, in the units of the positions
+ *      width       - width of each window
+ *      step        - distance from the start of one window to the next
+ *
+ *  Returns the number of windows (0 if an argument is not positive)
+ */
+int ss_num_windows(double length, double width, double step)
+{
+    int     n;                  /* windows that fit */
+
+    if (!(length > 0.0 && width > 0.0 && step > 0.0))
+        return 0;
+    if (width >= length)
+        return 1;
+    /* allow for rounding in (length - width)/step */
+    n = 1 + (int)floor((length - width)/step + 1e-9);
+    if (n*step < length*(1.0 - 1e-9) && (n - 1)*step + width < length*(1.0 - 1e-9))
+        n++;
+    return n;
+}
+
+/*  Calculate summary statistics in sliding windows along one replicate.
+ *    The per site quantities behind pi, ss, theta H and nss are summed
+ *    along the replicate once, so each window costs O(1) for those; the
+ *    haplotype hashes are updated only for the sites that come into or
+ *    drop out of the window, so each site is hashed at most twice in all.
+ *
+ *      rep         - the replicate (caller-owned genotype buffer)
+ *      positions   - position of each site, not decreasing, or NULL to
+ *                    use the site's index (alignment columns)
+ *      length      - length of the replicate (1 for ms output, nsites
+ *                    for alignments)
+ *      width       - width of each window
+ *      step        - distance from the start of one window to the next
+ *      mask        - the statistics wanted (within SS_WINDOW_STATS)
+ *      ws          - a workspace from ss_workspace_new()
+ *      out         - room for ss_num_windows(length, width, step) windows
+ *
+ *  Returns the number of windows filled in, or SS_EINVAL / SS_ENOMEM
+ */
+int ss_compute_windows(const struct ss_replicate *rep, const double *positions,
+                       double length, double width, double step, unsigned mask,
+                       struct ss_workspace *ws, struct ss_window *out)
+{
+    int     rc,                 /* return code */
+            w, j,               /* iterators */
+            nwin,               /* number of windows */
+            nsam,               /* number of samples */
+            nsites,             /* number of sites */
+            a, b,               /* sites in the current window: a..b-1 */
+            lo, hi,             /* sites in the hashes: lo..hi-1 */
+            seg;                /* ss of the window */
+    int64_t d[WIN_SUMS];        /* the window's sums */
+    double  pairs,              /* n(n-1)/2, turning sums into thetas */
+            pi, th,             /* pi and theta H of the window */
+            t0;                 /* when the work started */
+    struct ss_results *res;     /* results of the current window */
+
+    if (!valid_replicate(rep) || ws == NULL || out == NULL)
+        return SS_EINVAL;
+    if ((nwin = ss_num_windows(length, width, step)) == 0)
+        return SS_EINVAL;
+    nsam = rep->nsam;
+    nsites = rep->nsites;
+    if (positions != NULL)
+        for (j=1; j<nsites; j++)
+            if (positions[j] < positions[j-1])
+                return SS_EINVAL;
+
+    mask &= SS_WINDOW_STATS;
+    if (rep->alphabet == SS_AGCT)
+        mask &= ~UNFOLDED_STATS;
+
+    if ((rc = reserve(ws, nsam, nsites, rep->encoding != SS_ASCII, 0,
+                      (mask & SS_FS) != 0)) != SS_OK)
+        return rc;
+    if ((rc = reserve_windows(ws, nsam, nsites)) != SS_OK)
+        return rc;
+    ws->prof_bucket = SS_PROF_BUCKET(rep->nsites);
+    t0 = prof_start(ws);
+    load_rows(rep, ws);
+    window_sums(rep, ws);
+
+    pairs = (double)nsam*(nsam - 1)/2.0;
+    memset(ws->win_hashes, 0, nsam*sizeof(uint64_t));
+    a = b = lo = hi = 0;
+
+    for (w=0; w<nwin; w++) {
+        out[w].start = w*step;
+        /* the last window may not fit, and then ends at the end */
+        if (w > 0 && out[w].start + width > length)
+            out[w].start = length - width;
+        out[w].end = out[w].start + width;
+
+        /* both ends only ever move right */
+        while (a < nsites && (positions ? positions[a] : a) < out[w].start)
+            a++;
+        if (b < a)
+            b = a;
+        while (b < nsites && (positions ? positions[b] : b) < out[w].end)
+            b++;
+        out[w].first = a;
+        out[w].nsites = b - a;
+
+        for (j=0; j<WIN_SUMS; j++)
+            d[j] = ws->win_sums[WIN_SUMS*b + j] - ws->win_sums[WIN_SUMS*a + j];
+        seg = (int)d[WIN_SS];
+        pi = nsam > 1 ? d[WIN_PI]/pairs : 0.0;
+        th = nsam > 1 ? d[WIN_TH]/pairs : 0.0;
+
+        res = &out[w].res;
+        res->mask = mask;
+        res->sfs = NULL;
+        res->sfs_len = 0;
+        res->hfs = NULL;
+        res->hfs_len = 0;
+        res->mismatch = NULL;
+        res->mismatch_len = 0;
+        res->pi = pi;
+        res->ss = seg;
+        res->thetaH = th;
+        if (mask & SS_D)
+            res->D = tajd(nsam, seg, pi);
+        if (mask & SS_H)
+            res->H = pi - th;
+        if (mask & SS_THETAW)
+            res->thetaW = rep->alphabet == SS_BINARY ? seg/a1f(nsam) : agct_theta_w(nsam, seg);
+        if (mask & SS_NSS)
+            res->nss = (int)d[WIN_NSS];
+
+        if (mask & HAP_STATS) {
+            /* windows that do not overlap the last start over */
+            if (a >= hi) {
+                memset(ws->win_hashes, 0, nsam*sizeof(uint64_t));
+                toggle_sites(rep, ws, a, b);
+            } else {
+                toggle_sites(rep, ws, lo, a);
+                toggle_sites(rep, ws, hi, b);
+            }
+            lo = a;
+            hi = b;
+            window_haplotypes(nsam, ws, a, b);
+            res->nh = num_haplotypes(nsam, ws->hap_freqs);
+            if (mask & SS_NS)
+                res->ns = num_singletons(nsam, ws->hap_freqs);
+            if (mask & SS_HO)
+                res->ho = homozygosity(nsam, ws->hap_freqs);
+            if (mask & SS_HF)
+                res->hf = (double)nsam/(double)res->nh;
+            if (mask & SS_IH)
+                res->ih = max_identical_haplotypes(nsam, ws->hap_freqs);
+            if (mask & SS_FS)
+                res->fs = fu_fs(ws, nsam, pi, res->nh);
+            if (mask & GARUD_STATS)
+                haplotype_table(nsam, mask, ws, res);
+        }
+    }
+    prof_end(ws, SS_PROF_WINDOWS, t0);
+
+    return nwin;
+}
@@ -0,0 +1,310 @@
+#ifndef SAMPLESTATS_H
+#define SAMPLESTATS_H
+
+#include <stddef.h>
+
+/* libsamplestats: the statistics computed by sample_stats2 and sample_stats3,
+ * callable directly on genotype data held in memory.
+ *
+ * A replicate is described by a caller-owned buffer of nsam rows (samples),
+ * each holding nsites entries, with consecutive rows <stride> bytes apart.
+ * Statistics are selected with a bit mask and written to a results struct.
+ * All scratch memory lives in a reusable workspace, so repeated calls on
+ * replicates no bigger than earlier ones do not allocate. */
+
+/* Statistics that can be requested (combine with |) */
+#define SS_PI           (1u << 0)   /* pi:     nucleotide diversity */
+#define SS_SS           (1u << 1)   /* ss:     number of segregating sites */
+#define SS_D            (1u << 2)   /* D:      Tajima's D */
+#define SS_THETAH       (1u << 3)   /* thetaH: Fay's H (binary data only) */
+#define SS_H            (1u << 4)   /* H:      pi - thetaH (binary data only) */
+#define SS_THETAW       (1u << 5)   /* thetaW: Watterson's theta */
+#define SS_NH           (1u << 6)   /* nh:     number of haplotypes */
+#define SS_NS           (1u << 7)   /* ns:     number of singleton haplotypes */
+#define SS_HO           (1u << 8)   /* ho:     homozygosity */
+#define SS_NSS          (1u << 9)   /* nss:    number of singleton sites */
+#define SS_HF           (1u << 10)  /* hf:     mean haplotype frequency */
+#define SS_IH           (1u << 11)  /* ih:     max number identical haplotypes */
+#define SS_R2           (1u << 12)  /* R2:     Ramos-Onsins & Rozas' R2 */
+#define SS_FS           (1u << 13)  /* Fs:     Fu's Fs */
+#define SS_SFS          (1u << 14)  /* sfs:    site frequency spectrum, unfolded
+                                     *         for binary data, folded for agct */
+#define SS_FULID        (1u << 15)  /* FuLiD:  Fu & Li's D (binary data only) */
+#define SS_FULIF        (1u << 16)  /* FuLiF:  Fu & Li's F (binary data only) */
+#define SS_FULIDS       (1u << 17)  /* FuLiDstar: Fu & Li's D* */
+#define SS_FULIFS       (1u << 18)  /* FuLiFstar: Fu & Li's F* */
+#define SS_HNORM        (1u << 19)  /* Hnorm:  normalised Fay & Wu's H (binary data only) */
+#define SS_ZENGE        (1u << 20)  /* E:      Zeng et al's E (binary data only) */
+#define SS_ZNS          (1u << 21)  /* ZnS:    Kelly's ZnS, mean r^2 (binary data only) */
+#define SS_OMEGA        (1u << 22)  /* omega_max: Kim & Nielsen's omega (binary data only) */
+#define SS_IHS          (1u << 23)  /* iHS:    largest |standardised iHS| (binary data,
+                                     *         ss_compute_ehh() only) */
+#define SS_NSL          (1u << 24)  /* nSL:    largest |standardised nSL| (binary data,
+                                     *         ss_compute_ehh() only) */
+#define SS_H1           (1u << 25)  /* H1:     Garud et al's haplotype homozygosity */
+#define SS_H12          (1u << 26)  /* H12:    H1 with the two commonest haplotypes pooled */
+#define SS_H2H1         (1u << 27)  /* H2H1:   H2/H1, H1 less the commonest haplotype */
+#define SS_HFS          (1u << 28)  /* hfs:    haplotype frequency spectrum, the
+                                     *         haplotype counts largest first */
+#define SS_MISMATCH     (1u << 29)  /* mismatch: the mismatch distribution, pairs of
+                                     *         samples per number of differences */
+#define SS_MMVAR        (1u << 30)  /* mismatch_var: variance of the mismatch distribution */
+#define SS_RAGGED       (1u << 31)  /* raggedness: Harpending's raggedness index */
+
+/* Alphabets */
+#define SS_BINARY       0           /* ancestral/derived, as from ms */
+#define SS_AGCT         1           /* nucleotides, as from seq-gen */
+
+/* Encodings of the genotype buffer */
+#define SS_ASCII        0           /* one char per site: '0'/'1' or 'A','G','C','T' */
+#define SS_BYTES        1           /* one byte per site holding 0 or 1 (binary only) */
+#define SS_BITS         2           /* one bit per site, site j of a row in bit
+                                     * (j % 8) of byte (j / 8) (binary only) */
+
+/* Return codes */
+#define SS_OK           0
+#define SS_ENOMEM       (-1)        /* could not grow the workspace */
+#define SS_EINVAL       (-2)        /* bad replicate description */
+
+struct ss_replicate {
+    int     nsam;                   /* number of samples (rows) */
+    int     nsites;                 /* number of sites (entries per row);
+                                     *   for binary data, the segregating sites */
+    int     alphabet;               /* SS_BINARY or SS_AGCT */
+    int     encoding;               /* SS_ASCII, SS_BYTES or SS_BITS */
+    const unsigned char
+            *data;                  /* first row of the genotype buffer */
+    size_t  stride;                 /* bytes from the start of one row to the next */
+};
+
+struct ss_results {
+    unsigned mask;                  /* which of the fields below were filled in */
+    double  pi,
+            D,
+            thetaH,
+            H,
+            thetaW,
+            ho,
+            hf,
+            r2,
+            fs,
+            fuliD,
+            fuliF,
+            fuliDs,
+            fuliFs,
+            Hn,
+            E,
+            zns,
+            omega,
+            ihs,
+            nsl,
+            h1,
+            h12,
+            h2h1,
+            mmvar,
+            ragged;
+    int     ss,
+            nh,
+            ns,
+            nss,
+            ih;
+    int     *sfs;                   /* set by the caller: room for nsam ints, filled
+                                     *   in when SS_SFS is asked for (sfs[i-1] is the
+                                     *   number of sites with i derived, or for agct
+                                     *   minor, alleles) */
+    int     sfs_len;                /* entries of sfs filled in: nsam-1 for
+                                     *   binary data, nsam/2 for agct */
+    int     *hfs;                   /* set by the caller: room for nsam ints, filled
+                                     *   in when SS_HFS is asked for */
+    int     hfs_len;                /* entries of hfs filled in: nh */
+    long    *mismatch;              /* set by the caller: room for rep->nsites + 1
+                                     *   longs, filled in when SS_MISMATCH is asked
+                                     *   for (mismatch[k] is the number of pairs of
+                                     *   samples differing at k sites) */
+    int     mismatch_len;           /* entries of mismatch filled in: the largest
+                                     *   difference + 1 */
+};
+
+/* One window of a replicate, from ss_compute_windows() */
+struct ss_window {
+    double  start,                  /* the window holds the sites at positions */
+            end;                    /*   start <= x < end */
+    int     first,                  /* index of its first site */
+            nsites;                 /* number of sites in it */
+    struct ss_results res;          /* its statistics (res.sfs, res.hfs and
+                                     *   res.mismatch are not used) */
+};
+
+/* Statistics ss_compute_windows() gives per window; the rest of the mask
+ * is ignored */
+#define SS_WINDOW_STATS (SS_PI | SS_SS | SS_D | SS_THETAH | SS_H | SS_THETAW | SS_NH \
+                         | SS_NS | SS_HO | SS_NSS | SS_HF | SS_IH | SS_FS | SS_H1 | SS_H12 \
+                         | SS_H2H1)
+
+struct ss_workspace;
+
+struct ss_workspace *ss_workspace_new(void);
+void ss_workspace_free(struct ss_workspace *ws);
+int ss_compute(const struct ss_replicate *rep, unsigned mask,
+               struct ss_workspace *ws, struct ss_results *out);
+
+/* Many replicates in one call: out[i] gets what ss_compute() gives for
+ * reps[i], to the bit. Nucleotide replicates in ASCII of up to 255 samples
+ * and 1024 sites are taken SS_BATCH at a time, their bases counted in one
+ * pass over all their rows and their statistics worked out from the
+ * counts, when the mask asks for no more than pi, ss, D, thetaW, nss, R2
+ * and the haplotype statistics and no cache is set; the rest go through
+ * ss_compute() one at a time. */
+#define SS_BATCH        16
+int ss_compute_batch(const struct ss_replicate *reps, int n, unsigned mask,
+                     struct ss_workspace *ws, struct ss_results *out);
+
+/* Sliding windows along a replicate: windows <width> wide start every <step>
+ * from 0 for as long as they fit in [0, length) (one window if none fits);
+ * if the next start is still short of <length>, a last window is moved back
+ * to end at <length>, so every site from 0 on is in some window as long as
+ * <step> is no more than <width>.
+ * Site j sits at positions[j], which must not decrease, or at j if positions
+ * is NULL. <out> needs room for ss_num_windows(length, width, step) windows;
+ * ss_compute_windows() returns how many it filled in, or SS_EINVAL/SS_ENOMEM. */
+int ss_num_windows(double length, double width, double step);
+int ss_compute_windows(const struct ss_replicate *rep, const double *positions,
+                       double length, double width, double step, unsigned mask,
+                       struct ss_workspace *ws, struct ss_window *out);
+
+/* Extended haplotype homozygosity scans of a binary replicate: fills in
+ * out->ihs and out->nsl for SS_IHS and SS_NSL (adding them to out->mask, so
+ * it can follow ss_compute() on the same results), standardising iHS and
+ * nSL in derived allele frequency bins within the replicate. Site j sits at
+ * positions[j], which must not decrease, or at j if positions is NULL. If
+ * ihs or nsl is not NULL, the unstandardised value at each site (NAN where
+ * either allele has fewer than two carriers) is put there as well. */
+int ss_compute_ehh(const struct ss_replicate *rep, const double *positions, unsigned mask,
+                   struct ss_workspace *ws, struct ss_results *out,
+                   double *ihs, double *nsl);
+
+/* Statistics of structured samples, from ss_compute_pops() (a mask of
+ * their own; combine with |) */
+#define SS_POP_PI       (1u << 0)   /* pi_i:   nucleotide diversity within each population */
+#define SS_POP_SS       (1u << 1)   /* ss_i:   sites segregating within each population */
+#define SS_POP_D        (1u << 2)   /* D_i:    Tajima's D within each population */
+#define SS_POP_DXY      (1u << 3)   /* dxy_i_j: mean differences between populations */
+#define SS_POP_FST      (1u << 4)   /* Fst_i_j: Hudson et al's Fst, 1 - mean pi_i,pi_j / dxy */
+#define SS_POP_SNN      (1u << 5)   /* Snn:    Hudson's nearest neighbour statistic */
+
+/* most populations */
+#define SS_MAXPOPS      16
+
+struct ss_pop_results {
+    unsigned mask;                  /* which of the fields below were filled in */
+    int     npop;                   /* number of populations */
+    double  pi[SS_MAXPOPS],
+            D[SS_MAXPOPS];
+    int     ss[SS_MAXPOPS];
+    double  dxy[SS_MAXPOPS][SS_MAXPOPS],
+                                    /* both [i][j] and [j][i] are filled in */
+            fst[SS_MAXPOPS][SS_MAXPOPS],
+            snn;
+};
+
+/* Statistics within and between the populations of a binary replicate whose
+ * samples come population by population, sizes[0] of the first, then
+ * sizes[1] of the second and so on, as ms -I writes them; the sizes must add
+ * up to rep->nsam. Every population is counted in the one pass over the
+ * sites. */
+int ss_compute_pops(const struct ss_replicate *rep, int npop, const int *sizes,
+                    unsigned mask, struct ss_workspace *ws, struct ss_pop_results *out);
+
+/* Statistics ss_compute_subsamples() gives per subsample; the rest of the
+ * mask is ignored */
+#define SS_SUBSAMPLE_STATS (SS_PI | SS_SS | SS_D | SS_THETAH | SS_H | SS_THETAW | SS_NSS \
+                            | SS_SFS | SS_FULID | SS_FULIF | SS_FULIDS | SS_FULIFS \
+                            | SS_HNORM | SS_ZENGE)
+
+/* The site frequency statistics of several subsamples of a binary replicate
+ * (Hudson's segsub(), generalised), all from the one pass over the sites:
+ * subsample s has sizes[s] samples (2 .. rep->nsam), the first sizes[s] if
+ * samples is NULL, otherwise listed in samples, one subsample after the
+ * other. Only the sites segregating in a subsample count for it, so out[s]
+ * is what ss_compute() gives for those samples and sites alone. out[s].sfs
+ * needs room for sizes[s] ints for SS_SFS. */
+int ss_compute_subsamples(const struct ss_replicate *rep, int nsub, const int *sizes,
+                          const int *samples, unsigned mask, struct ss_workspace *ws,
+                          struct ss_results *out);
+
+/* Limits on the pairwise LD statistics (SS_ZNS, SS_OMEGA): pair only sites
+ * at most <window> segregating sites apart (0: all pairs), shrink the window
+ * if there would be more than <max_pairs> pairs (0: no cap), and share the
+ * pairs between <nthreads> threads. The default is 0, 0, 1. The pairs of
+ * samples behind SS_MISMATCH, SS_MMVAR and SS_RAGGED are shared between the
+ * same number of threads. */
+int ss_set_ld(struct ss_workspace *ws, int window, long max_pairs, int nthreads);
+
+/* Keep the results of the last <entries> distinct replicates ss_compute()
+ * was given (0, the default, for none), and hand them back when the same
+ * rows come again with the same mask, rather than working them out afresh;
+ * Fu's Fs is kept by sample size, pi and number of haplotypes as well.
+ * Replicates whose rows take more than 64 KB are not kept. The rows are
+ * compared, not just hashed, so the results are always those of the
+ * replicate. ss_cache_counts() gives the replicates found and not found. */
+int ss_set_cache(struct ss_workspace *ws, int entries);
+void ss_cache_counts(const struct ss_workspace *ws, long *hits, long *misses);
+
+/* Instruction set used for binary replicates of up to 128 samples: "auto"
+ * (the default, the best the CPU supports), "generic", "sse4.2", "avx2" or
+ * "avx512". Set it before starting any threads that call ss_compute(). */
+int ss_set_isa(const char *name);
+const char *ss_get_isa(void);
+
+/* Phases of the work on a replicate that a profile times */
+#define SS_PROF_LOAD        0       /* loading or packing the rows */
+#define SS_PROF_SITES       1       /* site frequencies */
+#define SS_PROF_SFS         2       /* the site frequency spectrum */
+#define SS_PROF_UNIC        3       /* unique sites per sample, for R2 */
+#define SS_PROF_HAPLOTYPES  4       /* haplotype counts */
+#define SS_PROF_FS          5       /* Fu's Fs */
+#define SS_PROF_LD          6       /* pairwise LD */
+#define SS_PROF_DIST        7       /* pairwise differences between samples */
+#define SS_PROF_EHH         8       /* ss_compute_ehh() */
+#define SS_PROF_WINDOWS     9       /* ss_compute_windows() */
+#define SS_PROF_POPS        10      /* ss_compute_pops() */
+#define SS_PROF_SUBSAMPLES  11      /* ss_compute_subsamples() */
+#define SS_PROF_PHASES      12
+
+/* Hardware events a profile can count as well (the same as perf(1)'s) */
+#define SS_PROF_CYCLES          0
+#define SS_PROF_INSTRUCTIONS    1
+#define SS_PROF_CACHE_MISSES    2   /* last level cache */
+#define SS_PROF_BRANCH_MISSES   3
+#define SS_PROF_EVENTS          4
+
+/* The events are counted separately for replicates of < 100, < 1000,
+ * < 10000 and more sites */
+#define SS_PROF_BUCKETS         4
+#define SS_PROF_BUCKET(nsites)  ((nsites) < 100 ? 0 : (nsites) < 1000 ? 1 \
+                                 : (nsites) < 10000 ? 2 : 3)
+
+struct ss_profile {
+    double  seconds[SS_PROF_PHASES];    /* wall time spent in each phase */
+    long    calls[SS_PROF_PHASES];      /* and the number of times it ran */
+    int     counters;                   /* set to 1 to count the events too;
+                                         *   ss_set_profile() clears it if
+                                         *   they cannot be counted */
+    long    bucket_calls[SS_PROF_BUCKETS][SS_PROF_PHASES];
+                                        /* calls per replicate size */
+    unsigned long long
+            events[SS_PROF_BUCKETS][SS_PROF_PHASES][SS_PROF_EVENTS];
+                                        /* and the events they took */
+};
+
+/* Add the time each phase takes to <prof> (NULL, the default, to stop),
+ * and with prof->counters set the hardware events as well, through
+ * perf_event_open(). Nothing is timed and the clock is never read while no
+ * profile is set. Returns SS_OK, or SS_EINVAL if the events were asked for
+ * but cannot be counted here (the phases are still timed). ss_clock() is
+ * the monotonic clock the phases are timed by, in seconds. */
+int ss_set_profile(struct ss_workspace *ws, struct ss_profile *prof);
+const char *ss_profile_name(int phase);
+double ss_clock(void);
+
+#endif /* SAMPLESTATS_H */
@@ -0,0 +1,361 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "tajd.h"
+#include "sfs_tests.h"
+
+/* Estimators of theta and neutrality tests worked out from a site frequency
+ * spectrum (a histogram of derived or minor allele counts) rather than from
+ * the sites themselves, so that each costs O(nsam) whatever the number of
+ * sites. sfs[i-1] is the number of sites with i copies of the allele.
+ *
+ * The estimators of theta add up integer numerators (pairs of samples that
+ * differ, and the like) in 64 bits and divide once, so they are exact
+ * however the sites were counted.
+ *
+ * Fu & Li's (1993) tests are normalised with coefficients worked out once
+ * per sample size (fu_li_coefficients); normalised H and E are from Zeng,
+ * Fu, Shi & Wu (2006). */
+
+/*  Count the sites in a spectrum
+ *
+ *      len             - number of classes in the spectrum
+ *      sfs             - the spectrum
+ *
+ *  Returns an integer
+ */
+int sfs_segsites(int len, const int *sfs)
+{
+    int     i,                  /* iterator */
+            count;              /* running total */
+
+    count = 0;
+    for (i=0; i<len; i++)
+        count += sfs[i];
+
+    return count;
+}
+
+/*  Calculate pi (mean pairwise differences) from a spectrum. Class i
+ *    adds i*(nsam-i) differences per site, so this works on folded
+ *    spectra too.
+ *
+ *      nsam            - total number of samples
+ *      len             - number of classes in the spectrum
+ *      sfs             - the spectrum
+ *
+ *  Returns a double
+ */
+double sfs_theta_pi(int nsam, int len, const int *sfs)
+{
+    int     i;                  /* iterator */
+    int64_t sum;                /* running total */
+
+    if (nsam < 2)
+        return 0.0;
+
+    sum = 0;
+    for (i=1; i<=len; i++)
+        sum += (int64_t)i*(nsam - i)*sfs[i-1];
+
+    return (double)sum*2.0/((double)nsam*(nsam - 1));
+}
+
+/*  Calculate Zeng et al's theta_L from an unfolded spectrum
+ *
+ *      nsam            - total number of samples
+ *      sfs             - the spectrum (length nsam-1)
+ *
+ *  Returns a double
+ */
+double sfs_theta_l(int nsam, const int *sfs)
+{
+    int     i;                  /* iterator */
+    int64_t sum;                /* running total */
+
+    if (nsam < 2)
+        return 0.0;
+
+    sum = 0;
+    for (i=1; i<nsam; i++)
+        sum += (int64_t)i*sfs[i-1];
+
+    return (double)sum/(nsam - 1);
+}
+
+/*  Calculate Fay & Wu's theta_H from an unfolded spectrum
+ *
+ *      nsam            - total number of samples
+ *      len             - number of classes in the spectrum: nsam-1, or
+ *                        nsam to count sites where the derived allele
+ *                        is fixed
+ *      sfs             - the spectrum
+ *
+ *  Returns a double
+ */
+double sfs_theta_h(int nsam, int len, const int *sfs)
+{
+    int     i;                  /* iterator */
+    int64_t sum;                /* running total */
+
+    if (nsam < 2)
+        return 0.0;
+
+    sum = 0;
+    for (i=1; i<=len; i++)
+        sum += (int64_t)i*i*sfs[i-1];
+
+    return (double)sum*2.0/((double)nsam*(nsam - 1));
+}
+
+/*  Work out the coefficients of the variances of Fu & Li's tests for a
+ *    sample size. Each test is a weighted sum of the classes of the
+ *    spectrum, sum w_i*xi_i, whose neutral variance is
+ *    theta*sum w_i^2/i + theta^2*sum w_i*w_j*sigma_ij (Fu 1995), and each
+ *    is divided by the square root of u*eta + v*eta^2 with u and v matched
+ *    to those two terms. For D and D* this gives back the published
+ *    coefficients; for F and F* it gives the exact variance in place of
+ *    the closed forms. The work is O(nsam^2), so callers keep the result
+ *    for as long as the sample size stays the same.
+ *
+ *      nsam            - total number of samples
+ *      c               - filled in
+ *
+ *  Returns 0, or -1 if out of memory
+ */
+int fu_li_coefficients(int nsam, struct fu_li_coeffs *c)
+{
+    int     i, j, hi, lo;       /* iterators */
+    double  n, an, bn,          /* sample size and a1f/a2f */
+            *a,                 /* a[i] = a1f(i), i = 1..nsam+1 */
+            *beta,              /* Fu's beta(i), i = 1..nsam-1 */
+            *w[4],              /* weights of D, F, D*, F* */
+            lin[4], quad[4],    /* coefficients of theta and theta^2 */
+            s;                  /* sigma_ij */
+    int     k;                  /* test */
+
+    memset(c, 0, sizeof(*c));
+    c->nsam = nsam;
+    if (nsam < 4)
+        return 0;
+
+    if ((a = malloc((size_t)(6*nsam + 2)*sizeof(double))) == NULL)
+        return -1;
+    beta = a + nsam + 2;
+    w[0] = beta + nsam;
+    for (k=1; k<4; k++)
+        w[k] = w[k-1] + nsam;
+
+    n = nsam;
+    a[1] = 0.0;
+    for (i=2; i<=nsam+1; i++)
+        a[i] = a[i-1] + 1.0/(i - 1);
+    an = a[nsam];
+    bn = a2f(nsam);
+    for (i=1; i<nsam; i++)
+        beta[i] = 2.0*n/((n - i + 1.0)*(n - i))*(a[nsam+1] - a[i]) - 2.0/(n - i);
+
+    for (i=1; i<nsam; i++) {
+        w[0][i] = 1.0;
+        w[1][i] = 2.0*i*(n - i)/(n*(n - 1.0));
+        w[2][i] = n/(n - 1.0);
+        w[3][i] = w[1][i];
+    }
+    w[0][1] -= an;
+    w[1][1] -= 1.0;
+    w[2][1] -= an;
+    w[2][nsam-1] -= an;
+    w[3][1] -= (n - 1.0)/n;
+    w[3][nsam-1] -= (n - 1.0)/n;
+
+    for (k=0; k<4; k++)
+        lin[k] = quad[k] = 0.0;
+    for (i=1; i<nsam; i++) {
+        for (k=0; k<4; k++)
+            lin[k] += w[k][i]*w[k][i]/i;
+        for (j=1; j<nsam; j++) {
+            hi = i > j ? i : j;
+            lo = i > j ? j : i;
+            if (i == j) {
+                if (2*i < nsam)
+                    s = beta[i+1];
+                else if (2*i == nsam)
+                    s = 2.0*(an - a[i])/(n - i) - 1.0/((double)i*i);
+                else
+                    s = beta[i] - 1.0/((double)i*i);
+            } else if (hi + lo < nsam) {
+                s = (beta[hi+1] - beta[hi])/2.0;
+            } else if (hi + lo == nsam) {
+                s = (an - a[hi])/(n - hi) + (an - a[lo])/(n - lo)
+                    - (beta[hi] + beta[lo+1])/2.0 - 1.0/((double)hi*lo);
+            } else {
+                s = (beta[lo] - beta[lo+1])/2.0 - 1.0/((double)hi*lo);
+            }
+            for (k=0; k<4; k++)
+                quad[k] += w[k][i]*w[k][j]*s;
+        }
+    }
+    free(a);
+
+    /* E[eta] = an*theta and E[eta^2] = an*theta + (an^2 + bn)*theta^2 */
+    c->vd = quad[0]/(an*an + bn);
+    c->ud = lin[0]/an - c->vd;
+    c->vf = quad[1]/(an*an + bn);
+    c->uf = lin[1]/an - c->vf;
+    c->vds = quad[2]/(an*an + bn);
+    c->uds = lin[2]/an - c->vds;
+    c->vfs = quad[3]/(an*an + bn);
+    c->ufs = lin[3]/an - c->vfs;
+    c->an = an;
+
+    return 0;
+}
+
+/*  Divide a test's numerator by its standard deviation
+ *
+ *      num             - the numerator
+ *      u, v            - the variance coefficients
+ *      segsites        - number of segregating sites (eta)
+ *
+ *  Returns a double (0.0 if the variance vanishes)
+ */
+static double fu_li_scale(double num, double u, double v, int segsites)
+{
+    double  var;                /* estimated variance */
+
+    var = u*segsites + v*(double)segsites*segsites;
+    return var > 0.0 ? num/sqrt(var) : 0.0;
+}
+
+/*  Calculate Fu & Li's D, with an outgroup
+ *
+ *      c               - coefficients for the sample size
+ *      segsites        - number of segregating sites (eta)
+ *      external        - mutations on external branches (derived
+ *                        singletons, sfs[0] of the unfolded spectrum)
+ *
+ *  Returns a double (0.0 if there are no sites or fewer than 4 samples)
+ */
+double fu_li_d(const struct fu_li_coeffs *c, int segsites, int external)
+{
+    if (segsites == 0 || c->nsam < 4)
+        return 0.0;
+
+    return fu_li_scale(segsites - c->an*external, c->ud, c->vd, segsites);
+}
+
+/*  Calculate Fu & Li's F, with an outgroup
+ *
+ *      c               - coefficients for the sample size
+ *      segsites        - number of segregating sites (eta)
+ *      external        - derived singletons
+ *      pi              - mean pairwise differences
+ *
+ *  Returns a double (0.0 if there are no sites or fewer than 4 samples)
+ */
+double fu_li_f(const struct fu_li_coeffs *c, int segsites, int external, double pi)
+{
+    if (segsites == 0 || c->nsam < 4)
+        return 0.0;
+
+    return fu_li_scale(pi - external, c->uf, c->vf, segsites);
+}
+
+/*  Calculate Fu & Li's D*, without an outgroup
+ *
+ *      c               - coefficients for the sample size
+ *      segsites        - number of segregating sites (eta)
+ *      singletons      - sites where one sample differs from the rest
+ *                        (sfs[0] of the folded spectrum)
+ *
+ *  Returns a double (0.0 if there are no sites or fewer than 4 samples)
+ */
+double fu_li_d_star(const struct fu_li_coeffs *c, int segsites, int singletons)
+{
+    double  n;                  /* sample size */
+
+    if (segsites == 0 || c->nsam < 4)
+        return 0.0;
+
+    n = c->nsam;
+    return fu_li_scale(n/(n - 1.0)*segsites - c->an*singletons, c->uds, c->vds, segsites);
+}
+
+/*  Calculate Fu & Li's F*, without an outgroup
+ *
+ *      c               - coefficients for the sample size
+ *      segsites        - number of segregating sites (eta)
+ *      singletons      - sites where one sample differs from the rest
+ *      pi              - mean pairwise differences
+ *
+ *  Returns a double (0.0 if there are no sites or fewer than 4 samples)
+ */
+double fu_li_f_star(const struct fu_li_coeffs *c, int segsites, int singletons, double pi)
+{
+    double  n;                  /* sample size */
+
+    if (segsites == 0 || c->nsam < 4)
+        return 0.0;
+
+    n = c->nsam;
+    return fu_li_scale(pi - (n - 1.0)/n*singletons, c->ufs, c->vfs, segsites);
+}
+
+/*  Calculate Fay & Wu's H normalised by its variance (Zeng et al 2006)
+ *
+ *      nsam            - total number of samples
+ *      segsites        - number of segregating sites
+ *      pi              - mean pairwise differences
+ *      theta_l         - Zeng et al's theta_L
+ *
+ *  Returns a double (0.0 if there are no sites or fewer than 3 samples)
+ */
+double fay_wu_h_norm(int nsam, int segsites, double pi, double theta_l)
+{
+    double  n, an, bn, bn1,     /* coefficients (bn1 is a2f(nsam+1)) */
+            theta, theta2;      /* theta and theta squared, from segsites */
+
+    if (segsites == 0 || nsam < 3)
+        return 0.0;
+
+    n = nsam;
+    an = a1f(nsam);
+    bn = a2f(nsam);
+    bn1 = a2f(nsam + 1);
+    theta = segsites/an;
+    theta2 = (double)segsites*(segsites - 1.0)/(an*an + bn);
+
+    return (pi - theta_l)/sqrt((n - 2.0)/(6.0*(n - 1.0))*theta
+                               + (18.0*n*n*(3.0*n + 2.0)*bn1 - (88.0*n*n*n + 9.0*n*n - 13.0*n + 6.0))
+                                 /(9.0*n*(n - 1.0)*(n - 1.0))*theta2);
+}
+
+/*  Calculate Zeng et al's E
+ *
+ *      nsam            - total number of samples
+ *      segsites        - number of segregating sites
+ *      theta_l         - Zeng et al's theta_L
+ *
+ *  Returns a double (0.0 if there are no sites or fewer than 3 samples)
+ */
+double zeng_e(int nsam, int segsites, double theta_l)
+{
+    double  n, an, bn,          /* coefficients */
+            theta, theta2;      /* theta and theta squared, from segsites */
+
+    if (segsites == 0 || nsam < 3)
+        return 0.0;
+
+    n = nsam;
+    an = a1f(nsam);
+    bn = a2f(nsam);
+    theta = segsites/an;
+    theta2 = (double)segsites*(segsites - 1.0)/(an*an + bn);
+
+    return (theta_l - theta)/sqrt((n/(2.0*(n - 1.0)) - 1.0/an)*theta
+                                  + (bn/(an*an) + 2.0*(n/(n - 1.0))*(n/(n - 1.0))*bn
+                                     - 2.0*(n*bn - n + 1.0)/((n - 1.0)*an)
+                                     - (3.0*n + 1.0)/(n - 1.0))*theta2);
+}
@@ -0,0 +1,26 @@
+#ifndef SFS_TESTS_H
+#define SFS_TESTS_H
+
+/* Coefficients of the variances of Fu & Li's tests for one sample size */
+struct fu_li_coeffs {
+    int     nsam;                   /* sample size they were worked out for */
+    double  an,                     /* a1f(nsam) */
+            ud, vd,                 /* D */
+            uf, vf,                 /* F */
+            uds, vds,               /* D* */
+            ufs, vfs;               /* F* */
+};
+
+int sfs_segsites(int len, const int *sfs);
+double sfs_theta_pi(int nsam, int len, const int *sfs);
+double sfs_theta_l(int nsam, const int *sfs);
+double sfs_theta_h(int nsam, int len, const int *sfs);
+int fu_li_coefficients(int nsam, struct fu_li_coeffs *c);
+double fu_li_d(const struct fu_li_coeffs *c, int segsites, int external);
+double fu_li_f(const struct fu_li_coeffs *c, int segsites, int external, double pi);
+double fu_li_d_star(const struct fu_li_coeffs *c, int segsites, int singletons);
+double fu_li_f_star(const struct fu_li_coeffs *c, int segsites, int singletons, double pi);
+double fay_wu_h_norm(int nsam, int segsites, double pi, double theta_l);
+double zeng_e(int nsam, int segsites, double theta_l);
+
+#endif /* SFS_TESTS_H */
@@ -8,6 +8,8 @@
 #include <stdio.h>
 #include <math.h>
 
+#include "nsam_tables.h"
+
 double a1f(int);
 double a2f(int);
 double b1f(int);
@@ -38,11 +40,18 @@ double tajd(int nsam, int segsites, double sumk)
   return D;
 }
 
+/* a1 and a2 for small samples, worked out by the compiler */
+static const double a1_table[NSAM_TABLE_MAX + 1] = A1_TABLE;
+static const double a2_table[NSAM_TABLE_MAX + 1] = A2_TABLE;
+
 double a1f(int nsam)
 {
   double a1;
   int i;
 
+  if (nsam >= 0 && nsam <= NSAM_TABLE_MAX)
+    return a1_table[nsam];
+
   a1 = 0.0;
   for (i=1; i<=nsam-1; i++) 
     a1 += 1.0/i;
@@ -56,6 +65,9 @@ double a2f(int nsam)
   double a2;
   int i;
 
+  if (nsam >= 0 && nsam <= NSAM_TABLE_MAX)
+    return a2_table[nsam];
+
   a2 = 0.0;
   for (i=1; i<=nsam-1; i++) 
     a2 += 1.0/(i*i);
@@ -1 +1,3 @@
 double tajd(int, int, double);
+double a1f(int);
+double a2f(int);
@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "samplestats.h"
+#include "distance.h"
+
+#define MAXSAM    200
+#define MAXSITES  600
+
+static unsigned long x = 8642;
+
+static int next_int(int n)
+{
+  x = x * 6364136223846793005ul + 1442695040888963407ul;
+  return (int)((x >> 33) % n);
+}
+
+/* the differences between two rows, a character at a time; nucleotide
+ * sites where either row has something other than a base do not count */
+static int differences(const char *a, const char *b, int nsites, int agct)
+{
+  int j, d;
+
+  d = 0;
+  for (j = 0; j < nsites; j++) {
+    if (agct && (!strchr("AGCT", a[j]) || !strchr("AGCT", b[j])))
+      continue;
+    d += a[j] != b[j];
+  }
+  return d;
+}
+
+/* the mismatch statistics straight from the pairs */
+static void reference(int nsam, int nsites, char rows[][MAXSITES + 1], int agct,
+                      long *counts, int *len, double *var, double *rag)
+{
+  static double f[MAXSITES + 2];
+  int i, j, d;
+  double pairs, mean;
+
+  *len = 0;
+  memset(counts, 0, (MAXSITES + 1) * sizeof(long));
+  pairs = mean = 0.0;
+  for (i = 0; i < nsam; i++) {
+    for (j = i + 1; j < nsam; j++) {
+      d = differences(rows[i], rows[j], nsites, agct);
+      counts[d]++;
+      if (d + 1 > *len)
+        *len = d + 1;
+      pairs += 1.0;
+      mean += d;
+    }
+  }
+  mean /= pairs;
+
+  *var = 0.0;
+  for (i = 0; i < nsam; i++)
+    for (j = i + 1; j < nsam; j++) {
+      d = differences(rows[i], rows[j], nsites, agct);
+      *var += (d - mean) * (d - mean) / pairs;
+    }
+
+  for (d = 0; d <= *len; d++)
+    f[d] = d < *len ? counts[d] / pairs : 0.0;
+  *rag = 0.0;
+  for (d = 1; d <= *len; d++)
+    *rag += (f[d] - f[d - 1]) * (f[d] - f[d - 1]);
+}
+
+int main(void) {
+  static char rows[MAXSAM][MAXSITES + 1];
+  static long counts[MAXSITES + 1], mismatch[MAXSITES + 1];
+  static struct dist_scratch s;
+  char *list[MAXSAM];
+  int pop[MAXSAM];
+  const char agct[] = "AGCTN";
+  const char *isas[] = { "generic", "sse4.2", "avx2", "avx512" };
+  const int sizes[] = { 2, 9, 64, 65, 130, 200 };
+  struct ss_replicate rep;
+  struct ss_results res;
+  struct ss_workspace *ws;
+  int t, i, j, a, isa, nthreads, nsam, nsites, len, nwords;
+  double var, rag, mean, var2, rag2;
+
+  ws = ss_workspace_new();
+  assert(ws != NULL);
+  for (i = 0; i < MAXSAM; i++)
+    list[i] = rows[i];
+
+  for (t = 0; t < (int)(sizeof(sizes) / sizeof(sizes[0])); t++) {
+    for (a = 0; a < 2; a++) {
+      nsam = sizes[t];
+      nsites = t % 2 ? MAXSITES : 77 + 64 * t;
+
+      /* rows copied from earlier ones with some changes, so that there
+       * are repeats and the distribution has some shape */
+      for (i = 0; i < nsam; i++) {
+        for (j = 0; j < nsites; j++)
+          rows[i][j] = i > 0 && next_int(6) ? rows[next_int(i)][j]
+                       : a ? agct[next_int(j % 7 ? 4 : 5)] : '0' + next_int(2);
+        rows[i][nsites] = '\0';
+      }
+      reference(nsam, nsites, rows, a, counts, &len, &var, &rag);
+
+      /* the matrix itself, on every instruction set this CPU has and
+       * with the tiles shared out or not */
+      assert(dist_reserve(&s, nsam, nsites, a) == 0);
+      if (a)
+        dist_pack_agct(nsam, nsites, list, s.rows);
+      else
+        dist_pack_rows(nsam, nsites, list, s.rows);
+      nwords = a ? DIST_AGCT_WORDS(nsites) : (nsites + 63) / 64;
+      for (isa = 0; isa < 4; isa++) {
+        if (ss_set_isa(isas[isa]) != SS_OK)
+          continue;
+        for (nthreads = 1; nthreads <= 3; nthreads += 2) {
+          memset(s.dist, 0xff, (size_t)nsam * nsam * sizeof(int));
+          dist_matrix(nsam, nwords, s.rows, a, nthreads, s.dist);
+          for (i = 0; i < nsam; i++)
+            for (j = 0; j < nsam; j++)
+              assert(s.dist[i * nsam + j] == differences(rows[i], rows[j], nsites, a));
+        }
+      }
+      assert(ss_set_isa("auto") == SS_OK);
+
+      assert(dist_mismatch(nsam, s.dist, s.counts) == len);
+      assert(!memcmp(s.counts, counts, len * sizeof(long)));
+      dist_mismatch_moments(len, s.counts, &mean, &var2, &rag2);
+      assert(fabs(var - var2) <= 1e-9 * var + 1e-12);
+      assert(fabs(rag - rag2) < 1e-12);
+
+      /* and through the library, packed or not */
+      rep.nsam = nsam;
+      rep.nsites = nsites;
+      rep.alphabet = a ? SS_AGCT : SS_BINARY;
+      rep.encoding = SS_ASCII;
+      rep.data = (unsigned char *)rows[0];
+      rep.stride = MAXSITES + 1;
+      res.mismatch = mismatch;
+      assert(ss_compute(&rep, SS_MISMATCH | SS_MMVAR | SS_RAGGED | SS_PI, ws, &res) == SS_OK);
+      assert(res.mismatch_len == len);
+      assert(!memcmp(res.mismatch, counts, len * sizeof(long)));
+      assert(fabs(res.mmvar - var) <= 1e-9 * var + 1e-12);
+      assert(fabs(res.ragged - rag) < 1e-12);
+      /* without missing data the mean of the distribution is pi */
+      if (!a)
+        assert(fabs(res.pi - mean) <= 1e-9 * mean);
+    }
+  }
+
+  /* Snn: two groups of identical haplotypes far apart are each others'
+   * nearest neighbours, so Snn is 1 when they are the populations */
+  nsam = 8;
+  nsites = 10;
+  for (i = 0; i < nsam; i++) {
+    for (j = 0; j < nsites; j++)
+      rows[i][j] = (i < 4) == (j < 5) ? '1' : '0';
+    rows[i][nsites] = '\0';
+    pop[i] = i < 4 ? 0 : 1;
+  }
+  assert(dist_reserve(&s, nsam, nsites, 0) == 0);
+  dist_pack_rows(nsam, nsites, list, s.rows);
+  dist_matrix(nsam, 1, s.rows, 0, 1, s.dist);
+  assert(dist_snn(nsam, s.dist, pop) == 1.0);
+  /* populations across the groups: each sample has 3 nearest neighbours,
+   * of which 1 shares its population */
+  for (i = 0; i < nsam; i++)
+    pop[i] = i % 2;
+  assert(fabs(dist_snn(nsam, s.dist, pop) - 1.0 / 3.0) < 1e-12);
+
+  /* a spectrum needs somewhere to go */
+  res.mismatch = NULL;
+  assert(ss_compute(&rep, SS_MISMATCH, ws, &res) == SS_EINVAL);
+
+  dist_scratch_free(&s);
+  ss_workspace_free(ws);
+  return 0;
+}
@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "samplestats.h"
+#include "ehh.h"
+
+#define MAXSAM    130
+#define MAXSITES  250
+
+static unsigned long x = 97531;
+
+static int next_int(int n)
+{
+  x = x * 6364136223846793005ul + 1442695040888963407ul;
+  return (int)((x >> 33) % n);
+}
+
+static int close_to(double a, double b)
+{
+  if (a == b || (isnan(a) && isnan(b)))
+    return 1;
+  return fabs(a - b) <= 1e-9 * (fabs(a) + fabs(b)) + 1e-12;
+}
+
+/* EHH of one allele at a core, pair by pair, integrated the slow way, one
+ * site at a time out from the core on the side <dir> points to */
+static void reference_side(int nsam, int nsites, char rows[][MAXSITES + 1],
+                           const double *pos, int core, char allele, int dir,
+                           double *ihh, double *sl)
+{
+  static int carrier[MAXSAM];
+  int m, i, j, k, y, same, pairs, stopped;
+  double e, last, total;
+
+  m = 0;
+  for (i = 0; i < nsam; i++)
+    if (rows[i][core] == allele)
+      carrier[m++] = i;
+  total = m * (m - 1) / 2.0;
+
+  *ihh = 0.0;
+  *sl = 1.0;
+  last = 1.0;
+  stopped = 0;
+  for (y = core + dir; y >= 0 && y < nsites; y += dir) {
+    pairs = 0;
+    for (i = 0; i < m; i++) {
+      for (j = i + 1; j < m; j++) {
+        same = 1;
+        for (k = core; same && k != y + dir; k += dir)
+          same = rows[carrier[i]][k] == rows[carrier[j]][k];
+        pairs += same;
+      }
+    }
+    e = pairs / total;
+    *sl += e;
+    if (!stopped) {
+      *ihh += 0.5 * (e + last) * fabs(pos[y] - pos[y - dir]);
+      stopped = e <= EHH_CUTOFF;
+      last = e;
+    }
+  }
+}
+
+static void reference(int nsam, int nsites, char rows[][MAXSITES + 1], const double *pos,
+                      double *ihs, double *nsl)
+{
+  int c, i, d;
+  double ihh[4], sl[4];
+
+  for (c = 0; c < nsites; c++) {
+    d = 0;
+    for (i = 0; i < nsam; i++)
+      d += rows[i][c] == '1';
+    if (d < 2 || nsam - d < 2) {
+      ihs[c] = nsl[c] = NAN;
+      continue;
+    }
+    reference_side(nsam, nsites, rows, pos, c, '0', -1, &ihh[0], &sl[0]);
+    reference_side(nsam, nsites, rows, pos, c, '0', 1, &ihh[1], &sl[1]);
+    reference_side(nsam, nsites, rows, pos, c, '1', -1, &ihh[2], &sl[2]);
+    reference_side(nsam, nsites, rows, pos, c, '1', 1, &ihh[3], &sl[3]);
+    ihs[c] = log((ihh[0] + ihh[1]) / (ihh[2] + ihh[3]));
+    nsl[c] = log((sl[0] + sl[1] - 1.0) / (sl[2] + sl[3] - 1.0));
+  }
+}
+
+/* the most extreme z score within derived frequency bins, two pass */
+static double standardised(int nsam, int nsites, const int *derived, const double *v)
+{
+  int i, j, b, n;
+  double mean, var, z, best;
+
+  best = 0.0;
+  for (i = 0; i < nsites; i++) {
+    if (isnan(v[i]))
+      continue;
+    b = (derived[i] - 1) * EHH_BINS / (nsam - 1);
+    n = 0;
+    mean = var = 0.0;
+    for (j = 0; j < nsites; j++)
+      if (!isnan(v[j]) && (derived[j] - 1) * EHH_BINS / (nsam - 1) == b) {
+        n++;
+        mean += v[j];
+      }
+    if (n < 2)
+      continue;
+    mean /= n;
+    for (j = 0; j < nsites; j++)
+      if (!isnan(v[j]) && (derived[j] - 1) * EHH_BINS / (nsam - 1) == b)
+        var += (v[j] - mean) * (v[j] - mean);
+    if (var <= 0.0)
+      continue;
+    z = fabs(v[i] - mean) / sqrt(var / (n - 1));
+    if (z > best)
+      best = z;
+  }
+  return best;
+}
+
+int main(void) {
+  static char rows[MAXSAM][MAXSITES + 1];
+  static double pos[MAXSITES], index[MAXSITES],
+                ihs[MAXSITES], nsl[MAXSITES], ihs2[MAXSITES], nsl2[MAXSITES];
+  static int derived[MAXSITES];
+  const int sizes[] = { 4, 11, 64, 65, 130 };
+  struct ss_replicate rep;
+  struct ss_results res;
+  struct ss_workspace *ws;
+  int t, i, j, nsam, nsites;
+
+  ws = ss_workspace_new();
+  assert(ws != NULL);
+
+  for (t = 0; t < (int)(sizeof(sizes) / sizeof(sizes[0])); t++) {
+    nsam = sizes[t];
+    nsites = t % 2 ? MAXSITES : 60;
+
+    /* haplotypes copied from earlier ones with a few changes, so that
+     * they share long stretches */
+    for (i = 0; i < nsam; i++) {
+      for (j = 0; j < nsites; j++)
+        rows[i][j] = i > 0 && next_int(20) ? rows[i - 1 - next_int(i < 4 ? i : 4)][j]
+                                           : '0' + next_int(2);
+      rows[i][nsites] = '\0';
+    }
+    pos[0] = 0.001;
+    for (j = 1; j < nsites; j++)
+      pos[j] = pos[j - 1] + (next_int(5) ? next_int(1000) * 1e-6 : 0.0);
+    for (j = 0; j < nsites; j++)
+      index[j] = j;
+
+    rep.nsam = nsam;
+    rep.nsites = nsites;
+    rep.alphabet = SS_BINARY;
+    rep.encoding = SS_ASCII;
+    rep.data = (unsigned char *)rows[0];
+    rep.stride = MAXSITES + 1;
+
+    reference(nsam, nsites, rows, pos, ihs, nsl);
+    res.mask = 0;
+    assert(ss_compute_ehh(&rep, pos, SS_IHS | SS_NSL, ws, &res, ihs2, nsl2) == SS_OK);
+    assert(res.mask == (SS_IHS | SS_NSL));
+    for (j = 0; j < nsites; j++) {
+      assert(close_to(ihs[j], ihs2[j]));
+      assert(close_to(nsl[j], nsl2[j]));
+    }
+
+    /* the standardised summaries are the most extreme per bin z scores */
+    for (j = 0; j < nsites; j++) {
+      derived[j] = 0;
+      for (i = 0; i < nsam; i++)
+        derived[j] += rows[i][j] == '1';
+    }
+    assert(fabs(res.ihs - standardised(nsam, nsites, derived, ihs)) < 1e-6);
+    assert(fabs(res.nsl - standardised(nsam, nsites, derived, nsl)) < 1e-6);
+    assert(nsam == 4 || (res.ihs > 0.0 && res.nsl > 0.0));
+
+    /* no positions means the site indices */
+    reference(nsam, nsites, rows, index, ihs, nsl);
+    assert(ss_compute_ehh(&rep, NULL, SS_IHS, ws, &res, ihs2, NULL) == SS_OK);
+    for (j = 0; j < nsites; j++)
+      assert(close_to(ihs[j], ihs2[j]));
+  }
+
+  /* positions must not go down, and the data must be binary */
+  pos[1] = pos[0] - 1.0;
+  assert(ss_compute_ehh(&rep, pos, SS_IHS, ws, &res, NULL, NULL) == SS_EINVAL);
+  rep.alphabet = SS_AGCT;
+  assert(ss_compute_ehh(&rep, NULL, SS_IHS, ws, &res, NULL, NULL) == SS_EINVAL);
+
+  ss_workspace_free(ws);
+  return 0;
+}
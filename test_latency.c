@@ -0,0 +1,67 @@
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+#include "latency.h"
+
+#define NTIMES  10000
+
+static unsigned long x = 2468;
+
+static double next_uniform(void)
+{
+  x = x * 6364136223846793005ul + 1442695040888963407ul;
+  return (double)(x >> 11) / 9007199254740992.0;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+  double d = *(const double *)a - *(const double *)b;
+  return (d > 0) - (d < 0);
+}
+
+/* a percentile is the top of its bucket, which is at most a quarter octave
+ * above the time itself, and never above the longest time */
+static int close_enough(double got, double want, double max)
+{
+  return got >= want * 0.999999 && got <= want * pow(2.0, 0.25) * 1.000001 && got <= max;
+}
+
+int main(void) {
+  static double times[NTIMES];
+  struct latency h;
+  int i;
+
+  latency_clear(&h);
+  assert(h.n == 0 && latency_quantile(&h, 0.5) == 0.0);
+
+  /* heavy tailed, from under a microsecond to seconds */
+  for (i = 0; i < NTIMES; i++) {
+    times[i] = 1e-7 * pow(10.0, 7.0 * next_uniform() * next_uniform());
+    latency_add(&h, times[i]);
+  }
+  qsort(times, NTIMES, sizeof(double), compare_doubles);
+  assert(h.n == NTIMES);
+  assert(h.max == times[NTIMES - 1]);
+  assert(close_enough(latency_quantile(&h, 0.5), times[NTIMES / 2 - 1], h.max));
+  assert(close_enough(latency_quantile(&h, 0.99), times[NTIMES * 99 / 100 - 1], h.max));
+  assert(latency_quantile(&h, 1.0) == h.max);
+
+  /* the buckets follow on, a quarter octave apart */
+  assert(fabs(latency_bucket_top(0) - 1e-6) < 1e-15);
+  assert(fabs(latency_bucket_top(4) - 2e-6) < 1e-15);
+  for (i = 1; i < LATENCY_BUCKETS; i++)
+    assert(latency_bucket_top(i) > latency_bucket_top(i - 1));
+
+  /* one time: every percentile is it */
+  latency_clear(&h);
+  latency_add(&h, 3e-3);
+  assert(latency_quantile(&h, 0.01) == 3e-3 && latency_quantile(&h, 0.99) == 3e-3);
+
+  /* times off the end go in the last bucket */
+  latency_add(&h, 1e9);
+  assert(h.count[LATENCY_BUCKETS - 1] == 1 && h.max == 1e9);
+  assert(latency_quantile(&h, 1.0) == 1e9);
+
+  return 0;
+}
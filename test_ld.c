@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "samplestats.h"
+
+#define MAXSAM    200
+#define MAXSITES  700
+
+static unsigned long x = 4321;
+static double r2[MAXSITES][MAXSITES];
+
+static int next_bit(int one_in)
+{
+  x = x * 6364136223846793005ul + 1442695040888963407ul;
+  return (x >> 33) % one_in == 0;
+}
+
+/* r^2 of every pair the slow way, then ZnS and omega straight from the
+ * definitions; returns the number of segregating sites. Omega is only
+ * checked to 1e-6, as a split with little r^2 across it is ill conditioned */
+static int reference(int nsam, int nsites, char rows[][MAXSITES + 1], int window,
+                     double *zns, double *omega)
+{
+  int freq[MAXSITES], seg[MAXSITES];
+  int i, j, k, l, s, both;
+  double pi, pj, d, sum, cnt, in, nin, out, nout, w;
+
+  s = 0;
+  for (j = 0; j < nsites; j++) {
+    freq[j] = 0;
+    for (i = 0; i < nsam; i++)
+      freq[j] += rows[i][j] == '1';
+    if (freq[j] > 0 && freq[j] < nsam)
+      seg[s++] = j;
+  }
+  if (window <= 0 || window > s - 1)
+    window = s - 1;
+
+  sum = cnt = 0.0;
+  for (i = 0; i < s; i++) {
+    for (j = i + 1; j < s; j++) {
+      both = 0;
+      for (k = 0; k < nsam; k++)
+        both += rows[k][seg[i]] == '1' && rows[k][seg[j]] == '1';
+      pi = (double)freq[seg[i]] / nsam;
+      pj = (double)freq[seg[j]] / nsam;
+      d = (double)both / nsam - pi * pj;
+      r2[i][j] = d * d / (pi * (1 - pi) * pj * (1 - pj));
+      if (j - i <= window) {
+        sum += r2[i][j];
+        cnt += 1;
+      }
+    }
+  }
+  *zns = cnt > 0 ? sum / cnt : 0.0;
+
+  *omega = 0.0;
+  for (l = 2; l <= s - 2; l++) {
+    in = nin = out = nout = 0.0;
+    for (i = 0; i < s; i++) {
+      for (j = i + 1; j < s && j - i <= window; j++) {
+        if ((i < l) == (j < l)) {
+          in += r2[i][j];
+          nin += 1;
+        } else {
+          out += r2[i][j];
+          nout += 1;
+        }
+      }
+    }
+    if (nout > 0 && out > 1e-9 * sum) {
+      w = (in / nin) / (out / nout);
+      if (w > *omega)
+        *omega = w;
+    }
+  }
+  return s;
+}
+
+static int close_to(double a, double b, double tol)
+{
+  return fabs(a - b) <= tol * (fabs(a) + fabs(b)) + 1e-12;
+}
+
+int main(void) {
+  static char rows[MAXSAM][MAXSITES + 1];
+  const int sizes[] = { 4, 10, 64, 65, 100, 128, 129, 200 };
+  const int windows[] = { 0, 1, 7, 200 };
+  const char *isas[] = { "generic", "sse4.2", "avx2", "avx512" };
+  struct ss_replicate rep;
+  struct ss_results res, res2;
+  struct ss_workspace *ws;
+  double zns, omega;
+  int t, w, isa, nsam, nsites, i, j, s;
+
+  ws = ss_workspace_new();
+  assert(ws != NULL);
+  assert(ss_set_ld(ws, -1, 0, 1) == SS_EINVAL);
+  assert(ss_set_ld(ws, 0, 0, 0) == SS_EINVAL);
+
+  for (t = 0; t < (int)(sizeof(sizes) / sizeof(sizes[0])); t++) {
+    nsam = sizes[t];
+    nsites = t % 2 ? MAXSITES : 150;
+    for (i = 0; i < nsam; i++) {
+      for (j = 0; j < nsites; j++)
+        rows[i][j] = next_bit(j % 5 + 2) ? '1' : '0';
+      rows[i][nsites] = '\0';
+    }
+    /* a few sites in LD */
+    for (j = 10; j < nsites; j += 17)
+      for (i = 0; i < nsam; i++)
+        rows[i][j] = rows[i][j - 1];
+
+    rep.nsam = nsam;
+    rep.nsites = nsites;
+    rep.alphabet = SS_BINARY;
+    rep.encoding = SS_ASCII;
+    rep.data = (unsigned char *)rows[0];
+    rep.stride = MAXSITES + 1;
+
+    for (w = 0; w < (int)(sizeof(windows) / sizeof(windows[0])); w++) {
+      s = reference(nsam, nsites, rows, windows[w], &zns, &omega);
+      assert(s > 2);
+
+      /* every instruction set, one thread */
+      for (isa = 0; isa < 4; isa++) {
+        if (ss_set_isa(isas[isa]) != SS_OK)
+          continue;
+        assert(ss_set_ld(ws, windows[w], 0, 1) == SS_OK);
+        assert(ss_compute(&rep, SS_ZNS | SS_OMEGA, ws, &res) == SS_OK);
+        assert(close_to(res.zns, zns, 1e-9));
+        assert(close_to(res.omega, omega, 1e-6));
+      }
+      assert(ss_set_isa("auto") == SS_OK);
+
+      /* several threads: the same to the bit as one */
+      assert(ss_set_ld(ws, windows[w], 0, 1) == SS_OK);
+      assert(ss_compute(&rep, SS_ZNS | SS_OMEGA, ws, &res) == SS_OK);
+      assert(ss_set_ld(ws, windows[w], 0, 3) == SS_OK);
+      assert(ss_compute(&rep, SS_ZNS | SS_OMEGA, ws, &res2) == SS_OK);
+      assert(close_to(res2.zns, zns, 1e-9));
+      assert(close_to(res2.omega, omega, 1e-6));
+      assert(res2.zns == res.zns && res2.omega == res.omega);
+    }
+
+    /* a cap on the pairs narrows the window to cap / segsites */
+    assert(ss_set_ld(ws, 0, (long)s * 7, 2) == SS_OK);
+    assert(ss_compute(&rep, SS_ZNS, ws, &res) == SS_OK);
+    reference(nsam, nsites, rows, 7, &zns, &omega);
+    assert(close_to(res.zns, zns, 1e-9));
+  }
+
+  ss_workspace_free(ws);
+  return 0;
+}
@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+#include "samplestats.h"
+#include "packed.h"
+#include "isa.h"
+#include "haplotypes.h"
+#include "r2.h"
+#include "tajd.h"
+#include "sfs_tests.h"
+
+#define MAXSITES  300
+#define MAXCHECK  200
+
+static unsigned long x = 12345;
+
+static int next_bit(int one_in)
+{
+  x = x * 6364136223846793005ul + 1442695040888963407ul;
+  return (x >> 33) % one_in == 0;
+}
+
+/* a1 and a2 from the tables must be exactly the loop values */
+static void check_tables(void)
+{
+  int n, i;
+  double a1, a2;
+
+  for (n = 0; n <= MAXCHECK; n++) {
+    a1 = a2 = 0.0;
+    for (i = 1; i <= n-1; i++) {
+      a1 += 1.0/i;
+      a2 += 1.0/(i*i);
+    }
+    assert(a1f(n) == a1);
+    assert(a2f(n) == a2);
+  }
+}
+
+/* the worked out coefficients of D and D* must be Fu & Li's and
+ * Simonsen et al's closed forms */
+static void check_fu_li(void)
+{
+  int nsam;
+  double n, an, bn, an1, cn, dn, vd, ud, vds, uds;
+  struct fu_li_coeffs c;
+
+  for (nsam = 4; nsam <= MAXCHECK; nsam++) {
+    assert(fu_li_coefficients(nsam, &c) == 0);
+    n = nsam;
+    an = a1f(nsam);
+    bn = a2f(nsam);
+    an1 = a1f(nsam + 1);
+    cn = 2.0*(n*an - 2.0*(n - 1.0))/((n - 1.0)*(n - 2.0));
+    vd = 1.0 + an*an/(bn + an*an)*(cn - (n + 1.0)/(n - 1.0));
+    ud = an - 1.0 - vd;
+    dn = cn + (n - 2.0)/((n - 1.0)*(n - 1.0))
+         + 2.0/(n - 1.0)*(1.5 - (2.0*an1 - 3.0)/(n - 2.0) - 1.0/n);
+    vds = ((n/(n - 1.0))*(n/(n - 1.0))*bn + an*an*dn
+           - 2.0*n*an*(an + 1.0)/((n - 1.0)*(n - 1.0)))/(an*an + bn);
+    uds = n/(n - 1.0)*(an - n/(n - 1.0)) - vds;
+    assert(fabs(c.vd - vd) < 1e-9 && fabs(c.ud - ud) < 1e-9);
+    assert(fabs(c.vds - vds) < 1e-9 && fabs(c.uds - uds) < 1e-9);
+    assert(c.uf > 0.0 && c.vf > 0.0 && c.ufs > 0.0 && c.vfs > 0.0);
+  }
+}
+
+/* Garud's H on a table worked out by hand: counts 5, 3, 2 of 10 */
+static void check_garud(void)
+{
+  int hap_freqs[10] = { 2, -9, 5, -9, -9, -9, -9, 3, -9, -9 };
+  int counts[10];
+  double h1, h12, h2h1;
+
+  assert(haplotype_count_table(10, hap_freqs, counts) == 3);
+  assert(counts[0] == 5 && counts[1] == 3 && counts[2] == 2);
+  garud_h(10, 3, counts, &h1, &h12, &h2h1);
+  assert(fabs(h1 - 0.38) < 1e-12);
+  assert(fabs(h12 - 0.68) < 1e-12);
+  assert(fabs(h2h1 - 0.13 / 0.38) < 1e-12);
+
+  /* one haplotype */
+  assert(haplotype_count_table(1, hap_freqs + 2, counts) == 1);
+  garud_h(5, 1, counts, &h1, &h12, &h2h1);
+  assert(h1 == 1.0 && h12 == 1.0 && h2h1 == 0.0);
+}
+
+int main(void) {
+  static char ascii[PACKED_MAXSAM][MAXSITES + 1];
+  static unsigned char bytes[PACKED_MAXSAM][MAXSITES];
+  static unsigned char bits[PACKED_MAXSAM][(MAXSITES + 7) / 8];
+  static uint64_t rowbits[PACKED_MAXSAM * PACKED_WORDS(MAXSITES)],
+                  rowbits2[PACKED_MAXSAM * PACKED_WORDS(MAXSITES)],
+                  cols[2 * MAXSITES];
+  char *list[PACKED_MAXSAM];
+  int site_freqs[MAXSITES], site_freqs2[MAXSITES];
+  int hap_freqs[PACKED_MAXSAM], hap_freqs2[PACKED_MAXSAM], counts[PACKED_MAXSAM];
+  int unic_freqs[PACKED_MAXSAM], unic_freqs2[PACKED_MAXSAM];
+  uint64_t hashes[PACKED_MAXSAM];
+  int nsam, nsites, nh, i, j, rep, isa;
+  double h1, h12, h2h1;
+  const char *isas[] = { "generic", "sse4.2", "avx2", "avx512" };
+  const struct ss_kernels *k;
+
+  check_tables();
+  check_fu_li();
+  check_garud();
+
+  assert(ss_set_isa("no-such-isa") == SS_EINVAL);
+  assert(ss_set_isa("generic") == SS_OK);
+  assert(!strcmp(ss_get_isa(), "generic"));
+
+  /* every instruction set this CPU has must agree with the character code */
+  for (isa = 0; isa < 4; isa++) {
+  if (ss_set_isa(isas[isa]) != SS_OK)
+    continue;
+  k = ss_kernels();
+
+  for (rep = 0; rep < 500; rep++) {
+    nsam = 1 + rep % PACKED_MAXSAM;
+    nsites = (rep * 37) % (MAXSITES + 1);
+
+    /* few distinct haplotypes some of the time, so that there are repeats */
+    memset(bits, 0, sizeof(bits));
+    for (i = 0; i < nsam; i++) {
+      for (j = 0; j < nsites; j++) {
+        if (rep % 3 == 0 && i > 0 && next_bit(2))
+          ascii[i][j] = ascii[i-1][j];
+        else
+          ascii[i][j] = next_bit(rep % 7 + 2) ? '1' : '0';
+        bytes[i][j] = ascii[i][j] == '1' ? (unsigned char)(1 + rep % 5) : 0;
+        if (ascii[i][j] == '1')
+          bits[i][j / 8] |= 1 << (j % 8);
+      }
+      ascii[i][nsites] = '\0';
+      list[i] = ascii[i];
+    }
+
+    k->pack_rows_ascii(nsam, nsites, (unsigned char *)ascii, MAXSITES + 1, rowbits);
+    pack_rows_bytes(nsam, nsites, (unsigned char *)bytes, MAXSITES, rowbits2);
+    assert(!memcmp(rowbits, rowbits2, nsam * PACKED_WORDS(nsites) * sizeof(uint64_t)));
+    pack_rows_bits(nsam, nsites, (unsigned char *)bits, (MAXSITES + 7) / 8, rowbits2);
+    assert(!memcmp(rowbits, rowbits2, nsam * PACKED_WORDS(nsites) * sizeof(uint64_t)));
+
+    packed_columns(nsam, nsites, rowbits, cols);
+    k->site_frequencies(nsam, nsites, cols, site_freqs);
+    for (j = 0; j < nsites; j++) {
+      site_freqs2[j] = frequency('1', j, nsam, list);
+      assert(site_freqs[j] == site_freqs2[j]);
+    }
+
+    packed_unic_frequencies(nsam, nsites, cols, site_freqs, unic_freqs);
+    count_binary_unic_frequencies(nsam, nsites, list, site_freqs2, unic_freqs2);
+    assert(!memcmp(unic_freqs, unic_freqs2, nsam * sizeof(int)));
+
+    k->row_hashes(nsam, nsites, rowbits, hashes);
+    packed_haplotype_frequencies(nsam, nsites, rowbits, hashes, hap_freqs);
+    count_haplotype_frequencies(nsam, nsites, list, hap_freqs2);
+    assert(!memcmp(hap_freqs, hap_freqs2, nsam * sizeof(int)));
+
+    /* the count table holds every haplotype once, largest first */
+    nh = haplotype_count_table(nsam, hap_freqs, counts);
+    assert(nh == num_haplotypes(nsam, hap_freqs));
+    assert(counts[0] == max_identical_haplotypes(nsam, hap_freqs));
+    for (i = 1, j = counts[0]; i < nh; i++) {
+      assert(counts[i] <= counts[i-1]);
+      j += counts[i];
+    }
+    assert(j == nsam);
+    garud_h(nsam, nh, counts, &h1, &h12, &h2h1);
+    assert(fabs(h1 - homozygosity(nsam, hap_freqs)) < 1e-12);
+    assert(h12 >= h1 && h12 <= 1.0 + 1e-12);
+    assert(h2h1 >= 0.0 && h2h1 < 1.0);
+
+    /* joint counts of the first site with every other */
+    if (nsites > 1) {
+      k->and_counts(PACKED_COLWORDS(nsam), cols, cols + PACKED_COLWORDS(nsam), nsites - 1,
+                    site_freqs);
+      for (j = 1; j < nsites; j++) {
+        site_freqs2[j-1] = 0;
+        for (i = 0; i < nsam; i++)
+          site_freqs2[j-1] += list[i][0] == '1' && list[i][j] == '1';
+      }
+      assert(!memcmp(site_freqs, site_freqs2, (nsites - 1) * sizeof(int)));
+    }
+  }
+  }
+
+  exit(0);
+}
@@ -0,0 +1,246 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "samplestats.h"
+
+#define MAXSAM    200
+#define MAXSITES  300
+#define MAXSUB    20
+
+static unsigned long x = 1357;
+
+static int next_int(int n)
+{
+  x = x * 6364136223846793005ul + 1442695040888963407ul;
+  return (int)((x >> 33) % n);
+}
+
+static int differences(const char *a, const char *b, int nsites)
+{
+  int j, d;
+
+  d = 0;
+  for (j = 0; j < nsites; j++)
+    d += a[j] != b[j];
+  return d;
+}
+
+/* Snn straight from its definition: the share of each sample's nearest
+ * neighbours that are from its own population, averaged over the samples */
+static double snn(int nsam, int nsites, char rows[][MAXSITES + 1], const int *pop)
+{
+  int i, j, d, best, near, same;
+  double sum;
+
+  sum = 0.0;
+  for (i = 0; i < nsam; i++) {
+    best = nsites + 1;
+    near = same = 0;
+    for (j = 0; j < nsam; j++) {
+      if (j == i)
+        continue;
+      d = differences(rows[i], rows[j], nsites);
+      if (d < best) {
+        best = d;
+        near = same = 0;
+      }
+      if (d == best) {
+        near++;
+        same += pop[j] == pop[i];
+      }
+    }
+    sum += (double)same / near;
+  }
+  return sum / nsam;
+}
+
+/* copy the sites of the given samples that segregate among them, the way
+ * ss_compute() would have to see them on their own; returns how many */
+static int segregating(int n, const int *idx, int nsites, char rows[][MAXSITES + 1],
+                       char own[][MAXSITES + 1])
+{
+  int i, j, seg;
+
+  seg = 0;
+  for (j = 0; j < nsites; j++) {
+    for (i = 1; i < n; i++)
+      if (rows[idx[i]][j] != rows[idx[0]][j])
+        break;
+    if (i == n)
+      continue;
+    for (i = 0; i < n; i++)
+      own[i][seg] = rows[idx[i]][j];
+    seg++;
+  }
+  return seg;
+}
+
+static int close_to(double a, double b)
+{
+  return fabs(a - b) <= 1e-9 * fabs(b) + 1e-12;
+}
+
+/* the same, or both not a number */
+static int same(double a, double b)
+{
+  return close_to(a, b) || (isnan(a) && isnan(b));
+}
+
+int main(void) {
+  static char rows[MAXSAM][MAXSITES + 1], own[MAXSAM][MAXSITES + 1];
+  const int sets[][5] = { { 2, 5, 7 }, { 3, 1, 20, 30, 13 }, { 3, 40, 60, 28 },
+                          { 4, 50, 50, 50, 50 }, { 1, 90 } };
+  static int subsfs[MAXSUB][MAXSAM], sfs[MAXSAM], subsamples[MAXSUB * MAXSAM];
+  int sizes[SS_MAXPOPS], first[SS_MAXPOPS], pop[MAXSAM], idx[MAXSAM], subsizes[MAXSUB];
+  struct ss_results subres[MAXSUB];
+  struct ss_replicate rep, sub;
+  struct ss_results res;
+  struct ss_pop_results out;
+  struct ss_workspace *ws;
+  int t, i, j, k, p, q, npop, nsam, nsites, d, n, r, nsub;
+  double dxy, fst;
+
+  ws = ss_workspace_new();
+  assert(ws != NULL);
+
+  for (t = 0; t < (int)(sizeof(sets) / sizeof(sets[0])); t++) {
+    npop = sets[t][0];
+    nsam = 0;
+    for (p = 0; p < npop; p++) {
+      sizes[p] = sets[t][p + 1];
+      first[p] = nsam;
+      for (i = 0; i < sizes[p]; i++)
+        pop[nsam + i] = p;
+      nsam += sizes[p];
+    }
+    nsites = 50 + 61 * t;
+
+    /* samples copied mostly from their own population, so that there is
+     * some structure to find */
+    for (i = 0; i < nsam; i++) {
+      for (j = 0; j < nsites; j++)
+        rows[i][j] = i > first[pop[i]] && next_int(5)
+                     ? rows[first[pop[i]] + next_int(i - first[pop[i]])][j]
+                     : '0' + (next_int(4) == 0);
+      rows[i][nsites] = '\0';
+    }
+
+    rep.nsam = nsam;
+    rep.nsites = nsites;
+    rep.alphabet = SS_BINARY;
+    rep.encoding = SS_ASCII;
+    rep.data = (unsigned char *)rows[0];
+    rep.stride = MAXSITES + 1;
+    assert(ss_compute_pops(&rep, npop, sizes, SS_POP_PI | SS_POP_SS | SS_POP_D | SS_POP_DXY
+                           | SS_POP_FST | SS_POP_SNN, ws, &out) == SS_OK);
+    assert(out.npop == npop);
+
+    /* each population on its own, with only the sites segregating in it
+     * (the library takes every binary site as segregating) */
+    for (p = 0; p < npop; p++) {
+      for (i = 0; i < sizes[p]; i++)
+        idx[i] = first[p] + i;
+      sub = rep;
+      sub.nsam = sizes[p];
+      sub.nsites = segregating(sizes[p], idx, nsites, rows, own);
+      sub.data = (unsigned char *)own[0];
+      if (sizes[p] < 2) {
+        assert(out.pi[p] == 0.0 && out.ss[p] == 0 && out.D[p] == 0.0);
+        continue;
+      }
+      assert(ss_compute(&sub, SS_PI | SS_SS | SS_D, ws, &res) == SS_OK);
+      assert(close_to(out.pi[p], res.pi));
+      assert(out.ss[p] == res.ss);
+      assert(same(out.D[p], res.D));
+    }
+
+    /* and each pair, from the differences between their samples */
+    for (p = 0; p < npop; p++) {
+      for (q = p + 1; q < npop; q++) {
+        d = 0;
+        for (i = first[p]; i < first[p] + sizes[p]; i++)
+          for (k = first[q]; k < first[q] + sizes[q]; k++)
+            d += differences(rows[i], rows[k], nsites);
+        dxy = (double)d / sizes[p] / sizes[q];
+        assert(close_to(out.dxy[p][q], dxy) && out.dxy[q][p] == out.dxy[p][q]);
+        fst = dxy > 0.0 ? 1.0 - (out.pi[p] + out.pi[q]) / 2.0 / dxy : 0.0;
+        assert(close_to(out.fst[p][q], fst) && out.fst[q][p] == out.fst[p][q]);
+      }
+    }
+    assert(close_to(out.snn, snn(nsam, nsites, rows, pop)));
+
+    /* subsamples, the first n and random ones, against ss_compute() on
+     * their own samples and sites */
+    nsub = 0;
+    for (n = 2; n <= nsam; n = n * 3 / 2 + 1)
+      subsizes[nsub++] = n;
+    subsizes[nsub++] = nsam;
+    for (r = 0; r < 2; r++) {
+      k = 0;
+      for (i = 0; i < nsub; i++) {
+        /* the first n, or n drawn without replacement */
+        for (j = 0; j < nsam; j++)
+          idx[j] = j;
+        for (j = 0; r && j < subsizes[i]; j++) {
+          d = j + next_int(nsam - j);
+          q = idx[j];
+          idx[j] = idx[d];
+          idx[d] = q;
+        }
+        memcpy(subsamples + k, idx, subsizes[i] * sizeof(int));
+        k += subsizes[i];
+        subres[i].sfs = subsfs[i];
+      }
+      assert(ss_compute_subsamples(&rep, nsub, subsizes, r ? subsamples : NULL,
+                                   SS_SUBSAMPLE_STATS, ws, subres) == SS_OK);
+      for (i = 0, k = 0; i < nsub; k += subsizes[i++]) {
+        sub = rep;
+        sub.nsam = subsizes[i];
+        sub.nsites = segregating(subsizes[i], subsamples + k, nsites, rows, own);
+        sub.data = (unsigned char *)own[0];
+        res.sfs = sfs;
+        assert(ss_compute(&sub, SS_SUBSAMPLE_STATS, ws, &res) == SS_OK);
+        assert(subres[i].mask == SS_SUBSAMPLE_STATS);
+        assert(subres[i].ss == res.ss && subres[i].nss == res.nss);
+        assert(subres[i].sfs_len == res.sfs_len);
+        assert(!memcmp(subres[i].sfs, res.sfs, res.sfs_len * sizeof(int)));
+        assert(close_to(subres[i].pi, res.pi) && close_to(subres[i].thetaH, res.thetaH));
+        assert(close_to(subres[i].thetaW, res.thetaW) && close_to(subres[i].H, res.H));
+        assert(same(subres[i].D, res.D) && same(subres[i].fuliD, res.fuliD));
+        assert(same(subres[i].fuliF, res.fuliF) && same(subres[i].fuliDs, res.fuliDs));
+        assert(same(subres[i].fuliFs, res.fuliFs) && same(subres[i].Hn, res.Hn));
+        assert(same(subres[i].E, res.E));
+      }
+    }
+  }
+
+  /* a subsample needs two distinct samples at least, all of them there */
+  subsizes[0] = 1;
+  assert(ss_compute_subsamples(&rep, 1, subsizes, NULL, SS_PI, ws, subres) == SS_EINVAL);
+  subsizes[0] = rep.nsam + 1;
+  assert(ss_compute_subsamples(&rep, 1, subsizes, NULL, SS_PI, ws, subres) == SS_EINVAL);
+  subsizes[0] = 2;
+  subsamples[0] = subsamples[1] = 3;
+  assert(ss_compute_subsamples(&rep, 1, subsizes, subsamples, SS_PI, ws, subres) == SS_EINVAL);
+  subsamples[1] = rep.nsam;
+  assert(ss_compute_subsamples(&rep, 1, subsizes, subsamples, SS_PI, ws, subres) == SS_EINVAL);
+  subres[0].sfs = NULL;
+  assert(ss_compute_subsamples(&rep, 1, subsizes, NULL, SS_SFS, ws, subres) == SS_EINVAL);
+
+  /* populations have to account for every sample */
+  sizes[0] = 2;
+  sizes[1] = 3;
+  rep.nsam = 6;
+  assert(ss_compute_pops(&rep, 2, sizes, SS_POP_PI, ws, &out) == SS_EINVAL);
+  rep.nsam = 5;
+  assert(ss_compute_pops(&rep, 2, sizes, SS_POP_PI, ws, &out) == SS_OK);
+  assert(ss_compute_pops(&rep, 0, sizes, SS_POP_PI, ws, &out) == SS_EINVAL);
+  assert(ss_compute_pops(&rep, SS_MAXPOPS + 1, sizes, SS_POP_PI, ws, &out) == SS_EINVAL);
+  rep.alphabet = SS_AGCT;
+  assert(ss_compute_pops(&rep, 2, sizes, SS_POP_PI, ws, &out) == SS_EINVAL);
+
+  ss_workspace_free(ws);
+  return 0;
+}
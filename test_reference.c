@@ -0,0 +1,397 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "samplestats.h"
+#include "binary_sites.h"
+#include "agct_sites.h"
+#include "haplotypes.h"
+#include "r2.h"
+#include "fs.h"
+#include "tajd.h"
+
+/* Differential test of the optimised paths against the scalar reference
+ * code: the per-site loops of binary_sites.c and agct_sites.c, the
+ * pairwise haplotype comparison of haplotypes.c and tajd(), Fs() and R2()
+ * on top of them. Random replicates go through ss_compute() with every
+ * instruction set this CPU has and every encoding, one window covering the
+ * whole replicate and one subsample holding every sample, and each
+ * statistic has to come within its tolerance of the reference. The cache
+ * and ss_compute_batch() have to give what ss_compute() gives, to the bit.
+ *
+ *   test_reference [-v] [ROUNDS [SEED]]
+ *
+ * With -v the largest differences seen are printed at the end. */
+
+#define MAXSAM    300
+#define MAXSITES  1500
+
+static unsigned long x;
+
+static int next_int(int n)
+{
+  x = x * 6364136223846793005ul + 1442695040888963407ul;
+  return (int)((x >> 33) % n);
+}
+
+/* Tolerances: a statistic passes if it is within <ulps> units in the last
+ * place of the reference or within <abs> of it. The optimised paths add the
+ * per site terms in another order and take Watterson's a1 from a table, so
+ * pi, the thetas and R2 may be a few hundred ulps out; H and D are
+ * differences of nearly equal numbers, so they are held to an absolute
+ * error instead. */
+struct tolerance {
+  const char *name;
+  int64_t ulps;
+  double abs;
+  int64_t worst_ulps;           /* the largest differences seen */
+  double worst_abs;
+};
+
+enum { T_PI, T_THETAH, T_THETAW, T_H, T_D, T_HO, T_HF, T_R2, T_FS, NTOL };
+
+static struct tolerance tol[NTOL] = {
+  { "pi",     1024,    1e-12, 0, 0.0 },
+  { "thetaH", 1024,    1e-12, 0, 0.0 },
+  { "thetaW", 1024,    0.0,   0, 0.0 },
+  { "H",      1024,    1e-10, 0, 0.0 },
+  { "D",      1 << 16, 1e-12, 0, 0.0 },
+  { "ho",     64,      1e-15, 0, 0.0 },
+  { "hf",     4,       0.0,   0, 0.0 },
+  { "R2",     1024,    1e-13, 0, 0.0 },
+  { "Fs",     1024,    1e-12, 0, 0.0 },
+};
+
+static const char *path;        /* the path being checked, for messages */
+static int nsam, nsites, round_no;
+
+/* the distance between two doubles in units in the last place */
+static int64_t ulps(double a, double b)
+{
+  int64_t ia, ib;
+
+  memcpy(&ia, &a, sizeof(ia));
+  memcpy(&ib, &b, sizeof(ib));
+  if (ia < 0)
+    ia = INT64_MIN - ia;
+  if (ib < 0)
+    ib = INT64_MIN - ib;
+  return ia > ib ? ia - ib : ib - ia;
+}
+
+static void check_within(int t, double got, double want, double abs)
+{
+  int64_t u;
+  double d;
+
+  /* an undefined statistic (Tajima's D of three samples is 0/0) may come
+   * out nan or +-inf depending on how the numerator rounds */
+  if (got == want || (!isfinite(got) && !isfinite(want)))
+    return;
+  u = ulps(got, want);
+  d = fabs(got - want);
+  if (u > tol[t].worst_ulps)
+    tol[t].worst_ulps = u;
+  if (d > tol[t].worst_abs)
+    tol[t].worst_abs = d;
+  if (u <= tol[t].ulps || d <= abs)
+    return;
+  fprintf(stderr, "%s: %s is %.17g, reference %.17g (%lld ulps) in round %d, nsam %d, nsites %d\n",
+          path, tol[t].name, got, want, (long long)u, round_no, nsam, nsites);
+  exit(1);
+}
+
+static void check(int t, double got, double want)
+{
+  check_within(t, got, want, tol[t].abs);
+}
+
+static void check_int(const char *name, int got, int want)
+{
+  if (got == want)
+    return;
+  fprintf(stderr, "%s: %s is %d, reference %d in round %d, nsam %d, nsites %d\n",
+          path, name, got, want, round_no, nsam, nsites);
+  exit(1);
+}
+
+/* the reference values of a replicate */
+struct reference {
+  double pi, th, tw, H, D, ho, hf, r2, fs;
+  int ss, nss, nh, ns, ih;
+  int sfs[MAXSAM];
+};
+
+static void check_results(const struct ss_results *res, const struct reference *ref,
+                          unsigned mask)
+{
+  mask &= res->mask;
+  if (mask & SS_PI)     check(T_PI, res->pi, ref->pi);
+  if (mask & SS_THETAH) check(T_THETAH, res->thetaH, ref->th);
+  if (mask & SS_THETAW) check(T_THETAW, res->thetaW, ref->tw);
+  if (mask & SS_H)      check(T_H, res->H, ref->H);
+  if (mask & SS_D)      check(T_D, res->D, ref->D);
+  if (mask & SS_HO)     check(T_HO, res->ho, ref->ho);
+  if (mask & SS_HF)     check(T_HF, res->hf, ref->hf);
+  if (mask & SS_R2)     check(T_R2, res->r2, ref->r2);
+  if (mask & SS_FS)     check(T_FS, res->fs, ref->fs);
+  if (mask & SS_SS)     check_int("ss", res->ss, ref->ss);
+  if (mask & SS_NSS)    check_int("nss", res->nss, ref->nss);
+  if (mask & SS_NH)     check_int("nh", res->nh, ref->nh);
+  if (mask & SS_NS)     check_int("ns", res->ns, ref->ns);
+  if (mask & SS_IH)     check_int("ih", res->ih, ref->ih);
+  if (mask & SS_SFS) {
+    check_int("sfs length", res->sfs_len, nsam - 1);
+    if (memcmp(res->sfs, ref->sfs, (nsam - 1) * sizeof(int)) != 0)
+      check_int("sfs", 1, 0);
+  }
+}
+
+/* a cached result has to be the same to the bit as the one worked out */
+static void check_same(const struct ss_results *got, const struct ss_results *want)
+{
+  const double *g[] = { &got->pi, &got->thetaH, &got->thetaW, &got->H, &got->D,
+                        &got->ho, &got->hf, &got->r2, &got->fs };
+  const double *w[] = { &want->pi, &want->thetaH, &want->thetaW, &want->H, &want->D,
+                        &want->ho, &want->hf, &want->r2, &want->fs };
+  int t;
+
+  for (t = 0; t < NTOL; t++)
+    if (memcmp(g[t], w[t], sizeof(double)) != 0)
+      check(t, *g[t], -*w[t] - 1.0);
+  check_int("ss", got->ss, want->ss);
+  check_int("nss", got->nss, want->nss);
+  check_int("nh", got->nh, want->nh);
+  check_int("ns", got->ns, want->ns);
+  check_int("ih", got->ih, want->ih);
+  check_int("sfs length", got->sfs_len, want->sfs_len);
+  if (memcmp(got->sfs, want->sfs, want->sfs_len * sizeof(int)) != 0)
+    check_int("sfs", 1, 0);
+}
+
+/* With every sample a haplotype of its own, S' is the chance of nsam
+ * alleles, theta^nsam / (theta (theta + 1) ... (theta + nsam - 1)), and Fs
+ * is its log odds; Fs() returns -10000 once S' is below 1e-37. Summed as
+ * 1 - S this used to be nothing but rounding error. */
+static void check_fs_all_distinct(void)
+{
+  const double thetas[] = { 0.5, 4.0, 21.822421, 25.457837, 80.0 };
+  const int sizes[] = { 2, 10, 64, 70, 129, 300 };
+  double ls, want;
+  int i, j, k;
+
+  path = "Fs, all haplotypes distinct";
+  for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+    for (k = 0; k < (int)(sizeof(thetas) / sizeof(thetas[0])); k++) {
+      nsam = sizes[i];
+      ls = nsam * log(thetas[k]);
+      for (j = 0; j < nsam; j++)
+        ls -= log(thetas[k] + j);
+      want = ls < log(1e-37) ? -10000 : ls - log1p(-exp(ls));
+      check_within(T_FS, Fs(nsam, thetas[k], nsam), want, 1e-10);
+    }
+}
+
+int main(int argc, char *argv[]) {
+  static char ascii[MAXSAM][MAXSITES + 1];
+  static unsigned char bytes[MAXSAM][MAXSITES];
+  static unsigned char bits[MAXSAM][(MAXSITES + 7) / 8];
+  static int site_freqs[MAXSITES], agct_counts[4 * MAXSITES], *agct_freqs[MAXSITES];
+  static int hap_freqs[MAXSAM], unic_freqs[MAXSAM], sfs[MAXSAM], cached_sfs[MAXSAM];
+  const char *isas[] = { "generic", "sse4.2", "avx2", "avx512" };
+  const char bases[] = "AGCT";
+  const unsigned all = SS_PI | SS_SS | SS_D | SS_THETAH | SS_H | SS_THETAW | SS_NH | SS_NS
+                       | SS_HO | SS_NSS | SS_HF | SS_IH | SS_R2 | SS_FS | SS_SFS;
+  char *list[MAXSAM];
+  struct reference ref;
+  struct ss_replicate rep;
+  struct ss_results res, cached, one;
+  static struct ss_results batched[3];
+  struct ss_replicate batch[3];
+  struct ss_window win;
+  struct ss_workspace *ws, *cws;
+  int rounds, verbose, i, j, t, isa, nfounders, enc, size;
+  long hits, misses, kept = 0;
+
+  verbose = argc > 1 && !strcmp(argv[1], "-v");
+  rounds = argc > 1 + verbose ? atoi(argv[1 + verbose]) : 200;
+  x = argc > 2 + verbose ? strtoul(argv[2 + verbose], NULL, 10) : 97531;
+
+  check_fs_all_distinct();
+
+  ws = ss_workspace_new();
+  cws = ss_workspace_new();
+  if (ss_set_cache(cws, 3) != SS_OK)
+    check_int("ss_set_cache", 1, 0);
+  for (j = 0; j < MAXSITES; j++)
+    agct_freqs[j] = agct_counts + 4 * j;
+  res.sfs = sfs;
+  cached.sfs = cached_sfs;
+
+  for (round_no = 0; round_no < rounds; round_no++) {
+    /* mostly the packed sizes, sometimes the big ones; a few founders
+     * some of the time, so that haplotypes repeat */
+    nsam = next_int(4) ? 2 + next_int(127) : 129 + next_int(MAXSAM - 128);
+    nsites = next_int(8) ? next_int(400) : next_int(MAXSITES + 1);
+    nfounders = next_int(2) ? nsam : 1 + next_int(nsam);
+    memset(bits, 0, sizeof(bits));
+    for (j = 0; j < nsites; j++) {
+      t = 1 + next_int(8);
+      for (i = 0; i < nsam; i++)
+        ascii[i][j] = i < nfounders ? (next_int(t) == 0 ? '1' : '0')
+                                    : ascii[next_int(nfounders)][j];
+      /* every site segregates, as in ms output */
+      for (i = 1; i < nsam && ascii[i][j] == ascii[0][j]; i++)
+        ;
+      if (i == nsam)
+        ascii[next_int(nsam)][j] ^= 1;
+    }
+    for (i = 0; i < nsam; i++) {
+      ascii[i][nsites] = '\0';
+      list[i] = ascii[i];
+      for (j = 0; j < nsites; j++) {
+        bytes[i][j] = ascii[i][j] == '1';
+        if (ascii[i][j] == '1')
+          bits[i][j / 8] |= 1 << (j % 8);
+      }
+    }
+
+    /* the reference */
+    for (j = 0; j < nsites; j++)
+      site_freqs[j] = frequency('1', j, nsam, list);
+    ref.ss = nsites;
+    ref.pi = theta_pi(nsam, nsites, site_freqs);
+    ref.th = theta_h(nsam, nsites, site_freqs);
+    ref.tw = theta_w(nsam, nsites, site_freqs);
+    ref.H = ref.pi - ref.th;
+    ref.D = tajd(nsam, nsites, ref.pi);
+    ref.nss = num_singleton_sites(nsites, site_freqs);
+    site_frequency_spectrum(nsam, nsites, site_freqs, ref.sfs);
+    count_haplotype_frequencies(nsam, nsites, list, hap_freqs);
+    ref.nh = num_haplotypes(nsam, hap_freqs);
+    ref.ns = num_singletons(nsam, hap_freqs);
+    ref.ho = homozygosity(nsam, hap_freqs);
+    ref.hf = (double)nsam / ref.nh;
+    ref.ih = max_identical_haplotypes(nsam, hap_freqs);
+    count_binary_unic_frequencies(nsam, nsites, list, site_freqs, unic_freqs);
+    ref.r2 = R2(unic_freqs, ref.pi, nsam, nsites);
+    ref.fs = Fs(nsam, ref.pi, ref.nh);
+
+    /* ss_compute(), with every instruction set and encoding */
+    rep.nsam = nsam;
+    rep.nsites = nsites;
+    rep.alphabet = SS_BINARY;
+    for (isa = 0; isa < 4; isa++) {
+      if (ss_set_isa(isas[isa]) != SS_OK)
+        continue;
+      for (enc = 0; enc < 3; enc++) {
+        path = enc == 0 ? "ss_compute ascii" : enc == 1 ? "ss_compute bytes" : "ss_compute bits";
+        rep.encoding = enc == 0 ? SS_ASCII : enc == 1 ? SS_BYTES : SS_BITS;
+        rep.data = enc == 0 ? (unsigned char *)ascii : enc == 1 ? bytes[0] : bits[0];
+        rep.stride = enc == 0 ? MAXSITES + 1 : enc == 1 ? MAXSITES : (MAXSITES + 7) / 8;
+        if (ss_compute(&rep, all, ws, &res) != SS_OK)
+          check_int("ss_compute", 1, 0);
+        check_results(&res, &ref, all);
+      }
+
+      /* one window over the whole replicate, and every sample as the one
+       * subsample */
+      rep.encoding = SS_ASCII;
+      rep.data = (unsigned char *)ascii;
+      rep.stride = MAXSITES + 1;
+      if (nsites > 0) {
+        path = "ss_compute_windows";
+        if (ss_compute_windows(&rep, NULL, nsites, nsites, nsites, all, ws, &win) != 1)
+          check_int("ss_compute_windows", 1, 0);
+        check_int("window sites", win.nsites, nsites);
+        check_results(&win.res, &ref, SS_WINDOW_STATS);
+      }
+      path = "ss_compute_subsamples";
+      size = nsam;
+      if (ss_compute_subsamples(&rep, 1, &size, NULL, all, ws, &res) != SS_OK)
+        check_int("ss_compute_subsamples", 1, 0);
+      check_results(&res, &ref, SS_SUBSAMPLE_STATS);
+    }
+    ss_set_isa("auto");
+
+    /* through the cache: worked out the first time, found the second */
+    path = "ss_compute cached";
+    if (ss_compute(&rep, all, ws, &res) != SS_OK)
+      check_int("ss_compute", 1, 0);
+    for (t = 0; t < 2; t++) {
+      if (ss_compute(&rep, all, cws, &cached) != SS_OK)
+        check_int("ss_compute", 1, 0);
+      check_same(&cached, &res);
+    }
+    if ((long)nsam * nsites <= 65536)  /* larger ones are not kept */
+      kept++;
+
+    /* the same replicate as nucleotides: '1' one base, '0' another, at
+     * each site, against the per-site agct code */
+    for (i = 0; i < nsam; i++)
+      for (j = 0; j < nsites; j++)
+        ascii[i][j] = ascii[i][j] == '1' ? bases[j % 4] : bases[(j + 1 + (j / 4) % 3) % 4];
+    calculate_site_frequencies(nsam, nsites, list, agct_freqs);
+    ref.pi = agct_theta_pi(nsam, nsites, agct_freqs);
+    ref.ss = num_segregating_sites(nsam, nsites, agct_freqs);
+    ref.tw = agct_theta_w(nsam, ref.ss);
+    ref.D = tajd(nsam, ref.ss, ref.pi);
+    ref.nss = agct_num_singleton_sites(nsites, agct_freqs);
+    count_agct_unic_frequencies(nsam, nsites, list, agct_freqs, unic_freqs);
+    ref.r2 = R2(unic_freqs, ref.pi, nsam, ref.ss);
+    ref.fs = Fs(nsam, ref.pi, ref.nh);
+    rep.alphabet = SS_AGCT;
+    path = "ss_compute agct";
+    if (ss_compute(&rep, all & ~SS_SFS, ws, &res) != SS_OK)
+      check_int("ss_compute", 1, 0);
+    check_results(&res, &ref, all & ~SS_SFS);
+    if (nsites > 0) {
+      path = "ss_compute_windows agct";
+      if (ss_compute_windows(&rep, NULL, nsites, nsites, nsites, all, ws, &win) != 1)
+        check_int("ss_compute_windows", 1, 0);
+      check_results(&win.res, &ref, SS_WINDOW_STATS & ~(SS_THETAH | SS_H));
+    }
+
+    /* many at once: the whole replicate, the first half of its samples and
+     * the first half of its sites, with an N and a gap thrown in, through
+     * ss_compute_batch() and through ss_compute() one by one */
+    if (nsites > 0) {
+      ascii[next_int(nsam)][next_int(nsites)] = 'N';
+      ascii[next_int(nsam)][next_int(nsites)] = '-';
+    }
+    for (t = 0; t < 3; t++)
+      batch[t] = rep;
+    batch[1].nsam = (nsam + 1) / 2;
+    batch[2].nsites = nsites / 2;
+    path = "ss_compute_batch";
+    if (ss_compute_batch(batch, 3, all & ~SS_SFS, ws, batched) != SS_OK)
+      check_int("ss_compute_batch", 1, 0);
+    for (t = 0; t < 3; t++) {
+      memset(&one, 0, sizeof(one));
+      if (ss_compute(batch + t, all & ~SS_SFS, ws, &one) != SS_OK)
+        check_int("ss_compute", 1, 0);
+      check_same(batched + t, &one);
+    }
+  }
+
+  if (verbose) {
+    printf("%d replicates; largest differences from the reference:\n", rounds);
+    for (t = 0; t < NTOL; t++)
+      printf("  %-8s %12lld ulps %12.3g (tolerance %lld ulps or %g)\n", tol[t].name,
+             (long long)tol[t].worst_ulps, tol[t].worst_abs, (long long)tol[t].ulps, tol[t].abs);
+  }
+
+  /* the second of each pair was found, and the larger ones never looked
+   * for */
+  path = "cache";
+  ss_cache_counts(cws, &hits, &misses);
+  if (hits < kept)
+    check_int("cache hits", (int)hits, (int)kept);
+  check_int("cache lookups", (int)(hits + misses), (int)(2 * kept));
+
+  ss_workspace_free(ws);
+  ss_workspace_free(cws);
+  return 0;
+}
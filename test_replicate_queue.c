@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "samplestats.h"
+#include "replicate_queue.h"
+
+#define NREPS     2000
+#define MAXSAM    30
+#define MAXSITES  200
+
+static struct ss_queue *q;
+static unsigned stats = SS_PI | SS_SS | SS_D | SS_THETAH | SS_H | SS_THETAW | SS_NH |
+                        SS_NS | SS_HO | SS_NSS | SS_HF | SS_IH | SS_R2 | SS_FS | SS_SFS |
+                        SS_FULID | SS_FULIF | SS_FULIDS | SS_FULIFS | SS_HNORM | SS_ZENGE |
+                        SS_H1 | SS_H12 | SS_H2H1 | SS_HFS | SS_MISMATCH | SS_RAGGED;
+
+/* fill a replicate deterministically from its number */
+static void make_replicate(unsigned long n, struct ss_replicate *rep, unsigned char *data, size_t stride)
+{
+  int i, j;
+  unsigned long x = n * 2654435761u + 1;
+
+  rep->nsam = 2 + n % (MAXSAM - 1);
+  rep->nsites = (n * 7) % MAXSITES;
+  for (i = 0; i < rep->nsam; i++) {
+    for (j = 0; j < rep->nsites; j++) {
+      x = x * 6364136223846793005ul + 1442695040888963407ul;
+      data[i*stride + j] = ((x >> 33) % 4 == 0) ? '1' : '0';
+    }
+    data[i*stride + rep->nsites] = '\0';
+  }
+}
+
+static void *producer(void *arg)
+{
+  unsigned long n;
+  struct ss_slot *slot;
+
+  (void)arg;
+  for (n = 0; n < NREPS; n++) {
+    slot = ss_queue_acquire(q);
+    make_replicate(n, &slot->rep, (unsigned char *)slot->rep.data, slot->rep.stride);
+    ss_queue_submit(q, slot, stats);
+  }
+
+  return NULL;
+}
+
+int main(void) {
+  pthread_t thread;
+  struct ss_slot *slot;
+  struct ss_replicate rep;
+  struct ss_results res;
+  struct ss_workspace *ws;
+  unsigned char data[MAXSAM * (MAXSITES + 1)];
+  int sfs[MAXSAM], hfs[MAXSAM];
+  long mismatch[MAXSITES + 1];
+  unsigned long n;
+
+  q = ss_queue_new(4, 16, MAXSAM, MAXSITES, SS_BINARY, SS_ASCII);
+  assert(q != NULL);
+  ws = ss_workspace_new();
+  assert(ws != NULL);
+
+  assert(pthread_create(&thread, NULL, producer, NULL) == 0);
+
+  /* results must come back in order and match a direct calculation */
+  for (n = 0; n < NREPS; n++) {
+    while ((slot = ss_queue_collect(q)) == NULL)
+      ;
+    assert(slot->seq == n);
+    assert(slot->status == SS_OK);
+
+    rep.alphabet = SS_BINARY;
+    rep.encoding = SS_ASCII;
+    rep.data = data;
+    rep.stride = MAXSITES + 1;
+    res.sfs = sfs;
+    res.hfs = hfs;
+    res.mismatch = mismatch;
+    make_replicate(n, &rep, data, rep.stride);
+    assert(ss_compute(&rep, stats, ws, &res) == SS_OK);
+
+    assert(slot->rep.nsam == rep.nsam);
+    assert(slot->res.ss == res.ss);
+    assert(slot->res.nh == res.nh);
+    assert(slot->res.pi == res.pi);
+    assert(slot->res.D == res.D);
+    assert(slot->res.thetaH == res.thetaH);
+    assert(slot->res.r2 == res.r2);
+    assert(slot->res.fs == res.fs);
+    assert(slot->res.ho == res.ho);
+    assert(slot->res.fuliF == res.fuliF);
+    assert(slot->res.fuliDs == res.fuliDs);
+    assert(slot->res.E == res.E);
+    assert(slot->res.sfs_len == res.sfs_len);
+    assert(!memcmp(slot->res.sfs, res.sfs, res.sfs_len * sizeof(int)));
+    assert(slot->res.h12 == res.h12);
+    assert(slot->res.hfs_len == res.hfs_len);
+    assert(!memcmp(slot->res.hfs, res.hfs, res.hfs_len * sizeof(int)));
+    assert(slot->res.ragged == res.ragged);
+    assert(slot->res.mismatch_len == res.mismatch_len);
+    assert(!memcmp(slot->res.mismatch, res.mismatch, res.mismatch_len * sizeof(long)));
+
+    ss_queue_release(q, slot);
+  }
+
+  assert(pthread_join(thread, NULL) == 0);
+  assert(ss_queue_collect(q) == NULL);
+
+  ss_queue_free(q);
+  ss_workspace_free(ws);
+
+  exit(0);
+}
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+#include "samplestats.h"
+#include "packed.h"
+#include "prefetch.h"
+#include "vcf.h"
+
+#define HEADER "##fileformat=VCFv4.2\n##contig=<ID=1>\n" \
+               "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT"
+#define MAXSAMPLES 70
+#define NSITES     300
+
+static unsigned long x = 2468;
+
+static int next_bit(int one_in)
+{
+  x = x * 6364136223846793005ul + 1442695040888963407ul;
+  return (x >> 33) % one_in == 0;
+}
+
+/* a reader over a temporary file holding <text> */
+static struct vcf *open_text(const char *text, FILE **f, struct prefetch **pf)
+{
+  assert((*f = tmpfile()) != NULL);
+  fputs(text, *f);
+  rewind(*f);
+  *pf = prefetch_open(fileno(*f));
+  return vcf_open(*pf);
+}
+
+static void close_text(struct vcf *v, FILE *f, struct prefetch *pf)
+{
+  vcf_close(v);
+  prefetch_close(pf);
+  fclose(f);
+}
+
+/* the allele of haplotype h at site j of a window */
+static int allele(const struct vcf_window *w, int j, int h)
+{
+  return (int)(w->cols[(size_t)j*w->colwords + h/64] >> (h % 64) & 1);
+}
+
+/* the skipped records, the windows and the columns of a small file */
+static void check_small(void)
+{
+  static const char *text =
+    HEADER "\ts1\ts2\ts3\n"
+    "1\t100\t.\tA\tG\t.\tPASS\t.\tGT\t0|1\t1|1\t0|0\n"
+    "1\t150\t.\tA\tG,T\t.\tPASS\t.\tGT\t0|1\t1|1\t0|0\n"
+    "1\t200\trs1\tA\tG\t50\tPASS\tAC=2;AN=6\tDP:GT\t3:0|0\t4:1|0\t5:0|1\n"
+    "1\t250\t.\tA\tG\t.\tPASS\t.\tGT\t0/1\t1|1\t0|0\n"
+    "1\t260\t.\tA\tG\t.\tPASS\t.\tGT\t.|.\t1|1\t0|0\n"
+    "1\t270\t.\tA\t.\t.\tPASS\t.\tGT\t0|0\t0|0\t0|0\n"
+    "1\t280\t.\tA\tG\t.\tPASS\t.\tDP\t3\t4\t5\n"
+    "1\t290\t.\tA\tG\t.\tPASS\t.\tGT\t0\t1|1\t0|0\n"
+    "1\t1200\t.\tC\tT\t.\tPASS\t.\tGT\t1|1\t1|1\t1|1\n"
+    "1\t1300\t.\tC\tT\t.\tPASS\t.\tGT\t1/1\t0|0\t0|0\r\n"
+    "\n"
+    "1\t3500\t.\tC\tT\t.\tPASS\t.\tGT\t0|0\t0|0\t0|1\n"
+    "2\t5\t.\tC\tT\t.\tPASS\t.\tGT\t1|0\t0|1\t0|0\n";
+  static const int hap100[6] = {0, 1, 1, 1, 0, 0},
+                   hap200[6] = {0, 0, 1, 0, 0, 1};
+  struct vcf *v;
+  struct vcf_window w;
+  struct prefetch *pf;
+  FILE *f;
+  int h;
+
+  assert((v = open_text(text, &f, &pf)) != NULL);
+  assert(vcf_nsamples(v) == 3);
+  memset(&w, 0, sizeof(w));
+
+  /* 1-1000: two sites, with REF as 0 and ALT as 1 */
+  assert(vcf_read_window(v, 1000, &w) == 2);
+  assert(strcmp(w.chrom, "1") == 0 && w.start == 1 && w.end == 1000);
+  assert(w.nhap == 6 && w.colwords == 1);
+  assert(w.positions[0] == 100 && w.positions[1] == 200);
+  for (h = 0; h < 6; h++) {
+    assert(allele(&w, 0, h) == hap100[h]);
+    assert(allele(&w, 1, h) == hap200[h]);
+  }
+  /* multiallelic, unphased, missing, no ALT, no GT and haploid records
+   * are skipped; the monomorphic site at 1200 is dropped silently */
+  assert(vcf_skipped(v) == 6);
+
+  /* 1001-2000: "1/1" is as good as "1|1" */
+  assert(vcf_read_window(v, 1000, &w) == 1);
+  assert(w.start == 1001 && w.end == 2000 && w.positions[0] == 1300);
+  assert(w.cols[0] == 3);
+
+  /* the windows between sites are there, with no sites */
+  assert(vcf_read_window(v, 1000, &w) == 0);
+  assert(w.start == 2001 && w.end == 3000);
+  assert(vcf_read_window(v, 1000, &w) == 1);
+  assert(w.start == 3001 && w.positions[0] == 3500 && w.cols[0] == 0x20);
+
+  /* a new chromosome starts with the window of its first site */
+  assert(vcf_read_window(v, 1000, &w) == 1);
+  assert(strcmp(w.chrom, "2") == 0 && w.start == 1 && w.end == 1000);
+  assert(w.cols[0] == 0x9);
+  assert(vcf_read_window(v, 1000, &w) == VCF_END);
+  assert(vcf_read_window(v, 1000, &w) == VCF_END);
+  assert(vcf_skipped(v) == 6);
+  close_text(v, f, pf);
+
+  /* width 0: a window per chromosome, ending at its last site */
+  assert((v = open_text(text, &f, &pf)) != NULL);
+  assert(vcf_read_window(v, 0, &w) == 4);
+  assert(strcmp(w.chrom, "1") == 0 && w.start == 1 && w.end == 3500);
+  assert(vcf_read_window(v, 0, &w) == 1);
+  assert(strcmp(w.chrom, "2") == 0 && w.end == 5);
+  assert(vcf_read_window(v, 0, &w) == VCF_END);
+  close_text(v, f, pf);
+
+  vcf_window_free(&w);
+}
+
+/* what cannot be read */
+static void check_bad(void)
+{
+  static char text[300*64];
+  char *p;
+  struct vcf *v;
+  struct vcf_window w;
+  struct prefetch *pf;
+  FILE *f;
+  int i;
+
+  /* no #CHROM line, or no samples on it */
+  assert(open_text("ms 4 1 -t 5\n1 2 3\n", &f, &pf) == NULL);
+  close_text(NULL, f, pf);
+  assert(open_text(HEADER "\n1\t100\t.\tA\tG\t.\t.\t.\tGT\n", &f, &pf) == NULL);
+  close_text(NULL, f, pf);
+
+  /* records out of order along a chromosome, the last on line 7 */
+  memset(&w, 0, sizeof(w));
+  assert((v = open_text(HEADER "\ts1\n"
+                        "1\t200\t.\tA\tG\t.\t.\t.\tGT\t0|1\n"
+                        "2\t100\t.\tA\tG\t.\t.\t.\tGT\t0|1\n"
+                        "2\t300\t.\tA\tG\t.\t.\t.\tGT\t0|1\n"
+                        "2\t250\t.\tA\tG\t.\t.\t.\tGT\t0|1\n", &f, &pf)) != NULL);
+  assert(vcf_read_window(v, 0, &w) == 1);
+  assert(vcf_read_window(v, 0, &w) == VCF_EBAD);
+  assert(vcf_line(v) == 7);
+  close_text(v, f, pf);
+
+  /* a chromosome come back to after another, on line 7, even in a
+   * record that would be skipped */
+  assert((v = open_text(HEADER "\ts1\n"
+                        "A\t100\t.\tA\tG\t.\t.\t.\tGT\t0|1\n"
+                        "B\t100\t.\tA\tG\t.\t.\t.\tGT\t0|1\n"
+                        "B\t200\t.\tA\tG\t.\t.\t.\tGT\t0|1\n"
+                        "A\t401\t.\tA\tG,T\t.\t.\t.\tGT\t0|1\n", &f, &pf)) != NULL);
+  assert(vcf_read_window(v, 1000, &w) == 1);
+  assert(strcmp(w.chrom, "A") == 0);
+  assert(vcf_read_window(v, 1000, &w) == VCF_EBAD);
+  assert(vcf_line(v) == 7);
+  close_text(v, f, pf);
+
+  /* many chromosomes, one block each, and one of them come back to */
+  p = text + sprintf(text, HEADER "\ts1\n");
+  for (i = 0; i < 300; i++)
+    p += sprintf(p, "c%d\t5\t.\tA\tG\t.\t.\t.\tGT\t0|1\n", i);
+  strcpy(p, "c17\t9\t.\tA\tG\t.\t.\t.\tGT\t0|1\n");
+  assert((v = open_text(text, &f, &pf)) != NULL);
+  for (i = 0; i < 299; i++)
+    assert(vcf_read_window(v, 0, &w) == 1);
+  assert(vcf_read_window(v, 0, &w) == VCF_EBAD);
+  assert(vcf_line(v) == 304);
+  close_text(v, f, pf);
+
+  /* a record cut short */
+  assert((v = open_text(HEADER "\ts1\ts2\n"
+                        "1\t200\t.\tA\tG\t.\t.\t.\tGT\t0|1\n", &f, &pf)) != NULL);
+  assert(vcf_read_window(v, 0, &w) == VCF_EBAD);
+  close_text(v, f, pf);
+
+  vcf_window_free(&w);
+}
+
+/* random phased genotypes: the window's columns, turned into SS_BITS rows,
+ * must give the same statistics as the segregating sites as ms rows, and
+ * a long INFO field must not get in the way */
+static void check_stats(int nsamples)
+{
+  static char rows[2*MAXSAMPLES][NSITES + 1];
+  static unsigned char bits[2*MAXSAMPLES][8*PACKED_WORDS(NSITES)];
+  char *text, *p, info[6000];
+  int nhap = 2*nsamples, h, j, s, nseg, ones, a[2*MAXSAMPLES];
+  struct vcf *v;
+  struct vcf_window w;
+  struct prefetch *pf;
+  struct ss_replicate rep;
+  struct ss_workspace *ws;
+  struct ss_results res1, res2;
+  int sfs1[2*MAXSAMPLES], sfs2[2*MAXSAMPLES], hfs1[2*MAXSAMPLES], hfs2[2*MAXSAMPLES];
+  unsigned stats = SS_PI | SS_SS | SS_D | SS_THETAH | SS_H | SS_THETAW | SS_HO | SS_NH
+                   | SS_NS | SS_NSS | SS_ZNS | SS_SFS | SS_HFS | SS_H1 | SS_H12;
+  FILE *f;
+
+  memset(info, 'A', sizeof(info) - 1);
+  info[sizeof(info) - 1] = '\0';
+  assert((text = (char *)malloc(NSITES*(sizeof(info) + 4*MAXSAMPLES + 64) + 4096)) != NULL);
+  p = text + sprintf(text, HEADER);
+  for (s = 0; s < nsamples; s++)
+    p += sprintf(p, "\ts%d", s);
+  p += sprintf(p, "\n");
+
+  nseg = 0;
+  for (j = 0; j < NSITES; j++) {
+    ones = 0;
+    for (h = 0; h < nhap; h++)
+      ones += a[h] = next_bit(j % 3 + 2);
+    p += sprintf(p, "1\t%d\t.\tA\tT\t.\tPASS\t%s\tGT", 10*j + 7, j % 50 == 0 ? info : ".");
+    for (s = 0; s < nsamples; s++)
+      p += sprintf(p, "\t%d|%d", a[2*s], a[2*s + 1]);
+    p += sprintf(p, "\n");
+    if (ones == 0 || ones == nhap)
+      continue;
+    for (h = 0; h < nhap; h++)
+      rows[h][nseg] = '0' + a[h];
+    nseg++;
+  }
+
+  assert((v = open_text(text, &f, &pf)) != NULL);
+  memset(&w, 0, sizeof(w));
+  assert(vcf_read_window(v, 0, &w) == nseg);
+  assert(vcf_skipped(v) == 0);
+  assert(w.colwords == (size_t)PACKED_WORDS(nhap));
+  for (j = 0; j < nseg; j++)
+    for (h = 0; h < nhap; h++)
+      assert(allele(&w, j, h) == rows[h][j] - '0');
+  assert(vcf_read_window(v, 0, &w) == VCF_END);
+  packed_column_rows(nhap, nseg, w.cols, w.colwords, bits[0], sizeof(bits[0]));
+  close_text(v, f, pf);
+
+  assert((ws = ss_workspace_new()) != NULL);
+  memset(&res1, 0, sizeof(res1));
+  memset(&res2, 0, sizeof(res2));
+  res1.sfs = sfs1;
+  res1.hfs = hfs1;
+  res2.sfs = sfs2;
+  res2.hfs = hfs2;
+  rep.nsam = nhap;
+  rep.alphabet = SS_BINARY;
+  rep.nsites = nseg;
+  rep.encoding = SS_ASCII;
+  rep.data = (unsigned char *)rows[0];
+  rep.stride = sizeof(rows[0]);
+  assert(ss_compute(&rep, stats, ws, &res1) == SS_OK);
+  rep.encoding = SS_BITS;
+  rep.data = bits[0];
+  rep.stride = sizeof(bits[0]);
+  assert(ss_compute(&rep, stats, ws, &res2) == SS_OK);
+
+  assert(res1.ss == nseg && res2.ss == nseg);
+  assert(fabs(res1.pi - res2.pi) < 1e-9);
+  assert(fabs(res1.D - res2.D) < 1e-9);
+  assert(fabs(res1.thetaH - res2.thetaH) < 1e-9);
+  assert(fabs(res1.H - res2.H) < 1e-9);
+  assert(fabs(res1.thetaW - res2.thetaW) < 1e-9);
+  assert(fabs(res1.ho - res2.ho) < 1e-9);
+  assert(fabs(res1.zns - res2.zns) < 1e-9);
+  assert(fabs(res1.h1 - res2.h1) < 1e-9);
+  assert(fabs(res1.h12 - res2.h12) < 1e-9);
+  assert(res1.sfs_len == nhap - 1 && res2.sfs_len == nhap - 1);
+  assert(res1.nh == res2.nh && res1.ns == res2.ns && res1.nss == res2.nss);
+  assert(memcmp(sfs1, sfs2, (nhap - 1)*sizeof(int)) == 0);
+  assert(memcmp(hfs1, hfs2, res1.nh*sizeof(int)) == 0);
+
+  ss_workspace_free(ws);
+  vcf_window_free(&w);
+  free(text);
+}
+
+int main(void) {
+  check_small();
+  check_bad();
+  /* 64 and 128 haplotypes or fewer fit the packed kernels' columns */
+  check_stats(5);
+  check_stats(32);
+  check_stats(33);
+  check_stats(64);
+  check_stats(MAXSAMPLES);
+
+  return EXIT_SUCCESS;
+}
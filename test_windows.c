@@ -0,0 +1,252 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+#include "samplestats.h"
+
+#define MAXSAM    150
+#define MAXSITES  400
+#define MAXWIN    2000
+
+static unsigned long x = 2468;
+
+static int next_int(int n)
+{
+  x = x * 6364136223846793005ul + 1442695040888963407ul;
+  return (int)((x >> 33) % n);
+}
+
+/* D and Fs are not finite for some small windows; both sides must agree */
+static int close_to(double a, double b)
+{
+  if (a == b || (isnan(a) && isnan(b)))
+    return 1;
+  return fabs(a - b) <= 1e-9 * (fabs(a) + fabs(b)) + 1e-12;
+}
+
+/* every window must agree with ss_compute() on the same columns */
+static void check(int nsam, int nsites, int alphabet, const double *positions,
+                  double length, double width, double step, char rows[][MAXSITES + 1],
+                  struct ss_workspace *ws, struct ss_workspace *ws2)
+{
+  static struct ss_window win[MAXWIN];
+  const unsigned mask = SS_WINDOW_STATS;
+  struct ss_replicate rep, sub;
+  struct ss_results res;
+  int nwin, w, j;
+  double pos;
+
+  rep.nsam = nsam;
+  rep.nsites = nsites;
+  rep.alphabet = alphabet;
+  rep.encoding = SS_ASCII;
+  rep.data = (unsigned char *)rows[0];
+  rep.stride = MAXSITES + 1;
+
+  nwin = ss_num_windows(length, width, step);
+  assert(nwin > 0 && nwin <= MAXWIN);
+  assert(ss_compute_windows(&rep, positions, length, width, step, mask, ws, win) == nwin);
+
+  /* windows that overlap or abut leave no site out, up to the end */
+  if (step <= width) {
+    assert(win[nwin - 1].end >= length * (1.0 - 1e-9));
+    for (j = 0; j < nsites; j++) {
+      pos = positions ? positions[j] : j;
+      for (w = 0; w < nwin && !(pos >= win[w].start && pos < win[w].end); w++)
+        ;
+      assert(w < nwin || pos >= length);
+    }
+  }
+
+  for (w = 0; w < nwin; w++) {
+    /* the window holds exactly the sites in [start, end) */
+    for (j = 0; j < nsites; j++) {
+      pos = positions ? positions[j] : j;
+      assert((pos >= win[w].start && pos < win[w].end)
+             == (j >= win[w].first && j < win[w].first + win[w].nsites));
+    }
+
+    sub = rep;
+    sub.nsites = win[w].nsites;
+    sub.data = rep.data + win[w].first;
+    assert(ss_compute(&sub, mask, ws2, &res) == SS_OK);
+    assert(win[w].res.mask == res.mask);
+    assert(win[w].res.ss == res.ss);
+    assert(close_to(win[w].res.pi, res.pi));
+    assert(close_to(win[w].res.D, res.D));
+    assert(close_to(win[w].res.thetaW, res.thetaW));
+    if (alphabet == SS_BINARY) {
+      assert(close_to(win[w].res.thetaH, res.thetaH));
+      assert(close_to(win[w].res.H, res.H));
+    }
+    assert(win[w].res.nh == res.nh);
+    assert(win[w].res.ns == res.ns);
+    assert(win[w].res.nss == res.nss);
+    assert(win[w].res.ih == res.ih);
+    assert(close_to(win[w].res.ho, res.ho));
+    assert(close_to(win[w].res.hf, res.hf));
+    assert(close_to(win[w].res.h1, res.h1));
+    assert(close_to(win[w].res.h12, res.h12));
+    assert(close_to(win[w].res.h2h1, res.h2h1));
+    /* agct pi is summed exactly here but site by site in ss_compute(), and
+     * Fs turns a difference in the last bit of pi into a big one */
+    if (win[w].res.pi == res.pi)
+      assert(close_to(win[w].res.fs, res.fs));
+  }
+}
+
+/* the key samplestats.c gives a '1' at site j */
+static uint64_t site_key(int j)
+{
+  uint64_t z = ((uint64_t)j << 8 | '1') + 0x9e3779b97f4a7c15ull;
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+/* 65 keys of 64 bits cannot all be independent: some of them XOR to 0,
+ * so a sample with '1's at just those sites hashes as one with none.
+ * The two must still count as two haplotypes. */
+static void check_collision(char rows[][MAXSITES + 1], struct ss_workspace *ws,
+                            struct ss_workspace *ws2)
+{
+  static unsigned char combo[64][65], c[65];
+  uint64_t basis[64], v;
+  int j, k, b, nsites = 65;
+  struct ss_window win[1];
+  struct ss_replicate rep;
+
+  memset(basis, 0, sizeof(basis));
+  for (j = 0; j < nsites; j++) {
+    v = site_key(j);
+    memset(c, 0, sizeof(c));
+    c[j] = 1;
+    for (b = 63; b >= 0 && v != 0; b--) {
+      if (!(v >> b & 1))
+        continue;
+      if (basis[b] == 0) {
+        basis[b] = v;
+        memcpy(combo[b], c, sizeof(c));
+        break;
+      }
+      v ^= basis[b];
+      for (k = 0; k < nsites; k++)
+        c[k] ^= combo[b][k];
+    }
+    if (v == 0)
+      break;
+  }
+  assert(j < nsites);
+
+  for (j = 0; j < nsites; j++) {
+    rows[0][j] = '0';
+    rows[1][j] = rows[2][j] = '0' + c[j];
+  }
+  rep.nsam = 3;
+  rep.nsites = nsites;
+  rep.alphabet = SS_BINARY;
+  rep.encoding = SS_ASCII;
+  rep.data = (unsigned char *)rows[0];
+  rep.stride = MAXSITES + 1;
+  assert(ss_compute_windows(&rep, NULL, nsites, nsites, nsites, SS_NH | SS_NS, ws, win) == 1);
+  assert(win[0].res.nh == 2 && win[0].res.ns == 1);
+  check(3, nsites, SS_BINARY, NULL, nsites, nsites, nsites, rows, ws, ws2);
+}
+
+int main(void) {
+  static char rows[MAXSAM][MAXSITES + 1];
+  static double positions[MAXSITES];
+  static struct ss_window win[4];
+  const char agct[] = "AGCT";
+  const int sizes[] = { 2, 7, 64, 129, 150 };
+  struct ss_replicate rep;
+  struct ss_workspace *ws, *ws2;
+  int t, i, j, nsam, nsites;
+
+  ws = ss_workspace_new();
+  ws2 = ss_workspace_new();
+  assert(ws != NULL && ws2 != NULL);
+
+  assert(ss_num_windows(1.0, 0.1, 0.05) == 19);
+  /* 0.9 to 1 is left after three windows of 0.3: a fourth ends at 1 */
+  assert(ss_num_windows(1.0, 0.3, 0.3) == 4);
+  assert(ss_num_windows(1.0, 0.25, 0.25) == 4);
+  assert(ss_num_windows(1.0, 0.1, 0.4) == 3);
+  assert(ss_num_windows(10.0, 20.0, 1.0) == 1);
+  assert(ss_num_windows(1.0, 0.0, 0.1) == 0);
+
+  for (t = 0; t < (int)(sizeof(sizes) / sizeof(sizes[0])); t++) {
+    nsam = sizes[t];
+    nsites = t % 2 ? MAXSITES : 97;
+
+    /* binary data, made of a few founder haplotypes so that windows
+     * hold repeated haplotypes, at sorted positions with some ties */
+    for (i = 0; i < nsam; i++) {
+      for (j = 0; j < nsites; j++)
+        rows[i][j] = i > 0 && next_int(8) ? rows[next_int(i)][j] : '0' + next_int(2);
+      rows[i][nsites] = '\0';
+    }
+    positions[0] = 0.0;
+    for (j = 1; j < nsites; j++)
+      positions[j] = positions[j - 1] + (next_int(4) ? next_int(1000) * 1e-6 : 0.0);
+    for (j = 0; j < nsites; j++)
+      positions[j] /= positions[nsites - 1] + 1e-6;
+
+    check(nsam, nsites, SS_BINARY, positions, 1.0, 1.0, 1.0, rows, ws, ws2);
+    check(nsam, nsites, SS_BINARY, positions, 1.0, 0.1, 0.05, rows, ws, ws2);
+    check(nsam, nsites, SS_BINARY, positions, 1.0, 0.05, 0.2, rows, ws, ws2);
+    check(nsam, nsites, SS_BINARY, positions, 1.0, 0.013, 0.001, rows, ws, ws2);
+    check(nsam, nsites, SS_BINARY, NULL, nsites, 10, 3, rows, ws, ws2);
+
+    /* nucleotides, on the alignment columns */
+    for (i = 0; i < nsam; i++) {
+      for (j = 0; j < nsites; j++)
+        rows[i][j] = i > 0 && next_int(6) ? rows[next_int(i)][j] : agct[next_int(j % 3 + 1)];
+      if (i % 5 == 1)
+        rows[i][next_int(nsites)] = 'N';
+    }
+    check(nsam, nsites, SS_AGCT, NULL, nsites, nsites, 1, rows, ws, ws2);
+    check(nsam, nsites, SS_AGCT, NULL, nsites, 25, 10, rows, ws, ws2);
+    check(nsam, nsites, SS_AGCT, NULL, nsites, 7, 13, rows, ws, ws2);
+  }
+
+  /* a site in the tail, past the last window that fits */
+  rep.nsam = 2;
+  rep.nsites = 3;
+  rep.alphabet = SS_BINARY;
+  rep.encoding = SS_ASCII;
+  rep.data = (unsigned char *)rows[0];
+  rep.stride = MAXSITES + 1;
+  memcpy(rows[0], "010", 3);
+  memcpy(rows[1], "101", 3);
+  positions[0] = 0.1;
+  positions[1] = 0.5;
+  positions[2] = 0.95;
+  assert(ss_compute_windows(&rep, positions, 1.0, 0.3, 0.3, SS_SS, ws, win) == 4);
+  assert(fabs(win[3].start - 0.7) < 1e-12 && fabs(win[3].end - 1.0) < 1e-12);
+  assert(win[3].first == 2 && win[3].nsites == 1 && win[3].res.ss == 1);
+  check(2, 3, SS_BINARY, positions, 1.0, 0.3, 0.3, rows, ws, ws2);
+  check(2, 3, SS_BINARY, positions, 1.0, 0.4, 0.25, rows, ws, ws2);
+
+  check_collision(rows, ws, ws2);
+
+  /* positions must not go down */
+  rep.nsam = 2;
+  rep.nsites = 3;
+  rep.alphabet = SS_BINARY;
+  rep.encoding = SS_ASCII;
+  rep.data = (unsigned char *)rows[0];
+  rep.stride = MAXSITES + 1;
+  positions[0] = 0.5;
+  positions[1] = 0.2;
+  positions[2] = 0.9;
+  assert(ss_compute_windows(&rep, positions, 1.0, 0.5, 0.5, SS_PI, ws, win) == SS_EINVAL);
+  assert(ss_compute_windows(&rep, NULL, 3.0, 0.0, 1.0, SS_PI, ws, win) == SS_EINVAL);
+
+  ss_workspace_free(ws);
+  ss_workspace_free(ws2);
+  return 0;
+}
@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "work_pool.h"
+
+#define NTASKS    20000
+#define CHUNK     64
+
+static int tasks[NTASKS];
+static _Atomic int runs[NTASKS];
+static _Atomic long by_others;
+
+struct source {
+  pthread_mutex_t lock;
+  int next,             /* next task to hand out */
+      chunk,            /* tasks handed out per fill (all of them with 0) */
+      busy,             /* fills to answer "none just now" first */
+      nthreads,
+      filler;           /* the thread that got all the tasks (chunk 0) */
+};
+
+static int fill(struct work_pool *pool, int worker, void *arg)
+{
+  struct source *s = (struct source *)arg;
+  int i, n;
+
+  pthread_mutex_lock(&s->lock);
+  if (s->busy > 0) {
+    s->busy--;
+    pthread_mutex_unlock(&s->lock);
+    return -1;
+  }
+  n = s->chunk > 0 ? s->chunk : NTASKS;
+  if (n > NTASKS - s->next)
+    n = NTASKS - s->next;
+  if (n > 0 && s->chunk == 0)
+    s->filler = worker;
+  for (i = 0; i < n; i++)
+    assert(work_push(pool, worker, &tasks[s->next++]) == 0);
+  pthread_mutex_unlock(&s->lock);
+  return n;
+}
+
+static void run(void *task, int worker, void *arg)
+{
+  struct source *s = (struct source *)arg;
+  volatile double x = 1.0;
+  int i;
+
+  atomic_fetch_add(&runs[*(int *)task], 1);
+  if (s->chunk == 0 && worker != s->filler)
+    atomic_fetch_add(&by_others, 1);
+  /* with every task on one thread, that thread holds back until another
+   * has stolen one, so that stealing is sure to be seen */
+  while (s->chunk == 0 && s->nthreads > 1 && worker == s->filler
+         && atomic_load(&by_others) == 0)
+    sched_yield();
+  for (i = 0; i < 200; i++)
+    x = x * 1.0000001 + 1e-9;
+}
+
+static long run_pool(int nthreads, int chunk, int busy)
+{
+  struct source s;
+  long steals;
+  int i;
+
+  for (i = 0; i < NTASKS; i++) {
+    tasks[i] = i;
+    atomic_init(&runs[i], 0);
+  }
+  atomic_init(&by_others, 0);
+  pthread_mutex_init(&s.lock, NULL);
+  s.next = 0;
+  s.chunk = chunk;
+  s.busy = busy;
+  s.nthreads = nthreads;
+  s.filler = -1;
+
+  steals = work_pool_run(nthreads, fill, run, &s);
+  assert(steals >= 0);
+
+  /* every task ran exactly once */
+  assert(s.next == NTASKS);
+  for (i = 0; i < NTASKS; i++)
+    assert(atomic_load(&runs[i]) == 1);
+  pthread_mutex_destroy(&s.lock);
+  return steals;
+}
+
+int main(void) {
+  int nthreads;
+
+  for (nthreads = 1; nthreads <= 8; nthreads *= 2) {
+    /* a little work at a time to each thread that asks */
+    run_pool(nthreads, CHUNK, 0);
+    /* the same, after a source that has nothing to give at first */
+    run_pool(nthreads, CHUNK, 100);
+    /* everything to the first thread that asks: the others can only
+     * steal, and must (1 thread has no one to steal from) */
+    if (nthreads == 1)
+      assert(run_pool(nthreads, 0, 0) == 0);
+    else {
+      assert(run_pool(nthreads, 0, 0) > 0);
+      assert(atomic_load(&by_others) > 0);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
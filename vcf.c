@@ -0,0 +1,447 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "vcf.h"
+
+/* Streaming reader of phased VCF (see vcf.h) */
+
+struct vcf {
+    struct prefetch *in;            /* the input */
+    char    *line;                  /* the current line */
+    size_t  line_size;              /* room in it */
+    long    lineno,                 /* its number */
+            skipped;                /* records passed over */
+    int     nsamples,               /* samples on the #CHROM line */
+            nhap;                   /* haplotypes, 2 per sample */
+    size_t  colwords;               /* words per column */
+
+    uint64_t *rec;                  /* the column of the last record read */
+    long    rec_pos;                /* its position */
+    char    rec_chrom[VCF_MAXCHROM];/* and chromosome */
+    int     have_rec,               /* 1 once a record has been read, 2 while
+                                     *   it waits for the next window */
+            in_chrom;               /* 1 once a window has been started */
+    char    chrom[VCF_MAXCHROM];    /* the chromosome of the windows */
+    long    next_start;             /* where the next window on it starts */
+
+    char    **done;                 /* the chromosomes finished with, in an
+                                     *   open addressed hash table */
+    size_t  ndone,                  /* how many */
+            done_size;              /* slots in the table (a power of 2) */
+};
+
+/*  Hash a chromosome name (FNV-1a)
+ *
+ *      name        - the name
+ *      len         - its length
+ *
+ *  Returns the hash
+ */
+static size_t name_hash(const char *name, size_t len)
+{
+    uint32_t h;                     /* the hash so far */
+    size_t  i;                      /* iterator */
+
+    h = 2166136261u;
+    for (i=0; i<len; i++)
+        h = (h ^ (unsigned char)name[i])*16777619u;
+    return h;
+}
+
+/*  Find a chromosome among those finished with
+ *
+ *      v           - the reader
+ *      name        - the name (not '\0' terminated)
+ *      len         - its length
+ *
+ *  Returns the slot holding it, or the empty slot it would go in
+ */
+static size_t done_slot(const struct vcf *v, const char *name, size_t len)
+{
+    size_t  i;                      /* the slot */
+
+    for (i=name_hash(name, len) & (v->done_size - 1); v->done[i] != NULL;
+         i=(i + 1) & (v->done_size - 1))
+        if (strncmp(v->done[i], name, len) == 0 && v->done[i][len] == '\0')
+            break;
+    return i;
+}
+
+/*  Record that a chromosome is finished with, growing the table to keep
+ *    it at most half full
+ *
+ *      v           - the reader
+ *      name        - the chromosome
+ *
+ *  Returns 0, or VCF_ENOMEM
+ */
+static int add_done(struct vcf *v, const char *name)
+{
+    char    **old;                  /* the table before it grew */
+    size_t  old_size,               /* and its size */
+            i;                      /* iterator */
+
+    if (2*(v->ndone + 1) > v->done_size) {
+        old = v->done;
+        old_size = v->done_size;
+        v->done_size = old_size > 0 ? 2*old_size : 64;
+        if (!(v->done = (char **)calloc(v->done_size, sizeof(char *)))) {
+            v->done = old;
+            v->done_size = old_size;
+            return VCF_ENOMEM;
+        }
+        for (i=0; i<old_size; i++)
+            if (old[i] != NULL)
+                v->done[done_slot(v, old[i], strlen(old[i]))] = old[i];
+        free(old);
+    }
+    i = done_slot(v, name, strlen(name));
+    if (v->done[i] == NULL) {
+        if (!(v->done[i] = (char *)malloc(strlen(name) + 1)))
+            return VCF_ENOMEM;
+        strcpy(v->done[i], name);
+        v->ndone++;
+    }
+    return 0;
+}
+
+/*  Find the end of a tab delimited field
+ *
+ *      p           - the start of the field
+ *      end         - the end of the line
+ *
+ *  Returns the tab after the field, or NULL if it is the last
+ */
+static char *field_end(char *p, char *end)
+{
+    return (char *)memchr(p, '\t', end - p);
+}
+
+/*  Read the next line that is not empty
+ *
+ *      v           - the reader
+ *      end         - where to put the end of the line, newline dropped
+ *
+ *  Returns the line, or NULL at end of input (or if out of memory)
+ */
+static char *next_line(struct vcf *v, char **end)
+{
+    long    n;                      /* length of the line */
+
+    do {
+        if ((n = prefetch_getline(&v->line, &v->line_size, v->in)) < 0)
+            return NULL;
+        v->lineno++;
+        while (n > 0 && (v->line[n - 1] == '\n' || v->line[n - 1] == '\r'))
+            n--;
+    } while (n == 0);
+    *end = v->line + n;
+    return v->line;
+}
+
+/*  Set up a reader, reading the header up to and including the #CHROM line
+ *
+ *      in          - the input
+ *
+ *  Returns the reader, or NULL if there is no #CHROM line with samples on
+ *    it (or out of memory)
+ */
+struct vcf *vcf_open(struct prefetch *in)
+{
+    struct vcf *v;                  /* the reader we are creating here */
+    char    *p,                     /* where we are in the line */
+            *end;                   /* its end */
+    int     nfields;                /* fields on the #CHROM line */
+
+    if (!(v = (struct vcf *)calloc(1, sizeof(struct vcf))))
+        return NULL;
+    v->in = in;
+
+    /* the meta-information lines come first, then the column names */
+    while ((p = next_line(v, &end)) != NULL && strncmp(p, "##", 2) == 0)
+        ;
+    if (p == NULL || strncmp(p, "#CHROM", 6) != 0) {
+        vcf_close(v);
+        return NULL;
+    }
+    for (nfields=1; (p = field_end(p, end)) != NULL; p++)
+        nfields++;
+
+    /* CHROM POS ID REF ALT QUAL FILTER INFO FORMAT, then the samples */
+    v->nsamples = nfields - 9;
+    v->nhap = 2*v->nsamples;
+    v->colwords = ((size_t)v->nhap + 63)/64;
+    if (v->nsamples < 1 || !(v->rec = (uint64_t *)malloc(v->colwords*sizeof(uint64_t)))) {
+        vcf_close(v);
+        return NULL;
+    }
+    return v;
+}
+
+/*  Read a record into v->rec: the next one for a biallelic site that
+ *    segregates in the samples, with every genotype phased
+ *
+ *      v           - the reader
+ *
+ *  Returns 1, 0 at end of input, or VCF_EBAD or VCF_ENOMEM
+ */
+static int read_record(struct vcf *v)
+{
+    char    *p,                     /* where we are in the line */
+            *q,                     /* the end of the current field */
+            *end;                   /* the end of the line */
+    int     i, s,                   /* iterators */
+            gt,                     /* index of GT among the FORMAT keys */
+            ok,                     /* 0 once the record is to be skipped */
+            ones,                   /* ALT alleles */
+            rc;                     /* return code */
+    long    pos;                    /* the record's position */
+    size_t  len;                    /* length of the chromosome name */
+    uint64_t word;                  /* 32 samples' alleles */
+    unsigned char a, sep, b;        /* the characters of a genotype */
+
+    for (;;) {
+        if ((p = next_line(v, &end)) == NULL)
+            return 0;
+        if (p[0] == '#')
+            continue;
+
+        /* CHROM */
+        if ((q = field_end(p, end)) == NULL || (len = q - p) >= VCF_MAXCHROM)
+            return VCF_EBAD;
+        /* POS; records must come in order along each chromosome, and each
+         * chromosome's records all together */
+        pos = strtol(q + 1, &p, 10);
+        if (pos < 1 || *p != '\t')
+            return VCF_EBAD;
+        if (v->have_rec && (strncmp(v->rec_chrom, q - len, len) != 0
+                            || v->rec_chrom[len] != '\0')) {
+            /* on to a new chromosome: the last one is finished with */
+            if ((rc = add_done(v, v->rec_chrom)) != 0)
+                return rc;
+            if (v->done[done_slot(v, q - len, len)] != NULL)
+                return VCF_EBAD;
+        } else if (v->have_rec && pos < v->rec_pos) {
+            return VCF_EBAD;
+        }
+        memcpy(v->rec_chrom, q - len, len);
+        v->rec_chrom[len] = '\0';
+        v->rec_pos = pos;
+        v->have_rec = 1;
+
+        /* ID, REF */
+        for (i=0; i<2; i++)
+            if ((p = field_end(p + 1, end)) == NULL)
+                return VCF_EBAD;
+        /* ALT: one allele, and not "." */
+        p++;
+        if ((q = field_end(p, end)) == NULL)
+            return VCF_EBAD;
+        ok = !(q - p == 1 && p[0] == '.') && memchr(p, ',', q - p) == NULL;
+        /* QUAL, FILTER, INFO are passed over */
+        for (i=0, p=q; i<3; i++)
+            if ((p = field_end(p + 1, end)) == NULL)
+                return VCF_EBAD;
+        /* FORMAT: where GT is among the keys */
+        p++;
+        if ((q = field_end(p, end)) == NULL)
+            return VCF_EBAD;
+        for (gt=0; p < q && !(q - p >= 2 && p[0] == 'G' && p[1] == 'T'
+                              && (p + 2 == q || p[2] == ':')); gt++) {
+            while (p < q && *p != ':')
+                p++;
+            if (p < q)
+                p++;
+        }
+        if (p >= q)
+            ok = 0;
+        if (!ok) {
+            v->skipped++;
+            continue;
+        }
+
+        /* the samples' GT entries, each "a|b" (or "a/a") with a and b 0 or 1 */
+        word = 0;
+        ones = 0;
+        for (s=0, p=q+1; s<v->nsamples; s++) {
+            if (p > end)
+                return VCF_EBAD;
+            for (i=0; i<gt && p < end && *p != '\t'; p++)
+                if (*p == ':')
+                    i++;
+            a = p + 3 <= end ? p[0] : 0;
+            sep = a ? p[1] : 0;
+            b = a ? p[2] : 0;
+            if (i < gt || !a || (a != '0' && a != '1') || (b != '0' && b != '1')
+                || (sep != '|' && !(sep == '/' && a == b))
+                || (p + 3 < end && p[3] != ':' && p[3] != '\t')) {
+                ok = 0;
+                break;
+            }
+            word |= (uint64_t)(a - '0') << (2*s % 64) | (uint64_t)(b - '0') << (2*s % 64 + 1);
+            ones += (a - '0') + (b - '0');
+            if (s % 32 == 31 || s == v->nsamples - 1) {
+                v->rec[s/32] = word;
+                word = 0;
+            }
+            /* on to the next sample */
+            p += 3;
+            if (p < end && *p != '\t' && (p = field_end(p, end)) == NULL)
+                p = end;
+            p++;
+        }
+        if (!ok) {
+            v->skipped++;
+            continue;
+        }
+        /* a site all the samples share does not segregate */
+        if (ones > 0 && ones < v->nhap)
+            return 1;
+    }
+}
+
+/*  Add the record read ahead to a window
+ *
+ *      v           - the reader
+ *      w           - the window
+ *
+ *  Returns 0, or VCF_ENOMEM
+ */
+static int add_site(struct vcf *v, struct vcf_window *w)
+{
+    void    *p;                     /* result of each reallocation */
+    int     n;                      /* new room */
+
+    if (w->nsites == w->maxsites) {
+        n = w->maxsites > 0 ? 2*w->maxsites : 1024;
+        if (!(p = realloc(w->cols, (size_t)n*v->colwords*sizeof(uint64_t))))
+            return VCF_ENOMEM;
+        w->cols = (uint64_t *)p;
+        if (!(p = realloc(w->positions, (size_t)n*sizeof(long))))
+            return VCF_ENOMEM;
+        w->positions = (long *)p;
+        w->maxsites = n;
+    }
+    memcpy(w->cols + (size_t)w->nsites*v->colwords, v->rec, v->colwords*sizeof(uint64_t));
+    w->positions[w->nsites++] = v->rec_pos;
+    return 0;
+}
+
+/*  Read the sites of the next window. Windows tile each chromosome from
+ *    the one holding its first site to the one holding its last, so some
+ *    may have no sites.
+ *
+ *      v           - the reader
+ *      width       - the width of the windows, in bases (0: a window per
+ *                    chromosome)
+ *      w           - where to put the sites (zeroed before first use)
+ *
+ *  Returns the number of sites, VCF_END after the last window, or
+ *    VCF_EBAD or VCF_ENOMEM
+ */
+int vcf_read_window(struct vcf *v, long width, struct vcf_window *w)
+{
+    int     rc;                     /* return code */
+
+    w->nhap = v->nhap;
+    w->colwords = v->colwords;
+    w->nsites = 0;
+
+    /* the next record decides where the window is */
+    if (v->have_rec < 2) {
+        if ((rc = read_record(v)) <= 0)
+            return rc == 0 ? VCF_END : rc;
+        v->have_rec = 2;
+    }
+    if (!v->in_chrom || strcmp(v->rec_chrom, v->chrom) != 0) {
+        strcpy(v->chrom, v->rec_chrom);
+        v->next_start = width > 0 ? (v->rec_pos - 1)/width*width + 1 : 1;
+        v->in_chrom = 1;
+    }
+    strcpy(w->chrom, v->chrom);
+    w->start = v->next_start;
+    w->end = width > 0 ? w->start + width - 1 : LONG_MAX;
+
+    /* take the records up to its end */
+    while (v->have_rec == 2 && v->rec_pos <= w->end && strcmp(v->rec_chrom, w->chrom) == 0) {
+        if ((rc = add_site(v, w)) != 0)
+            return rc;
+        if ((rc = read_record(v)) < 0)
+            return rc;
+        v->have_rec = rc == 1 ? 2 : 0;
+    }
+    if (width > 0)
+        v->next_start += width;
+    else
+        w->end = w->nsites > 0 ? w->positions[w->nsites - 1] : w->start;
+    return w->nsites;
+}
+
+/*  The number of samples on the #CHROM line
+ *
+ *      v           - the reader
+ *
+ *  Returns the number of samples
+ */
+int vcf_nsamples(const struct vcf *v)
+{
+    return v->nsamples;
+}
+
+/*  The line read last, to say where a malformed record is
+ *
+ *      v           - the reader
+ *
+ *  Returns the line number
+ */
+long vcf_line(const struct vcf *v)
+{
+    return v->lineno;
+}
+
+/*  The records passed over so far: not biallelic, or with a genotype
+ *    missing, haploid or unphased
+ *
+ *      v           - the reader
+ *
+ *  Returns the number of records
+ */
+long vcf_skipped(const struct vcf *v)
+{
+    return v->skipped;
+}
+
+/*  Free what a window holds
+ *
+ *      w           - the window
+ *
+ *  Returns nothing
+ */
+void vcf_window_free(struct vcf_window *w)
+{
+    free(w->cols);
+    free(w->positions);
+    memset(w, 0, sizeof(*w));
+}
+
+/*  Free a reader (the input is left open)
+ *
+ *      v           - the reader
+ *
+ *  Returns nothing
+ */
+void vcf_close(struct vcf *v)
+{
+    size_t  i;                      /* iterator */
+
+    if (v == NULL)
+        return;
+    for (i=0; i<v->done_size; i++)
+        free(v->done[i]);
+    free(v->done);
+    free(v->line);
+    free(v->rec);
+    free(v);
+}
@@ -0,0 +1,61 @@
+#ifndef VCF_H
+#define VCF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "prefetch.h"
+
+/* A streaming reader of phased VCF, for running the statistics on
+ * observed data a window of a chromosome at a time.
+ *
+ * Records are read a line at a time and cut up by hand: only CHROM, POS,
+ * ALT, FORMAT and the GT entry of each sample are looked at, and INFO is
+ * never parsed. Each biallelic site that segregates in the samples becomes
+ * a column of a bit per haplotype (two per sample, in sample order), set
+ * for the ALT allele, so REF is taken as ancestral. Up to 128 haplotypes
+ * the columns are laid out as the packed kernels' own (packed.h), and
+ * packed_column_rows() turns a window of them into SS_BITS rows for
+ * ss_compute(). Records that are not biallelic, or where a sample's GT is
+ * missing, haploid or an unphased heterozygote, are skipped and counted.
+ * Records must be sorted by position along each chromosome, and each
+ * chromosome's records must come together in one block.
+ *
+ * Only one window of sites is held at a time, so memory goes with the
+ * sites of a window and the longest line, not with the chromosome. */
+
+#define VCF_MAXCHROM    256         /* longest chromosome name, and its '\0' */
+
+/* Return codes */
+#define VCF_END         (-1)        /* the input has ended */
+#define VCF_EBAD        (-2)        /* a malformed or out of order record, or
+                                     *   a chromosome come back to
+                                     *   (vcf_line() tells which) */
+#define VCF_ENOMEM      (-3)        /* out of memory */
+
+/* The sites of one window, grown by vcf_read_window() as needed */
+struct vcf_window {
+    char    chrom[VCF_MAXCHROM];    /* the chromosome */
+    long    start,                  /* the first position of the window */
+            end;                    /* and the last (for a whole chromosome,
+                                     *   that of its last site) */
+    int     nhap,                   /* haplotypes: 2 per sample */
+            nsites,                 /* sites in the window */
+            maxsites;               /* sites cols and positions have room for */
+    size_t  colwords;               /* words per column: (nhap + 63)/64 */
+    uint64_t *cols;                 /* site j's column at cols + j*colwords,
+                                     *   haplotype h in bit h%64 of word h/64 */
+    long    *positions;             /* the POS of each site */
+};
+
+struct vcf;
+
+struct vcf *vcf_open(struct prefetch *in);
+int vcf_nsamples(const struct vcf *v);
+int vcf_read_window(struct vcf *v, long width, struct vcf_window *w);
+long vcf_line(const struct vcf *v);
+long vcf_skipped(const struct vcf *v);
+void vcf_window_free(struct vcf_window *w);
+void vcf_close(struct vcf *v);
+
+#endif /* VCF_H */
@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "work_pool.h"
+
+#define CACHE_LINE 64
+
+/* The tasks of one thread, oldest first, in a ring that grows as needed.
+ * The owner pushes and pops at the newest end and thieves take from the
+ * oldest; both go through the lock, but ntasks can be read without it to
+ * pass over empty deques cheaply. */
+struct work_deque {
+    pthread_mutex_t lock;
+    void            **items;            /* the ring */
+    int             size,               /* room in it */
+                    head;               /* index of the oldest task */
+    _Atomic int     ntasks;             /* tasks in it */
+};
+
+/* deques padded out to whole cache lines, so that threads working on
+ * their own deques do not share lines */
+union work_padded_deque {
+    struct work_deque d;
+    char            pad[CACHE_LINE * ((sizeof(struct work_deque) + CACHE_LINE - 1) / CACHE_LINE)];
+};
+
+struct work_thread {
+    struct work_pool *pool;             /* the pool this thread belongs to */
+    int             id;                 /* index of its deque */
+    pthread_t       thread;
+};
+
+struct work_pool {
+    int             nthreads;           /* number of deques */
+    union work_padded_deque *deques;
+    work_fill_fn    fill;               /* the caller's functions */
+    work_run_fn     run;
+    void            *arg;               /* and their argument */
+    _Atomic int     done,               /* set once fill has returned 0 */
+                    failed;             /* set if a push ran out of memory */
+    _Atomic long    steals;             /* tasks taken from another deque */
+};
+
+/*  Take the newest task of a thread's own deque
+ *
+ *      d           - the deque
+ *
+ *  Returns the task, or NULL if the deque is empty
+ */
+static void *pop_newest(struct work_deque *d)
+{
+    void    *task;                      /* the task taken */
+    int     n;                          /* tasks in the deque */
+
+    if (atomic_load_explicit(&d->ntasks, memory_order_relaxed) == 0)
+        return NULL;
+    task = NULL;
+    pthread_mutex_lock(&d->lock);
+    if ((n = atomic_load_explicit(&d->ntasks, memory_order_relaxed)) > 0) {
+        task = d->items[(d->head + n - 1) % d->size];
+        atomic_store_explicit(&d->ntasks, n - 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&d->lock);
+    return task;
+}
+
+/*  Take the oldest task of another thread's deque
+ *
+ *      d           - the deque
+ *
+ *  Returns the task, or NULL if the deque is empty
+ */
+static void *steal_oldest(struct work_deque *d)
+{
+    void    *task;                      /* the task taken */
+    int     n;                          /* tasks in the deque */
+
+    if (atomic_load_explicit(&d->ntasks, memory_order_relaxed) == 0)
+        return NULL;
+    task = NULL;
+    pthread_mutex_lock(&d->lock);
+    if ((n = atomic_load_explicit(&d->ntasks, memory_order_relaxed)) > 0) {
+        task = d->items[d->head];
+        d->head = (d->head + 1) % d->size;
+        atomic_store_explicit(&d->ntasks, n - 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&d->lock);
+    return task;
+}
+
+/*  Add a task to the newest end of a thread's deque. Meant for the fill
+ *    function, but a running task may push more tasks too.
+ *
+ *      pool        - the pool
+ *      worker      - the thread whose deque takes it (normally the caller)
+ *      task        - the task
+ *
+ *  Returns 0, or -1 if out of memory (the task is not added)
+ */
+int work_push(struct work_pool *pool, int worker, void *task)
+{
+    struct work_deque *d;               /* the deque */
+    void    **items;                    /* a bigger ring */
+    int     n,                          /* tasks in the deque */
+            size,                       /* room in the bigger ring */
+            i;                          /* iterator */
+
+    d = &pool->deques[worker].d;
+    pthread_mutex_lock(&d->lock);
+    n = atomic_load_explicit(&d->ntasks, memory_order_relaxed);
+    if (n == d->size) {
+        /* unroll the ring into one twice the size */
+        size = d->size > 0 ? 2*d->size : 16;
+        if ((items = (void **)malloc(size*sizeof(void *))) == NULL) {
+            pthread_mutex_unlock(&d->lock);
+            atomic_store(&pool->failed, 1);
+            return -1;
+        }
+        for (i=0; i<n; i++)
+            items[i] = d->items[(d->head + i) % d->size];
+        free(d->items);
+        d->items = items;
+        d->size = size;
+        d->head = 0;
+    }
+    d->items[(d->head + n) % d->size] = task;
+    atomic_store_explicit(&d->ntasks, n + 1, memory_order_relaxed);
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+/*  Wait a little before asking for work again: yield at first, then
+ *    sleep, so that idle threads do not burn a core
+ *
+ *      spins       - how many times we have waited so far (updated)
+ *
+ *  Returns nothing
+ */
+static void backoff(int *spins)
+{
+    struct timespec ts;
+
+    if (*spins < 64) {
+        (*spins)++;
+        sched_yield();
+    } else {
+        ts.tv_sec = 0;
+        ts.tv_nsec = 50000;
+        nanosleep(&ts, NULL);
+    }
+}
+
+/*  Body of each thread: run its own tasks, then other threads' tasks,
+ *    then ask for more, until there will be no more
+ */
+static void *work_thread(void *arg)
+{
+    struct work_thread *t;              /* this thread */
+    struct work_pool *pool;             /* its pool */
+    void    *task;                      /* the task being run */
+    int     i,                          /* iterator */
+            n,                          /* tasks fill pushed */
+            spins;                      /* for backing off when idle */
+
+    t = (struct work_thread *)arg;
+    pool = t->pool;
+    spins = 0;
+
+    for (;;) {
+        task = pop_newest(&pool->deques[t->id].d);
+        /* steal, going round the others from the next thread on */
+        for (i=1; task == NULL && i<pool->nthreads; i++)
+            if ((task = steal_oldest(&pool->deques[(t->id + i) % pool->nthreads].d)) != NULL)
+                atomic_fetch_add_explicit(&pool->steals, 1, memory_order_relaxed);
+        if (task != NULL) {
+            pool->run(task, t->id, pool->arg);
+            spins = 0;
+            continue;
+        }
+        if (atomic_load(&pool->done) || atomic_load(&pool->failed))
+            break;
+        if ((n = pool->fill(pool, t->id, pool->arg)) == 0)
+            atomic_store(&pool->done, 1);
+        else if (n < 0)
+            backoff(&spins);
+    }
+
+    return NULL;
+}
+
+/*  Run tasks on a pool of threads until there are no more. The calling
+ *    thread is one of them.
+ *
+ *      nthreads    - number of threads (fewer are used if some cannot be
+ *                    started)
+ *      fill        - pushes new tasks when a thread runs out
+ *      run         - runs a task
+ *      arg         - handed to fill and run
+ *
+ *  Returns the number of tasks run by a thread other than the one they were
+ *    pushed to, or -1 if out of memory (tasks may then be left unrun)
+ */
+long work_pool_run(int nthreads, work_fill_fn fill, work_run_fn run, void *arg)
+{
+    struct work_pool pool;              /* the pool */
+    struct work_thread *threads;        /* its threads */
+    int     i,                          /* iterator */
+            nstarted;                   /* threads started besides this one */
+
+    if (nthreads < 1)
+        nthreads = 1;
+    pool.nthreads = nthreads;
+    pool.fill = fill;
+    pool.run = run;
+    pool.arg = arg;
+    atomic_init(&pool.done, 0);
+    atomic_init(&pool.failed, 0);
+    atomic_init(&pool.steals, 0);
+    pool.deques = (union work_padded_deque *)calloc(nthreads, sizeof(union work_padded_deque));
+    threads = (struct work_thread *)calloc(nthreads, sizeof(struct work_thread));
+    if (pool.deques == NULL || threads == NULL) {
+        free(pool.deques);
+        free(threads);
+        return -1;
+    }
+    for (i=0; i<nthreads; i++) {
+        pthread_mutex_init(&pool.deques[i].d.lock, NULL);
+        atomic_init(&pool.deques[i].d.ntasks, 0);
+        threads[i].pool = &pool;
+        threads[i].id = i;
+    }
+
+    /* the first thread is this one; run with the others we managed to start */
+    for (nstarted=1; nstarted<nthreads; nstarted++)
+        if (pthread_create(&threads[nstarted].thread, NULL, work_thread,
+                           &threads[nstarted]) != 0)
+            break;
+    work_thread(&threads[0]);
+    for (i=1; i<nstarted; i++)
+        pthread_join(threads[i].thread, NULL);
+
+    for (i=0; i<nthreads; i++) {
+        pthread_mutex_destroy(&pool.deques[i].d.lock);
+        free(pool.deques[i].d.items);
+    }
+    free(pool.deques);
+    free(threads);
+
+    return atomic_load(&pool.failed) ? -1 : atomic_load(&pool.steals);
+}
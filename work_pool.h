@@ -0,0 +1,42 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+/* A work-stealing pool of threads, for work that comes in small tasks of
+ * uneven size from several sources at once (e.g. the replicates of many
+ * input files).
+ *
+ * Each thread keeps a deque of tasks. It runs the newest task of its own
+ * deque first, which is the one most likely still in its cache, and when
+ * that is empty steals the oldest task of another thread's deque. Only
+ * when there is nothing to run or steal does it ask the caller for more
+ * work, through a fill function that pushes new tasks onto the asking
+ * thread's deque. The pool ends once fill has said there will be no more
+ * and every deque is empty. */
+
+struct work_pool;
+
+/*  Called by a thread with nothing to run: push new tasks with work_push()
+ *
+ *      pool        - the pool
+ *      worker      - the thread asking (0 .. nthreads - 1)
+ *      arg         - as given to work_pool_run()
+ *
+ *  Returns the number of tasks pushed, 0 if there will never be more, or
+ *    -1 if there are none just now (the thread waits a little and asks again)
+ */
+typedef int (*work_fill_fn)(struct work_pool *pool, int worker, void *arg);
+
+/*  Called to run a task, on whichever thread took it
+ *
+ *      task        - the task
+ *      worker      - the thread running it (0 .. nthreads - 1)
+ *      arg         - as given to work_pool_run()
+ *
+ *  Returns nothing
+ */
+typedef void (*work_run_fn)(void *task, int worker, void *arg);
+
+long work_pool_run(int nthreads, work_fill_fn fill, work_run_fn run, void *arg);
+int work_push(struct work_pool *pool, int worker, void *task);
+
+#endif /* WORK_POOL_H */